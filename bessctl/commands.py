@@ -298,7 +298,7 @@ def get_var_attrs(cli, var_token, partial_word):
         elif var_token == '[SCHEDULER]':
             var_type = 'name'
             var_desc = 'specify the type of scheduler (none for default)'
-            var_candidates = ['', 'experimental']
+            var_candidates = ['', 'experimental', 'adaptive']
 
         elif var_token == 'PORT':
             var_type = 'name'
@@ -1010,22 +1010,49 @@ def delete_connection(cli, module, ogate):
         cli.bess.resume_all()
 
 
+@cmd('rebalance workers',
+     'Move a migratable task from the most loaded worker to the least loaded')
+def rebalance_workers(cli):
+    ret = cli.bess.rebalance_workers()
+    if ret.from_wid < 0:
+        cli.fout.write('  Sampled worker load, run again to rebalance\n')
+    elif ret.moved:
+        cli.fout.write('  Moved %s from worker %d (load %.2f) to worker %d '
+                       '(load %.2f)\n' % (ret.name, ret.from_wid,
+                                          ret.from_load, ret.to_wid,
+                                          ret.to_load))
+    else:
+        cli.fout.write('  Nothing moved (worker %d load %.2f, worker %d load '
+                       '%.2f)\n' % (ret.from_wid, ret.from_load, ret.to_wid,
+                                     ret.to_load))
+
+
 def _show_worker_header(cli):
-    cli.fout.write('  %10s%10s%10s%10s%16s\n' % (
+    cli.fout.write('  %10s%10s%10s%10s%16s%8s%8s%8s%8s%8s\n' % (
         'Worker ID',
         'Status',
         'CPU core',
         '# of TCs',
-        'Deadend pkts'))
+        'Deadend pkts',
+        'Busy%',
+        'Spin%',
+        'Pause%',
+        'Wait%',
+        'Sleep%'))
 
 
 def _show_worker(cli, w):
-    cli.fout.write('  %10d%10s%10d%10d%16d\n' % (
-        w.wid,
-        'RUNNING' if w.running else 'PAUSED',
-        w.core,
-        w.num_tcs,
-        w.silent_drops))
+    cycles = [w.cycles_busy, w.cycles_idle_spin, w.cycles_idle_pause,
+              w.cycles_idle_wait, w.cycles_idle_sleep]
+    total = sum(cycles) or 1
+
+    cli.fout.write('  %10d%10s%10d%10d%16d%8.1f%8.1f%8.1f%8.1f%8.1f\n' % (
+        (w.wid,
+         'RUNNING' if w.running else 'PAUSED',
+         w.core,
+         w.num_tcs,
+         w.silent_drops) +
+        tuple(100.0 * c / total for c in cycles)))
 
 
 @cmd('show worker', 'Show the status of all worker threads')
@@ -1401,6 +1428,9 @@ def _show_port(cli, port):
     cli.fout.write('bytes: {:<20,}\n'.format(stats.out.bytes))
     cli.fout.write('{:<14} dropped: {:<20,}\n'.format('', stats.out.dropped))
 
+    for name in sorted(stats.driver):
+        cli.fout.write('{:<14} {}: {:,}\n'.format('', name, stats.driver[name]))
+
 
 @cmd('show port', 'Show the status of all ports')
 def show_port_all(cli):
@@ -1429,11 +1459,23 @@ def show_port_list(cli, port_names):
             raise cli.CommandError('Port "%s" doest not exist' % port_name)
 
 
+def _show_batch_hist(cli, gate):
+    hist = ['%d:%d' % (size, cnt)
+            for size, cnt in enumerate(getattr(gate, 'batch_hist', []))
+            if cnt > 0]
+    if hist:
+        cli.fout.write('             batch sizes %s\n' % ' '.join(hist))
+
+
 def _show_module(cli, module_name):
     info = cli.bess.get_module_info(module_name)
 
     cli.fout.write('  %s::%s(%s)\n' % (info.name, info.mclass, info.desc))
 
+    if info.remote:
+        cli.fout.write('    WARNING: on NUMA node %d, but run by workers on '
+                       'other nodes\n' % info.socket)
+
     if len(info.metadata) > 0:
         cli.fout.write('    Per-packet metadata fields:\n')
         for field in info.metadata:
@@ -1462,6 +1504,7 @@ def _show_module(cli, module_name):
                            (gate.igate, track_str,
                             ', '.join('%s:%d ->' % (g.name, g.ogate)
                                       for g in gate.ogates)))
+            _show_batch_hist(cli, gate)
 
     if len(info.ogates) > 0:
         cli.fout.write('    Output gates:\n')
@@ -1475,6 +1518,7 @@ def _show_module(cli, module_name):
             cli.fout.write(
                 '      %5d: %s -> %d:%s\n' %
                 (gate.ogate, track_str, gate.igate, gate.name))
+            _show_batch_hist(cli, gate)
 
     if hasattr(info, 'dump'):
         dump_str = pprint.pformat(info.dump, width=74)
@@ -1740,7 +1784,8 @@ def monitor_port_all(cli, ports):
 
 
 TcCounterRate = collections.namedtuple('TcCounterRate',
-                                       ['count', 'cycles', 'bits', 'packets'])
+                                       ['count', 'cycles', 'bits', 'packets',
+                                        'polls', 'poll_hits'])
 
 
 def _monitor_tcs(cli, *tcs):
@@ -1749,20 +1794,23 @@ def _monitor_tcs(cli, *tcs):
         delta = TcCounterRate(count=(new.count - old.count) / sec_diff,
                               cycles=(new.cycles - old.cycles) / sec_diff,
                               bits=(new.bits - old.bits) / sec_diff,
-                              packets=(new.packets - old.packets) / sec_diff)
+                              packets=(new.packets - old.packets) / sec_diff,
+                              polls=(new.polls - old.polls) / sec_diff,
+                              poll_hits=(new.poll_hits - old.poll_hits) /
+                              sec_diff)
         return delta
 
     def print_header(timestamp):
         cli.fout.write('\n')
-        cli.fout.write('%-20s%12s%12s%12s%12s%12s%12s\n' %
+        cli.fout.write('%-20s%12s%12s%12s%12s%12s%12s%12s\n' %
                        (time.strftime('%X') + str(timestamp % 1)[1:8],
                         'CPU MHz', 'scheduled', 'Mpps', 'Mbps',
-                        'pkts/sched', 'cycles/p'))
+                        'pkts/sched', 'cycles/p', 'poll hit%'))
 
-        cli.fout.write('%s\n' % ('-' * 92))
+        cli.fout.write('%s\n' % ('-' * 104))
 
     def print_footer():
-        cli.fout.write('%s\n' % ('-' * 92))
+        cli.fout.write('%s\n' % ('-' * 104))
 
     def print_delta(tc, delta):
         if delta.count >= 1:
@@ -1775,14 +1823,20 @@ def _monitor_tcs(cli, *tcs):
         else:
             cpp = 0
 
-        cli.fout.write('%-20s%12.3f%12d%12.3f%12.3f%12.3f%12.3f\n' %
+        if delta.polls >= 1:
+            hit = 100.0 * delta.poll_hits / delta.polls
+        else:
+            hit = 0
+
+        cli.fout.write('%-20s%12.3f%12d%12.3f%12.3f%12.3f%12.3f%12.1f\n' %
                        (tc,
                         delta.cycles / 1e6,
                         delta.count,
                         delta.packets / 1e6,
                         delta.bits / 1e6,
                         ppb,
-                        cpp))
+                        cpp,
+                        hit))
 
     all_tcs = cli.bess.list_tcs().classes_status
     wids = {}
@@ -0,0 +1,73 @@
+# Copyright (c) 2017, Nefeli Networks, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# * Redistributions of source code must retain the above copyright notice, this
+# list of conditions and the following disclaimer.
+#
+# * Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# * Neither the names of the copyright holders nor the names of their
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+from test_utils import *
+
+
+class BessWildcardMatchTest(BessModuleTestCase):
+
+    def _rule(self, value, mask, gate):
+        return {'values': [{'value_int': value}],
+                'masks': [{'value_int': mask}],
+                'priority': 0, 'gate': gate}
+
+    def _gates(self, wm):
+        return sorted((r.values[0], r.gate) for r in wm.get_rules().rules)
+
+    def test_wildcardmatch_add_bulk_failure(self):
+        wm = WildcardMatch(fields=[{'offset': 26, 'num_bytes': 4}])
+        wm.add_bulk(rules=[self._rule(0x0a000000 + i, 0xffffffff, 1)
+                           for i in range(3)])
+        before = self._gates(wm)
+        self.assertEquals(len(before), 3)
+
+        # The first rules of the batch fit and overwrite existing ones, but
+        # the batch needs more distinct masks than the table can hold.
+        batch = [self._rule(0x0a000000 + i, 0xffffffff, 2) for i in range(3)]
+        batch += [self._rule(0, 0xffffffff << i & 0xffffffff, 2)
+                  for i in range(1, 10)]
+
+        with self.assertRaises(bess.Error):
+            wm.add_bulk(rules=batch)
+        self.assertEquals(self._gates(wm), before)
+
+        with self.assertRaises(bess.Error):
+            wm.add_bulk(rules=batch, replace=True)
+        self.assertEquals(self._gates(wm), before)
+
+        pkt = get_tcp_packet(sip='10.0.0.1', dip='1.2.3.4')
+        pkt_outs = self.run_module(wm, 0, [pkt], [1, 2])
+        self.assertEquals(len(pkt_outs[1]), 1)
+        self.assertEquals(len(pkt_outs[2]), 0)
+
+suite = unittest.TestLoader().loadTestsFromTestCase(BessWildcardMatchTest)
+results = unittest.TextTestRunner(verbosity=2).run(suite)
+
+if results.failures or results.errors:
+    sys.exit(1)
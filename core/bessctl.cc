@@ -30,6 +30,13 @@
 
 #include "bessctl.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <thread>
 
 #include <gflags/gflags.h>
@@ -47,6 +54,7 @@
 #include "gate.h"
 #include "gate_hooks/tcpdump.h"
 #include "gate_hooks/track.h"
+#include "mem_alloc.h"
 #include "message.h"
 #include "metadata.h"
 #include "module.h"
@@ -68,6 +76,7 @@
 
 using grpc::Status;
 using grpc::ServerContext;
+using grpc::ServerWriter;
 
 using bess::TrafficClassBuilder;
 using bess::ResumeHook;
@@ -231,6 +240,9 @@ static int collect_igates(Module* m, GetModuleInfoResponse* response) {
       igate->set_pkts(t->pkts());
       igate->set_bytes(t->bytes());
       igate->set_timestamp(get_epoch_time());
+      for (uint64_t n : t->batch_hist()) {
+        igate->add_batch_hist(n);
+      }
     }
 
     igate->set_igate(g->gate_idx());
@@ -259,6 +271,9 @@ static int collect_ogates(Module* m, GetModuleInfoResponse* response) {
       ogate->set_pkts(t->pkts());
       ogate->set_bytes(t->bytes());
       ogate->set_timestamp(get_epoch_time());
+      for (uint64_t n : t->batch_hist()) {
+        ogate->add_batch_hist(n);
+      }
     }
     ogate->set_name(g->igate()->module()->name());
     ogate->set_igate(g->igate()->gate_idx());
@@ -296,6 +311,141 @@ static int collect_metadata(Module* m, GetModuleInfoResponse* response) {
   return 0;
 }
 
+// Serializes all RPC handlers. See ApiServer::Run().
+static std::mutex rpc_mutex;
+
+// Releases rpc_mutex, held by the calling RPC handler, for its lifetime.
+class RpcLockReleaser {
+ public:
+  RpcLockReleaser() { rpc_mutex.unlock(); }
+  ~RpcLockReleaser() { rpc_mutex.lock(); }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RpcLockReleaser);
+};
+
+// Remembers the counters sent in the last StatsSnapshot of a StreamStats call,
+// so that the next snapshot can carry deltas.
+class StatsBaseline {
+ public:
+  StatsBaseline() : timestamp_() {}
+
+  // Fills snapshot with the counter deltas since the previous call.
+  // rpc_mutex must be held, as the lists of objects are walked.
+  void Collect(StatsSnapshot* snapshot) {
+    std::map<std::string, ::Port::PortStats> ports;
+    std::map<std::string, GateCounters> gates;
+    std::map<std::string, bess::tc_stats> tcs;
+
+    double now = get_epoch_time();
+    snapshot->set_timestamp(now);
+    snapshot->set_elapsed(timestamp_ ? now - timestamp_ : 0);
+    timestamp_ = now;
+
+    for (const auto& pair : PortBuilder::all_ports()) {
+      const ::Port::PortStats cur = pair.second->GetPortStats();
+      const ::Port::PortStats prev = Lookup(ports_, pair.first);
+      StatsSnapshot::Port* port = snapshot->add_ports();
+
+      port->set_name(pair.first);
+      port->mutable_inc()->set_packets(
+          Delta(cur.inc.packets, prev.inc.packets));
+      port->mutable_inc()->set_dropped(
+          Delta(cur.inc.dropped, prev.inc.dropped));
+      port->mutable_inc()->set_bytes(Delta(cur.inc.bytes, prev.inc.bytes));
+      port->mutable_out()->set_packets(
+          Delta(cur.out.packets, prev.out.packets));
+      port->mutable_out()->set_dropped(
+          Delta(cur.out.dropped, prev.out.dropped));
+      port->mutable_out()->set_bytes(Delta(cur.out.bytes, prev.out.bytes));
+      ports.emplace(pair.first, cur);
+    }
+
+    for (const auto& pair : ModuleGraph::GetAllModules()) {
+      const Module* m = pair.second;
+      for (const auto& g : m->igates()) {
+        if (g) {
+          CollectGate(m, g, true, snapshot, &gates);
+        }
+      }
+      for (const auto& g : m->ogates()) {
+        if (g) {
+          CollectGate(m, g, false, snapshot, &gates);
+        }
+      }
+    }
+
+    for (const auto& pair : TrafficClassBuilder::all_tcs()) {
+      const bess::tc_stats& cur = pair.second->stats();
+      const bess::tc_stats prev = Lookup(tcs_, pair.first);
+      StatsSnapshot::TrafficClass* tc = snapshot->add_tcs();
+
+      tc->set_name(pair.first);
+      tc->set_count(Delta(cur.usage[bess::RESOURCE_COUNT],
+                          prev.usage[bess::RESOURCE_COUNT]));
+      tc->set_cycles(Delta(cur.usage[bess::RESOURCE_CYCLE],
+                           prev.usage[bess::RESOURCE_CYCLE]));
+      tc->set_packets(Delta(cur.usage[bess::RESOURCE_PACKET],
+                            prev.usage[bess::RESOURCE_PACKET]));
+      tc->set_bits(Delta(cur.usage[bess::RESOURCE_BIT],
+                         prev.usage[bess::RESOURCE_BIT]));
+      tc->set_polls(Delta(cur.cnt_polls, prev.cnt_polls));
+      tc->set_poll_hits(Delta(cur.cnt_poll_hits, prev.cnt_poll_hits));
+      tcs.emplace(pair.first, cur);
+    }
+
+    // Objects that are gone by now are dropped from the baseline.
+    ports_.swap(ports);
+    gates_.swap(gates);
+    tcs_.swap(tcs);
+  }
+
+ private:
+  typedef std::array<uint64_t, 3> GateCounters;  // cnt, pkts, bytes
+
+  // Counters that went backwards belong to a new object with the same name.
+  static uint64_t Delta(uint64_t cur, uint64_t prev) {
+    return (cur >= prev) ? cur - prev : cur;
+  }
+
+  template <typename T>
+  static T Lookup(const std::map<std::string, T>& baseline,
+                  const std::string& name) {
+    const auto& it = baseline.find(name);
+    return (it == baseline.end()) ? T() : it->second;
+  }
+
+  void CollectGate(const Module* m, bess::Gate* g, bool is_igate,
+                   StatsSnapshot* snapshot,
+                   std::map<std::string, GateCounters>* gates) {
+    Track* t = reinterpret_cast<Track*>(g->FindHook(Track::kName));
+    if (!t) {
+      return;
+    }
+
+    std::string key = bess::utils::Format("%s:%c%hu", m->name().c_str(),
+                                          is_igate ? 'i' : 'o', g->gate_idx());
+    const GateCounters cur = {{t->cnt(), t->pkts(), t->bytes()}};
+    const GateCounters prev = Lookup(gates_, key);
+    StatsSnapshot::Gate* gate = snapshot->add_gates();
+
+    gate->set_module(m->name());
+    gate->set_is_igate(is_igate);
+    gate->set_gate(g->gate_idx());
+    gate->set_cnt(Delta(cur[0], prev[0]));
+    gate->set_pkts(Delta(cur[1], prev[1]));
+    gate->set_bytes(Delta(cur[2], prev[2]));
+    gates->emplace(key, cur);
+  }
+
+  double timestamp_;
+  std::map<std::string, ::Port::PortStats> ports_;
+  std::map<std::string, GateCounters> gates_;
+  std::map<std::string, bess::tc_stats> tcs_;
+
+  DISALLOW_COPY_AND_ASSIGN(StatsBaseline);
+};
+
 static ::Port* create_port(const std::string& name, const PortBuilder& driver,
                            queue_t num_inc_q, queue_t num_out_q,
                            size_t size_inc_q, size_t size_out_q,
@@ -440,6 +590,8 @@ static void collect_tc(const bess::TrafficClass* c, int wid,
 
 class BESSControlImpl final : public BESSControl::Service {
  public:
+  BESSControlImpl() : stopping_(false) {}
+
   void set_shutdown_func(const std::function<void()>& func) {
     shutdown_func_ = func;
   }
@@ -540,6 +692,13 @@ class BESSControlImpl final : public BESSControl::Service {
       status->set_core(workers[wid]->core());
       status->set_num_tcs(workers[wid]->scheduler()->NumTcs());
       status->set_silent_drops(workers[wid]->silent_drops());
+
+      const bess::sched_stats& stats = workers[wid]->scheduler()->stats();
+      status->set_cycles_busy(stats.cycles_busy);
+      status->set_cycles_idle_spin(stats.cycles_idle_stage[bess::IDLE_SPIN]);
+      status->set_cycles_idle_pause(stats.cycles_idle_stage[bess::IDLE_PAUSE]);
+      status->set_cycles_idle_wait(stats.cycles_idle_stage[bess::IDLE_WAIT]);
+      status->set_cycles_idle_sleep(stats.cycles_idle_stage[bess::IDLE_SLEEP]);
     }
     return Status::OK;
   }
@@ -559,12 +718,41 @@ class BESSControlImpl final : public BESSControl::Service {
                                wid);
     }
     const std::string& scheduler = request->scheduler();
-    if (scheduler != "" && scheduler != "experimental") {
+    if (scheduler != "" && scheduler != "experimental" &&
+        scheduler != "adaptive") {
       return return_with_error(response, EINVAL, "Invalid scheduler %s",
                                scheduler.c_str());
     }
+    if (request->max_poll_latency_us() && scheduler != "adaptive") {
+      return return_with_error(response, EINVAL,
+                               "max_poll_latency_us requires the adaptive "
+                               "scheduler");
+    }
+
+    launch_worker(wid, core, scheduler, request->idle_sleep_us(),
+                  request->max_poll_latency_us());
+    return Status::OK;
+  }
+
+  Status RebalanceWorkers(ServerContext*,
+                          const RebalanceWorkersRequest* request,
+                          RebalanceWorkersResponse* response) override {
+    double min_load_gap = request->min_load_gap();
+    if (min_load_gap < 0.0 || min_load_gap > 1.0) {
+      return return_with_error(response, EINVAL, "Invalid min_load_gap %f",
+                               min_load_gap);
+    }
+    if (min_load_gap == 0.0) {
+      min_load_gap = 0.2;
+    }
 
-    launch_worker(wid, core, scheduler);
+    rebalance_result ret = rebalance_workers(min_load_gap);
+    response->set_moved(ret.moved);
+    response->set_name(ret.tc);
+    response->set_from_wid(ret.from_wid);
+    response->set_to_wid(ret.to_wid);
+    response->set_from_load(ret.from_load);
+    response->set_to_load(ret.to_load);
     return Status::OK;
   }
 
@@ -881,6 +1069,8 @@ class BESSControlImpl final : public BESSControl::Service {
     response->set_cycles(c->stats().usage[bess::RESOURCE_CYCLE]);
     response->set_packets(c->stats().usage[bess::RESOURCE_PACKET]);
     response->set_bits(c->stats().usage[bess::RESOURCE_BIT]);
+    response->set_polls(c->stats().cnt_polls);
+    response->set_poll_hits(c->stats().cnt_poll_hits);
 
     return Status::OK;
   }
@@ -1039,6 +1229,9 @@ class BESSControlImpl final : public BESSControl::Service {
     response->mutable_out()->set_dropped(stats.out.dropped);
     response->mutable_out()->set_bytes(stats.out.bytes);
 
+    response->mutable_driver()->insert(stats.driver.begin(),
+                                       stats.driver.end());
+
     response->set_timestamp(get_epoch_time());
 
     return Status::OK;
@@ -1182,6 +1375,19 @@ class BESSControlImpl final : public BESSControl::Service {
     collect_ogates(m, response);
     collect_metadata(m, response);
 
+    // Every access from a worker on another node goes across the interconnect
+    int socket = mem_socket(m);
+    response->set_socket(socket);
+    for (int wid = 0; socket >= 0 && wid < Worker::kMaxWorkers; wid++) {
+      if (m->active_workers()[wid] && workers[wid] &&
+          workers[wid]->socket() != socket) {
+        LOG(WARNING) << "Module " << m->name() << " is on socket " << socket
+                     << ", but is run by worker " << wid << " on socket "
+                     << workers[wid]->socket();
+        response->set_remote(true);
+      }
+    }
+
     return Status::OK;
   }
 
@@ -1225,6 +1431,9 @@ class BESSControlImpl final : public BESSControl::Service {
 
     if (is_any_worker_running()) {
       propagate_active_worker();
+      // Modules that no worker runs yet may be connected together, e.g., to
+      // stage a new subgraph for SwapGate. Connecting to a module in use
+      // changes its igates, which needs a pause.
       if (m1->num_active_workers() || m2->num_active_workers()) {
         WorkerPauser wp;  // Only pause when absolutely required
         ret = m1->ConnectModules(ogate, m2, igate);
@@ -1270,6 +1479,164 @@ class BESSControlImpl final : public BESSControl::Service {
     return Status::OK;
   }
 
+  Status SwapGate(ServerContext*, const SwapGateRequest* request,
+                  SwapGateResponse* response) override {
+    VLOG(1) << "SwapGateRequest from client:" << std::endl
+            << request->DebugString();
+
+    const auto& modules = ModuleGraph::GetAllModules();
+    gate_idx_t ogate = request->ogate();
+    gate_idx_t igate = request->igate();
+    int ret;
+
+    if (request->drain_timeout_sec() < 0) {
+      return return_with_error(response, EINVAL, "Invalid drain timeout %f",
+                               request->drain_timeout_sec());
+    }
+    double drain_timeout =
+        (request->drain_timeout_sec() > 0) ? request->drain_timeout_sec() : 1.0;
+
+    const auto& it1 = modules.find(request->m1());
+    if (it1 == modules.end()) {
+      return return_with_error(response, ENOENT, "No module '%s' found",
+                               request->m1().c_str());
+    }
+    Module* m1 = it1->second;
+
+    const auto& it2 = modules.find(request->m2());
+    if (it2 == modules.end()) {
+      return return_with_error(response, ENOENT, "No module '%s' found",
+                               request->m2().c_str());
+    }
+    Module* m2 = it2->second;
+
+    std::set<Module*> destroy;
+    for (const auto& name : request->destroy()) {
+      const auto& it = modules.find(name);
+      if (it == modules.end()) {
+        return return_with_error(response, ENOENT, "No module '%s' found",
+                                 name.c_str());
+      }
+      if (it->second == m1 || it->second == m2) {
+        return return_with_error(response, EINVAL,
+                                 "Module '%s' is part of the new path",
+                                 name.c_str());
+      }
+      destroy.insert(it->second);
+    }
+
+    // Once the gate is swapped, nothing that stays may feed the modules to
+    // destroy, or they would never drain.
+    for (Module* m : destroy) {
+      for (const bess::IGate* ig : m->igates()) {
+        if (!ig) {
+          continue;
+        }
+        for (const bess::OGate* og : ig->ogates_upstream()) {
+          Module* m_prev = og->module();
+          if (!destroy.count(m_prev) &&
+              !(m_prev == m1 && og->gate_idx() == ogate)) {
+            return return_with_error(response, EBUSY,
+                                     "Module '%s' is also fed by '%s'",
+                                     m->name().c_str(),
+                                     m_prev->name().c_str());
+          }
+        }
+      }
+    }
+
+    // Find the modules that will see traffic for the first time.
+    propagate_active_worker();
+    std::set<Module*> staged;
+    std::vector<Module*> pending = {m2};
+    while (!pending.empty()) {
+      Module* m = pending.back();
+      pending.pop_back();
+      if (m->num_active_workers() || !staged.insert(m).second) {
+        continue;
+      }
+      for (const bess::OGate* og : m->ogates()) {
+        if (og) {
+          pending.push_back(og->next());
+        }
+      }
+    }
+
+    // Metadata offsets are only computed while workers are paused, and so is
+    // the per-worker setup of modules (e.g., PortOut queues). Modules without
+    // either can go live under the workers' feet.
+    bool pause = false;
+    auto& resume_modules = bess::event_modules[bess::Event::PreResume];
+    for (Module* m : staged) {
+      if (!m->all_attrs().empty()) {
+        pause = true;
+      }
+      // Not OnEvent() itself, which may change state the workers read.
+      if (m->HandlesEvent(bess::Event::PreResume)) {
+        pause = true;
+      }
+    }
+    pause = pause && is_any_worker_running();
+
+    {
+      std::unique_ptr<WorkerPauser> wp(pause ? new WorkerPauser() : nullptr);
+      ret = m1->RedirectModules(ogate, m2, igate);
+      propagate_active_worker();
+    }
+    if (ret < 0) {
+      return return_with_error(response, -ret, "Swap %s:%d->%d:%s failed",
+                               m1->name().c_str(), ogate, igate,
+                               m2->name().c_str());
+    }
+    response->set_paused(pause);
+
+    // No worker enters the old path any more; wait for whatever it buffers.
+    double start = get_epoch_time();
+    double drain_sec;
+    for (;;) {
+      size_t buffered = 0;
+      for (Module* m : destroy) {
+        buffered += m->NumBufferedPackets();
+      }
+
+      drain_sec = get_epoch_time() - start;
+      if (buffered == 0) {
+        break;
+      }
+      if (drain_sec >= drain_timeout) {
+        response->set_drain_sec(drain_sec);
+        return return_with_error(response, ETIMEDOUT,
+                                 "%zu packets still buffered after %.3fs, "
+                                 "no module destroyed",
+                                 buffered, drain_sec);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    response->set_drain_sec(drain_sec);
+
+    // Tasks of the old modules may still be scheduled.
+    bool has_tasks = false;
+    for (Module* m : destroy) {
+      has_tasks = has_tasks || !m->tasks().empty();
+    }
+
+    // DeInit() may free packets
+    ctx.SetNonWorker();
+
+    {
+      std::unique_ptr<WorkerPauser> wp(has_tasks ? new WorkerPauser()
+                                                 : nullptr);
+      for (Module* m : destroy) {
+        VLOG(1) << "Destroying drained module '" << m->name() << "'";
+        resume_modules.erase(m);
+        ModuleGraph::DestroyModule(m);
+      }
+      propagate_active_worker();
+    }
+
+    return Status::OK;
+  }
+
   Status DumpMempool(ServerContext*, const DumpMempoolRequest* request,
                      DumpMempoolResponse* response) override {
     int socket_filter = request->socket();
@@ -1301,6 +1668,40 @@ class BESSControlImpl final : public BESSControl::Service {
     return Status::OK;
   }
 
+  Status RunGateHookCommand(const ConfigureGateHookRequest* request,
+                            CommandResponse* response, bool is_igate,
+                            bool use_gate, gate_idx_t gate_idx) {
+    const auto& it = ModuleGraph::GetAllModules().find(request->module_name());
+    if (it == ModuleGraph::GetAllModules().end()) {
+      return return_with_error(response, ENOENT, "No module '%s' found",
+                               request->module_name().c_str());
+    }
+
+    const Module* m = it->second;
+    bess::Gate* gate;
+
+    if (!use_gate) {
+      return return_with_error(response, EINVAL,
+                               "Commands need a specific gate");
+    } else if (is_igate && is_active_gate(m->igates(), gate_idx)) {
+      gate = m->igates()[gate_idx];
+    } else if (!is_igate && is_active_gate(m->ogates(), gate_idx)) {
+      gate = m->ogates()[gate_idx];
+    } else {
+      return return_with_error(response, EINVAL, "%s gate '%hu' does not exist",
+                               is_igate ? "Input" : "Output", gate_idx);
+    }
+
+    bess::GateHook* hook = gate->FindHook(request->hook_name());
+    if (!hook) {
+      return return_with_error(response, ENOENT, "No '%s' hook at the gate",
+                               request->hook_name().c_str());
+    }
+
+    *response = hook->RunCommand(request->cmd(), request->arg());
+    return Status::OK;
+  }
+
   Status ConfigureGateHook(ServerContext*,
                            const ConfigureGateHookRequest* request,
                            CommandResponse* response) override {
@@ -1318,6 +1719,11 @@ class BESSControlImpl final : public BESSControl::Service {
       use_gate = request->ogate() >= 0;
     }
 
+    if (!request->cmd().empty()) {
+      return RunGateHookCommand(request, response, is_igate, use_gate,
+                                gate_idx);
+    }
+
     const auto factory = bess::GateHookFactory::all_gate_hook_factories().find(
         request->hook_name());
     if (factory == bess::GateHookFactory::all_gate_hook_factories().end()) {
@@ -1337,9 +1743,10 @@ class BESSControlImpl final : public BESSControl::Service {
                                               use_gate, request->hook_name());
         }
         if (response->error().code() != 0) {
-          return Status::OK;
+          break;
         }
       }
+      ModuleGraph::UpdateFusedGates();
       return Status::OK;
     }
 
@@ -1357,6 +1764,7 @@ class BESSControlImpl final : public BESSControl::Service {
       *response = disable_hook_for_module(it->second, gate_idx, is_igate,
                                           use_gate, request->hook_name());
     }
+    ModuleGraph::UpdateFusedGates();
 
     return Status::OK;
   }
@@ -1408,6 +1816,8 @@ class BESSControlImpl final : public BESSControl::Service {
     LOG(WARNING) << "Halt requested by a client\n";
 
     CHECK(shutdown_func_ != nullptr);
+    // Server::Shutdown() waits for all outstanding calls, including streams.
+    stopping_ = true;
     std::thread shutdown_helper([this]() {
       // Deadlock occurs when closing a gRPC server while processing a RPC.
       // Instead, we defer calling gRPC::Server::Shutdown() to a temporary
@@ -1506,6 +1916,53 @@ class BESSControlImpl final : public BESSControl::Service {
     return Status::OK;
   }
 
+  Status StreamStats(ServerContext* context, const StreamStatsRequest* request,
+                     ServerWriter<StatsSnapshot>* writer) override {
+    if (request->interval_sec() < 0) {
+      StatsSnapshot snapshot;
+      return_with_error(&snapshot, EINVAL, "Invalid interval %f",
+                        request->interval_sec());
+      writer->Write(snapshot);
+      return Status::OK;
+    }
+
+    double interval =
+        (request->interval_sec() > 0) ? request->interval_sec() : 1.0;
+    uint64_t max_snapshots = request->max_snapshots();
+
+    // This call lasts as long as the client wants it to, so it must not keep
+    // other RPCs waiting. The lock is taken only while counters are collected.
+    RpcLockReleaser unlocker;
+    StatsBaseline baseline;
+    double next = get_epoch_time();
+
+    for (uint64_t i = 0; max_snapshots == 0 || i < max_snapshots; i++) {
+      double now;
+      while ((now = get_epoch_time()) < next) {
+        if (context->IsCancelled() || stopping_) {
+          return Status::OK;
+        }
+        std::this_thread::sleep_for(
+            std::chrono::duration<double>(std::min(next - now, 0.1)));
+      }
+
+      StatsSnapshot snapshot;
+      {
+        std::lock_guard<std::mutex> lock(rpc_mutex);
+        baseline.Collect(&snapshot);
+      }
+
+      if (!writer->Write(snapshot) || stopping_) {
+        break;
+      }
+
+      // Do not try to catch up if collection has fallen behind.
+      next = std::max(next + interval, get_epoch_time());
+    }
+
+    return Status::OK;
+  }
+
  private:
   Status AttachTc(bess::TrafficClass* c_, const bess::pb::TrafficClass& class_,
                   EmptyResponse* response) {
@@ -1644,6 +2101,9 @@ class BESSControlImpl final : public BESSControl::Service {
 
   // function to call to close this gRPC service.
   std::function<void()> shutdown_func_;
+
+  // Set by KillBess, to end long-running streaming calls.
+  std::atomic<bool> stopping_;
 };
 
 bool ApiServer::grpc_cb_set_ = false;
@@ -1663,11 +2123,8 @@ void ApiServer::Run() {
   class ServerCallbacks : public grpc::Server::GlobalCallbacks {
    public:
     ServerCallbacks() {}
-    void PreSynchronousRequest(ServerContext*) { mutex_.lock(); }
-    void PostSynchronousRequest(ServerContext*) { mutex_.unlock(); }
-
-   private:
-    std::mutex mutex_;
+    void PreSynchronousRequest(ServerContext*) { rpc_mutex.lock(); }
+    void PostSynchronousRequest(ServerContext*) { rpc_mutex.unlock(); }
   };
 
   if (!builder_) {
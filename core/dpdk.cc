@@ -38,12 +38,14 @@
 #include <rte_cycles.h>
 #include <rte_eal.h>
 #include <rte_ethdev.h>
+#include <rte_pci.h>
 
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <string>
+#include <vector>
 
 #include "utils/time.h"
 #include "worker.h"
@@ -121,8 +123,16 @@ class CmdLineOpts {
   std::vector<char *> argv_;
 };
 
+// A PCI address that no device has. Whitelisting only this one makes
+// rte_eal_init() scan the PCI bus, but probe no device.
+static const char *kNoPciDevice = "ffff:ff:1f.7";
+
+// True while PCI devices are left unprobed, see probe_pci_devices().
+static bool pci_probe_deferred = false;
+
 static void init_eal(const char *prog_name, int mb_per_socket,
-                     int multi_instance, bool no_huge, int default_core) {
+                     int multi_instance, bool no_huge, bool lazy_probe,
+                     int default_core) {
   int numa_count = get_numa_count();
 
   CmdLineOpts rte_args{
@@ -153,6 +163,11 @@ static void init_eal(const char *prog_name, int mb_per_socket,
     rte_args.Append({"--file-prefix", "rte" + std::to_string(getpid())});
   }
 
+  if (lazy_probe) {
+    rte_args.Append({"--pci-whitelist", kNoPciDevice});
+    pci_probe_deferred = true;
+  }
+
   /* reset getopt() */
   optind = 0;
 
@@ -209,7 +224,7 @@ static int determine_default_core() {
 }
 
 void init_dpdk(const ::std::string &prog_name, int mb_per_socket,
-               int multi_instance, bool no_huge) {
+               int multi_instance, bool no_huge, bool lazy_probe) {
   // Isolate all background threads in a separate core.
   // All non-worker threads will be scheduled on default_core,
   // including threads spawned by DPDK and gRPC.
@@ -219,5 +234,40 @@ void init_dpdk(const ::std::string &prog_name, int mb_per_socket,
   ctx.SetNonWorker();
 
   init_eal(prog_name.c_str(), mb_per_socket, multi_instance, no_huge,
-           default_core);
+           lazy_probe, default_core);
+}
+
+bool is_pci_probe_deferred() {
+  return pci_probe_deferred;
+}
+
+void probe_pci_devices() {
+  if (!pci_probe_deferred) {
+    return;
+  }
+  pci_probe_deferred = false;
+
+  double start = get_epoch_time();
+  std::vector<struct rte_pci_addr> addrs;
+  struct rte_pci_device *dev;
+
+  // Probing may update the device list, so walk a copy. Devices without any
+  // kernel driver cannot be used by PMDs either.
+  FOREACH_DEVICE_ON_PCIBUS(dev) {
+    if (!dev->driver && dev->kdrv != RTE_KDRV_NONE) {
+      addrs.push_back(dev->addr);
+    }
+  }
+
+  int probed = 0;
+  for (const struct rte_pci_addr &addr : addrs) {
+    // Fails for devices that no PMD drives, which is fine.
+    if (rte_eal_pci_probe_one(&addr) == 0) {
+      probed++;
+    }
+  }
+
+  LOG(INFO) << "Probed " << probed << " of " << addrs.size()
+            << " PCI devices in " << (get_epoch_time() - start) * 1000
+            << " ms";
 }
@@ -53,7 +53,15 @@
 #error DPDK version is not available
 #endif
 
+// With lazy_probe, PCI devices are not probed (initialized by their PMDs) until
+// probe_pci_devices() is called, or a device is attached by its PCI address.
 void init_dpdk(const ::std::string &prog_name, int mb_per_socket,
-               int multi_instance, bool no_huge);
+               int multi_instance, bool no_huge, bool lazy_probe = false);
+
+// Returns true if init_dpdk() has left PCI devices unprobed.
+bool is_pci_probe_deferred();
+
+// Probes all PCI devices that init_dpdk() has deferred, if any.
+void probe_pci_devices();
 
 #endif  // BESS_DPDK_H_
@@ -0,0 +1,691 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "af_xdp.h"
+
+#include <glog/logging.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#include "../utils/copy.h"
+
+// Not all libc headers know about these yet.
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
+
+static int sys_bpf(enum bpf_cmd cmd, union bpf_attr *attr) {
+  return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+// Producer side of a ring (fill, tx): returns how many entries (<= n) can be
+// reserved.
+static inline uint32_t prod_nb_free(uint32_t cached_cons, uint32_t *consumer,
+                                    uint32_t size, uint32_t *cached_prod,
+                                    uint32_t n, uint32_t *out_cached_cons) {
+  uint32_t free_entries = cached_cons - *cached_prod;
+  if (free_entries >= n) {
+    return free_entries;
+  }
+
+  // Refresh the cached consumer index. It is offset by the ring size so that
+  // the subtraction above gives the number of free entries.
+  *out_cached_cons = __atomic_load_n(consumer, __ATOMIC_ACQUIRE) + size;
+  return *out_cached_cons - *cached_prod;
+}
+
+// Consumer side of a ring (comp, rx): returns how many entries (<= n) are
+// ready.
+static inline uint32_t cons_nb_avail(uint32_t *cached_prod,
+                                     uint32_t cached_cons, uint32_t *producer,
+                                     uint32_t n) {
+  uint32_t entries = *cached_prod - cached_cons;
+  if (entries == 0) {
+    *cached_prod = __atomic_load_n(producer, __ATOMIC_ACQUIRE);
+    entries = *cached_prod - cached_cons;
+  }
+  return std::min(entries, n);
+}
+
+static inline void ring_submit(uint32_t *producer, uint32_t n) {
+  __atomic_store_n(producer, *producer + n, __ATOMIC_RELEASE);
+}
+
+static inline void ring_release(uint32_t *consumer, uint32_t n) {
+  __atomic_store_n(consumer, *consumer + n, __ATOMIC_RELEASE);
+}
+
+static inline bool ring_needs_wakeup(const uint32_t *flags) {
+  return *flags & XDP_RING_NEED_WAKEUP;
+}
+
+// The XDP program, equivalent to:
+//   return bpf_redirect_map(&xsks_map, ctx->rx_queue_index, XDP_PASS);
+// Packets arriving on queues without a bound socket go to the kernel stack.
+CommandResponse AFXDPPort::LoadXdpProgram() {
+  union bpf_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.map_type = BPF_MAP_TYPE_XSKMAP;
+  attr.key_size = sizeof(int);
+  attr.value_size = sizeof(int);
+  attr.max_entries = MAX_QUEUES_PER_DIR;
+
+  xsks_map_fd_ = sys_bpf(BPF_MAP_CREATE, &attr);
+  if (xsks_map_fd_ < 0) {
+    xsks_map_fd_ = kInvalidFd;
+    return CommandFailure(errno, "Failed to create XSKMAP");
+  }
+
+  struct bpf_insn insns[6];
+  memset(insns, 0, sizeof(insns));
+
+  // r2 = ((struct xdp_md *)r1)->rx_queue_index
+  insns[0].code = BPF_LDX | BPF_W | BPF_MEM;
+  insns[0].dst_reg = BPF_REG_2;
+  insns[0].src_reg = BPF_REG_1;
+  insns[0].off = offsetof(struct xdp_md, rx_queue_index);
+
+  // r1 = xsks_map (64-bit immediate load, takes two instructions)
+  insns[1].code = BPF_LD | BPF_DW | BPF_IMM;
+  insns[1].dst_reg = BPF_REG_1;
+  insns[1].src_reg = BPF_PSEUDO_MAP_FD;
+  insns[1].imm = xsks_map_fd_;
+
+  // r3 = XDP_PASS
+  insns[3].code = BPF_ALU64 | BPF_MOV | BPF_K;
+  insns[3].dst_reg = BPF_REG_3;
+  insns[3].imm = XDP_PASS;
+
+  // r0 = bpf_redirect_map(r1, r2, r3)
+  insns[4].code = BPF_JMP | BPF_CALL;
+  insns[4].imm = BPF_FUNC_redirect_map;
+
+  // return r0
+  insns[5].code = BPF_JMP | BPF_EXIT;
+
+  static const char license[] = "GPL";
+
+  memset(&attr, 0, sizeof(attr));
+  attr.prog_type = BPF_PROG_TYPE_XDP;
+  attr.insns = reinterpret_cast<uintptr_t>(insns);
+  attr.insn_cnt = sizeof(insns) / sizeof(insns[0]);
+  attr.license = reinterpret_cast<uintptr_t>(license);
+
+  prog_fd_ = sys_bpf(BPF_PROG_LOAD, &attr);
+  if (prog_fd_ < 0) {
+    prog_fd_ = kInvalidFd;
+    return CommandFailure(errno, "Failed to load the XDP program");
+  }
+
+  return CommandSuccess();
+}
+
+// Attaches (fd >= 0) or detaches (fd == -1) the XDP program to/from the
+// interface, via rtnetlink.
+CommandResponse AFXDPPort::AttachXdpProgram(int fd) {
+  struct {
+    struct nlmsghdr nh;
+    struct ifinfomsg ifinfo;
+    char attrbuf[64];
+  } req;
+
+  int sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+  if (sock < 0) {
+    return CommandFailure(errno, "socket(AF_NETLINK) failed");
+  }
+
+  memset(&req, 0, sizeof(req));
+  req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+  req.nh.nlmsg_type = RTM_SETLINK;
+  req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+  req.ifinfo.ifi_family = AF_UNSPEC;
+  req.ifinfo.ifi_index = ifindex_;
+
+  struct nlattr *nest = reinterpret_cast<struct nlattr *>(
+      reinterpret_cast<char *>(&req) + NLMSG_ALIGN(req.nh.nlmsg_len));
+  nest->nla_type = NLA_F_NESTED | IFLA_XDP;
+  nest->nla_len = NLA_HDRLEN;
+
+  struct nlattr *nla = reinterpret_cast<struct nlattr *>(
+      reinterpret_cast<char *>(nest) + nest->nla_len);
+  nla->nla_type = IFLA_XDP_FD;
+  nla->nla_len = NLA_HDRLEN + sizeof(int);
+  memcpy(reinterpret_cast<char *>(nla) + NLA_HDRLEN, &fd, sizeof(fd));
+  nest->nla_len += NLA_ALIGN(nla->nla_len);
+
+  uint32_t flags = xdp_flags_;
+  if (fd >= 0) {
+    flags |= XDP_FLAGS_UPDATE_IF_NOEXIST;
+  }
+
+  if (flags) {
+    nla = reinterpret_cast<struct nlattr *>(reinterpret_cast<char *>(nest) +
+                                            nest->nla_len);
+    nla->nla_type = IFLA_XDP_FLAGS;
+    nla->nla_len = NLA_HDRLEN + sizeof(flags);
+    memcpy(reinterpret_cast<char *>(nla) + NLA_HDRLEN, &flags, sizeof(flags));
+    nest->nla_len += NLA_ALIGN(nla->nla_len);
+  }
+
+  req.nh.nlmsg_len += NLA_ALIGN(nest->nla_len);
+
+  if (send(sock, &req, req.nh.nlmsg_len, 0) < 0) {
+    int err = errno;
+    close(sock);
+    return CommandFailure(err, "Failed to send an rtnetlink request");
+  }
+
+  char buf[4096];
+  ssize_t len = recv(sock, buf, sizeof(buf), 0);
+  int err = (len < 0) ? errno : 0;
+  close(sock);
+
+  if (len < 0) {
+    return CommandFailure(err, "Failed to receive an rtnetlink reply");
+  }
+
+  for (struct nlmsghdr *nh = reinterpret_cast<struct nlmsghdr *>(buf);
+       NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+    if (nh->nlmsg_type == NLMSG_ERROR) {
+      struct nlmsgerr *e = static_cast<struct nlmsgerr *>(NLMSG_DATA(nh));
+      if (e->error) {
+        return CommandFailure(-e->error,
+                              "Failed to attach the XDP program (is another "
+                              "one already attached?)");
+      }
+    }
+  }
+
+  return CommandSuccess();
+}
+
+static void *mmap_ring(int fd, size_t len, off_t pgoff) {
+  void *ret = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, pgoff);
+  return (ret == MAP_FAILED) ? nullptr : ret;
+}
+
+CommandResponse AFXDPPort::CreateXsk(queue_t qid, Xsk *xsk, uint32_t bind_flags,
+                                     int64_t busy_poll_us,
+                                     uint32_t busy_poll_budget) {
+  int ret;
+
+  xsk->umem_len = static_cast<size_t>(frame_size_) * num_frames_;
+
+  // Try hugepages first to save TLB misses, then fall back to normal pages.
+  void *umem = mmap(nullptr, xsk->umem_len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (umem == MAP_FAILED) {
+    umem = mmap(nullptr, xsk->umem_len, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  }
+  if (umem == MAP_FAILED) {
+    xsk->umem_len = 0;
+    return CommandFailure(ENOMEM, "Failed to allocate UMEM");
+  }
+  xsk->umem = static_cast<char *>(umem);
+
+  xsk->fd = socket(AF_XDP, SOCK_RAW, 0);
+  if (xsk->fd < 0) {
+    return CommandFailure(errno, "socket(AF_XDP) failed");
+  }
+
+  struct xdp_umem_reg mr;
+  memset(&mr, 0, sizeof(mr));
+  mr.addr = reinterpret_cast<uintptr_t>(xsk->umem);
+  mr.len = xsk->umem_len;
+  mr.chunk_size = frame_size_;
+  mr.headroom = 0;
+
+  ret = setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_REG, &mr, sizeof(mr));
+  if (ret < 0) {
+    return CommandFailure(errno, "setsockopt(XDP_UMEM_REG) failed");
+  }
+
+  // All rings are as large as the UMEM, so that they never overflow.
+  uint32_t ring_size = num_frames_;
+  const struct {
+    int optname;
+    const char *desc;
+  } ring_opts[] = {{XDP_UMEM_FILL_RING, "XDP_UMEM_FILL_RING"},
+                   {XDP_UMEM_COMPLETION_RING, "XDP_UMEM_COMPLETION_RING"},
+                   {XDP_RX_RING, "XDP_RX_RING"},
+                   {XDP_TX_RING, "XDP_TX_RING"}};
+
+  for (const auto &opt : ring_opts) {
+    ret = setsockopt(xsk->fd, SOL_XDP, opt.optname, &ring_size,
+                     sizeof(ring_size));
+    if (ret < 0) {
+      return CommandFailure(errno, "setsockopt(%s) failed", opt.desc);
+    }
+  }
+
+  struct xdp_mmap_offsets off;
+  socklen_t optlen = sizeof(off);
+  ret = getsockopt(xsk->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen);
+  if (ret < 0) {
+    return CommandFailure(errno, "getsockopt(XDP_MMAP_OFFSETS) failed");
+  }
+
+  const struct {
+    Ring *ring;
+    const struct xdp_ring_offset *off;
+    size_t desc_size;
+    off_t pgoff;
+  } rings[] = {
+      {&xsk->fill, &off.fr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING},
+      {&xsk->comp, &off.cr, sizeof(uint64_t),
+       static_cast<off_t>(XDP_UMEM_PGOFF_COMPLETION_RING)},
+      {&xsk->rx, &off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING},
+      {&xsk->tx, &off.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING},
+  };
+
+  for (const auto &r : rings) {
+    Ring *ring = r.ring;
+
+    ring->map_len = r.off->desc + ring_size * r.desc_size;
+    ring->map = mmap_ring(xsk->fd, ring->map_len, r.pgoff);
+    if (!ring->map) {
+      ring->map_len = 0;
+      return CommandFailure(errno, "Failed to mmap XDP rings");
+    }
+
+    char *base = static_cast<char *>(ring->map);
+    ring->producer = reinterpret_cast<uint32_t *>(base + r.off->producer);
+    ring->consumer = reinterpret_cast<uint32_t *>(base + r.off->consumer);
+    ring->flags = reinterpret_cast<uint32_t *>(base + r.off->flags);
+    ring->descs = base + r.off->desc;
+    ring->mask = ring_size - 1;
+    ring->size = ring_size;
+    ring->cached_prod = *ring->producer;
+    ring->cached_cons = *ring->consumer;
+  }
+
+  // Producer rings see the whole ring as free.
+  xsk->fill.cached_cons += ring_size;
+  xsk->tx.cached_cons += ring_size;
+
+  // The first half of the frames are for RX, and the rest for TX.
+  uint32_t num_rx_frames = num_frames_ / 2;
+  uint64_t *fill_addrs = static_cast<uint64_t *>(xsk->fill.descs);
+  for (uint32_t i = 0; i < num_rx_frames; i++) {
+    fill_addrs[(xsk->fill.cached_prod + i) & xsk->fill.mask] =
+        static_cast<uint64_t>(i) * frame_size_;
+  }
+  xsk->fill.cached_prod += num_rx_frames;
+  ring_submit(xsk->fill.producer, num_rx_frames);
+
+  xsk->free_frames.clear();
+  for (uint32_t i = num_rx_frames; i < num_frames_; i++) {
+    xsk->free_frames.push_back(static_cast<uint64_t>(i) * frame_size_);
+  }
+
+  struct sockaddr_xdp sxdp;
+  memset(&sxdp, 0, sizeof(sxdp));
+  sxdp.sxdp_family = AF_XDP;
+  sxdp.sxdp_ifindex = ifindex_;
+  sxdp.sxdp_queue_id = qid;
+  sxdp.sxdp_flags = bind_flags;
+
+  ret = bind(xsk->fd, reinterpret_cast<struct sockaddr *>(&sxdp),
+             sizeof(sxdp));
+  if (ret < 0) {
+    return CommandFailure(errno, "bind(AF_XDP) to queue %d failed", qid);
+  }
+
+  if (busy_poll_us > 0) {
+    int opt = 1;
+    if (setsockopt(xsk->fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &opt,
+                   sizeof(opt)) < 0) {
+      return CommandFailure(errno, "setsockopt(SO_PREFER_BUSY_POLL) failed");
+    }
+
+    opt = busy_poll_us;
+    if (setsockopt(xsk->fd, SOL_SOCKET, SO_BUSY_POLL, &opt, sizeof(opt)) < 0) {
+      return CommandFailure(errno, "setsockopt(SO_BUSY_POLL) failed");
+    }
+
+    opt = busy_poll_budget ?: bess::PacketBatch::kMaxBurst;
+    if (setsockopt(xsk->fd, SOL_SOCKET, SO_BUSY_POLL_BUDGET, &opt,
+                   sizeof(opt)) < 0) {
+      return CommandFailure(errno, "setsockopt(SO_BUSY_POLL_BUDGET) failed");
+    }
+  }
+
+  int key = qid;
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_fd = xsks_map_fd_;
+  attr.key = reinterpret_cast<uintptr_t>(&key);
+  attr.value = reinterpret_cast<uintptr_t>(&xsk->fd);
+  attr.flags = BPF_ANY;
+
+  if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+    return CommandFailure(errno, "Failed to register the socket to XSKMAP");
+  }
+
+  return CommandSuccess();
+}
+
+void AFXDPPort::DestroyXsk(Xsk *xsk) {
+  for (Ring *ring : {&xsk->fill, &xsk->comp, &xsk->rx, &xsk->tx}) {
+    if (ring->map) {
+      munmap(ring->map, ring->map_len);
+      ring->map = nullptr;
+    }
+  }
+
+  if (xsk->fd != kInvalidFd) {
+    close(xsk->fd);
+    xsk->fd = kInvalidFd;
+  }
+
+  if (xsk->umem) {
+    munmap(xsk->umem, xsk->umem_len);
+    xsk->umem = nullptr;
+  }
+}
+
+CommandResponse AFXDPPort::Init(const bess::pb::AFXDPPortArg &arg) {
+  CommandResponse err;
+
+  if (arg.ifname().empty()) {
+    return CommandFailure(EINVAL, "'ifname' must be given");
+  }
+
+  ifindex_ = if_nametoindex(arg.ifname().c_str());
+  if (ifindex_ == 0) {
+    return CommandFailure(ENODEV, "Interface '%s' not found",
+                          arg.ifname().c_str());
+  }
+
+  if (arg.xdp_mode() == "skb") {
+    xdp_flags_ = XDP_FLAGS_SKB_MODE;
+  } else if (arg.xdp_mode() == "drv") {
+    xdp_flags_ = XDP_FLAGS_DRV_MODE;
+  } else if (arg.xdp_mode().empty()) {
+    xdp_flags_ = 0;  // let the kernel pick
+  } else {
+    return CommandFailure(EINVAL, "'xdp_mode' must be 'skb' or 'drv'");
+  }
+
+  frame_size_ = arg.frame_size() ?: kDefaultFrameSize;
+  if (frame_size_ != 2048 && frame_size_ != 4096) {
+    return CommandFailure(EINVAL, "'frame_size' must be 2048 or 4096");
+  }
+
+  num_frames_ = arg.num_frames() ?: kDefaultNumFrames;
+  if (num_frames_ < 2 * bess::PacketBatch::kMaxBurst ||
+      (num_frames_ & (num_frames_ - 1)) != 0) {
+    return CommandFailure(EINVAL,
+                          "'num_frames' must be a power of two, at least %zu",
+                          2 * bess::PacketBatch::kMaxBurst);
+  }
+
+  uint32_t bind_flags = XDP_USE_NEED_WAKEUP;
+  if (arg.zero_copy()) {
+    bind_flags |= XDP_ZEROCOPY;
+  } else if (arg.xdp_mode() == "skb") {
+    bind_flags |= XDP_COPY;
+  }
+
+  busy_poll_ = arg.busy_poll_us() > 0;
+
+  // XDP sockets are bidirectional, so each one serves both an incoming and
+  // an outgoing queue of the same index.
+  int num_xsks =
+      std::max(num_queues[PACKET_DIR_INC], num_queues[PACKET_DIR_OUT]);
+
+  err = LoadXdpProgram();
+  if (err.error().code() != 0) {
+    DeInit();
+    return err;
+  }
+
+  xsks_.resize(num_xsks);
+  for (Xsk &xsk : xsks_) {
+    xsk.fd = kInvalidFd;
+    xsk.umem = nullptr;
+    xsk.umem_len = 0;
+    for (Ring *ring : {&xsk.fill, &xsk.comp, &xsk.rx, &xsk.tx}) {
+      memset(ring, 0, sizeof(*ring));
+    }
+  }
+
+  for (int i = 0; i < num_xsks; i++) {
+    err = CreateXsk(i, &xsks_[i], bind_flags, arg.busy_poll_us(),
+                    arg.busy_poll_budget());
+    if (err.error().code() != 0) {
+      DeInit();
+      return err;
+    }
+  }
+
+  err = AttachXdpProgram(prog_fd_);
+  if (err.error().code() != 0) {
+    DeInit();
+    return err;
+  }
+  prog_attached_ = true;
+
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  snprintf(ifr.ifr_name, IFNAMSIZ, "%s", arg.ifname().c_str());
+  if (ioctl(xsks_[0].fd, SIOCGIFHWADDR, &ifr) == 0) {
+    bess::utils::Copy(mac_addr, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+  }
+
+  return CommandSuccess();
+}
+
+void AFXDPPort::DeInit() {
+  if (prog_attached_) {
+    CommandResponse err = AttachXdpProgram(-1);
+    if (err.error().code() != 0) {
+      LOG(WARNING) << "Failed to detach the XDP program: "
+                   << err.error().errmsg();
+    }
+    prog_attached_ = false;
+  }
+
+  for (Xsk &xsk : xsks_) {
+    DestroyXsk(&xsk);
+  }
+  xsks_.clear();
+
+  if (prog_fd_ != kInvalidFd) {
+    close(prog_fd_);
+    prog_fd_ = kInvalidFd;
+  }
+
+  if (xsks_map_fd_ != kInvalidFd) {
+    close(xsks_map_fd_);
+    xsks_map_fd_ = kInvalidFd;
+  }
+}
+
+int AFXDPPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
+  Xsk *xsk = &xsks_[qid];
+  Ring *rx = &xsk->rx;
+  Ring *fill = &xsk->fill;
+
+  uint32_t n = cons_nb_avail(&rx->cached_prod, rx->cached_cons, rx->producer,
+                             cnt);
+  if (n == 0) {
+    // Without busy polling, the kernel needs a syscall only if it ran out of
+    // fill ring entries. With busy polling, the syscall drives the NAPI loop.
+    if (busy_poll_ || ring_needs_wakeup(fill->flags)) {
+      recvfrom(xsk->fd, nullptr, 0, MSG_DONTWAIT, nullptr, nullptr);
+    }
+    return 0;
+  }
+
+  const struct xdp_desc *descs = static_cast<struct xdp_desc *>(rx->descs);
+  uint64_t *fill_addrs = static_cast<uint64_t *>(fill->descs);
+  uint32_t rx_idx = rx->cached_cons;
+  uint32_t fill_idx = fill->cached_prod;
+
+  // The fill ring is as large as the UMEM, so there is always room.
+  prod_nb_free(fill->cached_cons, fill->consumer, fill->size,
+               &fill->cached_prod, n, &fill->cached_cons);
+
+  int received = bess::Packet::Alloc(pkts, n, 0);
+  if (received == 0) {
+    queue_stats[PACKET_DIR_INC][qid].dropped += n;
+  }
+
+  for (uint32_t i = 0; i < n; i++) {
+    const struct xdp_desc *desc = &descs[(rx_idx + i) & rx->mask];
+
+    if (received) {
+      bess::Packet *pkt = pkts[i];
+      bess::utils::CopyInlined(pkt->append(desc->len), xsk->umem + desc->addr,
+                               desc->len);
+    }
+
+    // Give the frame back to the kernel right away.
+    fill_addrs[(fill_idx + i) & fill->mask] =
+        desc->addr & ~static_cast<uint64_t>(frame_size_ - 1);
+  }
+
+  rx->cached_cons += n;
+  ring_release(rx->consumer, n);
+
+  fill->cached_prod += n;
+  ring_submit(fill->producer, n);
+
+  return received;
+}
+
+void AFXDPPort::ReclaimTxFrames(Xsk *xsk) {
+  Ring *comp = &xsk->comp;
+
+  uint32_t n = cons_nb_avail(&comp->cached_prod, comp->cached_cons,
+                             comp->producer, comp->size);
+  if (n == 0) {
+    return;
+  }
+
+  const uint64_t *addrs = static_cast<uint64_t *>(comp->descs);
+  for (uint32_t i = 0; i < n; i++) {
+    xsk->free_frames.push_back(addrs[(comp->cached_cons + i) & comp->mask]);
+  }
+
+  comp->cached_cons += n;
+  ring_release(comp->consumer, n);
+}
+
+int AFXDPPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
+  Xsk *xsk = &xsks_[qid];
+  Ring *tx = &xsk->tx;
+
+  ReclaimTxFrames(xsk);
+
+  uint32_t n = std::min(static_cast<size_t>(cnt), xsk->free_frames.size());
+  n = std::min(n, prod_nb_free(tx->cached_cons, tx->consumer, tx->size,
+                               &tx->cached_prod, n, &tx->cached_cons));
+
+  struct xdp_desc *descs = static_cast<struct xdp_desc *>(tx->descs);
+  uint32_t tx_idx = tx->cached_prod;
+  uint32_t queued = 0;
+
+  for (uint32_t i = 0; i < n; i++) {
+    bess::Packet *pkt = pkts[i];
+
+    if (unlikely(static_cast<uint32_t>(pkt->total_len()) > frame_size_)) {
+      // Too large for a UMEM frame. The packet is consumed (and freed below),
+      // but never hits the wire.
+      queue_stats[PACKET_DIR_OUT][qid].dropped++;
+      continue;
+    }
+
+    uint64_t addr = xsk->free_frames.back();
+    xsk->free_frames.pop_back();
+
+    char *dst = xsk->umem + addr;
+    for (bess::Packet *seg = pkt; seg; seg = seg->next()) {
+      bess::utils::CopyInlined(dst, seg->head_data(), seg->head_len());
+      dst += seg->head_len();
+    }
+
+    struct xdp_desc *desc = &descs[(tx_idx + queued) & tx->mask];
+    desc->addr = addr;
+    desc->len = pkt->total_len();
+    desc->options = 0;
+    queued++;
+  }
+
+  if (queued) {
+    tx->cached_prod += queued;
+    ring_submit(tx->producer, queued);
+
+    if (busy_poll_ || ring_needs_wakeup(tx->flags)) {
+      sendto(xsk->fd, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+    }
+  }
+
+  if (n) {
+    bess::Packet::Free(pkts, n);
+  }
+
+  return n;
+}
+
+ADD_DRIVER(AFXDPPort, "af_xdp_port",
+           "packet exchange via XDP sockets (AF_XDP)")
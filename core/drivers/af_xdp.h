@@ -0,0 +1,139 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_DRIVERS_AF_XDP_H_
+#define BESS_DRIVERS_AF_XDP_H_
+
+#include <linux/if_xdp.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "../message.h"
+#include "../port.h"
+
+/*!
+ * This driver binds a port to a Linux interface through XDP sockets (AF_XDP).
+ * Unlike VPort, it does not need the BESS kernel module, and it works on any
+ * interface with XDP support, including veth pairs (in "skb" mode).
+ *
+ * Each queue of the port is backed by one XDP socket, bound to the same
+ * queue index of the interface. Every socket has its own UMEM, half of which
+ * is posted to the fill ring for RX and the other half is used for TX.
+ */
+class AFXDPPort final : public Port {
+ public:
+  AFXDPPort()
+      : Port(),
+        ifindex_(),
+        xdp_flags_(),
+        prog_fd_(kInvalidFd),
+        xsks_map_fd_(kInvalidFd),
+        prog_attached_(false),
+        frame_size_(),
+        num_frames_(),
+        busy_poll_(false),
+        xsks_() {}
+
+  /*!
+   * Initialize the port, i.e., load and attach the XDP program and create
+   * one XDP socket per queue.
+   */
+  CommandResponse Init(const bess::pb::AFXDPPortArg &arg);
+
+  /*!
+   * Detach the XDP program and close all sockets.
+   */
+  void DeInit() override;
+
+  int RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
+  int SendPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
+
+ private:
+  static const int kInvalidFd = -1;
+
+  static const uint32_t kDefaultFrameSize = 4096;
+  static const uint32_t kDefaultNumFrames = 4096;  // per queue
+
+  // Either the producer or the consumer side of an XDP ring, mmap'd from the
+  // kernel. See Documentation/networking/af_xdp.rst in the Linux tree.
+  struct Ring {
+    uint32_t cached_prod;
+    uint32_t cached_cons;
+    uint32_t mask;
+    uint32_t size;
+    uint32_t *producer;
+    uint32_t *consumer;
+    uint32_t *flags;
+    void *descs;
+
+    void *map;
+    size_t map_len;
+  };
+
+  struct Xsk {
+    int fd;
+
+    char *umem;
+    size_t umem_len;
+
+    Ring fill;  // BESS -> kernel, UMEM addresses for RX
+    Ring comp;  // kernel -> BESS, UMEM addresses done with TX
+    Ring rx;    // kernel -> BESS, RX descriptors
+    Ring tx;    // BESS -> kernel, TX descriptors
+
+    // UMEM addresses of frames available for TX
+    std::vector<uint64_t> free_frames;
+  };
+
+  CommandResponse LoadXdpProgram();
+  CommandResponse AttachXdpProgram(int fd);
+  CommandResponse CreateXsk(queue_t qid, Xsk *xsk, uint32_t bind_flags,
+                            int64_t busy_poll_us, uint32_t busy_poll_budget);
+  void DestroyXsk(Xsk *xsk);
+
+  // Moves completed TX frames back to the free list.
+  void ReclaimTxFrames(Xsk *xsk);
+
+  int ifindex_;
+  uint32_t xdp_flags_;
+
+  int prog_fd_;
+  int xsks_map_fd_;
+  bool prog_attached_;
+
+  uint32_t frame_size_;
+  uint32_t num_frames_;
+
+  bool busy_poll_;
+
+  std::vector<Xsk> xsks_;
+};
+
+#endif  // BESS_DRIVERS_AF_XDP_H_
@@ -0,0 +1,639 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "memif.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "../rcu.h"
+#include "../utils/copy.h"
+
+#define SIG_THREAD_EXIT SIGUSR2
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+// Fills in the queue pair offsets and returns the total size of the region.
+static size_t layout_region(struct memif_region_hdr *hdr) {
+  uint64_t ring_bytes = MEMIF_ALIGN(llring_bytes_with_slots(hdr->ring_slots));
+  uint64_t off = MEMIF_ALIGN(sizeof(*hdr));
+
+  for (uint32_t i = 0; i < hdr->num_qps; i++) {
+    struct memif_queue_pair *qp = &hdr->qps[i];
+
+    qp->regs_off = off;
+    off += MEMIF_ALIGN(sizeof(struct memif_queue_regs));
+
+    qp->free_ring_off = off;
+    off += ring_bytes;
+
+    if (i < hdr->num_inc_q) {
+      qp->inc_ring_off = off;
+      off += ring_bytes;
+    }
+
+    if (i < hdr->num_out_q) {
+      qp->out_ring_off = off;
+      off += ring_bytes;
+    }
+
+    // Start buffers on a page boundary
+    off = (off + 4095) & ~4095ULL;
+    qp->bufs_off = off;
+    off += MEMIF_ALIGN(static_cast<uint64_t>(hdr->bufs_per_qp) * hdr->buf_size);
+  }
+
+  return off;
+}
+
+// Drops descriptors that point past the buffer pool of the queue pair.
+// Returns the number of valid descriptors, which are kept in order.
+static inline int filter_descs(llring_addr_t *descs, int n,
+                               uint32_t bufs_per_qp) {
+  int valid = 0;
+
+  for (int i = 0; i < n; i++) {
+    if (likely(memif_desc_idx(descs[i]) < bufs_per_qp)) {
+      descs[valid++] = descs[i];
+    }
+  }
+
+  return valid;
+}
+
+// The data path does not use llring_*() on the rings: they would take the
+// ring geometry from the ring header, and wait for as long as it takes for
+// the client to finish an operation it started, both of which the client
+// controls. The functions below take the mask from the private layout, clamp
+// head/tail distances to what a ring can hold and give up waiting for the
+// client after a while (e.g., because it died in the middle of an
+// operation). A misbehaving client can still mess up its own rings, but not
+// make BESS access memory out of the ring or hang.
+
+// How many times to check whether the client has finished its operation
+static const int kMaxRingSpins = 1 << 16;
+
+static inline void wait_for_client(volatile uint32_t *tail, uint32_t val) {
+  for (int i = 0; *tail != val && i < kMaxRingSpins; i++) {
+    _mm_pause();
+  }
+}
+
+// Dequeues up to n descriptors. Set `shared` if the client may also dequeue
+// from the ring.
+static inline int ring_dequeue(struct llring *r, uint32_t mask,
+                               llring_addr_t *descs, uint32_t n, bool shared) {
+  const uint32_t max = n;
+  uint32_t head;
+  uint32_t next;
+
+  while (true) {
+    head = r->cons.head;
+    n = std::min(max, std::min(r->prod.tail - head, mask));
+    if (n == 0) {
+      return 0;
+    }
+    next = head + n;
+    if (!shared) {
+      r->cons.head = next;
+      break;
+    }
+    if (llring_atomic32_cmpset(&r->cons.head, head, next)) {
+      break;
+    }
+  }
+
+  COMPILER_BARRIER();
+  for (uint32_t i = 0; i < n; i++) {
+    descs[i] = r->ring[(head + i) & mask];
+  }
+  COMPILER_BARRIER();
+
+  if (shared) {
+    wait_for_client(&r->cons.tail, head);
+  }
+  r->cons.tail = next;
+  return n;
+}
+
+// Enqueues up to n descriptors. Set `shared` if the client may also enqueue
+// to the ring.
+static inline int ring_enqueue(struct llring *r, uint32_t mask,
+                               const llring_addr_t *descs, uint32_t n,
+                               bool shared) {
+  const uint32_t max = n;
+  uint32_t head;
+  uint32_t next;
+
+  while (true) {
+    head = r->prod.head;
+    n = std::min(max, std::min(mask + r->cons.tail - head, mask));
+    if (n == 0) {
+      return 0;
+    }
+    next = head + n;
+    if (!shared) {
+      r->prod.head = next;
+      break;
+    }
+    if (llring_atomic32_cmpset(&r->prod.head, head, next)) {
+      break;
+    }
+  }
+
+  for (uint32_t i = 0; i < n; i++) {
+    r->ring[(head + i) & mask] = descs[i];
+  }
+  COMPILER_BARRIER();
+
+  if (shared) {
+    wait_for_client(&r->prod.tail, head);
+  }
+  r->prod.tail = next;
+  return n;
+}
+
+void MemifPort::ResetRegion() {
+  const uint32_t slots = layout_.ring_slots;
+
+  // Undo whatever the previous client may have written to the header.
+  memcpy(hdr_, &layout_, sizeof(layout_));
+
+  for (uint32_t i = 0; i < layout_.num_qps; i++) {
+    // The free ring is shared by both sides, in both directions.
+    llring_init(free_rings_[i], slots, 0, 0);
+
+    if (inc_rings_[i]) {
+      llring_init(inc_rings_[i], slots, 1, 1);
+    }
+
+    if (out_rings_[i]) {
+      llring_init(out_rings_[i], slots, 1, 1);
+      out_regs_[i]->irq_enabled = 0;
+    }
+
+    llring_addr_t descs[bess::PacketBatch::kMaxBurst];
+    const uint32_t burst = bess::PacketBatch::kMaxBurst;
+    uint32_t idx = 0;
+    while (idx < layout_.bufs_per_qp) {
+      uint32_t n = std::min(layout_.bufs_per_qp - idx, burst);
+      for (uint32_t j = 0; j < n; j++) {
+        descs[j] = memif_desc(idx + j, 0);
+      }
+      int ret = llring_mp_enqueue_bulk(free_rings_[i], descs, n);
+      DCHECK(ret == 0 || ret == -LLRING_ERR_QUOT);
+      idx += n;
+    }
+  }
+
+  __sync_synchronize();
+}
+
+bool MemifPort::SendHello(int fd) {
+  struct memif_hello hello;
+  memset(&hello, 0, sizeof(hello));
+  hello.magic = MEMIF_MAGIC;
+  hello.region_size = region_size_;
+  hello.num_inc_q = layout_.num_inc_q;
+  hello.num_out_q = layout_.num_out_q;
+
+  int num_fds = 1 + layout_.num_out_q;
+  int fds[1 + MAX_QUEUES_PER_DIR];
+  fds[0] = region_fd_;
+  for (uint32_t i = 0; i < layout_.num_out_q; i++) {
+    fds[1 + i] = out_irq_fds_[i];
+  }
+
+  char cbuf[CMSG_SPACE(sizeof(fds))];
+  memset(cbuf, 0, sizeof(cbuf));
+
+  struct iovec iov;
+  iov.iov_base = &hello;
+  iov.iov_len = sizeof(hello);
+
+  struct msghdr msg = msghdr();
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf;
+  msg.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * num_fds);
+
+  ssize_t ret;
+  do {
+    ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+  } while (ret < 0 && errno == EINTR);
+
+  if (ret < 0) {
+    PLOG(ERROR) << "sendmsg()";
+    return false;
+  }
+
+  return true;
+}
+
+void MemifPort::AcceptThread() {
+  sigset_t sigset;
+  sigfillset(&sigset);
+  sigdelset(&sigset, SIG_THREAD_EXIT);
+
+  struct pollfd fds[2];
+  memset(fds, 0, sizeof(fds));
+  fds[0].fd = listen_fd_;
+  fds[0].events = POLLIN;
+  fds[1].events = POLLRDHUP;
+
+  while (true) {
+    // negative FDs are ignored by ppoll()
+    fds[1].fd = client_fd_;
+    int res = ppoll(fds, 2, nullptr, &sigset);
+
+    if (accept_thread_stop_req_) {
+      return;
+
+    } else if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      } else {
+        PLOG(ERROR) << "ppoll()";
+      }
+
+    } else if (fds[0].revents & POLLIN) {
+      // new client connected
+      int fd;
+      while (true) {
+        fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0 || errno != EINTR) {
+          break;
+        }
+      }
+      if (fd < 0) {
+        PLOG(ERROR) << "accept4()";
+      } else if (client_fd_ != kInvalidFd) {
+        LOG(WARNING) << "Ignoring additional client";
+        close(fd);
+      } else {
+        // The data path does not touch the region while disconnected, but a
+        // worker may still be in Recv/SendPackets() for the previous client.
+        bess::SynchronizeRcu();
+        ResetRegion();
+        if (SendHello(fd)) {
+          client_fd_ = fd;
+          connected_.store(true, std::memory_order_release);
+        } else {
+          close(fd);
+        }
+      }
+
+    } else if (fds[1].revents & (POLLRDHUP | POLLHUP)) {
+      // connection dropped by client
+      connected_.store(false, std::memory_order_release);
+      close(client_fd_);
+      client_fd_ = kInvalidFd;
+    }
+  }
+}
+
+static void AcceptThreadHandler(int) {
+  // empty handler, we only care about blocking syscalls being interrupted
+}
+
+CommandResponse MemifPort::Init(const bess::pb::MemifPortArg &arg) {
+  uint32_t num_inc_q = num_queues[PACKET_DIR_INC];
+  uint32_t num_out_q = num_queues[PACKET_DIR_OUT];
+  int ret;
+
+  static_assert(MEMIF_MAX_QUEUES == MAX_QUEUES_PER_DIR,
+                "memif_common.h is out of sync with port.h");
+
+  uint64_t ring_slots = arg.ring_size() ?: kDefaultRingSlots;
+  if (ring_slots < 2 * bess::PacketBatch::kMaxBurst || ring_slots > 65536 ||
+      (ring_slots & (ring_slots - 1)) != 0) {
+    return CommandFailure(EINVAL,
+                          "'ring_size' must be a power of two in [%zu, 65536]",
+                          2 * bess::PacketBatch::kMaxBurst);
+  }
+
+  uint64_t buf_size = arg.buf_size() ?: kDefaultBufSize;
+  if (buf_size < 64 || buf_size > SNBUF_DATA || buf_size % 64 != 0) {
+    return CommandFailure(EINVAL,
+                          "'buf_size' must be a multiple of 64 in [64, %d]",
+                          SNBUF_DATA);
+  }
+
+  struct memif_region_hdr hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = MEMIF_MAGIC;
+  hdr.num_inc_q = num_inc_q;
+  hdr.num_out_q = num_out_q;
+  hdr.num_qps = std::max(num_inc_q, num_out_q);
+  hdr.ring_slots = ring_slots;
+  hdr.bufs_per_qp = ring_slots - 1;
+  hdr.buf_size = buf_size;
+  hdr.region_size = region_size_ = layout_region(&hdr);
+
+  region_fd_ = syscall(__NR_memfd_create, name().c_str(), MFD_CLOEXEC);
+  if (region_fd_ < 0) {
+    region_fd_ = kInvalidFd;
+    DeInit();
+    return CommandFailure(errno, "memfd_create() failed");
+  }
+
+  if (ftruncate(region_fd_, region_size_) < 0) {
+    DeInit();
+    return CommandFailure(errno, "ftruncate() failed");
+  }
+
+  region_ = mmap(nullptr, region_size_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, region_fd_, 0);
+  if (region_ == MAP_FAILED) {
+    region_ = nullptr;
+    DeInit();
+    return CommandFailure(errno, "mmap() of %zu bytes failed", region_size_);
+  }
+
+  hdr_ = static_cast<struct memif_region_hdr *>(region_);
+  memcpy(hdr_, &hdr, sizeof(hdr));
+  layout_ = hdr;
+
+  for (uint32_t i = 0; i < hdr.num_qps; i++) {
+    const struct memif_queue_pair *qp = &hdr.qps[i];
+
+    bufs_[i] = static_cast<char *>(region_) + qp->bufs_off;
+    free_rings_[i] = memif_ring(region_, qp->free_ring_off);
+    if (qp->inc_ring_off) {
+      inc_rings_[i] = memif_ring(region_, qp->inc_ring_off);
+    }
+    if (qp->out_ring_off) {
+      out_rings_[i] = memif_ring(region_, qp->out_ring_off);
+      out_regs_[i] = reinterpret_cast<struct memif_queue_regs *>(
+          static_cast<char *>(region_) + qp->regs_off);
+    }
+  }
+
+  for (uint32_t i = 0; i < num_out_q; i++) {
+    out_irq_fds_[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (out_irq_fds_[i] < 0) {
+      out_irq_fds_[i] = kInvalidFd;
+      DeInit();
+      return CommandFailure(errno, "eventfd() failed");
+    }
+  }
+
+  listen_fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) {
+    listen_fd_ = kInvalidFd;
+    DeInit();
+    return CommandFailure(errno, "socket(AF_UNIX) failed");
+  }
+
+  addr_.sun_family = AF_UNIX;
+
+  const std::string path = arg.path();
+  if (path.length() != 0) {
+    snprintf(addr_.sun_path, sizeof(addr_.sun_path), "%s", path.c_str());
+  } else {
+    snprintf(addr_.sun_path, sizeof(addr_.sun_path), "%s/bess_memif_%s",
+             P_tmpdir, name().c_str());
+  }
+
+  // This doesn't include the trailing null character.
+  size_t addrlen = sizeof(addr_.sun_family) + strlen(addr_.sun_path);
+
+  // Non-abstract socket address?
+  if (addr_.sun_path[0] != '@') {
+    // Remove existing socket file, if any.
+    unlink(addr_.sun_path);
+  } else {
+    addr_.sun_path[0] = '\0';
+  }
+
+  ret = bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr_), addrlen);
+  if (ret < 0) {
+    DeInit();
+    return CommandFailure(errno, "bind(%s) failed", addr_.sun_path);
+  }
+
+  ret = listen(listen_fd_, 1);
+  if (ret < 0) {
+    DeInit();
+    return CommandFailure(errno, "listen() failed");
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = AcceptThreadHandler;
+  if (sigaction(SIG_THREAD_EXIT, &sa, NULL) < 0) {
+    DeInit();
+    return CommandFailure(errno, "sigaction(SIG_THREAD_EXIT) failed");
+  }
+
+  accept_thread_ = std::thread([this]() { this->AcceptThread(); });
+
+  return CommandSuccess();
+}
+
+void MemifPort::DeInit() {
+  if (accept_thread_.joinable()) {
+    accept_thread_stop_req_ = true;
+    pthread_kill(accept_thread_.native_handle(), SIG_THREAD_EXIT);
+    accept_thread_.join();
+  }
+
+  connected_ = false;
+
+  if (client_fd_ != kInvalidFd) {
+    close(client_fd_);
+    client_fd_ = kInvalidFd;
+  }
+
+  if (listen_fd_ != kInvalidFd) {
+    close(listen_fd_);
+    listen_fd_ = kInvalidFd;
+    if (addr_.sun_path[0] != '\0') {
+      unlink(addr_.sun_path);
+    }
+  }
+
+  for (int i = 0; i < MAX_QUEUES_PER_DIR; i++) {
+    if (out_irq_fds_[i] > 0) {
+      close(out_irq_fds_[i]);
+    }
+    out_irq_fds_[i] = 0;
+  }
+
+  if (region_) {
+    munmap(region_, region_size_);
+    region_ = nullptr;
+    hdr_ = nullptr;
+  }
+
+  if (region_fd_ != kInvalidFd) {
+    close(region_fd_);
+    region_fd_ = kInvalidFd;
+  }
+}
+
+int MemifPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
+  if (!connected_.load(std::memory_order_acquire)) {
+    return 0;
+  }
+
+  DCHECK_LE(cnt, bess::PacketBatch::kMaxBurst);
+
+  const uint32_t mask = layout_.ring_slots - 1;
+  llring_addr_t descs[bess::PacketBatch::kMaxBurst];
+  int n = ring_dequeue(inc_rings_[qid], mask, descs, cnt, false);
+  if (n == 0) {
+    return 0;
+  }
+
+  // Do not trust the client with the index. Bogus descriptors are dropped
+  // without being returned to the free ring.
+  int valid = filter_descs(descs, n, layout_.bufs_per_qp);
+  if (unlikely(valid < n)) {
+    queue_stats[PACKET_DIR_INC][qid].dropped += n - valid;
+    n = valid;
+    if (n == 0) {
+      return 0;
+    }
+  }
+
+  const uint32_t buf_size = layout_.buf_size;
+  int received = 0;
+
+  if (bess::Packet::Alloc(pkts, n, 0)) {
+    for (int i = 0; i < n; i++) {
+      uint32_t idx = memif_desc_idx(descs[i]);
+      // Nor with the length
+      uint32_t len = std::min(memif_desc_len(descs[i]), buf_size);
+
+      const char *src = bufs_[qid] + static_cast<uint64_t>(idx) * buf_size;
+
+      bess::utils::CopyInlined(pkts[i]->append(len), src, len);
+      descs[i] = memif_desc(idx, 0);
+    }
+    received = n;
+  } else {
+    queue_stats[PACKET_DIR_INC][qid].dropped += n;
+    for (int i = 0; i < n; i++) {
+      descs[i] = memif_desc(memif_desc_idx(descs[i]), 0);
+    }
+  }
+
+  ring_enqueue(free_rings_[qid], mask, descs, n, true);
+
+  return received;
+}
+
+int MemifPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
+  if (!connected_.load(std::memory_order_acquire)) {
+    return 0;
+  }
+
+  DCHECK_LE(cnt, bess::PacketBatch::kMaxBurst);
+
+  const uint32_t mask = layout_.ring_slots - 1;
+  llring_addr_t descs[bess::PacketBatch::kMaxBurst];
+  int n = ring_dequeue(free_rings_[qid], mask, descs, cnt, true);
+  if (n == 0) {
+    return 0;
+  }
+
+  // The client also enqueues to the free ring. Discard bogus descriptors and
+  // send only as many packets as there are valid ones.
+  n = filter_descs(descs, n, layout_.bufs_per_qp);
+  if (unlikely(n == 0)) {
+    return 0;
+  }
+
+  const uint32_t buf_size = layout_.buf_size;
+  int used = 0;
+
+  for (int i = 0; i < n; i++) {
+    bess::Packet *pkt = pkts[i];
+    uint32_t len = pkt->total_len();
+
+    if (unlikely(len > buf_size)) {
+      // Consumed (and freed below), but never reaches the client.
+      queue_stats[PACKET_DIR_OUT][qid].dropped++;
+      continue;
+    }
+
+    uint32_t idx = memif_desc_idx(descs[used]);
+    char *dst = bufs_[qid] + static_cast<uint64_t>(idx) * buf_size;
+    for (bess::Packet *seg = pkt; seg; seg = seg->next()) {
+      bess::utils::CopyInlined(dst, seg->head_data(), seg->head_len());
+      dst += seg->head_len();
+    }
+
+    descs[used++] = memif_desc(idx, len);
+  }
+
+  if (unlikely(used < n)) {
+    ring_enqueue(free_rings_[qid], mask, descs + used, n - used, true);
+  }
+
+  if (used) {
+    // Never fails, unless the client has messed up the ring: the ring is
+    // larger than the buffer pool.
+    ring_enqueue(out_rings_[qid], mask, descs, used, false);
+
+    struct memif_queue_regs *regs = out_regs_[qid];
+    if (regs->irq_enabled &&
+        __sync_bool_compare_and_swap(&regs->irq_enabled, 1, 0)) {
+      uint64_t t = 1;
+      ssize_t ret = write(out_irq_fds_[qid], &t, sizeof(t));
+      (void)ret;
+    }
+  }
+
+  bess::Packet::Free(pkts, n);
+
+  return n;
+}
+
+ADD_DRIVER(MemifPort, "memif_port",
+           "packet exchange via shared memory rings with a local process")
@@ -0,0 +1,143 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_DRIVERS_MEMIF_H_
+#define BESS_DRIVERS_MEMIF_H_
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <atomic>
+#include <thread>
+
+#include "../message.h"
+#include "../port.h"
+#include "memif_common.h"
+
+/*!
+ * This driver exchanges packets with a local process through descriptor rings
+ * and packet buffers in a shared memory region (see memif_common.h). The UNIX
+ * socket is used only for setup: upon connection, the client receives the
+ * file descriptors of the region and of the eventfds for wakeups. There are no
+ * system calls on the data path, unless the client asks to be woken up.
+ * Only one client can be connected at the same time.
+ */
+class MemifPort final : public Port {
+ public:
+  MemifPort()
+      : Port(),
+        region_(),
+        region_size_(),
+        region_fd_(kInvalidFd),
+        hdr_(),
+        layout_(),
+        bufs_(),
+        inc_rings_(),
+        out_rings_(),
+        free_rings_(),
+        out_regs_(),
+        out_irq_fds_(),
+        accept_thread_stop_req_(false),
+        listen_fd_(kInvalidFd),
+        addr_(),
+        client_fd_(kInvalidFd),
+        connected_(false) {}
+
+  /*!
+   * Initialize the port, ie, allocate the shared memory region and open the
+   * socket.
+   *
+   * PARAMETERS:
+   * * string path : file name to bind the socket to.
+   * * uint64 ring_size : number of slots of each ring.
+   * * uint64 buf_size : size of each packet buffer.
+   */
+  CommandResponse Init(const bess::pb::MemifPortArg &arg);
+
+  /*!
+   * Close the socket and release the region.
+   */
+  void DeInit() override;
+
+  int RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
+  int SendPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
+
+ private:
+  static const int kInvalidFd = -1;
+
+  static const uint32_t kDefaultRingSlots = 1024;
+  static const uint32_t kDefaultBufSize = 2048;
+
+  /*!
+   * (Re)initialize all rings and put every buffer back to the free rings.
+   * Called whenever a new client connects, so that buffers held by a previous
+   * client that died are reclaimed.
+   */
+  void ResetRegion();
+
+  /*!
+   * Send the memif_hello message with the file descriptors to a new client.
+   */
+  bool SendHello(int fd);
+
+  void AcceptThread();
+
+  void *region_;
+  size_t region_size_;
+  int region_fd_;
+
+  struct memif_region_hdr *hdr_;
+
+  // Private copy of the region header as laid out by Init(). The client can
+  // write anything to hdr_, so the data path only trusts this one.
+  struct memif_region_hdr layout_;
+
+  // Cached pointers into the region, indexed by queue (pair) id
+  char *bufs_[MAX_QUEUES_PER_DIR];
+  struct llring *inc_rings_[MAX_QUEUES_PER_DIR];
+  struct llring *out_rings_[MAX_QUEUES_PER_DIR];
+  struct llring *free_rings_[MAX_QUEUES_PER_DIR];
+  struct memif_queue_regs *out_regs_[MAX_QUEUES_PER_DIR];
+
+  int out_irq_fds_[MAX_QUEUES_PER_DIR];
+
+  std::thread accept_thread_;
+  std::atomic<bool> accept_thread_stop_req_;
+
+  int listen_fd_;
+  struct sockaddr_un addr_;
+
+  // Only accessed by the accept thread
+  int client_fd_;
+
+  // Data path functions do not touch the region unless a client is connected.
+  std::atomic<bool> connected_;
+};
+
+#endif  // BESS_DRIVERS_MEMIF_H_
@@ -0,0 +1,125 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Shared memory layout of MemifPort, shared with external (C) clients such as
+// core/nvport/memif.h. Keep this file C-compatible.
+
+#ifndef BESS_DRIVERS_MEMIF_COMMON_H_
+#define BESS_DRIVERS_MEMIF_COMMON_H_
+
+#include <stdint.h>
+
+#include "../kmod/llring.h"
+
+#define MEMIF_MAGIC 0x4245535353484d31ULL /* "BESSSHM1" */
+
+#define MEMIF_MAX_QUEUES 32 /* per direction, same as MAX_QUEUES_PER_DIR */
+
+#define MEMIF_CACHELINE_SIZE 64
+
+#define MEMIF_ALIGN(x) \
+  (((x) + MEMIF_CACHELINE_SIZE - 1) & ~(uint64_t)(MEMIF_CACHELINE_SIZE - 1))
+
+/* A descriptor is a 64-bit llring slot: buffer index in the lower 32 bits,
+ * data length in the upper 32 bits. Buffers are referred to by index, not by
+ * pointer, since the region is mapped at different addresses in each process.
+ */
+static inline void *memif_desc(uint32_t buf_idx, uint32_t len) {
+  return (void *)(((uint64_t)len << 32) | buf_idx);
+}
+
+static inline uint32_t memif_desc_idx(const void *desc) {
+  return (uint32_t)(uintptr_t)desc;
+}
+
+static inline uint32_t memif_desc_len(const void *desc) {
+  return (uint32_t)((uintptr_t)desc >> 32);
+}
+
+/* The term RX/TX could be very confusing for a virtual switch.
+ * Instead, we use the "incoming/outgoing" convention:
+ * - incoming: outside -> BESS
+ * - outgoing: BESS -> outside */
+struct memif_queue_regs {
+  /* Set by the client before it sleeps on the eventfd of the outgoing queue.
+   * BESS clears it and writes to the eventfd. */
+  volatile uint32_t irq_enabled;
+} __attribute__((aligned(MEMIF_CACHELINE_SIZE)));
+
+/* Queue pair i consists of the incoming queue i and the outgoing queue i
+ * (either can be absent), sharing a pool of buffers. Initially all buffers sit
+ * in the free ring. Anyone (BESS or the client) takes buffers from the free
+ * ring, fills them and enqueues them to a data ring. The receiver gives them
+ * back to the free ring, or forwards them to the other data ring without
+ * copying. The free ring is multi-producer/consumer, the data rings are
+ * single-producer/consumer: each queue must be served by a single thread on
+ * either side. All offsets are from the beginning of the region. */
+struct memif_queue_pair {
+  uint64_t regs_off;
+  uint64_t free_ring_off;
+  uint64_t inc_ring_off; /* 0 if absent */
+  uint64_t out_ring_off; /* 0 if absent */
+  uint64_t bufs_off;
+};
+
+struct memif_region_hdr {
+  uint64_t magic;
+  uint64_t region_size;
+
+  uint32_t num_inc_q;
+  uint32_t num_out_q;
+  uint32_t num_qps; /* max(num_inc_q, num_out_q) */
+
+  uint32_t ring_slots;
+  uint32_t bufs_per_qp; /* ring_slots - 1, so that no ring ever overflows */
+  uint32_t buf_size;
+
+  struct memif_queue_pair qps[MEMIF_MAX_QUEUES];
+};
+
+static inline struct llring *memif_ring(void *region, uint64_t off) {
+  return (struct llring *)((char *)region + off);
+}
+
+static inline char *memif_buf(void *region, const struct memif_queue_pair *qp,
+                              uint32_t buf_size, uint32_t buf_idx) {
+  return (char *)region + qp->bufs_off + (uint64_t)buf_idx * buf_size;
+}
+
+/* Upon connection to the UNIX socket, BESS sends a single message with this
+ * payload. It carries (SCM_RIGHTS) the file descriptor of the region first,
+ * followed by an eventfd for each outgoing queue. */
+struct memif_hello {
+  uint64_t magic;
+  uint64_t region_size;
+  uint32_t num_inc_q;
+  uint32_t num_out_q;
+};
+
+#endif /* BESS_DRIVERS_MEMIF_COMMON_H_ */
@@ -30,24 +30,72 @@
 
 #include "pcap.h"
 
+#include <rte_malloc.h>
+
 #include <algorithm>
 #include <string>
 
 #include "../utils/pcap.h"
+#include "../utils/time.h"
 
 CommandResponse PCAPPort::Init(const bess::pb::PCAPPortArg& arg) {
   if (pcap_handle_.is_initialized()) {
     return CommandFailure(EINVAL, "Device already initialized.");
   }
 
+  if (!arg.replay_file().empty()) {
+    int ret = reader_.Open(arg.replay_file());
+    if (ret < 0) {
+      return CommandFailure(-ret, "Cannot open pcap/pcapng file '%s'",
+                            arg.replay_file().c_str());
+    }
+
+    if (arg.replay_speed() < 0.0) {
+      DeInit();
+      return CommandFailure(EINVAL, "'replay_speed' must be positive");
+    }
+    if (arg.replay_speed() > 0.0 && arg.replay_pps() > 0) {
+      DeInit();
+      return CommandFailure(EINVAL,
+                            "'replay_speed' and 'replay_pps' are exclusive");
+    }
+
+    replay_ = true;
+    speed_ = arg.replay_speed();
+    pps_period_ns_ = arg.replay_pps() ? 1e9 / arg.replay_pps() : 0.0;
+    loops_ = arg.replay_loops() ?: 1;
+
+    if (arg.replay_preload()) {
+      CommandResponse err = Preload();
+      if (err.error().code() != 0) {
+        DeInit();
+        return err;
+      }
+    } else {
+      // Otherwise a looping replay would spin on a trace with nothing in it.
+      Record rec;
+      if (!reader_.Next(&rec)) {
+        DeInit();
+        return CommandFailure(EINVAL, "No packets in the trace");
+      }
+      reader_.Rewind();
+    }
+
+    if (arg.dev().empty()) {
+      return CommandSuccess();
+    }
+  }
+
   const std::string dev = arg.dev();
   pcap_handle_ = PcapHandle(dev);
 
   if (!pcap_handle_.is_initialized()) {
+    DeInit();
     return CommandFailure(EINVAL, "Error initializing device.");
   }
 
   if (pcap_handle_.SetBlocking(false)) {
+    DeInit();
     return CommandFailure(EINVAL, "Error initializing device.");
   }
 
@@ -56,9 +104,157 @@ CommandResponse PCAPPort::Init(const bess::pb::PCAPPortArg& arg) {
 
 void PCAPPort::DeInit() {
   pcap_handle_.Reset();
+
+  reader_.Close();
+  preloaded_.clear();
+  if (preload_buf_) {
+    rte_free(preload_buf_);
+    preload_buf_ = nullptr;
+  }
+}
+
+CommandResponse PCAPPort::Preload() {
+  Record rec;
+  size_t total_bytes = 0;
+
+  while (reader_.Next(&rec)) {
+    preloaded_.push_back(rec);
+    total_bytes += rec.caplen;
+  }
+
+  if (preloaded_.empty()) {
+    return CommandFailure(EINVAL, "No packets in the trace");
+  }
+
+  preload_buf_ =
+      static_cast<char*>(rte_malloc("pcap_preload", total_bytes, 64));
+  if (!preload_buf_) {
+    return CommandFailure(ENOMEM, "Cannot allocate %zu bytes for preloading",
+                          total_bytes);
+  }
+
+  char* p = preload_buf_;
+  for (Record& r : preloaded_) {
+    bess::utils::Copy(p, r.data, r.caplen);
+    r.data = reinterpret_cast<const uint8_t*>(p);
+    p += r.caplen;
+  }
+
+  // The file is no longer needed
+  reader_.Close();
+
+  return CommandSuccess();
+}
+
+bool PCAPPort::NextRecord(Record* rec) {
+  // Two rewinds in a row mean that a whole pass yielded nothing (e.g., the
+  // rest of the file stopped parsing), which would loop forever.
+  int rewinds = 0;
+
+  while ((loops_ < 0 || passes_ < loops_) && rewinds < 2) {
+    if (preload_buf_) {
+      if (preload_idx_ < preloaded_.size()) {
+        *rec = preloaded_[preload_idx_++];
+        return true;
+      }
+      preload_idx_ = 0;
+    } else {
+      if (reader_.Next(rec)) {
+        return true;
+      }
+      reader_.Rewind();
+    }
+
+    passes_++;
+    new_pass_ = true;
+    rewinds++;
+  }
+
+  return false;
+}
+
+uint64_t PCAPPort::ReleaseTime(const Record& rec, uint64_t now_ns) {
+  uint64_t release_ns;
+
+  if (pps_period_ns_ > 0.0) {
+    if (next_release_ns_ == 0.0) {
+      next_release_ns_ = now_ns;
+    }
+    release_ns = next_release_ns_;
+    next_release_ns_ += pps_period_ns_;
+  } else if (speed_ > 0.0) {
+    if (new_pass_) {
+      // The next pass starts right after the previous one, so that falling
+      // behind in one pass does not shift the timing of the following ones.
+      pass_base_ns_ = last_release_ns_ ?: now_ns;
+      pass_first_ts_ = rec.ts_ns;
+      new_pass_ = false;
+    }
+    // Out-of-order timestamps are sent right away.
+    uint64_t delta = (rec.ts_ns > pass_first_ts_)
+                         ? (rec.ts_ns - pass_first_ts_) / speed_
+                         : 0;
+    release_ns = pass_base_ns_ + delta;
+  } else {
+    return 0;
+  }
+
+  last_release_ns_ = release_ns;
+  return release_ns;
+}
+
+int PCAPPort::ReplayPackets(bess::Packet** pkts, int cnt) {
+  const bool paced = (pps_period_ns_ > 0.0 || speed_ > 0.0);
+  uint64_t now_ns = paced ? tsc_to_ns(rdtsc()) : 0;
+
+  Record recs[bess::PacketBatch::kMaxBurst];
+  int n = 0;
+
+  DCHECK_LE(cnt, bess::PacketBatch::kMaxBurst);
+
+  while (n < cnt) {
+    if (!have_pending_) {
+      if (!NextRecord(&pending_)) {
+        break;
+      }
+      have_pending_ = true;
+      pending_release_ns_ = ReleaseTime(pending_, now_ns);
+    }
+
+    if (pending_release_ns_ > now_ns) {
+      break;
+    }
+
+    recs[n++] = pending_;
+    have_pending_ = false;
+  }
+
+  if (n == 0) {
+    return 0;
+  }
+
+  if (!bess::Packet::Alloc(pkts, n, 0)) {
+    // Out of buffers: drop them, rather than delaying the rest of the trace.
+    queue_stats[PACKET_DIR_INC][0].dropped += n;
+    return 0;
+  }
+
+  for (int i = 0; i < n; i++) {
+    bess::Packet* pkt = pkts[i];
+    // Jumbo frames longer than a snbuf are truncated.
+    uint32_t len = std::min<uint32_t>(recs[i].caplen, pkt->tailroom());
+    bess::utils::CopyInlined(pkt->append(len), recs[i].data, len);
+  }
+
+  return n;
 }
 
 int PCAPPort::RecvPackets(queue_t qid, bess::Packet** pkts, int cnt) {
+  if (replay_) {
+    DCHECK_EQ(qid, 0);
+    return ReplayPackets(pkts, cnt);
+  }
+
   if (!pcap_handle_.is_initialized()) {
     return 0;
   }
@@ -114,6 +310,9 @@ int PCAPPort::RecvPackets(queue_t qid, bess::Packet** pkts, int cnt) {
 
 int PCAPPort::SendPackets(queue_t, bess::Packet** pkts, int cnt) {
   if (!pcap_handle_.is_initialized()) {
+    if (replay_) {
+      return 0;  // No device to send to: PortOut drops them.
+    }
     CHECK(0);  // raise an error
   }
 
@@ -147,4 +346,5 @@ void PCAPPort::GatherData(unsigned char* data, bess::Packet* pkt) {
   }
 }
 
-ADD_DRIVER(PCAPPort, "pcap_port", "libpcap live packet capture from Linux port")
+ADD_DRIVER(PCAPPort, "pcap_port",
+           "libpcap live packet capture from Linux port, or pcap file replay")
@@ -35,12 +35,19 @@
 
 #include <glog/logging.h>
 
+#include <vector>
+
 #include "../utils/pcap_handle.h"
+#include "../utils/pcap_reader.h"
 
 // Port to connect to a device via PCAP.
 // (Not recommended because PCAP is slow :-)
 // This driver is experimental. Currently does not support mbuf chaining and
 // needs more tests!
+//
+// With replay_file, the port instead replays a pcap/pcapng trace on RX,
+// optionally paced (original timing, scaled, or at a fixed rate) and looped.
+// The file is parsed in place (PcapReader), not through libpcap.
 class PCAPPort final : public Port {
  public:
   CommandResponse Init(const bess::pb::PCAPPortArg &arg);
@@ -52,8 +59,49 @@ class PCAPPort final : public Port {
   int RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
 
  private:
+  typedef bess::utils::PcapReader::Record Record;
+
   void GatherData(unsigned char *data, bess::Packet *pkt);
+
+  // Copies the whole trace into hugepage memory.
+  CommandResponse Preload();
+
+  // Returns the next record of the trace, rewinding it at the end of each
+  // pass. Returns false once all passes are done.
+  bool NextRecord(Record *rec);
+
+  // Returns the (TSC-based) time in ns at which rec should be sent.
+  uint64_t ReleaseTime(const Record &rec, uint64_t now_ns);
+
+  int ReplayPackets(bess::Packet **pkts, int cnt);
+
   PcapHandle pcap_handle_;
+
+  bool replay_ = false;
+  bess::utils::PcapReader reader_;
+
+  // Preloaded trace, if enabled. Records point into preload_buf_.
+  std::vector<Record> preloaded_;
+  char *preload_buf_ = nullptr;
+  size_t preload_idx_ = 0;
+
+  double speed_ = 0.0;          // > 0 for timestamp-based pacing
+  double pps_period_ns_ = 0.0;  // > 0 for fixed-rate pacing
+  double next_release_ns_ = 0.0;
+
+  int64_t loops_ = 1;  // negative: forever
+  int64_t passes_ = 0;
+
+  // A record read from the trace, but not sent yet (too early)
+  bool have_pending_ = false;
+  Record pending_ = {};
+  uint64_t pending_release_ns_ = 0;
+
+  // For timestamp-based pacing: time = pass_base_ns_ + (ts - pass_first_ts_)
+  bool new_pass_ = true;
+  uint64_t pass_base_ns_ = 0;
+  uint64_t pass_first_ts_ = 0;
+  uint64_t last_release_ns_ = 0;
 };
 
 #endif  // BESS_DRIVERS_PCAP_H_
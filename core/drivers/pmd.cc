@@ -30,6 +30,9 @@
 
 #include "pmd.h"
 
+#include <algorithm>
+
+#include "../dpdk.h"
 #include "../utils/ether.h"
 #include "../utils/format.h"
 
@@ -71,6 +74,10 @@ static const struct rte_eth_conf default_eth_conf() {
 }
 
 void PMDPort::InitDriver() {
+  if (is_pci_probe_deferred()) {
+    LOG(INFO) << "DPDK PCI devices will be probed when a PMD port is created";
+  }
+
   dpdk_port_t num_dpdk_ports = rte_eth_dev_count();
 
   LOG(INFO) << static_cast<int>(num_dpdk_ports)
@@ -220,6 +227,8 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
   CommandResponse err;
   switch (arg.port_case()) {
     case bess::pb::PMDPortArg::kPortId: {
+      // Port IDs are assigned as devices are probed.
+      probe_pci_devices();
       err = find_dpdk_port_by_id(arg.port_id(), &ret_port_id);
       break;
     }
@@ -294,9 +303,9 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
       sid = 0;
     }
 
-    ret =
-        rte_eth_rx_queue_setup(ret_port_id, i, queue_size[PACKET_DIR_INC], sid,
-                               &eth_rxconf, bess::get_pframe_pool_socket(sid));
+    struct rte_mempool *pool = bess::ensure_pframe_pool_socket(sid);
+    ret = rte_eth_rx_queue_setup(ret_port_id, i, queue_size[PACKET_DIR_INC],
+                                 sid, &eth_rxconf, pool);
     if (ret != 0) {
       return CommandFailure(-ret, "rte_eth_rx_queue_setup() failed");
     }
@@ -392,7 +401,21 @@ void PMDPort::CollectStats(bool reset) {
 }
 
 int PMDPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
-  return rte_eth_rx_burst(dpdk_port_id_, qid, (struct rte_mbuf **)pkts, cnt);
+  // Vector PMDs return at most 32 packets per call, regardless of cnt, so
+  // keep polling while they return full bursts for larger batch sizes.
+  static const int kPmdBurst = 32;
+
+  int recv = 0;
+  while (recv < cnt) {
+    int want = std::min(cnt - recv, kPmdBurst);
+    int n = rte_eth_rx_burst(dpdk_port_id_, qid,
+                             (struct rte_mbuf **)(pkts + recv), want);
+    recv += n;
+    if (n < want) {
+      break;
+    }
+  }
+  return recv;
 }
 
 int PMDPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
@@ -31,6 +31,7 @@
 #include <glog/logging.h>
 #include <poll.h>
 #include <signal.h>
+#include <sys/epoll.h>
 
 #include <cerrno>
 #include <cstring>
@@ -80,6 +81,12 @@ void UnixSocketPort::AcceptThread() {
         LOG(WARNING) << "Ignoring additional client\n";
         close(fd);
       } else {
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+          PLOG(ERROR) << "epoll_ctl()";
+        }
         client_fd_ = fd;
         if (confirm_connect_) {
           // Send confirmation that we've accepted their connect().
@@ -119,6 +126,22 @@ CommandResponse UnixSocketPort::Init(const bess::pb::UnixSocketPortArg &arg) {
 
   confirm_connect_ = arg.confirm_connect();
 
+  // The client fd is added/removed by the accept thread as it comes and
+  // goes.
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    epoll_fd_ = kNotConnectedFd;
+    DeInit();
+    return CommandFailure(errno, "epoll_create1() failed");
+  }
+
+  // Also lets idle workers sleep until a packet arrives (see
+  // Worker::IdleSleep()), if they are configured to.
+  if (!add_idle_wakeup_fd(epoll_fd_)) {
+    LOG(WARNING) << name() << ": too many idle wakeup fds, workers will not "
+                 << "wake up for incoming packets before their timeout";
+  }
+
   listen_fd_ = socket(AF_UNIX, SOCK_SEQPACKET, 0);
   if (listen_fd_ < 0) {
     DeInit();
@@ -183,100 +206,132 @@ void UnixSocketPort::DeInit() {
   if (client_fd_ != kNotConnectedFd) {
     close(client_fd_);
   }
+  if (epoll_fd_ != kNotConnectedFd) {
+    remove_idle_wakeup_fd(epoll_fd_);
+    close(epoll_fd_);
+  }
+}
+
+int UnixSocketPort::RecvBatch(int client_fd, bess::Packet **pkts, int cnt) {
+  struct mmsghdr msgs[bess::PacketBatch::kMaxBurst];
+  struct iovec iovs[bess::PacketBatch::kMaxBurst];
+
+  for (int i = 0; i < cnt; i++) {
+    // Datagrams larger than SNBUF_DATA will be truncated.
+    iovs[i].iov_base = pkts[i]->data();
+    iovs[i].iov_len = SNBUF_DATA;
+
+    msgs[i].msg_hdr = msghdr();
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  int ret;
+  do {
+    ret = recvmmsg(client_fd, msgs, cnt, MSG_DONTWAIT, nullptr);
+  } while (ret < 0 && errno == EINTR);
+
+  if (ret <= 0) {
+    // EAGAIN/EWOULDBLOCK: nothing to receive; EBADF: the client is gone.
+    return 0;
+  }
+
+  for (int i = 0; i < ret; i++) {
+    // Connection closed.
+    if (msgs[i].msg_len == 0) {
+      return i;
+    }
+    pkts[i]->append(msgs[i].msg_len);
+  }
+
+  return ret;
 }
 
 int UnixSocketPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
   int client_fd = client_fd_;
 
   DCHECK_EQ(qid, 0);
+  DCHECK_LE(cnt, bess::PacketBatch::kMaxBurst);
 
   if (client_fd == kNotConnectedFd) {
     last_idle_ns_ = 0;
     return 0;
   }
 
-  uint64_t now_ns = ctx.current_ns();
-  if (now_ns - last_idle_ns_ < min_rx_interval_ns_) {
-    return 0;
-  }
-
-  int received = 0;
-  while (received < cnt) {
-    bess::Packet *pkt = static_cast<bess::Packet *>(bess::Packet::Alloc());
-
-    if (!pkt) {
-      break;
+  if (last_idle_ns_) {
+    uint64_t now_ns = ctx.current_ns();
+    if (now_ns - last_idle_ns_ < min_rx_interval_ns_) {
+      return 0;
     }
 
-    // Datagrams larger than 2KB will be truncated.
-    int ret = recv(client_fd, pkt->data(), SNBUF_DATA, 0);
-
-    if (ret > 0) {
-      pkt->append(ret);
-      pkts[received++] = pkt;
-      continue;
+    // Nothing came last time. Make sure something did since, before
+    // allocating a batch of packets only to free it again.
+    if (recv(client_fd, nullptr, 0, MSG_PEEK | MSG_DONTWAIT) < 0) {
+      last_idle_ns_ = now_ns;
+      return 0;
     }
+  }
 
-    bess::Packet::Free(pkt);
-
-    if (ret < 0) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EBADF) {
-        break;
-      }
+  if (!bess::Packet::Alloc(pkts, cnt, 0)) {
+    return 0;
+  }
 
-      if (errno == EINTR) {
-        continue;
-      }
-    }
+  int received = RecvBatch(client_fd, pkts, cnt);
 
-    // Connection closed.
-    break;
+  if (received < cnt) {
+    bess::Packet::Free(pkts + received, cnt - received);
   }
 
-  last_idle_ns_ = (received == 0) ? now_ns : 0;
+  last_idle_ns_ = (received == 0) ? ctx.current_ns() : 0;
 
   return received;
 }
 
 int UnixSocketPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
-  int sent = 0;
   int client_fd = client_fd_;
 
   DCHECK_EQ(qid, 0);
+  DCHECK_LE(cnt, bess::PacketBatch::kMaxBurst);
 
   if (client_fd == kNotConnectedFd) {
     return 0;
   }
 
+  int total_segs = 0;
   for (int i = 0; i < cnt; i++) {
-    bess::Packet *pkt = pkts[i];
+    total_segs += pkts[i]->nb_segs();
+  }
 
-    int nb_segs = pkt->nb_segs();
-    struct iovec iov[nb_segs];
+  struct mmsghdr msgs[bess::PacketBatch::kMaxBurst];
+  struct iovec iovs[total_segs];
+  struct iovec *iov = iovs;
 
-    struct msghdr msg = msghdr();
-    msg.msg_iov = iov;
-    msg.msg_iovlen = nb_segs;
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = pkts[i];
+    int nb_segs = pkt->nb_segs();
 
-    ssize_t ret;
+    msgs[i].msg_hdr = msghdr();
+    msgs[i].msg_hdr.msg_iov = iov;
+    msgs[i].msg_hdr.msg_iovlen = nb_segs;
 
     for (int j = 0; j < nb_segs; j++) {
-      iov[j].iov_base = pkt->head_data();
-      iov[j].iov_len = pkt->head_len();
+      iov->iov_base = pkt->head_data();
+      iov->iov_len = pkt->head_len();
+      iov++;
       pkt = pkt->next();
     }
+  }
 
-    ret = sendmsg(client_fd, &msg, 0);
-    if (ret < 0) {
-      break;
-    }
+  int sent;
+  do {
+    sent = sendmmsg(client_fd, msgs, cnt, 0);
+  } while (sent < 0 && errno == EINTR);
 
-    sent++;
+  if (sent <= 0) {
+    return 0;
   }
 
-  if (sent) {
-    bess::Packet::Free(pkts, sent);
-  }
+  bess::Packet::Free(pkts, sent);
 
   return sent;
 }
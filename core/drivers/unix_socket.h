@@ -51,6 +51,7 @@ class UnixSocketPort final : public Port {
       : Port(),
         min_rx_interval_ns_(),
         last_idle_ns_(),
+        epoll_fd_(kNotConnectedFd),
         accept_thread_stop_req_(false),
         listen_fd_(kNotConnectedFd),
         addr_(),
@@ -61,6 +62,7 @@ class UnixSocketPort final : public Port {
    *
    * PARAMETERS:
    * * string path : file name to bind the socket to.
+   * * int64 min_rx_interval_ns : RX polling throttle, when idle.
    */
   CommandResponse Init(const bess::pb::UnixSocketPortArg &arg);
 
@@ -87,6 +89,18 @@ class UnixSocketPort final : public Port {
   uint64_t min_rx_interval_ns_;
   uint64_t last_idle_ns_;
 
+  /*!
+   * Watches the client fd (if any), so that idle workers sleep until a packet
+   * arrives. Registered with add_idle_wakeup_fd().
+   */
+  int epoll_fd_;
+
+  /*!
+   * Receive up to cnt datagrams into pkts (already allocated) with a single
+   * recvmmsg() call. Returns the number of datagrams received.
+   */
+  int RecvBatch(int client_fd, bess::Packet **pkts, int cnt);
+
   /*!
    * Allow user to detect that the accepting/monitoring thread has
    * finished its accept() call and that the socket is now connected.
@@ -0,0 +1,169 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmarks for UnixSocketPort. Everything runs on a loopback connection
+// within the process: a client socket sends a batch of datagrams, which the
+// port receives and sends back to the client. Requires root (for DPDK).
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "../dpdk.h"
+#include "../packet.h"
+#include "../pktbatch.h"
+#include "unix_socket.h"
+
+namespace {
+
+const char kSocketPath[] = "@bess_unix_socket_bench";
+const size_t kPacketSize = 60;
+
+class UnixSocketLoopback : public benchmark::Fixture {
+ public:
+  UnixSocketLoopback() : port_(), client_fd_(-1) {}
+
+  void SetUp(benchmark::State &) override {
+    if (!dpdk_inited_) {
+      if (geteuid() != 0) {
+        LOG(INFO) << "This benchmark requires root privileges. Skipping...";
+        return;
+      }
+      init_dpdk("unix_socket_bench", 1024, 0, true);
+      bess::init_mempool();
+      dpdk_inited_ = true;
+    }
+
+    bess::pb::UnixSocketPortArg arg;
+    arg.set_path(kSocketPath);
+    arg.set_min_rx_interval_ns(-1);
+    arg.set_confirm_connect(true);
+
+    port_ = new UnixSocketPort();
+    port_->num_queues[PACKET_DIR_INC] = 1;
+    port_->num_queues[PACKET_DIR_OUT] = 1;
+    CHECK_EQ(port_->Init(arg).error().code(), 0);
+
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", kSocketPath);
+    addr.sun_path[0] = '\0';
+
+    client_fd_ = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    CHECK_GE(client_fd_, 0);
+    CHECK_EQ(connect(client_fd_, reinterpret_cast<struct sockaddr *>(&addr),
+                     sizeof(addr.sun_family) + strlen(kSocketPath)),
+             0);
+
+    // Wait for the accept thread
+    char buf[4];
+    CHECK_EQ(recv(client_fd_, buf, sizeof(buf), 0), 4);
+  }
+
+  void TearDown(benchmark::State &) override {
+    if (client_fd_ >= 0) {
+      close(client_fd_);
+      client_fd_ = -1;
+    }
+
+    if (port_) {
+      port_->DeInit();
+      delete port_;
+      port_ = nullptr;
+    }
+  }
+
+ protected:
+  UnixSocketPort *port_;
+  int client_fd_;
+
+  static bool dpdk_inited_;
+};
+
+bool UnixSocketLoopback::dpdk_inited_ = false;
+
+}  // namespace
+
+// Client -> port RX -> port TX -> client, batch_size packets at a time.
+BENCHMARK_DEFINE_F(UnixSocketLoopback, RoundTrip)(benchmark::State &state) {
+  const int batch_size = state.range(0);
+
+  if (!port_) {
+    while (state.KeepRunning()) {
+    }
+    return;
+  }
+
+  char tx_data[kPacketSize] = {};
+  char rx_data[bess::PacketBatch::kMaxBurst][kPacketSize];
+
+  struct iovec tx_iov = {tx_data, kPacketSize};
+  struct iovec rx_iovs[bess::PacketBatch::kMaxBurst];
+  struct mmsghdr tx_msgs[bess::PacketBatch::kMaxBurst];
+  struct mmsghdr rx_msgs[bess::PacketBatch::kMaxBurst];
+
+  for (int i = 0; i < batch_size; i++) {
+    tx_msgs[i].msg_hdr = msghdr();
+    tx_msgs[i].msg_hdr.msg_iov = &tx_iov;
+    tx_msgs[i].msg_hdr.msg_iovlen = 1;
+
+    rx_iovs[i] = {rx_data[i], kPacketSize};
+    rx_msgs[i].msg_hdr = msghdr();
+    rx_msgs[i].msg_hdr.msg_iov = &rx_iovs[i];
+    rx_msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  bess::Packet *pkts[bess::PacketBatch::kMaxBurst];
+  uint64_t packets = 0;
+
+  while (state.KeepRunning()) {
+    sendmmsg(client_fd_, tx_msgs, batch_size, 0);
+
+    int cnt = port_->RecvPackets(0, pkts, batch_size);
+    int sent = port_->SendPackets(0, pkts, cnt);
+    if (sent < cnt) {
+      bess::Packet::Free(pkts + sent, cnt - sent);
+    }
+
+    recvmmsg(client_fd_, rx_msgs, batch_size, MSG_DONTWAIT, nullptr);
+    packets += sent;
+  }
+
+  state.SetItemsProcessed(packets);
+}
+
+BENCHMARK_REGISTER_F(UnixSocketLoopback, RoundTrip)
+    ->RangeMultiplier(2)
+    ->Range(1, bess::PacketBatch::kMaxBurst);
+
+BENCHMARK_MAIN();
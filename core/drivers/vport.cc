@@ -35,6 +35,8 @@
 #include <sched.h>
 #include <unistd.h>
 
+#include <cinttypes>
+
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
@@ -44,6 +46,7 @@
 
 #include "../message.h"
 #include "../utils/format.h"
+#include "../utils/time.h"
 
 /* TODO: Unify vport and vport_native */
 
@@ -292,6 +295,11 @@ void *VPort::AllocBar(struct tx_queue_opts *txq_opts,
                 SINGLE_P, SINGLE_C);
     out_qs_[i].sn_to_drv = reinterpret_cast<struct llring *>(ptr);
     ptr += ROUND_TO_64(bytes_per_llring);
+
+    out_qs_[i].port = this;
+    out_qs_[i].kick_deferred = false;
+    out_qs_[i].kicks = 0;
+    out_qs_[i].deferred_kicks = 0;
   }
 
   return bar;
@@ -507,6 +515,10 @@ CommandResponse VPort::Init(const bess::pb::VPortArg &arg) {
   txq_opts.tci = arg.tx_tci();
   txq_opts.outer_tci = arg.tx_outer_tci();
   rxq_opts.loopback = arg.loopback();
+  rxq_opts.busy_poll_budget = arg.busy_poll_budget();
+  rxq_opts.irq_moderation_us = arg.irq_moderation_us();
+
+  kick_threshold_ = arg.kick_threshold() ?: kDefaultKickThreshold;
 
   bar_ = AllocBar(&txq_opts, &rxq_opts);
   phy_addr = rte_malloc_virt2phy(bar_);
@@ -659,15 +671,89 @@ int VPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
   if (ret == -LLRING_ERR_NOBUF)
     return 0;
 
+  /* Enough packets have piled up that the kernel should start draining them
+   * right away, even if a kick is already deferred. KickRx() does nothing if
+   * the kernel is polling. */
+  if (llring_count(rx_queue->sn_to_drv) >= kick_threshold_) {
+    KickRx(rx_queue);
+    return cnt;
+  }
+
+  /* The kernel is already polling this queue (or will do so soon, if
+   * interrupt moderation is on). No need to kick. */
+  if (rx_queue->rx_regs->irq_disabled || rx_queue->kick_deferred)
+    return cnt;
+
+  /* Coalesce kicks within a scheduling round */
+  if (ctx.DeferCall(&VPort::DeferredKickRx, rx_queue)) {
+    rx_queue->kick_deferred = true;
+    rx_queue->deferred_kicks++;
+    return cnt;
+  }
+
+  KickRx(rx_queue);
+
+  return cnt;
+}
+
+void VPort::KickRx(struct queue *rx_queue) {
+  queue_t qid = rx_queue - out_qs_;
+  int ret;
+
+  rx_queue->kick_deferred = false;
+
   /* TODO: generic notification architecture */
   if (__sync_bool_compare_and_swap(&rx_queue->rx_regs->irq_disabled, 0, 1)) {
+    rx_queue->kicks++;
     ret = ioctl(fd_, SN_IOC_KICK_RX, 1 << map_.rxq_to_cpu[qid]);
     if (ret) {
       PLOG(ERROR) << "ioctl(KICK_RX)";
     }
   }
+}
 
-  return cnt;
+void VPort::DeferredKickRx(void *arg) {
+  struct queue *rx_queue = static_cast<struct queue *>(arg);
+  rx_queue->port->KickRx(rx_queue);
+}
+
+void VPort::CollectStats(bool reset) {
+  uint64_t now = rdtsc();
+  uint64_t kicks = 0;
+  uint64_t pkts = 0;
+
+  for (queue_t qid = 0; qid < num_queues[PACKET_DIR_OUT]; qid++) {
+    kicks += out_qs_[qid].kicks;
+    pkts += queue_stats[PACKET_DIR_OUT][qid].packets;
+  }
+
+  if (!reset && last_stats_tsc_ && now > last_stats_tsc_) {
+    double secs = static_cast<double>(now - last_stats_tsc_) / tsc_hz;
+    uint64_t kicks_diff = kicks - last_kicks_;
+    uint64_t pkts_diff = pkts - last_kicked_pkts_;
+
+    VLOG(1) << bess::utils::Format(
+        "VPort %s: kicks %" PRIu64 " (%.0f kicks/s), %.1f packets/kick",
+        name().c_str(), kicks, kicks_diff / secs,
+        kicks_diff ? static_cast<double>(pkts_diff) / kicks_diff : 0.0);
+  }
+
+  last_kicks_ = kicks;
+  last_kicked_pkts_ = pkts;
+  last_stats_tsc_ = now;
+}
+
+void VPort::GetDriverStats(std::map<std::string, uint64_t> *stats) {
+  uint64_t kicks = 0;
+  uint64_t deferred_kicks = 0;
+
+  for (queue_t qid = 0; qid < num_queues[PACKET_DIR_OUT]; qid++) {
+    kicks += out_qs_[qid].kicks;
+    deferred_kicks += out_qs_[qid].deferred_kicks;
+  }
+
+  (*stats)["kicks"] = kicks;
+  (*stats)["deferred_kicks"] = deferred_kicks;
 }
 
 ADD_DRIVER(VPort, "vport", "Virtual port for Linux host")
@@ -36,12 +36,24 @@
 
 class VPort final : public Port {
  public:
-  VPort() : fd_(), bar_(), map_(), netns_fd_(), container_pid_() {}
+  VPort()
+      : fd_(),
+        bar_(),
+        map_(),
+        netns_fd_(),
+        container_pid_(),
+        kick_threshold_(),
+        last_kicks_(),
+        last_kicked_pkts_(),
+        last_stats_tsc_() {}
   void InitDriver() override;
 
   CommandResponse Init(const bess::pb::VPortArg &arg);
   void DeInit() override;
 
+  void CollectStats(bool reset) override;
+  void GetDriverStats(std::map<std::string, uint64_t> *stats) override;
+
   int RecvPackets(queue_t qid, bess::Packet **pkts, int max_cnt) override;
   int SendPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
 
@@ -53,8 +65,19 @@ class VPort final : public Port {
 
     struct llring *drv_to_sn;
     struct llring *sn_to_drv;
+
+    VPort *port;              // back pointer, for deferred kicks
+    bool kick_deferred;       // a kick is scheduled at the end of the task
+    uint64_t kicks;           // # of SN_IOC_KICK_RX ioctls issued
+    uint64_t deferred_kicks;  // # of kicks deferred to the end of the task
   };
 
+  // Default RX queue occupancy above which kicks are not deferred
+  static const size_t kDefaultKickThreshold = 32;
+
+  void KickRx(struct queue *rx_queue);
+  static void DeferredKickRx(void *arg);
+
   void FreeBar();
   void *AllocBar(struct tx_queue_opts *txq_opts,
                  struct rx_queue_opts *rxq_opts);
@@ -73,6 +96,13 @@ class VPort final : public Port {
 
   int netns_fd_;
   int container_pid_;
+
+  size_t kick_threshold_;
+
+  // Snapshot at the last CollectStats(), for rate calculation
+  uint64_t last_kicks_;
+  uint64_t last_kicked_pkts_;
+  uint64_t last_stats_tsc_;
 };
 
 #endif  // BESS_DRIVERS_VPORT_H_
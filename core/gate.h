@@ -85,6 +85,14 @@ class GateHook {
 
   virtual void ProcessBatch(const bess::PacketBatch *) {}
 
+  // Runs a hook-specific command on an installed hook (e.g., to read out
+  // collected data). Called only while workers are paused.
+  virtual CommandResponse RunCommand(const std::string &cmd,
+                                     const google::protobuf::Any &) {
+    return CommandFailure(ENOTSUP, "Gate hook '%s' has no command '%s'",
+                          name_.c_str(), cmd.c_str());
+  }
+
   bool operator<(const GateHook &rhs) const {
     return std::tie(priority_, name_) < std::tie(rhs.priority_, rhs.name_);
   }
@@ -0,0 +1,325 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "capture.h"
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#include <glog/logging.h>
+
+#include "../utils/common.h"
+#include "../utils/pcap.h"
+#include "../utils/time.h"
+
+// pcap variant with nanosecond timestamps
+#define PCAP_MAGIC_NUMBER_NSEC 0xa1b23c4d
+
+const std::string Capture::kName = "capture";
+
+Capture::Capture()
+    : bess::GateHook(Capture::kName, Capture::kPriority),
+      fd_(-1),
+      snaplen_(kDefaultSnaplen),
+      sample_rate_(1),
+      has_filter_(false),
+      filter_(),
+      ring_size_(kDefaultRingSize),
+      base_ns_(),
+      base_tsc_(),
+      rings_(),
+      missed_(0),
+      stop_(false) {}
+
+Capture::~Capture() {
+  if (writer_.joinable()) {
+    stop_ = true;
+    writer_.join();
+  }
+
+  uint64_t captured = 0;
+  uint64_t dropped = 0;
+
+  for (auto &slot : rings_) {
+    Ring *ring = slot.load();
+    if (ring) {
+      captured += ring->captured;
+      dropped += ring->dropped;
+      free(ring->buf);
+      ring->~Ring();
+      free(ring);
+    }
+  }
+
+  if (fd_ >= 0) {
+    LOG(INFO) << "capture: " << captured << " packets captured, " << dropped
+              << " dropped, " << missed_ << " seen by workers without a ring";
+    close(fd_);
+  }
+
+  if (has_filter_) {
+    pcap_freecode(&filter_);
+  }
+}
+
+CommandResponse Capture::Init(const bess::Gate *,
+                              const bess::pb::CaptureArg &arg) {
+  static const struct pcap_hdr PCAP_FILE_HDR = {
+      .magic_number = PCAP_MAGIC_NUMBER_NSEC,
+      .version_major = PCAP_VERSION_MAJOR,
+      .version_minor = PCAP_VERSION_MINOR,
+      .thiszone = PCAP_THISZONE,
+      .sigfigs = PCAP_SIGFIGS,
+      .snaplen = PCAP_SNAPLEN,
+      .network = PCAP_NETWORK,
+  };
+  int ret;
+
+  if (arg.snaplen()) {
+    snaplen_ = std::min<uint32_t>(arg.snaplen(), PCAP_SNAPLEN);
+  }
+
+  sample_rate_ = std::max<uint32_t>(arg.sample_rate(), 1);
+
+  if (arg.ring_size()) {
+    if (arg.ring_size() < 2 * (sizeof(struct pcap_rec_hdr) + snaplen_) ||
+        (arg.ring_size() & (arg.ring_size() - 1))) {
+      return CommandFailure(EINVAL,
+                            "'ring_size' must be a power of two, large enough "
+                            "for two packets");
+    }
+    ring_size_ = arg.ring_size();
+  }
+
+  if (!arg.filter().empty()) {
+    if (pcap_compile_nopcap(PCAP_SNAPLEN, DLT_EN10MB, &filter_,
+                            arg.filter().c_str(), 1,
+                            PCAP_NETMASK_UNKNOWN) == -1) {
+      return CommandFailure(EINVAL, "BPF compilation error");
+    }
+    has_filter_ = true;
+  }
+
+  // Hooks are attached with workers paused, so this is the time to allocate
+  // rings, for the workers that exist, or for the one that will be launched
+  // by default if there is none yet.
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (is_worker_active(wid) || (num_workers == 0 && wid == 0)) {
+      Ring *ring = NewRing();
+      if (!ring) {
+        return CommandFailure(ENOMEM, "Failed to allocate a ring");
+      }
+      rings_[wid].store(ring, std::memory_order_release);
+    }
+  }
+
+  // Opening a FIFO with O_NONBLOCK fails right away if there is no reader.
+  fd_ = open(arg.path().c_str(),
+             O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    return CommandFailure(errno, "Failed to open '%s'", arg.path().c_str());
+  }
+
+  // Only the writer thread writes from now on, and it may block.
+  ret = fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_NONBLOCK);
+  if (ret < 0) {
+    return CommandFailure(errno, "fcntl() failed");
+  }
+
+  ret = write(fd_, &PCAP_FILE_HDR, sizeof(PCAP_FILE_HDR));
+  if (ret < 0) {
+    return CommandFailure(errno, "Failed to write PCAP header");
+  }
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  base_tsc_ = rdtsc();
+  base_ns_ = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+  writer_ = std::thread([this]() { this->WriterThread(); });
+
+  return CommandSuccess();
+}
+
+Capture::Ring *Capture::NewRing() {
+  void *mem;
+  if (posix_memalign(&mem, alignof(Ring), sizeof(Ring))) {
+    return nullptr;
+  }
+
+  Ring *ring = new (mem) Ring();
+  ring->head = 0;
+  ring->cached_tail = 0;
+  ring->captured = 0;
+  ring->dropped = 0;
+  ring->sample_count = 0;
+  ring->tail = 0;
+  ring->mask = ring_size_ - 1;
+  ring->buf = static_cast<char *>(malloc(ring_size_));
+  if (!ring->buf) {
+    ring->~Ring();
+    free(ring);
+    return nullptr;
+  }
+
+  return ring;
+}
+
+// Copies len bytes at the ring position pos, wrapping around if needed.
+static inline void RingWrite(char *buf, size_t mask, uint64_t pos,
+                             const void *src, size_t len) {
+  size_t off = pos & mask;
+  size_t first = std::min(len, mask + 1 - off);
+
+  memcpy(buf + off, src, first);
+  if (unlikely(first < len)) {
+    memcpy(buf, static_cast<const char *>(src) + first, len - first);
+  }
+}
+
+void Capture::ProcessBatch(const bess::PacketBatch *batch) {
+  Ring *ring = rings_[ctx.wid()].load(std::memory_order_relaxed);
+  if (unlikely(!ring)) {
+    missed_.fetch_add(batch->cnt(), std::memory_order_relaxed);
+    return;
+  }
+
+  // One timestamp for the whole batch
+  uint64_t now_ns = base_ns_ + tsc_to_ns(rdtsc() - base_tsc_);
+  uint32_t ts_sec = now_ns / 1000000000ull;
+  uint32_t ts_nsec = now_ns % 1000000000ull;
+
+  const size_t size = ring_size_;
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+
+  for (int i = 0; i < batch->cnt(); i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+
+    if (sample_rate_ > 1 && ++ring->sample_count < sample_rate_) {
+      continue;
+    }
+    ring->sample_count = 0;
+
+    if (has_filter_ &&
+        !bpf_filter(filter_.bf_insns, pkt->head_data<const u_char *>(),
+                    pkt->total_len(), pkt->head_len())) {
+      continue;
+    }
+
+    uint32_t caplen = std::min<uint32_t>(pkt->head_len(), snaplen_);
+    size_t need = sizeof(struct pcap_rec_hdr) + caplen;
+
+    if (size - (head - ring->cached_tail) < need) {
+      ring->cached_tail = ring->tail.load(std::memory_order_acquire);
+      if (size - (head - ring->cached_tail) < need) {
+        ring->dropped++;
+        continue;
+      }
+    }
+
+    struct pcap_rec_hdr rec = {
+        .ts_sec = ts_sec,
+        .ts_usec = ts_nsec,
+        .incl_len = caplen,
+        .orig_len = static_cast<uint32_t>(pkt->total_len()),
+    };
+
+    RingWrite(ring->buf, ring->mask, head, &rec, sizeof(rec));
+    RingWrite(ring->buf, ring->mask, head + sizeof(rec), pkt->head_data(),
+              caplen);
+    head += need;
+    ring->captured++;
+  }
+
+  ring->head.store(head, std::memory_order_release);
+}
+
+size_t Capture::Drain(Ring *ring) {
+  uint64_t head = ring->head.load(std::memory_order_acquire);
+  uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+  size_t len = head - tail;
+
+  if (len == 0) {
+    return 0;
+  }
+
+  size_t off = tail & ring->mask;
+  size_t first = std::min(len, ring->mask + 1 - off);
+
+  struct iovec iov[2] = {{ring->buf + off, first},
+                         {ring->buf, len - first}};
+
+  ssize_t ret = writev(fd_, iov, (first < len) ? 2 : 1);
+  if (ret < 0) {
+    if (errno == EINTR || errno == EAGAIN) {
+      return 0;
+    }
+    // The reader went away (EPIPE) or the disk is full: discard the data,
+    // so that the worker keeps going.
+    LOG_FIRST_N(WARNING, 1) << "capture: write() failed: " << strerror(errno);
+    ret = len;
+  }
+
+  // A partial write may split a record; the rest goes out next time.
+  ring->tail.store(tail + ret, std::memory_order_release);
+  return ret;
+}
+
+void Capture::WriterThread() {
+  while (true) {
+    bool stopping = stop_.load();
+    size_t bytes = 0;
+
+    for (auto &slot : rings_) {
+      Ring *ring = slot.load(std::memory_order_acquire);
+      if (ring) {
+        bytes += Drain(ring);
+      }
+    }
+
+    if (stopping) {
+      // The final drain is done: no worker runs the gate at this point.
+      return;
+    }
+
+    if (bytes == 0) {
+      // Let the rings fill up a bit, for larger writes
+      usleep(1000);
+    }
+  }
+}
+
+ADD_GATE_HOOK(Capture)
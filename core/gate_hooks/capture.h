@@ -0,0 +1,116 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_GATE_HOOKS_CAPTURE_
+#define BESS_GATE_HOOKS_CAPTURE_
+
+#include <pcap.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "../message.h"
+#include "../module.h"
+#include "../worker.h"
+
+// Capture dumps copies of the packets seen by a gate, like Tcpdump, but cheap
+// enough to leave on for a busy gate. The worker only copies the first
+// `snaplen` bytes of each packet into its own lock-free ring buffer. A
+// background thread drains the rings into a file or FIFO with large writes.
+// If the writer cannot keep up, packets are dropped from the capture (and
+// counted), never delayed.
+class Capture final : public bess::GateHook {
+ public:
+  Capture();
+
+  virtual ~Capture();
+
+  CommandResponse Init(const bess::Gate *, const bess::pb::CaptureArg &);
+
+  void ProcessBatch(const bess::PacketBatch *batch);
+
+  static constexpr uint16_t kPriority = 3;
+  static const std::string kName;
+
+ private:
+  static const size_t kDefaultRingSize = 4 * 1024 * 1024;
+  static const uint32_t kDefaultSnaplen = 128;
+
+  // Byte ring of pcap records, with a single producer (a worker) and a single
+  // consumer (the writer thread). Positions only increase; the offset in buf
+  // is (position & mask).
+  struct Ring {
+    // Producer side
+    alignas(64) std::atomic<uint64_t> head;
+    uint64_t cached_tail;
+    uint64_t captured;
+    uint64_t dropped;
+    uint32_t sample_count;
+
+    // Consumer side
+    alignas(64) std::atomic<uint64_t> tail;
+
+    alignas(64) size_t mask;
+    char *buf;
+  };
+
+  // Returns a new, empty ring, or nullptr if out of memory.
+  Ring *NewRing();
+
+  void WriterThread();
+
+  // Writes out everything in the ring. Returns the number of bytes drained.
+  size_t Drain(Ring *ring);
+
+  int fd_;
+
+  uint32_t snaplen_;
+  uint32_t sample_rate_;
+
+  bool has_filter_;
+  struct bpf_program filter_;
+
+  size_t ring_size_;
+
+  // Timestamps are derived from the TSC: base_ns_ + (tsc - base_tsc_)
+  uint64_t base_ns_;
+  uint64_t base_tsc_;
+
+  // Indexed by worker ID. Set up by Init(), for the workers that exist then.
+  std::atomic<Ring *> rings_[Worker::kMaxWorkers];
+
+  // Packets seen by workers launched after Init(), which have no ring
+  std::atomic<uint64_t> missed_;
+
+  std::thread writer_;
+  std::atomic<bool> stop_;
+};
+
+#endif  // BESS_GATE_HOOKS_CAPTURE_
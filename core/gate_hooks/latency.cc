@@ -0,0 +1,240 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "latency.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include "../utils/time.h"
+
+using bess::metadata::Attribute;
+
+const std::string LatencyTrace::kName = "latency";
+
+LatencyTrace::LatencyTrace()
+    : bess::GateHook(LatencyTrace::kName, LatencyTrace::kPriority),
+      mode_(kStamp),
+      sample_rate_(1),
+      bucket_cycles_(),
+      num_buckets_(kDefaultNumBuckets),
+      module_(),
+      attr_id_(-1),
+      workers_() {
+  void *p;
+  size_t size = sizeof(WorkerState) * Worker::kMaxWorkers;
+  CHECK_EQ(0, posix_memalign(&p, alignof(WorkerState), size));
+  memset(p, 0, size);
+  workers_ = static_cast<WorkerState *>(p);
+}
+
+LatencyTrace::~LatencyTrace() {
+  for (int i = 0; i < Worker::kMaxWorkers; i++) {
+    delete workers_[i].hist;
+  }
+  free(workers_);
+}
+
+CommandResponse LatencyTrace::Init(const bess::Gate *gate,
+                                   const bess::pb::LatencyTraceArg &arg) {
+  if (arg.mode().empty() || arg.mode() == "stamp") {
+    mode_ = kStamp;
+  } else if (arg.mode() == "record") {
+    mode_ = kRecord;
+  } else if (arg.mode() == "hop") {
+    mode_ = kHop;
+  } else {
+    return CommandFailure(EINVAL, "'mode' must be 'stamp', 'record' or 'hop'");
+  }
+
+  sample_rate_ = std::max<uint32_t>(arg.sample_rate(), 1);
+
+  uint64_t bucket_ns = arg.bucket_ns() ?: kDefaultBucketNs;
+  bucket_cycles_ = std::max<uint64_t>(bucket_ns * tsc_hz / 1000000000ull, 1);
+
+  if (arg.num_buckets()) {
+    num_buckets_ = arg.num_buckets();
+  }
+
+  const std::string attr_name =
+      arg.attr_name().empty() ? "latency_tsc" : arg.attr_name();
+
+  Attribute::AccessMode attr_mode;
+  switch (mode_) {
+    case kStamp:
+      attr_mode = Attribute::AccessMode::kWrite;
+      break;
+    case kRecord:
+      attr_mode = Attribute::AccessMode::kRead;
+      break;
+    default:
+      attr_mode = Attribute::AccessMode::kUpdate;
+  }
+
+  // The attribute belongs to the module that owns the gate, so that the
+  // metadata offsets are computed for it on resume. Hooks on other gates of
+  // the same module share it, which also means it stays registered after the
+  // hook is removed.
+  module_ = gate->module();
+
+  int i = 0;
+  for (const auto &attr : module_->all_attrs()) {
+    if (attr.name == attr_name) {
+      if (attr.size != sizeof(uint64_t) || attr.mode != attr_mode) {
+        return CommandFailure(EINVAL,
+                              "Attribute '%s' is already used by module '%s' "
+                              "in another way",
+                              attr_name.c_str(), module_->name().c_str());
+      }
+      attr_id_ = i;
+      break;
+    }
+    i++;
+  }
+
+  if (attr_id_ < 0) {
+    attr_id_ = module_->AddMetadataAttr(attr_name, sizeof(uint64_t),
+                                        attr_mode);
+    if (attr_id_ < 0) {
+      return CommandFailure(-attr_id_, "Failed to add attribute '%s'",
+                            attr_name.c_str());
+    }
+  }
+
+  return CommandSuccess();
+}
+
+void LatencyTrace::ProcessBatch(const bess::PacketBatch *batch) {
+  bess::metadata::mt_offset_t offset = module_->attr_offset(attr_id_);
+  if (!bess::metadata::IsValidOffset(offset)) {
+    // Nobody downstream reads the stamp, or nobody upstream writes it
+    return;
+  }
+
+  WorkerState &state = workers_[ctx.wid()];
+  const int cnt = batch->cnt();
+  uint64_t now = rdtsc();
+
+  if (mode_ == kStamp) {
+    uint64_t stamp = (state.batches++ % sample_rate_ == 0) ? now : 0;
+    for (int i = 0; i < cnt; i++) {
+      _set_attr_with_offset<uint64_t>(offset, batch->pkts()[i], stamp);
+    }
+    return;
+  }
+
+  if (unlikely(!state.hist)) {
+    state.hist = new Histogram<uint64_t>(num_buckets_, bucket_cycles_);
+  }
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    uint64_t stamp = _get_attr_with_offset<uint64_t>(offset, pkt);
+
+    if (stamp == 0) {
+      continue;
+    }
+
+    // TSCs may be slightly off across cores
+    state.hist->Insert(now > stamp ? now - stamp : 0);
+
+    if (mode_ == kHop) {
+      _set_attr_with_offset<uint64_t>(offset, pkt, now);
+    }
+  }
+}
+
+Histogram<uint64_t> LatencyTrace::Merged() const {
+  Histogram<uint64_t> ret(num_buckets_, bucket_cycles_);
+
+  for (int i = 0; i < Worker::kMaxWorkers; i++) {
+    if (workers_[i].hist) {
+      ret.Combine(*workers_[i].hist);
+    }
+  }
+
+  return ret;
+}
+
+CommandResponse LatencyTrace::RunCommand(const std::string &cmd,
+                                         const google::protobuf::Any &arg) {
+  if (cmd == "get_summary") {
+    bess::pb::LatencyTraceCommandGetSummaryArg summary_arg;
+    if (!arg.UnpackTo(&summary_arg)) {
+      return CommandFailure(EINVAL,
+                            "Expected LatencyTraceCommandGetSummaryArg");
+    }
+    return CommandGetSummary(summary_arg);
+  } else if (cmd == "clear") {
+    return CommandClear();
+  }
+
+  return bess::GateHook::RunCommand(cmd, arg);
+}
+
+CommandResponse LatencyTrace::CommandGetSummary(
+    const bess::pb::LatencyTraceCommandGetSummaryArg &arg) {
+  if (mode_ == kStamp) {
+    return CommandFailure(EINVAL, "A 'stamp' hook does not record latency");
+  }
+
+  std::vector<double> percentiles(arg.percentiles().begin(),
+                                  arg.percentiles().end());
+  const auto summary = Merged().Summarize(percentiles);
+
+  bess::pb::LatencyTraceCommandGetSummaryResponse r;
+  r.set_count(summary.count);
+  r.set_above_range(summary.above_range);
+  r.set_min_ns(tsc_to_ns(summary.min));
+  r.set_avg_ns(tsc_to_ns(summary.avg));
+  r.set_max_ns(tsc_to_ns(summary.max));
+  r.set_total_ns(tsc_to_ns(summary.total));
+  for (uint64_t val : summary.percentile_values) {
+    r.add_percentile_values_ns(tsc_to_ns(val));
+  }
+
+  if (arg.clear()) {
+    CommandClear();
+  }
+
+  return CommandSuccess(r);
+}
+
+CommandResponse LatencyTrace::CommandClear() {
+  for (int i = 0; i < Worker::kMaxWorkers; i++) {
+    if (workers_[i].hist) {
+      workers_[i].hist->Reset();
+    }
+  }
+  return CommandSuccess();
+}
+
+ADD_GATE_HOOK(LatencyTrace)
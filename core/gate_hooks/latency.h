@@ -0,0 +1,94 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_GATE_HOOKS_LATENCY_
+#define BESS_GATE_HOOKS_LATENCY_
+
+#include <string>
+
+#include "../message.h"
+#include "../module.h"
+#include "../utils/histogram.h"
+#include "../worker.h"
+
+// LatencyTrace measures how long packets take between gates. A hook in
+// "stamp" mode stores the TSC in a metadata attribute; hooks downstream in
+// "record" mode add the elapsed cycles to a histogram, and those in "hop"
+// mode also restamp the packets. A zero stamp means "not sampled".
+class LatencyTrace final : public bess::GateHook {
+ public:
+  LatencyTrace();
+
+  virtual ~LatencyTrace();
+
+  CommandResponse Init(const bess::Gate *, const bess::pb::LatencyTraceArg &);
+
+  void ProcessBatch(const bess::PacketBatch *batch);
+
+  CommandResponse RunCommand(const std::string &cmd,
+                             const google::protobuf::Any &arg);
+
+  static constexpr uint16_t kPriority = 4;
+  static const std::string kName;
+
+  static const uint64_t kDefaultBucketNs = 100;
+  static const uint64_t kDefaultNumBuckets = 10000;
+
+ private:
+  enum Mode {
+    kStamp = 0,
+    kRecord,
+    kHop,
+  };
+
+  // Each worker samples and records on its own
+  struct alignas(64) WorkerState {
+    uint64_t batches;
+    Histogram<uint64_t> *hist;  // Allocated on first use
+  };
+
+  // Returns all histograms merged, in cycles
+  Histogram<uint64_t> Merged() const;
+
+  CommandResponse CommandGetSummary(
+      const bess::pb::LatencyTraceCommandGetSummaryArg &arg);
+  CommandResponse CommandClear();
+
+  Mode mode_;
+  uint32_t sample_rate_;
+  uint64_t bucket_cycles_;
+  uint64_t num_buckets_;
+
+  Module *module_;  // Module that owns the gate (and the attribute)
+  int attr_id_;
+
+  WorkerState *workers_;  // [Worker::kMaxWorkers], cache-aligned
+};
+
+#endif  // BESS_GATE_HOOKS_LATENCY_
@@ -35,18 +35,67 @@
 #include <unistd.h>
 
 #include <limits>
+#include <map>
+#include <mutex>
 
 #include <glog/logging.h>
 
 #include "../message.h"
 #include "../utils/common.h"
+#include "../utils/format.h"
 #include "../utils/pcapng.h"
 #include "../utils/time.h"
 
 using namespace bess::utils::pcapng;
+using bess::utils::PcapngWriter;
 
 namespace {
 
+const uint64_t kDefaultFileSize = 1ull << 30;
+
+// Returns the writer for `config.prefix`, opening it if nobody uses it yet.
+// Hooks that share a writer must agree on how it writes the files, and on the
+// snapshot length. Returns nullptr (and sets `err`) on error: -EEXIST if the
+// writer is in use with different settings.
+std::shared_ptr<PcapngWriter> GetWriter(const PcapngWriter::Config &config,
+                                        uint32_t snaplen, int *err) {
+  struct Shared {
+    std::weak_ptr<PcapngWriter> writer;
+    uint32_t snaplen;
+  };
+
+  static std::mutex mtx;
+  static std::map<std::string, Shared> writers;
+
+  std::lock_guard<std::mutex> guard(mtx);
+
+  Shared &shared = writers[config.prefix];
+  std::shared_ptr<PcapngWriter> writer = shared.writer.lock();
+  if (writer) {
+    const PcapngWriter::Config &cur = writer->config();
+    if (cur.file_size != config.file_size ||
+        cur.file_count != config.file_count ||
+        cur.rotate_ns != config.rotate_ns ||
+        cur.segment_size != config.segment_size ||
+        cur.num_segments != config.num_segments ||
+        shared.snaplen != snaplen) {
+      *err = -EEXIST;
+      return nullptr;
+    }
+    return writer;
+  }
+
+  writer = std::make_shared<PcapngWriter>();
+  *err = writer->Open(config);
+  if (*err < 0) {
+    return nullptr;
+  }
+
+  shared.writer = writer;
+  shared.snaplen = snaplen;
+  return writer;
+}
+
 // Return `a` rounded up to the nearest multiple of `b`
 template <typename T>
 T RoundUp(T a, T b) {
@@ -90,7 +139,12 @@ Pcapng::Pcapng()
     : bess::GateHook(Pcapng::kName, Pcapng::kPriority),
       fifo_fd_(-1),
       attrs_(),
-      attr_template_() {}
+      attr_template_(),
+      writer_(),
+      if_id_(),
+      snaplen_(),
+      base_ns_(),
+      base_tsc_() {}
 
 Pcapng::~Pcapng() {
   if (fifo_fd_ >= 0) {
@@ -98,8 +152,66 @@ Pcapng::~Pcapng() {
   }
 }
 
+CommandResponse Pcapng::InitFile(const bess::Gate *gate,
+                                 const bess::pb::PcapngArg &arg) {
+  if (!arg.fifo().empty()) {
+    return CommandFailure(EINVAL,
+                          "'fifo' and 'file_prefix' cannot be used together");
+  }
+
+  if (arg.file_count() == 1) {
+    return CommandFailure(EINVAL, "'file_count' must be 0 or at least 2");
+  }
+
+  snaplen_ = std::numeric_limits<uint16_t>::max();
+  if (arg.snaplen()) {
+    snaplen_ = std::min(arg.snaplen(), snaplen_);
+  }
+
+  PcapngWriter::Config config;
+  config.prefix = arg.file_prefix();
+  config.file_size = arg.file_size() ?: kDefaultFileSize;
+  config.file_count = arg.file_count();
+  config.rotate_ns = arg.rotate_secs() * 1000000000ull;
+  config.segment_size = PcapngWriter::kDefaultSegmentSize;
+  config.num_segments = PcapngWriter::kDefaultNumSegments;
+
+  int ret = 0;
+  writer_ = GetWriter(config, snaplen_, &ret);
+  if (ret == -EEXIST) {
+    return CommandFailure(EEXIST,
+                          "'%s' is in use by a hook with different settings",
+                          config.prefix.c_str());
+  }
+  if (!writer_) {
+    return CommandFailure(-ret, "Failed to open '%s'", config.prefix.c_str());
+  }
+
+  const char *dir = dynamic_cast<const bess::IGate *>(gate) ? "in" : "out";
+  ret = writer_->AddInterface(
+      bess::utils::Format("%s:%s%hu", gate->module()->name().c_str(), dir,
+                          gate->gate_idx()),
+      snaplen_);
+  if (ret < 0) {
+    writer_.reset();
+    return CommandFailure(-ret, "Failed to add interface");
+  }
+  if_id_ = ret;
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  base_tsc_ = rdtsc();
+  base_ns_ = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+  return CommandSuccess();
+}
+
 CommandResponse Pcapng::Init(const bess::Gate *gate,
                              const bess::pb::PcapngArg &arg) {
+  if (!arg.file_prefix().empty()) {
+    return InitFile(gate, arg);
+  }
+
   Module *m = gate->module();
   std::string tmpl;
   int ret;
@@ -179,7 +291,29 @@ CommandResponse Pcapng::Init(const bess::Gate *gate,
   return CommandSuccess();
 }
 
+void Pcapng::ProcessBatchFile(const bess::PacketBatch *batch) {
+  uint64_t ts = base_ns_ + tsc_to_ns(rdtsc() - base_tsc_);
+  mcslock_node_t node;
+
+  writer_->Lock(&node);
+  for (int i = 0; i < batch->cnt(); i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    uint32_t caplen = std::min<uint32_t>(pkt->head_len(), snaplen_);
+
+    if (!writer_->Append(if_id_, ts, pkt->head_data(), caplen,
+                         pkt->total_len())) {
+      break;  // The writer is lagging behind. Don't bother with the rest.
+    }
+  }
+  writer_->Unlock(&node);
+}
+
 void Pcapng::ProcessBatch(const bess::PacketBatch *batch) {
+  if (writer_) {
+    ProcessBatchFile(batch);
+    return;
+  }
+
   struct timeval tv;
 
   int ret = 0;
@@ -31,11 +31,18 @@
 #ifndef BESS_GATE_HOOKS_PCAPNG_
 #define BESS_GATE_HOOKS_PCAPNG_
 
+#include <memory>
+
 #include "../message.h"
 #include "../module.h"
+#include "../utils/pcapng_writer.h"
 
 // Pcapng dumps copies of the packets seen by a gate (data + metadata) in
 // pcapng format.  Useful for debugging.
+//
+// Alternatively, packets (without metadata) can be written to a rotating set
+// of files, for long-running captures.  Hooks with the same file prefix share
+// the files, each gate being a separate interface.
 class Pcapng final : public bess::GateHook {
  public:
   Pcapng();
@@ -50,6 +57,10 @@ class Pcapng final : public bess::GateHook {
   static const std::string kName;
 
  private:
+  CommandResponse InitFile(const bess::Gate *, const bess::pb::PcapngArg &);
+
+  void ProcessBatchFile(const bess::PacketBatch *batch);
+
   struct Attr {
     // Attribute offset in the packet metadata.
     int md_offset;
@@ -67,6 +78,13 @@ class Pcapng final : public bess::GateHook {
   // we will change in place the values and send the string out, without
   // doing any memory allocation.
   std::vector<char> attr_template_;
+
+  // For the file mode. Shared by all hooks with the same file prefix.
+  std::shared_ptr<bess::utils::PcapngWriter> writer_;
+  uint32_t if_id_;
+  uint32_t snaplen_;
+  uint64_t base_ns_;   // Wall clock time at base_tsc_
+  uint64_t base_tsc_;
 };
 
 #endif  // BESS_GATE_HOOKS_PCAPNG_
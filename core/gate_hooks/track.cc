@@ -30,36 +30,105 @@
 
 #include "track.h"
 
+#include <cstdlib>
+#include <cstring>
+
+#include <glog/logging.h>
+
 #include "../message.h"
 
 // Ethernet overhead in bytes
 static const size_t kEthernetOverhead = 24;
 
+// Returns zeroed, cache-aligned storage for one T per worker
+template <typename T>
+static T *AllocPerWorker() {
+  void *p;
+  CHECK_EQ(0, posix_memalign(&p, alignof(T), sizeof(T) * Worker::kMaxWorkers));
+  memset(p, 0, sizeof(T) * Worker::kMaxWorkers);
+  return static_cast<T *>(p);
+}
+
 const std::string Track::kName = "track";
 
 Track::Track()
     : bess::GateHook(Track::kName, Track::kPriority),
       track_bytes_(),
-      cnt_(),
-      pkts_() {}
+      counters_(AllocPerWorker<Counters>()),
+      batch_hist_() {}
+
+Track::~Track() {
+  free(counters_);
+  free(batch_hist_);
+}
 
 CommandResponse Track::Init(const bess::Gate *, const bess::pb::TrackArg &arg) {
   track_bytes_ = arg.bits();
+  if (arg.batch_hist() && !batch_hist_) {
+    batch_hist_ = AllocPerWorker<BatchHist>();
+  }
   return CommandSuccess();
 }
 
+uint64_t Track::cnt() const {
+  uint64_t ret = 0;
+  for (int i = 0; i < Worker::kMaxWorkers; i++) {
+    ret += counters_[i].cnt;
+  }
+  return ret;
+}
+
+uint64_t Track::pkts() const {
+  uint64_t ret = 0;
+  for (int i = 0; i < Worker::kMaxWorkers; i++) {
+    ret += counters_[i].pkts;
+  }
+  return ret;
+}
+
+uint64_t Track::bytes() const {
+  uint64_t ret = 0;
+  for (int i = 0; i < Worker::kMaxWorkers; i++) {
+    ret += counters_[i].bytes;
+  }
+  return ret;
+}
+
+std::vector<uint64_t> Track::batch_hist() const {
+  std::vector<uint64_t> ret;
+
+  if (batch_hist_) {
+    ret.resize(bess::PacketBatch::kMaxBurst + 1);
+    for (int i = 0; i < Worker::kMaxWorkers; i++) {
+      for (size_t j = 0; j < ret.size(); j++) {
+        ret[j] += batch_hist_[i].cnt[j];
+      }
+    }
+  }
+
+  return ret;
+}
+
 void Track::ProcessBatch(const bess::PacketBatch *batch) {
+  Counters &counters = counters_[ctx.wid()];
   size_t cnt = batch->cnt();
-  cnt_ += 1;
-  pkts_ += cnt;
+
+  counters.cnt += 1;
+  counters.pkts += cnt;
+
+  if (batch_hist_) {
+    batch_hist_[ctx.wid()].cnt[cnt]++;
+  }
 
   if (!track_bytes_) {
     return;
   }
 
+  uint64_t bytes = 0;
   for (size_t i = 0; i < cnt; i++) {
-    bytes_ += batch->pkts()[i]->data_len() + kEthernetOverhead;
+    bytes += batch->pkts()[i]->data_len() + kEthernetOverhead;
   }
+  counters.bytes += bytes;
 }
 
 ADD_GATE_HOOK(Track)
@@ -31,21 +31,32 @@
 #ifndef BESS_GATE_HOOKS_TRACK_
 #define BESS_GATE_HOOKS_TRACK_
 
+#include <vector>
+
 #include "../message.h"
 #include "../module.h"
+#include "../worker.h"
 
 // TrackGate counts the number of packets, batches and bytes seen by a gate.
+// Counters are kept per worker, each in its own cache line, so that workers
+// sharing a gate do not contend. They are summed up when read.
 class Track final : public bess::GateHook {
  public:
   Track();
 
+  virtual ~Track();
+
   CommandResponse Init(const bess::Gate *, const bess::pb::TrackArg &);
 
-  uint64_t cnt() const { return cnt_; }
+  uint64_t cnt() const;
 
-  uint64_t pkts() const { return pkts_; }
+  uint64_t pkts() const;
 
-  uint64_t bytes() const { return bytes_; }
+  uint64_t bytes() const;
+
+  // Number of batches seen for each batch size (0..kMaxBurst), or empty if
+  // not enabled.
+  std::vector<uint64_t> batch_hist() const;
 
   void set_track_bytes(bool track) { track_bytes_ = track; }
 
@@ -55,10 +66,24 @@ class Track final : public bess::GateHook {
   static const std::string kName;
 
  private:
+  struct alignas(64) Counters {
+    uint64_t cnt;
+    uint64_t pkts;
+    uint64_t bytes;
+  };
+
+  struct alignas(64) BatchHist {
+    uint64_t cnt[bess::PacketBatch::kMaxBurst + 1];
+  };
+
   bool track_bytes_;
-  uint64_t cnt_;
-  uint64_t pkts_;
-  uint64_t bytes_;
+
+  // [Worker::kMaxWorkers]. Allocated with the proper alignment, since
+  // operator new does not honor alignas() in C++11.
+  Counters *counters_;
+
+  // [Worker::kMaxWorkers], or nullptr if batch sizes are not tracked
+  BatchHist *batch_hist_;
 };
 
 #endif  // BESS_GATE_HOOKS_TRACK_
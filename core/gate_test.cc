@@ -101,6 +101,29 @@ TEST(HookTest, Track) {
   t.ProcessBatch(&b);
   ASSERT_EQ(1, t.cnt());
   ASSERT_EQ(b.cnt(), t.pkts());
+  ASSERT_TRUE(t.batch_hist().empty());
+}
+
+TEST(HookTest, TrackBatchHist) {
+  Track t;
+  bess::pb::TrackArg arg;
+  arg.set_batch_hist(true);
+  ASSERT_EQ(0, t.Init(nullptr, arg).error().code());
+
+  bess::PacketBatch b;
+  b.set_cnt(32);
+  t.ProcessBatch(&b);
+  t.ProcessBatch(&b);
+  b.set_cnt(1);
+  t.ProcessBatch(&b);
+
+  std::vector<uint64_t> hist = t.batch_hist();
+  ASSERT_EQ(bess::PacketBatch::kMaxBurst + 1, hist.size());
+  EXPECT_EQ(2, hist[32]);
+  EXPECT_EQ(1, hist[1]);
+  EXPECT_EQ(0, hist[0]);
+  EXPECT_EQ(3, t.cnt());
+  EXPECT_EQ(65, t.pkts());
 }
 
 TEST_F(IOGateTest, OGate) {
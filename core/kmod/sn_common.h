@@ -79,6 +79,15 @@ struct tx_queue_opts {
 
 struct rx_queue_opts {
 	uint8_t loopback;
+
+	/* NAPI budget for busy polling (sn_poll_ll). 0 for the default */
+	uint16_t busy_poll_budget;
+
+	/* If nonzero, after a NAPI poll that received packets the driver
+	 * keeps the interrupt disabled (so BESS does not kick) and polls
+	 * again after this many microseconds. The interrupt is re-enabled
+	 * only once a poll finds the queue empty. */
+	uint32_t irq_moderation_us;
 };
 
 struct sn_conf_space {
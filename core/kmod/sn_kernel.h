@@ -33,6 +33,7 @@
 #ifdef __KERNEL__
 
 #include <linux/netdevice.h>
+#include <linux/hrtimer.h>
 #include <linux/miscdevice.h>
 
 #define MODULE_NAME "bess"
@@ -85,11 +86,18 @@ struct sn_queue {
 				u64 polls;
 				u64 interrupts;
 				u64 ll_polls;
+				u64 deferred_polls;
 			} stats;
 
 			struct sn_rxq_registers *rx_regs;
 			struct napi_struct napi;
 
+			/* for interrupt moderation. see sn_poll() */
+			struct hrtimer moderation_timer;
+
+			/* adaptive busy polling budget. see sn_poll_ll() */
+			int ll_budget;
+
 			spinlock_t lock; /* kernel has its own locks for TX */
 
 			struct rx_queue_opts opts;
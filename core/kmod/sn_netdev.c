@@ -56,6 +56,7 @@
 #include "../snbuf_layout.h"
 
 static int sn_poll(struct napi_struct *napi, int budget);
+static enum hrtimer_restart sn_moderation_timer_fn(struct hrtimer *timer);
 static void sn_enable_interrupt(struct sn_queue *rx_queue);
 
 static void sn_test_cache_alignment(struct sn_device *dev)
@@ -176,6 +177,11 @@ static int sn_alloc_queues(struct sn_device *dev,
 		napi_hash_add(&dev->rx_queues[i]->rx.napi);
 #endif
 		spin_lock_init(&dev->rx_queues[i]->rx.lock);
+
+		hrtimer_init(&dev->rx_queues[i]->rx.moderation_timer,
+				CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		dev->rx_queues[i]->rx.moderation_timer.function =
+				sn_moderation_timer_fn;
 	}
 
 	sn_test_cache_alignment(dev);
@@ -219,8 +225,10 @@ static int sn_close(struct net_device *netdev)
 	struct sn_device *dev = netdev_priv(netdev);
 	int i;
 
-	for (i = 0; i < dev->num_rxq; i++)
+	for (i = 0; i < dev->num_rxq; i++) {
+		hrtimer_cancel(&dev->rx_queues[i]->rx.moderation_timer);
 		napi_disable(&dev->rx_queues[i]->rx.napi);
+	}
 
 	return 0;
 }
@@ -439,28 +447,42 @@ static int sn_poll_ll(struct napi_struct *napi)
 {
 	struct sn_queue *rx_queue;
 
+	int min_budget;
+	int budget;
 	int idle_cnt = 0;
 	int ret;
 
 	rx_queue = container_of(napi, struct sn_queue, rx.napi);
 
-	if (!spin_trylock(&rx_queue->lock))
+	if (!spin_trylock(&rx_queue->rx.lock))
 		return LL_FLUSH_BUSY;
 
 	rx_queue->rx.stats.ll_polls++;
 
 	sn_disable_interrupt(rx_queue);
 
+	/* The budget adapts to the load: it doubles (up to MAX_BATCH)
+	 * whenever a poll consumes all of it, and shrinks back towards the
+	 * configured minimum when polls come back short. */
+	min_budget = rx_queue->rx.opts.busy_poll_budget ? :
+			SN_BUSY_POLL_BUDGET;
+	budget = max(rx_queue->rx.ll_budget, min_budget);
+
 	/* Meh... Since there is no notification for busy loop completion,
 	 * there is no clean way to avoid race condition w.r.t. interrupts.
 	 * Instead, do a roughly 5-us polling in this function. */
 
 	do {
-		ret = sn_poll_action(rx_queue, SN_BUSY_POLL_BUDGET);
+		ret = sn_poll_action(rx_queue, budget);
 		if (ret == 0)
 			cpu_relax();
 	} while (ret == 0 && idle_cnt++ < 1000);
 
+	if (ret >= budget)
+		rx_queue->rx.ll_budget = min(budget * 2, MAX_BATCH);
+	else
+		rx_queue->rx.ll_budget = max(budget / 2, min_budget);
+
 	sn_enable_interrupt(rx_queue);
 
 	if (rx_queue->dev->ops->pending_rx(rx_queue)) {
@@ -468,12 +490,24 @@ static int sn_poll_ll(struct napi_struct *napi)
 		napi_schedule(napi);
 	}
 
-	spin_unlock(&rx_queue->lock);
+	spin_unlock(&rx_queue->rx.lock);
 
 	return ret;
 }
 #endif
 
+/* Fires irq_moderation_us after a productive NAPI poll.
+ * The interrupt is still disabled at this point, so poll again. */
+static enum hrtimer_restart sn_moderation_timer_fn(struct hrtimer *timer)
+{
+	struct sn_queue *rx_queue;
+
+	rx_queue = container_of(timer, struct sn_queue, rx.moderation_timer);
+	napi_schedule(&rx_queue->rx.napi);
+
+	return HRTIMER_NORESTART;
+}
+
 /* NAPI callback */
 /* The return value says how many packets are actually received */
 static int sn_poll(struct napi_struct *napi, int budget)
@@ -493,13 +527,27 @@ static int sn_poll(struct napi_struct *napi, int budget)
 
 	if (ret < budget) {
 		napi_complete(napi);
-		sn_enable_interrupt(rx_queue);
 
-		/* last check for race condition.
-		 * see sn_enable_interrupt() */
-		if (rx_queue->dev->ops->pending_rx(rx_queue)) {
-			napi_reschedule(napi);
-			sn_disable_interrupt(rx_queue);
+		if (ret > 0 && rx_queue->rx.opts.irq_moderation_us) {
+			/* Traffic is flowing. Rather than taking an interrupt
+			 * (and making BESS issue a kick ioctl) for the next
+			 * few packets, keep the interrupt disabled and poll
+			 * again shortly. Once a poll comes back empty,
+			 * we fall back to interrupts below. */
+			rx_queue->rx.stats.deferred_polls++;
+			hrtimer_start(&rx_queue->rx.moderation_timer,
+				ns_to_ktime(rx_queue->rx.opts.irq_moderation_us *
+					    NSEC_PER_USEC),
+				HRTIMER_MODE_REL);
+		} else {
+			sn_enable_interrupt(rx_queue);
+
+			/* last check for race condition.
+			 * see sn_enable_interrupt() */
+			if (rx_queue->dev->ops->pending_rx(rx_queue)) {
+				napi_reschedule(napi);
+				sn_disable_interrupt(rx_queue);
+			}
 		}
 	}
 
@@ -39,6 +39,7 @@
 #include "opts.h"
 #include "packet.h"
 #include "port.h"
+#include "utils/time.h"
 #include "version.h"
 
 int main(int argc, char *argv[]) {
@@ -70,6 +71,9 @@ int main(int argc, char *argv[]) {
   // Store our PID (child's, if daemonized) in the PID file.
   bess::bessd::WritePidfile(pidfile_fd, getpid());
 
+  // Time spent in each startup phase, reported once all are done
+  double t_start = get_epoch_time();
+
   // Load plugins
   if (!bess::bessd::LoadPlugins(FLAGS_modules)) {
     PLOG(FATAL) << "LoadPlugins() failed to load from directory: "
@@ -78,10 +82,20 @@ int main(int argc, char *argv[]) {
 
   // TODO(barath): Make these DPDK calls generic, so as to not be so tied to
   // DPDK.
-  init_dpdk(argv[0], FLAGS_m, FLAGS_a, FLAGS_no_huge);
+  double t_plugins = get_epoch_time();
+  init_dpdk(argv[0], FLAGS_m, FLAGS_a, FLAGS_no_huge, FLAGS_lazy_probe);
+  double t_dpdk = get_epoch_time();
   bess::init_mempool();
+  double t_mempool = get_epoch_time();
 
   PortBuilder::InitDrivers();
+  double t_drivers = get_epoch_time();
+
+  LOG(INFO) << "Startup took " << (t_drivers - t_start) * 1000
+            << " ms: plugins " << (t_plugins - t_start) * 1000 << " ms, DPDK "
+            << (t_dpdk - t_plugins) * 1000 << " ms, packet pools "
+            << (t_mempool - t_dpdk) * 1000 << " ms, port drivers "
+            << (t_drivers - t_mempool) * 1000 << " ms";
 
   {
     ApiServer server;
@@ -38,31 +38,110 @@
 
 #if MEM_ALLOC_PROVIDER == LIBC
 
+#include <linux/mempolicy.h>
 #include <malloc.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
+#include <cerrno>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 
+/* Returns in [*start, *end) the pages that lie wholly within
+ * [ptr, ptr + size). Pages only partly covered may hold other heap objects. */
+static void whole_pages(const void *ptr, size_t size, uintptr_t *start,
+                        uintptr_t *end) {
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+
+  *start = (reinterpret_cast<uintptr_t>(ptr) + page_size - 1) &
+           ~(page_size - 1);
+  *end = (reinterpret_cast<uintptr_t>(ptr) + size) & ~(page_size - 1);
+}
+
+/* Sets the memory policy of the pages that lie wholly within
+ * [ptr, ptr + size) to prefer `socket`, moving those already in use. Pages
+ * only partly covered may hold other heap objects, which must stay where they
+ * are, so they are left alone. Calls the system call directly, so as not to
+ * depend on libnuma. */
+static int bind_pages(void *ptr, size_t size, int socket) {
+  uintptr_t start;
+  uintptr_t end;
+  unsigned long nodemask;
+
+  if (socket < 0 || socket >= static_cast<int>(sizeof(nodemask) * 8)) {
+    return -EINVAL;
+  }
+
+  whole_pages(ptr, size, &start, &end);
+  if (start >= end) {
+    return 0;
+  }
+
+  nodemask = 1ul << socket;
+  if (syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, &nodemask,
+              sizeof(nodemask) * 8, MPOL_MF_MOVE)) {
+    return -errno;
+  }
+
+  return 0;
+}
+
+/* Undoes bind_pages() before the block goes back to the heap, or the pages
+ * would keep preferring the socket for whatever malloc() puts there next.
+ * This also lets the kernel merge the heap mapping back, which every
+ * bind_pages() splits. The pages stay where they are. */
+static void unbind_pages(void *ptr, size_t size) {
+  uintptr_t start;
+  uintptr_t end;
+
+  whole_pages(ptr, size, &start, &end);
+  if (start < end) {
+    syscall(SYS_mbind, start, end - start, MPOL_DEFAULT, nullptr, 0, 0);
+  }
+}
+
 void *mem_alloc(size_t size) {
   return calloc(1, size);
 }
 
-/* TODO: socket is ignored for now */
-void *mem_alloc_ex(size_t size, size_t align, int) {
+void *mem_alloc_ex(size_t size, size_t align, int socket) {
   void *ptr;
   int ret;
 
+  /* posix_memalign() wants at least this */
+  if (align < sizeof(void *))
+    align = sizeof(void *);
+
   ret = posix_memalign(&ptr, align, size);
   if (ret)
     return nullptr;
 
+  /* best effort: the memory is still usable if this fails */
+  if (socket >= 0)
+    bind_pages(ptr, size, socket);
+
+  /* first touch, after the policy is set */
   memset(ptr, 0, size);
 
   return ptr;
 }
 
+void *mem_alloc_pages(size_t size, int socket) {
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+
+  return mem_alloc_ex((size + page_size - 1) & ~(page_size - 1), page_size,
+                      socket);
+}
+
 void *mem_realloc(void *ptr, size_t size) {
   size_t old_size = malloc_usable_size(ptr);
+
+  /* the block may move, leaving its pages behind */
+  if (ptr) {
+    unbind_pages(ptr, old_size);
+  }
+
   char *new_ptr = static_cast<char *>(realloc(ptr, size));
 
   if (new_ptr && size > old_size) {
@@ -73,18 +152,46 @@ void *mem_realloc(void *ptr, size_t size) {
 }
 
 void mem_free(void *ptr) {
+  if (ptr) {
+    unbind_pages(ptr, malloc_usable_size(ptr));
+  }
   free(ptr);
 }
 
+int mem_move(void *ptr, int socket) {
+  return bind_pages(ptr, malloc_usable_size(ptr), socket);
+}
+
+int mem_socket(const void *ptr) {
+  int node;
+
+  if (syscall(SYS_get_mempolicy, &node, nullptr, 0, ptr,
+              MPOL_F_NODE | MPOL_F_ADDR))
+    return -1;
+
+  return node;
+}
+
 #elif MEM_ALLOC_PROVIDER == DPDK
 
 #include <rte_config.h>
 #include <rte_malloc.h>
 
+#include <cerrno>
+
 void *mem_alloc(size_t size) {
   return rte_zmalloc(/* name= */ nullptr, size, /* align= */ 0);
 }
 
+void *mem_alloc_ex(size_t size, size_t align, int socket) {
+  return rte_zmalloc_socket(/* name= */ nullptr, size, align,
+                            socket < 0 ? SOCKET_ID_ANY : socket);
+}
+
+void *mem_alloc_pages(size_t size, int socket) {
+  return mem_alloc_ex(size, /* align= */ 0, socket);
+}
+
 void *mem_realloc(void *ptr, size_t size) {
   return rte_realloc(ptr, size, /* align= */ 0);
 }
@@ -93,6 +200,15 @@ void mem_free(void *ptr) {
   rte_free(ptr);
 }
 
+/* hugepages cannot be migrated */
+int mem_move(void *, int) {
+  return -ENOTSUP;
+}
+
+int mem_socket(const void *) {
+  return -1;
+}
+
 #else
 
 #error "Unknown mem_alloc provider"
@@ -35,15 +35,77 @@
 #define BESS_MEMALLOC_H_
 
 #include <cstddef>
-
-/* TODO: Use C++11-style allocator */
+#include <new>
+#include <type_traits>
 
 void *mem_alloc(size_t size); /* zero initialized by default */
 
+/* The pages of the block are placed on NUMA node `socket` (anywhere if it is
+ * negative). The pages at either end may be shared with other data, so they
+ * end up on the node of whoever touches them first instead. */
 void *mem_alloc_ex(size_t size, size_t align, int socket);
 
+/* Like mem_alloc_ex(), but the block is made of whole pages that hold nothing
+ * else, so that mem_move() can move all of it. */
+void *mem_alloc_pages(size_t size, int socket);
+
 void *mem_realloc(void *ptr, size_t size);
 
 void mem_free(void *ptr);
 
+/* Moves the pages of a block returned by mem_alloc*() to NUMA node `socket`,
+ * in place: the block stays valid and may be accessed meanwhile. Pages the
+ * block shares with other data (at either end, unless it comes from
+ * mem_alloc_pages()) are not moved. Returns -errno if fails. */
+int mem_move(void *ptr, int socket);
+
+/* Returns the NUMA node ptr resides on, or -1 if unknown */
+int mem_socket(const void *ptr);
+
+namespace bess {
+
+// Standard allocator for containers of data that the workers of one socket
+// access, e.g., std::vector<T, SocketAllocator<T>> v(SocketAllocator<T>(1)).
+// Containers carry their allocator along when moved or swapped.
+template <typename T>
+class SocketAllocator {
+ public:
+  typedef T value_type;
+  typedef std::true_type propagate_on_container_copy_assignment;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  explicit SocketAllocator(int socket = -1) : socket_(socket) {}
+
+  template <typename U>
+  SocketAllocator(const SocketAllocator<U> &other) : socket_(other.socket()) {}
+
+  T *allocate(size_t n) {
+    void *ptr = mem_alloc_ex(n * sizeof(T), alignof(T), socket_);
+    if (!ptr) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(ptr);
+  }
+
+  void deallocate(T *ptr, size_t) { mem_free(ptr); }
+
+  int socket() const { return socket_; }
+
+ private:
+  int socket_;
+};
+
+template <typename T, typename U>
+bool operator==(const SocketAllocator<T> &a, const SocketAllocator<U> &b) {
+  return a.socket() == b.socket();
+}
+
+template <typename T, typename U>
+bool operator!=(const SocketAllocator<T> &a, const SocketAllocator<U> &b) {
+  return !(a == b);
+}
+
+}  // namespace bess
+
 #endif  // BESS_MEMALLOC_H_
@@ -0,0 +1,177 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "mem_alloc.h"
+
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// Returns the memory policy of the page at ptr, or -1 if unknown
+int mem_policy(const void *ptr) {
+  int mode;
+  if (syscall(SYS_get_mempolicy, &mode, nullptr, 0, ptr, MPOL_F_ADDR)) {
+    return -1;
+  }
+  return mode;
+}
+
+TEST(MemAllocTest, AllocEx) {
+  const size_t size = 1 << 20;
+  char *ptr = static_cast<char *>(mem_alloc_ex(size, 64, /* socket = */ 0));
+  ASSERT_NE(nullptr, ptr);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ptr) % 64);
+
+  for (size_t i = 0; i < size; i++) {
+    ASSERT_EQ(0, ptr[i]);
+  }
+
+  // -1 if the kernel does not support NUMA policies
+  int socket = mem_socket(ptr + size / 2);
+  EXPECT_TRUE(socket == 0 || socket == -1);
+
+  mem_free(ptr);
+
+  // Alignment smaller than that of a pointer
+  ptr = static_cast<char *>(mem_alloc_ex(3, 1, /* socket = */ -1));
+  ASSERT_NE(nullptr, ptr);
+  mem_free(ptr);
+}
+
+TEST(MemAllocTest, Move) {
+  const size_t size = 1 << 20;
+  char *ptr = static_cast<char *>(mem_alloc_ex(size, 64, /* socket = */ -1));
+  ASSERT_NE(nullptr, ptr);
+  ptr[0] = 1;
+  ptr[size - 1] = 2;
+
+  int ret = mem_move(ptr, 0);
+  if (ret == 0) {
+    EXPECT_EQ(0, mem_socket(ptr + size / 2));
+  }
+
+  // The block stays where it is
+  EXPECT_EQ(1, ptr[0]);
+  EXPECT_EQ(2, ptr[size - 1]);
+
+  EXPECT_NE(0, mem_move(ptr, 4096));
+  mem_free(ptr);
+}
+
+TEST(MemAllocTest, AllocPages) {
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  const size_t size = page_size + 100;
+  char *ptr = static_cast<char *>(mem_alloc_pages(size, /* socket = */ -1));
+  ASSERT_NE(nullptr, ptr);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ptr) % page_size);
+
+  for (size_t i = 0; i < size; i++) {
+    ASSERT_EQ(0, ptr[i]);
+  }
+  ptr[size - 1] = 1;
+
+  // The block moves as a whole
+  int ret = mem_move(ptr, 0);
+  if (ret == 0) {
+    EXPECT_EQ(0, mem_socket(ptr));
+    EXPECT_EQ(0, mem_socket(ptr + size - 1));
+    EXPECT_EQ(MPOL_PREFERRED, mem_policy(ptr));
+    EXPECT_EQ(MPOL_PREFERRED, mem_policy(ptr + size - 1));
+  }
+  EXPECT_EQ(1, ptr[size - 1]);
+
+  mem_free(ptr);
+}
+
+// Tests that moving a block leaves the pages it shares with others alone.
+TEST(MemAllocTest, MoveSmallBlock) {
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  char *ptr = static_cast<char *>(mem_alloc_ex(64, 64, /* socket = */ -1));
+  ASSERT_NE(nullptr, ptr);
+
+  // Earlier tests may have left a policy on the heap
+  uintptr_t page = reinterpret_cast<uintptr_t>(ptr) & ~(page_size - 1);
+  if (syscall(SYS_mbind, page, page_size, MPOL_DEFAULT, nullptr, 0, 0)) {
+    mem_free(ptr);
+    return;  // no NUMA support
+  }
+
+  EXPECT_EQ(0, mem_move(ptr, 0));
+  EXPECT_EQ(MPOL_DEFAULT, mem_policy(ptr));
+
+  mem_free(ptr);
+}
+
+// Tests that a block bound to a socket does not leave its policy behind for
+// whatever the heap reuses its pages for.
+TEST(MemAllocTest, FreeBoundBlock) {
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  const size_t size = 16 * page_size;  // on the heap, not mmap()ed by malloc
+  char *ptr = static_cast<char *>(mem_alloc_ex(size, page_size, 0));
+  ASSERT_NE(nullptr, ptr);
+  if (mem_policy(ptr) != MPOL_PREFERRED) {
+    mem_free(ptr);
+    return;  // no NUMA support
+  }
+  mem_free(ptr);
+
+  char *reused = static_cast<char *>(mem_alloc(size));
+  ASSERT_NE(nullptr, reused);
+  for (size_t i = page_size; i < size - page_size; i += page_size) {
+    EXPECT_EQ(MPOL_DEFAULT, mem_policy(reused + i));
+  }
+  mem_free(reused);
+}
+
+TEST(SocketAllocatorTest, Vector) {
+  bess::SocketAllocator<uint64_t> alloc(0);
+  std::vector<uint64_t, bess::SocketAllocator<uint64_t>> v(alloc);
+
+  for (uint64_t i = 0; i < 100000; i++) {
+    v.push_back(i);
+  }
+  EXPECT_EQ(99999, v.back());
+  EXPECT_EQ(0, v.get_allocator().socket());
+
+  // The allocator goes along with the data
+  std::vector<uint64_t, bess::SocketAllocator<uint64_t>> w(
+      bess::SocketAllocator<uint64_t>(1));
+  w = std::move(v);
+  EXPECT_EQ(0, w.get_allocator().socket());
+  EXPECT_EQ(100000, w.size());
+}
+
+}  // namespace
@@ -78,12 +78,13 @@ static inline int IsValidOffset(mt_offset_t offset) {
 }
 
 struct Attribute {
-  Attribute() : name(), size(), mode(), scope_id() {}
+  Attribute() : name(), size(), mode(), scope_id(), optional() {}
 
   std::string name;
   size_t size;  // in bytes
   enum class AccessMode { kRead = 0, kWrite, kUpdate } mode;
   mutable int scope_id;
+  bool optional;  // Read if available; do not warn if nobody sets it.
 };
 
 typedef std::string attr_id_t;
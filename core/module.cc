@@ -31,8 +31,10 @@
 #include "module.h"
 
 #include <glog/logging.h>
+#include <x86intrin.h>
 
 #include <algorithm>
+#include <cstring>
 #include <sstream>
 
 #include "gate.h"
@@ -40,6 +42,7 @@
 #include "gate_hooks/track.h"
 #include "mem_alloc.h"
 #include "module_graph.h"
+#include "rcu.h"
 #include "scheduler.h"
 #include "task.h"
 #include "utils/pcap.h"
@@ -151,12 +154,13 @@ void Module::ProcessBatch(bess::PacketBatch *) {
   CHECK(0);  // You must override this function
 }
 
-task_id_t Module::RegisterTask(void *arg) {
+task_id_t Module::RegisterTask(void *arg, bool migratable) {
   std::string leafname = std::string("!leaf_") + name_ + std::string(":") +
                          std::to_string(tasks_.size());
   bess::LeafTrafficClass *c =
       bess::TrafficClassBuilder::CreateTrafficClass<bess::LeafTrafficClass>(
           leafname, Task(this, arg));
+  c->set_migratable(migratable);
 
   add_tc_to_orphan(c, -1);
   tasks_.push_back(c->task());
@@ -264,8 +268,41 @@ CheckConstraintResult Module::CheckModuleConstraints() const {
   return valid;
 }
 
+int Module::WorkerSocket() const {
+  int socket = -1;
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (!active_workers_[wid] || !workers[wid]) {
+      continue;
+    }
+    if (socket != -1 && socket != workers[wid]->socket()) {
+      return -1;
+    }
+    socket = workers[wid]->socket();
+  }
+
+  return socket;
+}
+
+void Module::PlaceOnSocket(int socket) {
+  if (socket == socket_) {
+    return;
+  }
+
+  int ret = mem_move(this, socket);
+  if (ret < 0) {
+    LOG(WARNING) << "Cannot move module " << name_ << " to socket " << socket
+                 << ": " << strerror(-ret);
+  }
+
+  MoveToSocket(socket);
+  socket_ = socket;
+  VLOG(1) << "Module " << name_ << " placed on socket " << socket;
+}
+
 int Module::AddMetadataAttr(const std::string &name, size_t size,
-                            bess::metadata::Attribute::AccessMode mode) {
+                            bess::metadata::Attribute::AccessMode mode,
+                            bool optional) {
   int ret;
 
   if (attrs_.size() >= bess::metadata::kMaxAttrsPerModule)
@@ -293,6 +330,7 @@ int Module::AddMetadataAttr(const std::string &name, size_t size,
   attr.size = size;
   attr.mode = mode;
   attr.scope_id = -1;
+  attr.optional = optional;
 
   attrs_.push_back(attr);
 
@@ -346,6 +384,7 @@ int Module::ConnectModules(gate_idx_t ogate_idx, Module *m_next,
   // Gate tracking is enabled by default
   ogate->AddHook(new Track());
   igate->PushOgate(ogate);
+  ModuleGraph::UpdateFusedGates(this);
 
   // Update graph
   return !ModuleGraph::AddEdge(name_, m_next->name_);
@@ -388,10 +427,109 @@ int Module::DisconnectModules(gate_idx_t ogate_idx) {
   ogates_[ogate_idx] = nullptr;
   ogate->ClearHooks();
   delete ogate;
+  ModuleGraph::UpdateFusedGates(this);
 
   return 0;
 }
 
+int Module::RedirectModules(gate_idx_t ogate_idx, Module *m_next,
+                            gate_idx_t igate_idx) {
+  if (ogate_idx >= module_builder_->NumOGates()) {
+    return -EINVAL;
+  }
+
+  if (igate_idx >= m_next->module_builder()->NumIGates() ||
+      igate_idx >= MAX_GATES) {
+    return -EINVAL;
+  }
+
+  if (!is_active_gate<bess::OGate>(ogates_, ogate_idx)) {
+    return -ENOTCONN;
+  }
+
+  bess::OGate *old_ogate = ogates_[ogate_idx];
+  bess::IGate *old_igate = old_ogate->igate();
+  Module *m_prev = old_igate->module();
+
+  if (m_prev == m_next && old_igate->gate_idx() == igate_idx) {
+    return 0;
+  }
+
+  // Build the new gate on the side. Workers do not look at igates_ or at the
+  // upstream list of an igate, so those can be updated right away.
+  bess::OGate *ogate = new bess::OGate(this, ogate_idx, m_next);
+  if (!ogate) {
+    return -ENOMEM;
+  }
+
+  if (igate_idx >= m_next->igates_.size()) {
+    m_next->igates_.resize(igate_idx + 1, nullptr);
+  }
+
+  bess::IGate *igate = m_next->igates_[igate_idx];
+  if (!igate) {
+    igate = new bess::IGate(m_next, igate_idx);
+    m_next->igates_[igate_idx] = igate;
+  }
+
+  ogate->set_igate(igate);
+  ogate->set_igate_idx(igate_idx);
+  ogate->AddHook(new Track());
+  igate->PushOgate(ogate);
+
+  // Send everyone through ogates_[] first, so that the fused entry can be
+  // rewritten while nobody reads it, then swap the gate itself.
+  ACCESS_ONCE(fused_gates_[ogate_idx].next) = nullptr;
+  bess::SynchronizeRcu();
+
+  ACCESS_ONCE(ogates_[ogate_idx]) = ogate;
+  bess::SynchronizeRcu();
+
+  UpdateFusedGate(ogate_idx);
+
+  // No worker can be using the old gates any more.
+  old_igate->RemoveOgate(old_ogate);
+  if (old_igate->ogates_upstream().empty()) {
+    m_prev->igates_[old_igate->gate_idx()] = nullptr;
+    old_igate->ClearHooks();
+    delete old_igate;
+  }
+  old_ogate->ClearHooks();
+  delete old_ogate;
+
+  // Update graph. Another ogate of ours may still lead to the old module.
+  bool still_connected = false;
+  for (const bess::OGate *g : ogates_) {
+    if (g && g->next() == m_prev) {
+      still_connected = true;
+      break;
+    }
+  }
+
+  if (!still_connected && !ModuleGraph::RemoveEdge(name_, m_prev->name_)) {
+    return 1;
+  }
+
+  return !ModuleGraph::AddEdge(name_, m_next->name_);
+}
+
+void Module::UpdateFusedGate(gate_idx_t ogate_idx) {
+  FusedGate &fused = fused_gates_[ogate_idx];
+  const bess::OGate *ogate = ogates_[ogate_idx];
+
+  ACCESS_ONCE(fused.next) = nullptr;
+  if (!ogate || ogate->hooks().size() > 1 ||
+      !ogate->igate()->hooks().empty()) {
+    return;
+  }
+
+  ACCESS_ONCE(fused.hook) =
+      ogate->hooks().empty() ? nullptr : ogate->hooks()[0];
+  ACCESS_ONCE(fused.igate_idx) = ogate->igate_idx();
+  STORE_BARRIER();
+  ACCESS_ONCE(fused.next) = ogate->next();
+}
+
 int Module::DisconnectModulesUpstream(gate_idx_t igate_idx) {
   bess::IGate *igate;
 
@@ -413,6 +551,7 @@ int Module::DisconnectModulesUpstream(gate_idx_t igate_idx) {
     Module *m_prev = ogate->module();
     m_prev->ogates_[ogate->gate_idx()] = nullptr;
     ogate->ClearHooks();
+    ModuleGraph::UpdateFusedGates(m_prev);
 
     // Remove edge in module graph
     if (!ModuleGraph::RemoveEdge(ogate->module()->name_, name_)) {
@@ -429,45 +568,134 @@ int Module::DisconnectModulesUpstream(gate_idx_t igate_idx) {
   return 0;
 }
 
+void Module::UnshareBatch(bess::PacketBatch *batch) {
+  const int cnt = batch->cnt();
+  bess::Packet **pkts = batch->pkts();
+  int i = 0;
+
+  while (i < cnt && !pkts[i]->is_shared()) {
+    i++;
+  }
+
+  if (likely(i == cnt)) {
+    return;
+  }
+
+  int num_out = i;
+  for (; i < cnt; i++) {
+    bess::Packet *pkt = pkts[i];
+
+    if (pkt->is_shared()) {
+      bess::Packet *copy = bess::Packet::copy(pkt);
+      if (!copy) {
+        ctx.incr_silent_drops(1);
+      }
+      bess::Packet::Free(pkt);
+      pkt = copy;
+    }
+
+    if (pkt) {
+      pkts[num_out++] = pkt;
+    }
+  }
+
+  batch->set_cnt(num_out);
+}
+
+// Returns true if all of the cnt (> 0) gates are the same
+static inline bool IsUniformGates(const gate_idx_t *gates, int cnt) {
+  static_assert(sizeof(gate_idx_t) == 2, "gate_idx_t must be 16-bit");
+
+  const gate_idx_t first = gates[0];
+  const __m128i first_x8 = _mm_set1_epi16(first);
+  int i = 0;
+
+  for (; i + 8 <= cnt; i += 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(gates + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(v, first_x8)) != 0xffff) {
+      return false;
+    }
+  }
+
+  for (; i < cnt; i++) {
+    if (gates[i] != first) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 void Module::RunSplit(const gate_idx_t *out_gates,
                       bess::PacketBatch *mixed_batch) {
-  int cnt = mixed_batch->cnt();
+  const int cnt = mixed_batch->cnt();
   int num_pending = 0;
 
-  bess::Packet **p_pkt = &mixed_batch->pkts()[0];
+  if (unlikely(cnt <= 0)) {
+    return;
+  }
+
+  // fast path: the whole batch goes to one ogate, so pass it as it is
+  if (IsUniformGates(out_gates, cnt)) {
+    RunChooseModule(out_gates[0], mixed_batch);
+    return;
+  }
+
+  bess::Packet **pkts = mixed_batch->pkts();
 
+  // Per-batch state is kept in arrays indexed by packet or by gate slot
+  // rather than in one PacketBatch per ogate, which would take
+  // kMaxBurst * sizeof(PacketBatch) of stack (512KB with 256-packet batches).
   gate_idx_t pending[bess::PacketBatch::kMaxBurst];
-  bess::PacketBatch batches[bess::PacketBatch::kMaxBurst];
+  uint16_t start[bess::PacketBatch::kMaxBurst + 1];
+  uint16_t slot_of[bess::PacketBatch::kMaxBurst];
+  bess::Packet *sorted[bess::PacketBatch::kMaxBurst];
 
-  bess::PacketBatch **splits = ctx.splits();
+  uint16_t *slots = ctx.split_slots();
 
-  // phase 1: collect unique ogates into pending[] and add packets to local
-  // batches, using splits to remember the association between an ogate and a
-  // local batch
+  // phase 1: collect unique ogates into pending[] and count the packets for
+  // each of them, using slots to remember the ogate -> pending[] mapping
   for (int i = 0; i < cnt; i++) {
-    bess::PacketBatch *batch;
-    gate_idx_t ogate;
-
-    ogate = out_gates[i];
-    batch = splits[ogate];
-    if (!batch) {
-      batch = splits[ogate] = &batches[num_pending];
-      batch->clear();
-      pending[num_pending] = ogate;
-      num_pending++;
+    gate_idx_t ogate = out_gates[i];
+    uint16_t slot = slots[ogate];
+    if (!slot) {
+      slot = slots[ogate] = ++num_pending;
+      pending[slot - 1] = ogate;
+      start[slot] = 0;
     }
 
-    batch->add(*(p_pkt++));
+    start[slot]++;
+    slot_of[i] = slot - 1;
   }
 
-  // phase 2: clear splits, since it may be reentrant.
+  // phase 2: clear slots, since it may be reentrant.
   for (int i = 0; i < num_pending; i++) {
-    splits[pending[i]] = nullptr;
+    slots[pending[i]] = 0;
+  }
+
+  // phase 3: group packets by ogate, preserving their order. After the
+  // prefix sum start[i] is where the i-th group begins; after the scatter
+  // it is where the i-th group ends.
+  start[0] = 0;
+  for (int i = 1; i <= num_pending; i++) {
+    start[i] += start[i - 1];
+  }
+
+  for (int i = 0; i < cnt; i++) {
+    sorted[start[slot_of[i]]++] = pkts[i];
   }
 
-  // phase 3: fire
-  for (int i = 0; i < num_pending; i++)
-    RunChooseModule(pending[i], &batches[i]);
+  // phase 4: fire
+  bess::PacketBatch batch;
+  int begin = 0;
+  for (int i = 0; i < num_pending; i++) {
+    int n = start[i] - begin;
+    bess::utils::CopyInlined(batch.pkts(), &sorted[begin],
+                             n * sizeof(bess::Packet *));
+    batch.set_cnt(n);
+    RunChooseModule(pending[i], &batch);
+    begin = start[i];
+  }
 }
 
 #if SN_TRACE_MODULES
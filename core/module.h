@@ -180,8 +180,10 @@ enum CheckConstraintResult {
 class alignas(64) Module {
   // overide this section to create a new module -----------------------------
  public:
+  // Modules get pages of their own, so that PlaceOnSocket() moves nothing
+  // but the module
   static void *operator new(std::size_t size) {
-    return mem_alloc_ex(size, alignof(Module), 0);
+    return mem_alloc_pages(size, /* socket = */ -1);
   }
 
   static void operator delete(void *ptr) { mem_free(ptr); }
@@ -195,6 +197,7 @@ class alignas(64) Module {
         tasks_(),
         igates_(),
         ogates_(),
+        fused_gates_(),
         active_workers_(Worker::kMaxWorkers, false),
         visited_tasks_(),
         is_task_(false),
@@ -204,7 +207,9 @@ class alignas(64) Module {
         node_constraints_(UNCONSTRAINED_SOCKET),
         min_allowed_workers_(1),
         max_allowed_workers_(1),
-        propagate_workers_(true) {}
+        propagate_workers_(true),
+        writes_payload_(false),
+        socket_(-1) {}
   virtual ~Module() {}
 
   CommandResponse Init(const bess::pb::EmptyArg &arg);
@@ -223,8 +228,23 @@ class alignas(64) Module {
    */
   virtual int OnEvent(bess::Event) { return -ENOTSUP; }
 
+  // Tells, without side effects, whether OnEvent() acts on Event `e`. Used to
+  // decide whether a module can go live without pausing the workers (see
+  // SwapGate), so modules that override OnEvent() must override it too.
+  virtual bool HandlesEvent(bess::Event) const { return false; }
+
   virtual std::string GetDesc() const { return ""; }
 
+  // Returns the number of packets the module holds on to between calls
+  // (e.g., in a queue) and has yet to push downstream. Used to tell when a
+  // module taken out of the pipeline has drained and can be destroyed.
+  virtual size_t NumBufferedPackets() const { return 0; }
+
+  // Moves large data structures that the workers access (e.g., tables) to
+  // NUMA node `socket`, which the workers running the module are on. Called
+  // with all workers paused, after the module object itself has been moved.
+  virtual void MoveToSocket(int) {}
+
   static const gate_idx_t kNumIGates = 1;
   static const gate_idx_t kNumOGates = 1;
 
@@ -256,6 +276,7 @@ class alignas(64) Module {
    * NOTE:
    *   1. Order is preserved for packets with the same gate.
    *   2. No ordering guarantee for packets with different gates.
+   *   3. If all packets go to the same gate, mixed_batch itself is passed.
    */
   void RunSplit(const gate_idx_t *ogates, bess::PacketBatch *mixed_batch);
 
@@ -265,8 +286,16 @@ class alignas(64) Module {
   int DisconnectModulesUpstream(gate_idx_t igate_idx);
   int DisconnectModules(gate_idx_t ogate_idx);
 
-  // Register a task.
-  task_id_t RegisterTask(void *arg);
+  // Moves a connected ogate over to `m_next`, while workers keep running:
+  // each batch goes either to the old or to the new module, and no worker is
+  // still using the old gate once this returns. Master thread only.
+  int RedirectModules(gate_idx_t ogate_idx, Module *m_next,
+                      gate_idx_t igate_idx);
+
+  // Register a task. If `migratable`, rebalance_workers() may move the task
+  // to another worker: the task must not depend on running on a particular
+  // worker (e.g., polling one queue of a port, with no per-worker state).
+  task_id_t RegisterTask(void *arg, bool migratable = false);
 
   /* Modules should call this function to declare additional metadata
    * attributes at initialization time.
@@ -274,9 +303,12 @@ class alignas(64) Module {
    * automatically registered, so only attributes specific to a module
    * 'instance'
    * need this function.
+   * An optional attribute is one the module can do without (e.g., it falls
+   * back to computing the value itself when attr_offset() is not valid).
    * Returns its allocated ID (>= 0), or a negative number for error */
   int AddMetadataAttr(const std::string &name, size_t size,
-                      bess::metadata::Attribute::AccessMode mode);
+                      bess::metadata::Attribute::AccessMode mode,
+                      bool optional = false);
 
   CommandResponse RunCommand(const std::string &cmd,
                              const google::protobuf::Any &arg) {
@@ -325,6 +357,19 @@ class alignas(64) Module {
 
   const std::vector<bool> &active_workers() const { return active_workers_; }
 
+  int max_allowed_workers() const { return max_allowed_workers_; }
+
+  // Returns the NUMA node of the active workers, or -1 if there is none or
+  // they are on different nodes.
+  int WorkerSocket() const;
+
+  // NUMA node the module has been placed on, or -1 if not placed yet
+  int socket() const { return socket_; }
+
+  // Moves the module object, and with MoveToSocket() its data structures, to
+  // NUMA node `socket`. Workers must be paused.
+  void PlaceOnSocket(int socket);
+
   /*!
    * Number of active workers attached to this module.
    */
@@ -408,6 +453,23 @@ class alignas(64) Module {
   std::vector<bess::IGate *> igates_;
   std::vector<bess::OGate *> ogates_;
 
+  // Direct dispatch for each ogate, precomputed by ModuleGraph so that a hop
+  // along a chain does not have to go through the OGate/IGate objects.
+  // An entry has a non-null `next` only if the ogate is connected, has at most
+  // one hook and the igate has none; otherwise the generic path is taken.
+  struct FusedGate {
+    Module *next;
+    bess::GateHook *hook;
+    gate_idx_t igate_idx;
+  };
+  std::vector<FusedGate> fused_gates_;
+
+  // Recomputes fused_gates_[ogate_idx], publishing `next` last with release
+  // semantics so that a worker never follows a half-written entry. Workers
+  // must either be paused, or have stopped using the previous entry (its
+  // `next` cleared, followed by an RCU grace period).
+  void UpdateFusedGate(gate_idx_t ogate_idx);
+
  protected:
   // Set of active workers accessing this module.
   std::vector<bool> active_workers_;
@@ -443,6 +505,19 @@ class alignas(64) Module {
   // Note, one should override the `AddActiveWorker` method in more complex
   // cases.
   bool propagate_workers_;
+
+  // Set this to true if ProcessBatch() modifies packet data in place,
+  // including the headroom via prepend(). Shared packets (e.g., clones made by
+  // `Replicate`) are replaced with private copies before reaching the module.
+  bool writes_payload_;
+
+ private:
+  // Copy-on-write for modules with writes_payload_ set
+  static void UnshareBatch(bess::PacketBatch *batch);
+
+  // See PlaceOnSocket()
+  int socket_;
+
   DISALLOW_COPY_AND_ASSIGN(Module);
 };
 
@@ -459,6 +534,30 @@ inline void Module::RunChooseModule(gate_idx_t ogate_idx,
     return;
   }
 
+  if (likely(ogate_idx < fused_gates_.size())) {
+    const FusedGate &fused = fused_gates_[ogate_idx];
+    // RedirectModules() may clear the entry at any time. Read it exactly once,
+    // `next` first (paired with the release in UpdateFusedGate()).
+    Module *next = ACCESS_ONCE(fused.next);
+    if (likely(next != nullptr)) {
+      LOAD_BARRIER();
+      bess::GateHook *hook = ACCESS_ONCE(fused.hook);
+      gate_idx_t igate_idx = ACCESS_ONCE(fused.igate_idx);
+
+      if (hook) {
+        hook->ProcessBatch(batch);
+      }
+
+      if (next->writes_payload_) {
+        UnshareBatch(batch);
+      }
+
+      ctx.set_current_igate(igate_idx);
+      next->ProcessBatch(batch);
+      return;
+    }
+  }
+
   if (unlikely(ogate_idx >= ogates_.size())) {
     deadend(batch);
     return;
@@ -478,8 +577,13 @@ inline void Module::RunChooseModule(gate_idx_t ogate_idx,
     hook->ProcessBatch(batch);
   }
 
+  Module *next = static_cast<Module *>(ogate->next());
+  if (next->writes_payload_) {
+    UnshareBatch(batch);
+  }
+
   ctx.set_current_igate(ogate->igate_idx());
-  (static_cast<Module *>(ogate->next()))->ProcessBatch(batch);
+  next->ProcessBatch(batch);
 }
 
 inline void Module::RunNextModule(bess::PacketBatch *batch) {
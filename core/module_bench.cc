@@ -0,0 +1,140 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmarks for Module::RunSplit().
+
+#include <benchmark/benchmark.h>
+
+#include "module.h"
+#include "module_graph.h"
+
+namespace {
+
+class SplitSource final : public Module {
+ public:
+  static const gate_idx_t kNumIGates = 0;
+  static const gate_idx_t kNumOGates = bess::PacketBatch::kMaxBurst;
+
+  static const Commands cmds;
+
+  CommandResponse Init(const bess::pb::EmptyArg &) { return CommandResponse(); }
+};
+
+const Commands SplitSource::cmds = {};
+
+ADD_MODULE(SplitSource, "split_source", "feeds RunSplit()")
+
+// Counts packets but never touches them, so fake packets can be used
+class SplitSink final : public Module {
+ public:
+  static const gate_idx_t kNumIGates = 1;
+  static const gate_idx_t kNumOGates = 0;
+
+  static const Commands cmds;
+
+  CommandResponse Init(const bess::pb::EmptyArg &) { return CommandResponse(); }
+
+  void ProcessBatch(bess::PacketBatch *batch) override {
+    received += batch->cnt();
+  }
+
+  uint64_t received = {};
+};
+
+const Commands SplitSink::cmds = {};
+
+ADD_MODULE(SplitSink, "split_sink", "counts packets from RunSplit()")
+
+Module *CreateModule(const std::string &class_name) {
+  const ModuleBuilder &builder =
+      ModuleBuilder::all_module_builders().find(class_name)->second;
+  bess::pb::EmptyArg arg_;
+  google::protobuf::Any arg;
+  arg.PackFrom(arg_);
+  pb_error_t perr;
+
+  return ModuleGraph::CreateModule(
+      builder, ModuleGraph::GenerateDefaultName(builder.class_name(),
+                                                builder.name_template()),
+      arg, &perr);
+}
+
+// Args: the number of distinct ogates in a batch of kMaxBurst packets
+class RunSplitFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    const int num_gates = state.range(0);
+
+    src_ = CreateModule("SplitSource");
+    for (int i = 0; i < num_gates; i++) {
+      Module *sink = CreateModule("SplitSink");
+      CHECK_EQ(src_->ConnectModules(i, sink, 0), 0);
+    }
+
+    // Gates are assigned round-robin, the worst case for grouping
+    for (size_t i = 0; i < bess::PacketBatch::kMaxBurst; i++) {
+      ogates_[i] = i % num_gates;
+      pkts_[i] = reinterpret_cast<bess::Packet *>(uintptr_t(i + 1) * 64);
+    }
+  }
+
+  void TearDown(benchmark::State &) override {
+    ModuleGraph::DestroyAllModules();
+  }
+
+ protected:
+  Module *src_;
+  gate_idx_t ogates_[bess::PacketBatch::kMaxBurst];
+  bess::Packet *pkts_[bess::PacketBatch::kMaxBurst];
+};
+
+BENCHMARK_DEFINE_F(RunSplitFixture, BmRunSplit)(benchmark::State &state) {
+  const int cnt = bess::PacketBatch::kMaxBurst;
+  bess::PacketBatch batch;
+
+  while (state.KeepRunning()) {
+    batch.clear();
+    for (int i = 0; i < cnt; i++) {
+      batch.add(pkts_[i]);
+    }
+    src_->RunSplit(ogates_, &batch);
+  }
+
+  state.SetItemsProcessed(state.iterations() * cnt);
+}
+
+BENCHMARK_REGISTER_F(RunSplitFixture, BmRunSplit)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(bess::PacketBatch::kMaxBurst);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -33,6 +33,7 @@
 #include <glog/logging.h>
 
 #include "module.h"
+#include "worker.h"
 
 std::map<std::string, Module *> ModuleGraph::all_modules_;
 std::unordered_map<std::string, Node> ModuleGraph::module_graph_;
@@ -128,6 +129,30 @@ bool ModuleGraph::RemoveEdge(const std::string &from, const std::string &to) {
   return UpdateTaskGraph();
 }
 
+void ModuleGraph::UpdateFusedGates(Module *m) {
+  if (!is_any_worker_running()) {
+    m->fused_gates_.assign(m->ogates_.size(), Module::FusedGate());
+  } else {
+    // Workers are running, but none of them can reach `m` (e.g., a module
+    // being staged for SwapGate), so its table may grow. The entries of a
+    // module in use must go through RedirectModules() instead.
+    DCHECK_EQ(m->num_active_workers(), 0);
+    if (m->fused_gates_.size() < m->ogates_.size()) {
+      m->fused_gates_.resize(m->ogates_.size(), Module::FusedGate());
+    }
+  }
+
+  for (size_t i = 0; i < m->ogates_.size(); i++) {
+    m->UpdateFusedGate(i);
+  }
+}
+
+void ModuleGraph::UpdateFusedGates() {
+  for (auto &pair : all_modules_) {
+    UpdateFusedGates(pair.second);
+  }
+}
+
 // Creates a module to the graph.
 Module *ModuleGraph::CreateModule(const ModuleBuilder &builder,
                                   const std::string &module_name,
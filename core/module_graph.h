@@ -98,6 +98,15 @@ class ModuleGraph {
   // Disconnects two modules (`to` and `from`) together in `module_graph_`.
   static bool RemoveEdge(const std::string &from, const std::string &to);
 
+  // Recomputes the direct dispatch table of `m` for RunChooseModule(). Must be
+  // called whenever an ogate of `m`, its hooks, or the hooks of the igate it
+  // connects to, change. Workers must be paused, or not run `m` at all: the
+  // table may be reallocated.
+  static void UpdateFusedGates(Module *m);
+
+  // Same as above, for all modules
+  static void UpdateFusedGates();
+
  private:
   // Updates the parents of modules with tasks by traversing `module_graph_` and
   // ignoring all modules that are not tasks.
@@ -35,6 +35,9 @@
 
 #include <gtest/gtest.h>
 
+#include "gate_hooks/track.h"
+#include "packet_test_util.h"
+
 namespace {
 
 // Mocking out misc things  ------------------------------------------------
@@ -55,7 +58,19 @@ class AcmeModule : public Module {
     return CommandResponse();
   }
 
+  void ProcessBatch(bess::PacketBatch *batch) override {
+    last_batch = batch;
+    num_batches++;
+    received.insert(received.end(), batch->pkts(),
+                    batch->pkts() + batch->cnt());
+  }
+
+  void set_writes_payload(bool writes) { writes_payload_ = writes; }
+
   int n = {};
+  int num_batches = {};
+  bess::PacketBatch *last_batch = {};
+  std::vector<bess::Packet *> received;
 };
 
 const Commands AcmeModule::cmds = {{"foo", "EmptyArg",
@@ -80,6 +95,19 @@ class AcmeModuleWithTask : public Module {
 
 DEF_MODULE(AcmeModuleWithTask, "acme_module_with_task", "foo bar");
 
+class CountingHook final : public bess::GateHook {
+ public:
+  CountingHook() : bess::GateHook(kName) {}
+
+  void ProcessBatch(const bess::PacketBatch *) override { n++; }
+
+  static const std::string kName;
+
+  int n = {};
+};
+
+const std::string CountingHook::kName = "counting";
+
 // Simple harness for testing the Module class.
 class ModuleTester : public ::testing::Test {
  protected:
@@ -264,6 +292,179 @@ TEST_F(ModuleTester, ResetModules) {
   EXPECT_EQ(0, ModuleGraph::GetAllModules().size());
 }
 
+// RunSplit() should deliver one batch per distinct ogate, keeping the
+// relative order of packets, and be reusable back to back.
+TEST_F(ModuleTester, RunSplit) {
+  pb_error_t perr;
+  Module *m0, *m1, *m2;
+
+  ASSERT_NE(nullptr, m0 = create_acme("m0", &perr));
+  ASSERT_NE(nullptr, m1 = create_acme("m1", &perr));
+  ASSERT_NE(nullptr, m2 = create_acme("m2", &perr));
+  ASSERT_EQ(0, m0->ConnectModules(0, m1, 0));
+  ASSERT_EQ(0, m0->ConnectModules(1, m2, 0));
+
+  AcmeModule *a1 = static_cast<AcmeModule *>(m1);
+  AcmeModule *a2 = static_cast<AcmeModule *>(m2);
+
+  const int cnt = bess::PacketBatch::kMaxBurst;
+  bess::PacketBatch batch;
+  gate_idx_t ogates[bess::PacketBatch::kMaxBurst];
+  std::vector<bess::Packet *> expected[2];
+
+  batch.clear();
+  for (int i = 0; i < cnt; i++) {
+    // Fake packets; they are never dereferenced.
+    auto *pkt = reinterpret_cast<bess::Packet *>(uintptr_t(i + 1) * 64);
+    ogates[i] = (i % 3 == 0) ? 1 : 0;
+    batch.add(pkt);
+    expected[ogates[i]].push_back(pkt);
+  }
+
+  for (int round = 1; round <= 2; round++) {
+    m0->RunSplit(ogates, &batch);
+    EXPECT_EQ(round, a1->num_batches);
+    EXPECT_EQ(round, a2->num_batches);
+  }
+
+  for (auto &e : expected) {
+    std::vector<bess::Packet *> once = e;
+    e.insert(e.end(), once.begin(), once.end());
+  }
+  EXPECT_EQ(expected[0], a1->received);
+  EXPECT_EQ(expected[1], a2->received);
+}
+
+// A batch whose packets all go to the same ogate is passed on as it is.
+TEST_F(ModuleTester, RunSplitUniform) {
+  pb_error_t perr;
+  Module *m0, *m1, *m2;
+
+  ASSERT_NE(nullptr, m0 = create_acme("m0", &perr));
+  ASSERT_NE(nullptr, m1 = create_acme("m1", &perr));
+  ASSERT_NE(nullptr, m2 = create_acme("m2", &perr));
+  ASSERT_EQ(0, m0->ConnectModules(0, m1, 0));
+  ASSERT_EQ(0, m0->ConnectModules(1, m2, 0));
+
+  AcmeModule *a1 = static_cast<AcmeModule *>(m1);
+  AcmeModule *a2 = static_cast<AcmeModule *>(m2);
+
+  const int cnt = bess::PacketBatch::kMaxBurst;
+  bess::PacketBatch batch;
+  gate_idx_t ogates[bess::PacketBatch::kMaxBurst];
+
+  batch.clear();
+  for (int i = 0; i < cnt; i++) {
+    batch.add(reinterpret_cast<bess::Packet *>(uintptr_t(i + 1) * 64));
+    ogates[i] = 1;
+  }
+
+  m0->RunSplit(ogates, &batch);
+  EXPECT_EQ(0, a1->num_batches);
+  EXPECT_EQ(1, a2->num_batches);
+  EXPECT_EQ(&batch, a2->last_batch);
+  EXPECT_EQ(cnt, a2->received.size());
+
+  // the last packet differs: no longer uniform
+  ogates[cnt - 1] = 0;
+  m0->RunSplit(ogates, &batch);
+  EXPECT_EQ(1, a1->num_batches);
+  EXPECT_EQ(2, a2->num_batches);
+  EXPECT_NE(&batch, a2->last_batch);
+  EXPECT_EQ(2 * cnt - 1, a2->received.size());
+}
+
+// Gate hooks must run whether or not RunChooseModule() can use the fused
+// dispatch for the gate.
+TEST_F(ModuleTester, RunChooseModuleHooks) {
+  pb_error_t perr;
+  Module *m0, *m1;
+
+  ASSERT_NE(nullptr, m0 = create_acme("m0", &perr));
+  ASSERT_NE(nullptr, m1 = create_acme("m1", &perr));
+  ASSERT_EQ(0, m0->ConnectModules(0, m1, 0));
+
+  AcmeModule *a1 = static_cast<AcmeModule *>(m1);
+  ASSERT_EQ(1, m0->ogates()[0]->hooks().size());
+  Track *track = static_cast<Track *>(m0->ogates()[0]->hooks()[0]);
+
+  bess::PacketBatch batch;
+  batch.clear();
+  batch.add(reinterpret_cast<bess::Packet *>(uintptr_t(64)));
+
+  // the default Track hook only
+  m0->RunChooseModule(0, &batch);
+  EXPECT_EQ(1, a1->num_batches);
+  EXPECT_EQ(1, track->cnt());
+
+  // an igate hook as well
+  CountingHook *hook = new CountingHook();
+  ASSERT_EQ(0, m1->igates()[0]->AddHook(hook));
+  ModuleGraph::UpdateFusedGates(m0);
+  m0->RunChooseModule(0, &batch);
+  EXPECT_EQ(2, a1->num_batches);
+  EXPECT_EQ(2, track->cnt());
+  EXPECT_EQ(1, hook->n);
+
+  m1->igates()[0]->RemoveHook(CountingHook::kName);
+  ModuleGraph::UpdateFusedGates(m0);
+  m0->RunChooseModule(0, &batch);
+  EXPECT_EQ(3, a1->num_batches);
+  EXPECT_EQ(3, track->cnt());
+}
+
+// Shared packets must be copied before they reach a module that writes them
+TEST_F(ModuleTester, RunChooseModuleUnshare) {
+  const char data[] = "some packet data";
+  struct rte_mempool *pool = bess::TestPacketPool();
+  const unsigned avail = rte_mempool_avail_count(pool);
+  pb_error_t perr;
+  Module *m0, *m1;
+
+  ASSERT_NE(nullptr, m0 = create_acme("m0", &perr));
+  ASSERT_NE(nullptr, m1 = create_acme("m1", &perr));
+  ASSERT_EQ(0, m0->ConnectModules(0, m1, 0));
+  AcmeModule *a1 = static_cast<AcmeModule *>(m1);
+
+  bess::Packet *priv = bess::AllocTestPacket(data, sizeof(data));
+  bess::Packet *src = bess::AllocTestPacket(data, sizeof(data));
+  ASSERT_NE(nullptr, priv);
+  ASSERT_NE(nullptr, src);
+  bess::Packet *clone = bess::Packet::clone(src);
+  ASSERT_NE(nullptr, clone);
+
+  bess::PacketBatch batch;
+  batch.clear();
+  batch.add(priv);
+  batch.add(src);
+  batch.add(clone);
+
+  // A module that does not write gets the shared packets as they are
+  m0->RunChooseModule(0, &batch);
+  ASSERT_EQ(3, a1->received.size());
+  EXPECT_EQ(priv, a1->received[0]);
+  EXPECT_EQ(src, a1->received[1]);
+  EXPECT_EQ(clone, a1->received[2]);
+
+  a1->received.clear();
+  a1->set_writes_payload(true);
+  m0->RunChooseModule(0, &batch);
+
+  // The private packet is left alone, and both references to the shared
+  // buffer are replaced with copies (and freed)
+  ASSERT_EQ(3, a1->received.size());
+  EXPECT_EQ(priv, a1->received[0]);
+  for (bess::Packet *pkt : a1->received) {
+    EXPECT_FALSE(pkt->is_shared());
+    ASSERT_EQ(sizeof(data), pkt->total_len());
+    EXPECT_EQ(0, memcmp(data, pkt->head_data(), sizeof(data)));
+  }
+  EXPECT_NE(a1->received[1]->head_data(), a1->received[2]->head_data());
+
+  bess::Packet::Free(a1->received.data(), a1->received.size());
+  EXPECT_EQ(avail, rte_mempool_avail_count(pool));
+}
+
 TEST(ModuleBuilderTest, GenerateDefaultNameTemplate) {
   std::string name1 = ModuleGraph::GenerateDefaultName("FooBar", "foo");
   EXPECT_EQ("foo0", name1);
@@ -32,14 +32,27 @@
 #include "../utils/ether.h"
 #include "../utils/ip.h"
 #include "../utils/udp.h"
+#include "parse_headers.h"
 
 const Commands ACL::cmds = {
     {"add", "ACLArg", MODULE_CMD_FUNC(&ACL::CommandAdd),
-     Command::Command::THREAD_UNSAFE},
+     Command::Command::THREAD_SAFE},
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&ACL::CommandClear),
-     Command::Command::THREAD_UNSAFE}};
+     Command::Command::THREAD_SAFE}};
 
 CommandResponse ACL::Init(const bess::pb::ACLArg &arg) {
+  headers_attr_id_ =
+      ParseHeaders::AddAttr(this, bess::metadata::Attribute::AccessMode::kRead);
+  if (headers_attr_id_ < 0) {
+    return CommandFailure(-headers_attr_id_,
+                          "Failed to register metadata attribute");
+  }
+
+  return CommandAdd(arg);
+}
+
+CommandResponse ACL::CommandAdd(const bess::pb::ACLArg &arg) {
+  std::vector<ACLRule> new_rules;
   for (const auto &rule : arg.rules()) {
     ACLRule new_rule = {
         .src_ip = Ipv4Prefix(rule.src_ip()),
@@ -47,42 +60,58 @@ CommandResponse ACL::Init(const bess::pb::ACLArg &arg) {
         .src_port = be16_t(static_cast<uint16_t>(rule.src_port())),
         .dst_port = be16_t(static_cast<uint16_t>(rule.dst_port())),
         .drop = rule.drop()};
-    rules_.push_back(new_rule);
+    new_rules.push_back(new_rule);
   }
-  return CommandSuccess();
-}
 
-CommandResponse ACL::CommandAdd(const bess::pb::ACLArg &arg) {
-  Init(arg);
+  rules_.Update([&](std::vector<ACLRule> &rules) {
+    rules.insert(rules.end(), new_rules.begin(), new_rules.end());
+    return 0;
+  });
   return CommandSuccess();
 }
 
 CommandResponse ACL::CommandClear(const bess::pb::EmptyArg &) {
-  rules_.clear();
+  rules_.Update([](std::vector<ACLRule> &rules) {
+    rules.clear();
+    return 0;
+  });
   return CommandSuccess();
 }
 
 void ACL::ProcessBatch(bess::PacketBatch *batch) {
   using bess::utils::Ethernet;
   using bess::utils::Ipv4;
+  using bess::utils::ParsedHeaders;
   using bess::utils::Udp;
 
   gate_idx_t out_gates[bess::PacketBatch::kMaxBurst];
   gate_idx_t incoming_gate = get_igate();
+  const std::vector<ACLRule> &rules = rules_.Get();
+  bess::metadata::mt_offset_t headers_offset = attr_offset(headers_attr_id_);
+  bool parsed = bess::metadata::IsValidOffset(headers_offset);
 
   int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
-    Ethernet *eth = pkt->head_data<Ethernet *>();
-    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
-    size_t ip_bytes = ip->header_length << 2;
-    Udp *udp =
-        reinterpret_cast<Udp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
+    Ipv4 *ip;
+    Udp *udp;
+    const ParsedHeaders *h =
+        parsed ? _ptr_attr_with_offset<ParsedHeaders>(headers_offset, pkt)
+               : nullptr;
+    if (h && h->l4_offset) {
+      ip = pkt->head_data<Ipv4 *>(h->l3_offset);
+      udp = pkt->head_data<Udp *>(h->l4_offset);
+    } else {
+      Ethernet *eth = pkt->head_data<Ethernet *>();
+      ip = reinterpret_cast<Ipv4 *>(eth + 1);
+      size_t ip_bytes = ip->header_length << 2;
+      udp = reinterpret_cast<Udp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
+    }
 
     out_gates[i] = DROP_GATE;  // By default, drop unmatched packets
 
-    for (const auto &rule : rules_) {
+    for (const auto &rule : rules) {
       if (rule.Match(ip->src, ip->dst, udp->src_port, udp->dst_port)) {
         if (!rule.drop) {
           out_gates[i] = incoming_gate;
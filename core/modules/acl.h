@@ -34,6 +34,7 @@
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../rcu.h"
 #include "../utils/ip.h"
 
 using bess::utils::be16_t;
@@ -58,7 +59,9 @@ class ACL final : public Module {
 
   static const Commands cmds;
 
-  ACL() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  ACL() : Module(), headers_attr_id_() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
 
   CommandResponse Init(const bess::pb::ACLArg &arg);
 
@@ -68,7 +71,10 @@ class ACL final : public Module {
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
 
  private:
-  std::vector<ACLRule> rules_;
+  // Updated without pausing workers, see bess::RcuDoubleBuffer
+  bess::RcuDoubleBuffer<std::vector<ACLRule>> rules_;
+
+  int headers_attr_id_;  // ParseHeaders::kAttrName
 };
 
 #endif  // BESS_MODULES_ACL_H_
@@ -54,6 +54,8 @@ struct arp_entry {
 // Currently drops non ARP packets
 class ArpResponder final : public Module {
  public:
+  ArpResponder() : Module() { writes_payload_ = true; }
+
   static const gate_idx_t kNumIGates = 1;
   static const gate_idx_t kNumOGates = 1;
 
@@ -36,7 +36,10 @@
 
 class EtherEncap final : public Module {
  public:
-  EtherEncap() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  EtherEncap() : Module() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
+  }
 
   CommandResponse Init(const bess::pb::EtherEncapArg &arg);
 
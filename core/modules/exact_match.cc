@@ -30,11 +30,13 @@
 
 #include "exact_match.h"
 
+#include <cstring>
 #include <string>
 #include <vector>
 
 #include "../utils/endian.h"
 #include "../utils/format.h"
+#include "../utils/time.h"
 
 // XXX: this is repeated in many modules. get rid of them when converting .h to
 // .hh, etc... it's in defined in some old header
@@ -50,13 +52,15 @@ const Commands ExactMatch::cmds = {
      Command::THREAD_SAFE},
     {"set_runtime_config", "ExactMatchConfig",
      MODULE_CMD_FUNC(&ExactMatch::SetRuntimeConfig),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
     {"add", "ExactMatchCommandAddArg", MODULE_CMD_FUNC(&ExactMatch::CommandAdd),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
+    {"add_bulk", "ExactMatchCommandAddBulkArg",
+     MODULE_CMD_FUNC(&ExactMatch::CommandAddBulk), Command::THREAD_SAFE},
     {"delete", "ExactMatchCommandDeleteArg",
-     MODULE_CMD_FUNC(&ExactMatch::CommandDelete), Command::THREAD_UNSAFE},
+     MODULE_CMD_FUNC(&ExactMatch::CommandDelete), Command::THREAD_SAFE},
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&ExactMatch::CommandClear),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
     {"set_default_gate", "ExactMatchCommandSetDefaultGateArg",
      MODULE_CMD_FUNC(&ExactMatch::CommandSetDefaultGate),
      Command::THREAD_SAFE}};
@@ -75,12 +79,12 @@ CommandResponse ExactMatch::AddFieldOne(const bess::pb::Field &field,
 
   Error ret;
   if (field.position_case() == bess::pb::Field::kAttrName) {
-    ret = table_.AddField(this, field.attr_name(), size, mask64, idx);
+    ret = table_.at(0).AddField(this, field.attr_name(), size, mask64, idx);
     if (ret.first) {
       return CommandFailure(ret.first, "%s", ret.second.c_str());
     }
   } else if (field.position_case() == bess::pb::Field::kOffset) {
-    ret = table_.AddField(field.offset(), size, mask64, idx);
+    ret = table_.at(0).AddField(field.offset(), size, mask64, idx);
     if (ret.first) {
       return CommandFailure(ret.first, "%s", ret.second.c_str());
     }
@@ -115,6 +119,10 @@ CommandResponse ExactMatch::Init(const bess::pb::ExactMatchArg &arg) {
     }
   }
 
+  // Fields are set up on the first copy only, so that metadata attributes
+  // are registered once.
+  table_.at(1).CopyFields(table_.at(0));
+
   default_gate_ = DROP_GATE;
 
   return CommandSuccess();
@@ -123,9 +131,10 @@ CommandResponse ExactMatch::Init(const bess::pb::ExactMatchArg &arg) {
 // Retrieves an ExactMatchArg that would reconstruct this module.
 CommandResponse ExactMatch::GetInitialArg(const bess::pb::EmptyArg &) {
   bess::pb::ExactMatchArg r;
+  const auto &table = table_.Get();
 
-  for (size_t i = 0; i < table_.num_fields(); i++) {
-    const ExactMatchField &f = table_.get_field(i);
+  for (size_t i = 0; i < table.num_fields(); i++) {
+    const ExactMatchField &f = table.get_field(i);
     bess::pb::Field *ret_field = r.add_fields();
     if (f.attr_id >= 0) {
       ret_field->set_attr_name(all_attrs().at(f.attr_id).name);
@@ -152,16 +161,17 @@ CommandResponse ExactMatch::GetInitialArg(const bess::pb::EmptyArg &) {
 CommandResponse ExactMatch::GetRuntimeConfig(const bess::pb::EmptyArg &) {
   bess::pb::ExactMatchConfig r;
   using rule_t = bess::pb::ExactMatchCommandAddArg;
+  auto &table = table_.standby();
 
   r.set_default_gate(default_gate_);
-  for (auto const &kv : table_) {
+  for (auto const &kv : table) {
     auto const &key = kv.first;
     auto const &value = kv.second;
     rule_t *rule = r.add_rules();
 
     rule->set_gate(value);
-    for (size_t i = 0; i < table_.num_fields(); i++) {
-      const ExactMatchField &f = table_.get_field(i);
+    for (size_t i = 0; i < table.num_fields(); i++) {
+      const ExactMatchField &f = table.get_field(i);
       bess::pb::FieldData *field = rule->add_fields();
 
       // See GetInitialArg above for why we only set_value_bin here.
@@ -170,13 +180,13 @@ CommandResponse ExactMatch::GetRuntimeConfig(const bess::pb::EmptyArg &) {
     }
   }
   std::sort(r.mutable_rules()->begin(), r.mutable_rules()->end(),
-            [this](const rule_t &a, const rule_t &b){
+            [&table](const rule_t &a, const rule_t &b){
               // Primary sort key is gate number.
               if (a.gate() != b.gate()) {
                 return a.gate() < b.gate();
               }
               // After that, sort by value-to-be-matched, in field order.
-              for (size_t i = 0; i < table_.num_fields(); i++) {
+              for (size_t i = 0; i < table.num_fields(); i++) {
                 if (a.fields(i).value_bin() != b.fields(i).value_bin()) {
                   return a.fields(i).value_bin() < b.fields(i).value_bin();
                 }
@@ -188,8 +198,8 @@ CommandResponse ExactMatch::GetRuntimeConfig(const bess::pb::EmptyArg &) {
   return CommandSuccess(r);
 }
 
-Error ExactMatch::AddRule(
-    const bess::pb::ExactMatchCommandAddArg &arg) {
+Error ExactMatch::AddRule(ExactMatchTable<gate_idx_t> *table,
+                          const bess::pb::ExactMatchCommandAddArg &arg) {
   gate_idx_t gate = arg.gate();
 
   if (!is_valid_gate(gate)) {
@@ -204,7 +214,7 @@ Error ExactMatch::AddRule(
   ExactMatchRuleFields rule;
   RuleFieldsFromPb(arg.fields(), &rule);
 
-  return table_.AddRule(gate, rule);
+  return table->AddRule(gate, rule);
 }
 
 // Uses an ExactMatchConfig to restore this module's runtime config.
@@ -213,13 +223,20 @@ Error ExactMatch::AddRule(
 CommandResponse ExactMatch::SetRuntimeConfig(
     const bess::pb::ExactMatchConfig &arg) {
   default_gate_ = arg.default_gate();
-  table_.ClearRules();
 
-  for (auto i = 0; i < arg.rules_size(); i++) {
-    Error ret = AddRule(arg.rules(i));
-    if (ret.first) {
-      return CommandFailure(ret.first, "%s", ret.second.c_str());
+  Error ret = table_.Update([&](ExactMatchTable<gate_idx_t> &table) -> Error {
+    table.ClearRules();
+    for (auto i = 0; i < arg.rules_size(); i++) {
+      Error err = AddRule(&table, arg.rules(i));
+      if (err.first) {
+        return err;
+      }
     }
+    return Error(0, "");
+  });
+
+  if (ret.first) {
+    return CommandFailure(ret.first, "%s", ret.second.c_str());
   }
   return CommandSuccess();
 }
@@ -232,6 +249,7 @@ void ExactMatch::ProcessBatch(bess::PacketBatch *batch) {
   int cnt = batch->cnt();
 
   default_gate = ACCESS_ONCE(default_gate_);
+  const auto &table = table_.Get();
 
   const auto buffer_fn = [&](bess::Packet *pkt, const ExactMatchField &f) {
     int attr_id = f.attr_id;
@@ -240,22 +258,28 @@ void ExactMatch::ProcessBatch(bess::PacketBatch *batch) {
     }
     return pkt->head_data<uint8_t *>() + f.offset;
   };
-  table_.MakeKeys(batch, buffer_fn, keys);
-  table_.Find(keys, out_gates, cnt, default_gate);
+  table.MakeKeys(batch, buffer_fn, keys);
+  table.Find(keys, out_gates, cnt, default_gate);
 
   RunSplit(out_gates, batch);
 }
 
 std::string ExactMatch::GetDesc() const {
-  return bess::utils::Format("%zu fields, %zu rules", table_.num_fields(),
-                             table_.Size());
+  const auto &table = table_.Get();
+  return bess::utils::Format("%zu fields, %zu rules", table.num_fields(),
+                             table.Size());
+}
+
+void ExactMatch::MoveToSocket(int socket) {
+  table_.at(0).MoveToSocket(socket);
+  table_.at(1).MoveToSocket(socket);
 }
 
 void ExactMatch::RuleFieldsFromPb(
     const RepeatedPtrField<bess::pb::FieldData> &fields,
     bess::utils::ExactMatchRuleFields *rule) {
   for (auto i = 0; i < fields.size(); i++) {
-    int field_size = table_.get_field(i).size;
+    int field_size = table_.Get().get_field(i).size;
 
     bess::pb::FieldData current = fields.Get(i);
 
@@ -275,7 +299,9 @@ void ExactMatch::RuleFieldsFromPb(
 
 CommandResponse ExactMatch::CommandAdd(
     const bess::pb::ExactMatchCommandAddArg &arg) {
-  Error ret = AddRule(arg);
+  Error ret = table_.Update([&](ExactMatchTable<gate_idx_t> &table) {
+    return AddRule(&table, arg);
+  });
   if (ret.first) {
     return CommandFailure(ret.first, "%s", ret.second.c_str());
   }
@@ -283,6 +309,114 @@ CommandResponse ExactMatch::CommandAdd(
   return CommandSuccess();
 }
 
+// Appends the rule in `arg` to `packed`, in the format described in
+// ExactMatchCommandAddBulkArg.
+Error ExactMatch::PackRule(const bess::pb::ExactMatchCommandAddArg &arg,
+                           std::string *packed) {
+  const auto &table = table_.Get();
+  gate_idx_t gate = arg.gate();
+
+  if (!is_valid_gate(gate)) {
+    return std::make_pair(EINVAL,
+                          bess::utils::Format("Invalid gate: %hu", gate));
+  }
+
+  if (static_cast<size_t>(arg.fields_size()) != table.num_fields()) {
+    return std::make_pair(
+        EINVAL, bess::utils::Format("rule should have %zu fields (has %d)",
+                                    table.num_fields(), arg.fields_size()));
+  }
+
+  ExactMatchRuleFields rule;
+  RuleFieldsFromPb(arg.fields(), &rule);
+
+  for (size_t i = 0; i < rule.size(); i++) {
+    if (rule[i].size() != static_cast<size_t>(table.get_field(i).size)) {
+      return std::make_pair(
+          EINVAL, bess::utils::Format("rule field %zu should have size %d "
+                                      "(has %zu)",
+                                      i, table.get_field(i).size,
+                                      rule[i].size()));
+    }
+    packed->append(rule[i].begin(), rule[i].end());
+  }
+
+  packed->append(reinterpret_cast<const char *>(&gate), sizeof(gate));
+  return std::make_pair(0, "");
+}
+
+CommandResponse ExactMatch::CommandAddBulk(
+    const bess::pb::ExactMatchCommandAddBulkArg &arg) {
+  double start = get_epoch_time();
+
+  size_t key_size = table_.Get().raw_key_size();
+  size_t rule_size = key_size + sizeof(gate_idx_t);
+
+  // All rules are packed and checked first, so that the table is updated
+  // only once, and in one go.
+  std::string packed = arg.packed_rules();
+
+  if (packed.size() % rule_size) {
+    return CommandFailure(EINVAL,
+                          "packed rules are %zu bytes, not a multiple of the "
+                          "rule size (%zu bytes)",
+                          packed.size(), rule_size);
+  }
+
+  for (size_t i = 0; i < packed.size(); i += rule_size) {
+    gate_idx_t gate;
+    memcpy(&gate, &packed[i + key_size], sizeof(gate));  // little endian
+    if (!is_valid_gate(gate)) {
+      return CommandFailure(EINVAL, "packed rule %zu: invalid gate: %hu",
+                            i / rule_size, gate);
+    }
+  }
+
+  for (int i = 0; i < arg.rules_size(); i++) {
+    Error ret = PackRule(arg.rules(i), &packed);
+    if (ret.first) {
+      return CommandFailure(ret.first, "rule %d: %s", i, ret.second.c_str());
+    }
+  }
+
+  size_t num_rules = packed.size() / rule_size;
+
+  // The table is updated the same way in both copies, so a rule that does not
+  // fit fails in both, after the same rules before it.
+  size_t failed_rule = 0;
+  Error ret = table_.Update([&](ExactMatchTable<gate_idx_t> &table) -> Error {
+    if (arg.replace()) {
+      table.ClearRules();
+    }
+    table.Reserve(table.Size() + num_rules);
+
+    for (size_t i = 0; i < packed.size(); i += rule_size) {
+      gate_idx_t gate;
+      memcpy(&gate, &packed[i + key_size], sizeof(gate));
+      Error err = table.AddRawRule(gate, &packed[i]);
+      if (err.first) {
+        failed_rule = i / rule_size;
+        return err;
+      }
+    }
+    return Error(0, "");
+  });
+
+  if (ret.first) {
+    return CommandFailure(ret.first, "rule %zu: %s (only the %zu rules before "
+                          "it were added)",
+                          failed_rule, ret.second.c_str(), failed_rule);
+  }
+
+  double elapsed = get_epoch_time() - start;
+
+  bess::pb::ExactMatchCommandAddBulkResponse r;
+  r.set_rules(num_rules);
+  r.set_elapsed_sec(elapsed);
+  r.set_rules_per_sec(elapsed > 0 ? num_rules / elapsed : 0);
+  return CommandSuccess(r);
+}
+
 CommandResponse ExactMatch::CommandDelete(
     const bess::pb::ExactMatchCommandDeleteArg &arg) {
   CommandResponse err;
@@ -294,7 +428,9 @@ CommandResponse ExactMatch::CommandDelete(
   ExactMatchRuleFields rule;
   RuleFieldsFromPb(arg.fields(), &rule);
 
-  Error ret = table_.DeleteRule(rule);
+  Error ret = table_.Update([&](ExactMatchTable<gate_idx_t> &table) {
+    return table.DeleteRule(rule);
+  });
   if (ret.first) {
     return CommandFailure(ret.first, "%s", ret.second.c_str());
   }
@@ -303,7 +439,10 @@ CommandResponse ExactMatch::CommandDelete(
 }
 
 CommandResponse ExactMatch::CommandClear(const bess::pb::EmptyArg &) {
-  table_.ClearRules();
+  table_.Update([](ExactMatchTable<gate_idx_t> &table) {
+    table.ClearRules();
+    return 0;
+  });
   return CommandSuccess();
 }
 
@@ -36,6 +36,7 @@
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../rcu.h"
 #include "../utils/exact_match_table.h"
 
 using google::protobuf::RepeatedPtrField;
@@ -59,11 +60,15 @@ class ExactMatch final : public Module {
 
   std::string GetDesc() const override;
 
+  void MoveToSocket(int socket) override;
+
   CommandResponse Init(const bess::pb::ExactMatchArg &arg);
   CommandResponse GetInitialArg(const bess::pb::EmptyArg &arg);
   CommandResponse GetRuntimeConfig(const bess::pb::EmptyArg &arg);
   CommandResponse SetRuntimeConfig(const bess::pb::ExactMatchConfig &arg);
   CommandResponse CommandAdd(const bess::pb::ExactMatchCommandAddArg &arg);
+  CommandResponse CommandAddBulk(
+      const bess::pb::ExactMatchCommandAddBulkArg &arg);
   CommandResponse CommandDelete(
       const bess::pb::ExactMatchCommandDeleteArg &arg);
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
@@ -75,12 +80,16 @@ class ExactMatch final : public Module {
                               const bess::pb::FieldData &mask, int idx);
   void RuleFieldsFromPb(const RepeatedPtrField<bess::pb::FieldData> &fields,
                         bess::utils::ExactMatchRuleFields *rule);
-  Error AddRule(const bess::pb::ExactMatchCommandAddArg &arg);
+  Error AddRule(ExactMatchTable<gate_idx_t> *table,
+                const bess::pb::ExactMatchCommandAddArg &arg);
+  Error PackRule(const bess::pb::ExactMatchCommandAddArg &arg,
+                 std::string *packed);
 
   gate_idx_t default_gate_;
   bool empty_masks_;		// mainly for GetInitialArg
 
-  ExactMatchTable<gate_idx_t> table_;
+  // Updated without pausing workers, see bess::RcuDoubleBuffer
+  bess::RcuDoubleBuffer<ExactMatchTable<gate_idx_t>> table_;
 };
 
 #endif  // BESS_MODULES_EXACTMATCH_H_
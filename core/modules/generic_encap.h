@@ -48,6 +48,7 @@ class GenericEncap final : public Module {
  public:
   GenericEncap() : Module(), encap_size_(), num_fields_(), fields_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
   }
 
   CommandResponse Init(const bess::pb::GenericEncapArg &arg);
@@ -32,6 +32,12 @@
 
 #include <rte_hash_crc.h>
 
+#include "parse_headers.h"
+
+using bess::utils::Ipv4;
+using bess::utils::ParsedHeaders;
+using bess::utils::be16_t;
+
 const enum LbMode DEFAULT_MODE = LB_L4;
 
 static inline uint32_t hash_64(uint64_t val, uint32_t init_val) {
@@ -61,6 +67,26 @@ static inline uint16_t hash_range(uint32_t hashval, uint16_t range) {
 #endif
 }
 
+/* The 5-tuple hash of an untagged IPv4 packet, read in place. Same as
+ * ParsedHeaders::hash, so that a flow goes to the same gate whether or not
+ * ParseHeaders has seen the packet. */
+static inline uint32_t hash_l4(const char *head) {
+  const int ip_offset = 14;
+  const Ipv4 *ip = reinterpret_cast<const Ipv4 *>(head + ip_offset);
+  uint8_t proto = ip->protocol;
+  uint32_t ports = 0;
+
+  /* only the first fragment has the L4 header */
+  if ((ip->fragment_offset & be16_t(0x1fff)) == be16_t(0) &&
+      (proto == Ipv4::Proto::kTcp || proto == Ipv4::Proto::kUdp ||
+       proto == Ipv4::Proto::kIcmp)) {
+    ports = *reinterpret_cast<const uint32_t *>(head + ip_offset +
+                                                (ip->header_length << 2));
+  }
+
+  return ParsedHeaders::FlowHash(ip->src, ip->dst, ports, proto);
+}
+
 static inline int is_valid_gate(gate_idx_t gate) {
   return (gate < MAX_GATES || gate == DROP_GATE);
 }
@@ -106,6 +132,13 @@ CommandResponse HashLB::CommandSetGates(
 CommandResponse HashLB::Init(const bess::pb::HashLBArg &arg) {
   mode_ = DEFAULT_MODE;
 
+  headers_attr_id_ =
+      ParseHeaders::AddAttr(this, bess::metadata::Attribute::AccessMode::kRead);
+  if (headers_attr_id_ < 0) {
+    return CommandFailure(-headers_attr_id_,
+                          "Failed to register metadata attribute");
+  }
+
   if (arg.gates_size() > MAX_HLB_GATES) {
     return CommandFailure(EINVAL, "no more than %d gates", MAX_HLB_GATES);
   }
@@ -147,15 +180,23 @@ void HashLB::LbL2(bess::PacketBatch *batch, gate_idx_t *out_gates) {
 }
 
 void HashLB::LbL3(bess::PacketBatch *batch, gate_idx_t *out_gates) {
-  /* assumes untagged packets */
+  /* assumes untagged packets, unless ParseHeaders says otherwise */
   const int ip_offset = 14;
+  bess::metadata::mt_offset_t headers_offset = attr_offset(headers_attr_id_);
+  bool parsed = bess::metadata::IsValidOffset(headers_offset);
 
   for (int i = 0; i < batch->cnt(); i++) {
     bess::Packet *snb = batch->pkts()[i];
     char *head = snb->head_data<char *>();
 
     uint32_t hash_val;
-    uint64_t v = *(reinterpret_cast<uint64_t *>(head + ip_offset + 12));
+    int offset = ip_offset;
+    if (parsed) {
+      const ParsedHeaders *h =
+          _ptr_attr_with_offset<ParsedHeaders>(headers_offset, snb);
+      offset = h->l3_offset ?: ip_offset;
+    }
+    uint64_t v = *(reinterpret_cast<uint64_t *>(head + offset + 12));
 
     hash_val = hash_64(v, 0);
 
@@ -164,21 +205,23 @@ void HashLB::LbL3(bess::PacketBatch *batch, gate_idx_t *out_gates) {
 }
 
 void HashLB::LbL4(bess::PacketBatch *batch, gate_idx_t *out_gates) {
-  /* assumes untagged packets without IP options */
-  const int ip_offset = 14;
-  const int l4_offset = ip_offset + 20;
+  bess::metadata::mt_offset_t headers_offset = attr_offset(headers_attr_id_);
+  bool parsed = bess::metadata::IsValidOffset(headers_offset);
 
   for (int i = 0; i < batch->cnt(); i++) {
     bess::Packet *snb = batch->pkts()[i];
-    char *head = snb->head_data<char *>();
-
     uint32_t hash_val;
-    uint64_t v0 = *(reinterpret_cast<uint64_t *>(head + ip_offset + 12));
-    uint32_t v1 = *(reinterpret_cast<uint64_t *>(head + l4_offset)); /* ports */
-
-    v1 ^= *(reinterpret_cast<uint32_t *>(head + ip_offset + 9)); /* ip_proto */
 
-    hash_val = hash_64(v0, v1);
+    /* ParseHeaders has already hashed IPv4 packets, even with VLAN tags.
+     * Others are hashed in place, as if they were untagged IPv4. */
+    const ParsedHeaders *h =
+        parsed ? _ptr_attr_with_offset<ParsedHeaders>(headers_offset, snb)
+               : nullptr;
+    if (h && h->l3_offset) {
+      hash_val = h->hash;
+    } else {
+      hash_val = hash_l4(snb->head_data<const char *>());
+    }
 
     out_gates[i] = gates_[hash_range(hash_val, num_gates_)];
   }
@@ -49,7 +49,7 @@ class HashLB final : public Module {
 
   static const Commands cmds;
 
-  HashLB() : Module(), gates_(), num_gates_(), mode_() {
+  HashLB() : Module(), gates_(), num_gates_(), mode_(), headers_attr_id_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -69,6 +69,8 @@ class HashLB final : public Module {
   gate_idx_t gates_[MAX_HLB_GATES];
   int num_gates_;
   enum LbMode mode_;
+
+  int headers_attr_id_;  // ParseHeaders::kAttrName
 };
 
 #endif  // BESS_MODULES_HASHLB_H_
@@ -37,7 +37,10 @@
 // Compute IP checksum on packet
 class IPChecksum final : public Module {
  public:
-  IPChecksum() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  IPChecksum() : Module() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
+  }
 
   void ProcessBatch(bess::PacketBatch *batch) override;
 };
@@ -36,7 +36,10 @@
 
 class IPEncap final : public Module {
  public:
-  IPEncap() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  IPEncap() : Module() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
+  }
 
   CommandResponse Init(const bess::pb::IPEncapArg &arg);
 
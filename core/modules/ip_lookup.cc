@@ -35,7 +35,9 @@
 #include <rte_lpm.h>
 
 #include "../utils/ether.h"
+#include "../utils/format.h"
 #include "../utils/ip.h"
+#include "parse_headers.h"
 
 #define VECTOR_OPTIMIZATION 1
 
@@ -148,11 +150,18 @@ static inline int is_valid_gate(gate_idx_t gate) {
 
 const Commands IPLookup::cmds = {
     {"add", "IPLookupCommandAddArg", MODULE_CMD_FUNC(&IPLookup::CommandAdd),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&IPLookup::CommandClear),
-     Command::THREAD_UNSAFE}};
+     Command::THREAD_SAFE}};
 
 CommandResponse IPLookup::Init(const bess::pb::IPLookupArg &arg) {
+  headers_attr_id_ =
+      ParseHeaders::AddAttr(this, bess::metadata::Attribute::AccessMode::kRead);
+  if (headers_attr_id_ < 0) {
+    return CommandFailure(-headers_attr_id_,
+                          "Failed to register metadata attribute");
+  }
+
   struct rte_lpm_config conf = {
       .max_rules = arg.max_rules() ? arg.max_rules() : 1024,
       .number_tbl8s = arg.max_tbl8s() ? arg.max_tbl8s() : 128,
@@ -161,27 +170,104 @@ CommandResponse IPLookup::Init(const bess::pb::IPLookupArg &arg) {
 
   default_gate_ = DROP_GATE;
 
-  lpm_ = rte_lpm_create(name().c_str(), /* socket_id = */ 0, &conf);
+  // LPM tables need unique names
+  for (int i = 0; i < 2; i++) {
+    std::string lpm_name = i ? name() + "/1" : name();
+    lpm_.at(i) = rte_lpm_create(lpm_name.c_str(), /* socket_id = */ 0, &conf);
+    lpm_socket_[i] = 0;
 
-  if (!lpm_) {
-    return CommandFailure(rte_errno, "DPDK error: %s", rte_strerror(rte_errno));
+    if (!lpm_.at(i)) {
+      return CommandFailure(rte_errno, "DPDK error: %s",
+                            rte_strerror(rte_errno));
+    }
   }
 
   return CommandSuccess();
 }
 
 void IPLookup::DeInit() {
-  if (lpm_) {
-    rte_lpm_free(lpm_);
+  for (int i = 0; i < 2; i++) {
+    if (lpm_.at(i)) {
+      rte_lpm_free(lpm_.at(i));
+    }
+  }
+}
+
+// rte_lpm tables cannot be moved, so this builds a copy on `socket`, from the
+// rules that the table keeps (sorted by depth).
+static struct rte_lpm *copy_lpm(const struct rte_lpm *lpm,
+                                const std::string &name, int socket) {
+  struct rte_lpm_config conf = {
+      .max_rules = lpm->max_rules,
+      .number_tbl8s = lpm->number_tbl8s,
+      .flags = 0,
+  };
+
+  struct rte_lpm *copy = rte_lpm_create(name.c_str(), socket, &conf);
+  if (!copy) {
+    return nullptr;
+  }
+
+  for (int depth = 1; depth <= RTE_LPM_MAX_DEPTH; depth++) {
+    const struct rte_lpm_rule_info &info = lpm->rule_info[depth - 1];
+    for (uint32_t i = 0; i < info.used_rules; i++) {
+      const struct rte_lpm_rule &rule = lpm->rules_tbl[info.first_rule + i];
+      if (rte_lpm_add(copy, rule.ip, depth, rule.next_hop)) {
+        rte_lpm_free(copy);
+        return nullptr;
+      }
+    }
+  }
+
+  return copy;
+}
+
+void IPLookup::MoveToSocket(int socket) {
+  for (int i = 0; i < 2; i++) {
+    // Rebuilding takes a while, and the workers are paused meanwhile
+    if (lpm_socket_[i] == socket) {
+      continue;
+    }
+
+    // Names must be unique, and the old table still exists
+    std::string lpm_name = bess::utils::Format(
+        "%s%s@%d", name().c_str(), i ? "/1" : "", socket);
+    struct rte_lpm *lpm = copy_lpm(lpm_.at(i), lpm_name, socket);
+
+    if (!lpm) {
+      LOG(WARNING) << "Cannot move LPM table of " << name() << " to socket "
+                   << socket;
+      continue;
+    }
+
+    rte_lpm_free(lpm_.at(i));
+    lpm_.at(i) = lpm;
+    lpm_socket_[i] = socket;
   }
 }
 
 void IPLookup::ProcessBatch(bess::PacketBatch *batch) {
   using bess::utils::Ethernet;
   using bess::utils::Ipv4;
+  using bess::utils::ParsedHeaders;
 
   gate_idx_t out_gates[bess::PacketBatch::kMaxBurst];
   gate_idx_t default_gate = default_gate_;
+  struct rte_lpm *lpm = lpm_.Get();
+
+  // The IPv4 header follows the Ethernet header, unless an upstream
+  // ParseHeaders module found VLAN tags in between.
+  bess::metadata::mt_offset_t headers_offset = attr_offset(headers_attr_id_);
+  bool parsed = bess::metadata::IsValidOffset(headers_offset);
+  auto get_ip = [=](const bess::Packet *pkt) {
+    size_t offset = sizeof(Ethernet);
+    if (parsed) {
+      const ParsedHeaders *h =
+          _ptr_attr_with_offset<ParsedHeaders>(headers_offset, pkt);
+      offset = h->l3_offset ?: offset;
+    }
+    return pkt->head_data<const Ipv4 *>(offset);
+  };
 
   int cnt = batch->cnt();
   int i;
@@ -193,37 +279,33 @@ void IPLookup::ProcessBatch(bess::PacketBatch *batch) {
 
   /* 4 at a time */
   for (i = 0; i + 3 < cnt; i += 4) {
-    Ethernet *eth;
-    Ipv4 *ip;
+    const Ipv4 *ip;
 
     uint32_t a0, a1, a2, a3;
     uint32_t next_hops[4];
 
     __m128i ip_addr;
 
-    eth = batch->pkts()[i]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
+    ip = get_ip(batch->pkts()[i]);
     a0 = ip->dst.raw_value();
 
-    eth = batch->pkts()[i + 1]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
+    ip = get_ip(batch->pkts()[i + 1]);
     a1 = ip->dst.raw_value();
 
-    eth = batch->pkts()[i + 2]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
+    ip = get_ip(batch->pkts()[i + 2]);
     a2 = ip->dst.raw_value();
 
-    eth = batch->pkts()[i + 3]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
+    ip = get_ip(batch->pkts()[i + 3]);
     a3 = ip->dst.raw_value();
 
     ip_addr = _mm_set_epi32(a3, a2, a1, a0);
     ip_addr = _mm_shuffle_epi8(ip_addr, bswap_mask);
 
 #ifndef __OPTIMIZE__
-    lpm_lookupx4(lpm_, ip_addr, reinterpret_cast<uint64_t *>(next_hops), default_gate);
+    lpm_lookupx4(lpm, ip_addr, reinterpret_cast<uint64_t *>(next_hops),
+                 default_gate);
 #else
-    rte_lpm_lookupx4(lpm_, ip_addr, next_hops, default_gate);
+    rte_lpm_lookupx4(lpm, ip_addr, next_hops, default_gate);
 #endif
 
     out_gates[i + 0] = next_hops[0];
@@ -235,16 +317,14 @@ void IPLookup::ProcessBatch(bess::PacketBatch *batch) {
 
   /* process the rest one by one */
   for (; i < cnt; i++) {
-    Ethernet *eth;
-    Ipv4 *ip;
+    const Ipv4 *ip;
 
     uint32_t next_hop;
     int ret;
 
-    eth = batch->pkts()[i]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
+    ip = get_ip(batch->pkts()[i]);
 
-    ret = rte_lpm_lookup(lpm_, ip->dst.value(), &next_hop);
+    ret = rte_lpm_lookup(lpm, ip->dst.value(), &next_hop);
 
     if (ret == 0) {
       out_gates[i] = next_hop;
@@ -293,7 +373,9 @@ CommandResponse IPLookup::CommandAdd(
   if (prefix_len == 0) {
     default_gate_ = gate;
   } else {
-    int ret = rte_lpm_add(lpm_, net_addr.value(), prefix_len, gate);
+    int ret = lpm_.Update([&](struct rte_lpm *lpm) {
+      return rte_lpm_add(lpm, net_addr.value(), prefix_len, gate);
+    });
     if (ret) {
       return CommandFailure(-ret, "rpm_lpm_add() failed");
     }
@@ -303,7 +385,10 @@ CommandResponse IPLookup::CommandAdd(
 }
 
 CommandResponse IPLookup::CommandClear(const bess::pb::EmptyArg &) {
-  rte_lpm_delete_all(lpm_);
+  lpm_.Update([](struct rte_lpm *lpm) {
+    rte_lpm_delete_all(lpm);
+    return 0;
+  });
   return CommandSuccess();
 }
 
@@ -33,6 +33,7 @@
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../rcu.h"
 
 class IPLookup final : public Module {
  public:
@@ -40,7 +41,8 @@ class IPLookup final : public Module {
 
   static const Commands cmds;
 
-  IPLookup() : Module(), lpm_(), default_gate_() {
+  IPLookup()
+      : Module(), lpm_(), lpm_socket_(), default_gate_(), headers_attr_id_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -48,14 +50,20 @@ class IPLookup final : public Module {
 
   void DeInit() override;
 
+  void MoveToSocket(int socket) override;
+
   void ProcessBatch(bess::PacketBatch *batch) override;
 
   CommandResponse CommandAdd(const bess::pb::IPLookupCommandAddArg &arg);
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
 
  private:
-  struct rte_lpm *lpm_;
+  // Updated without pausing workers, see bess::RcuDoubleBuffer
+  bess::RcuDoubleBuffer<struct rte_lpm *> lpm_;
+  int lpm_socket_[2];  // The NUMA node of each copy of lpm_
   gate_idx_t default_gate_;
+
+  int headers_attr_id_;  // ParseHeaders::kAttrName
 };
 
 #endif  // BESS_MODULES_IPLOOKUP_H_
@@ -36,7 +36,10 @@
 // Swap source and destination IP addresses and UDP/TCP ports
 class IPSwap final : public Module {
  public:
-  IPSwap() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  IPSwap() : Module() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
+  }
 
   void ProcessBatch(bess::PacketBatch *batch) override;
 };
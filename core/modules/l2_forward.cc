@@ -70,8 +70,9 @@ static int l2_init(struct l2_table *l2tbl, int size, int bucket) {
     return -EINVAL;
   }
 
-  l2tbl->table = static_cast<l2_entry *>(mem_alloc_ex(
-      sizeof(struct l2_entry) * size * bucket, alignof(struct l2_entry), 0));
+  l2tbl->table = static_cast<l2_entry *>(
+      mem_alloc_pages(sizeof(struct l2_entry) * size * bucket,
+                      /* socket = */ -1));
   if (l2tbl->table == nullptr) {
     return -ENOMEM;
   }
@@ -102,7 +103,8 @@ static int l2_deinit(struct l2_table *l2tbl) {
   return 0;
 }
 
-static uint32_t l2_ib_to_offset(struct l2_table *l2tbl, int index, int bucket) {
+static uint32_t l2_ib_to_offset(const struct l2_table *l2tbl, int index,
+                                int bucket) {
   return index * l2tbl->bucket + bucket;
 }
 
@@ -160,7 +162,7 @@ static inline int find_index(uint64_t addr, uint64_t *table, const uint64_t) {
 #endif
 }
 
-static inline int l2_find(struct l2_table *l2tbl, uint64_t addr,
+static inline int l2_find(const struct l2_table *l2tbl, uint64_t addr,
                           gate_idx_t *gate) {
   size_t i;
   int ret = -ENOENT;
@@ -546,15 +548,15 @@ static int parse_mac_addr(const char *str, char *addr) {
 
 const Commands L2Forward::cmds = {
     {"add", "L2ForwardCommandAddArg", MODULE_CMD_FUNC(&L2Forward::CommandAdd),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
     {"delete", "L2ForwardCommandDeleteArg",
-     MODULE_CMD_FUNC(&L2Forward::CommandDelete), Command::THREAD_UNSAFE},
+     MODULE_CMD_FUNC(&L2Forward::CommandDelete), Command::THREAD_SAFE},
     {"set_default_gate", "L2ForwardCommandSetDefaultGateArg",
      MODULE_CMD_FUNC(&L2Forward::CommandSetDefaultGate), Command::THREAD_SAFE},
     {"lookup", "L2ForwardCommandLookupArg",
      MODULE_CMD_FUNC(&L2Forward::CommandLookup), Command::THREAD_SAFE},
     {"populate", "L2ForwardCommandPopulateArg",
-     MODULE_CMD_FUNC(&L2Forward::CommandPopulate), Command::THREAD_UNSAFE},
+     MODULE_CMD_FUNC(&L2Forward::CommandPopulate), Command::THREAD_SAFE},
 };
 
 CommandResponse L2Forward::Init(const bess::pb::L2ForwardArg &arg) {
@@ -571,7 +573,13 @@ CommandResponse L2Forward::Init(const bess::pb::L2ForwardArg &arg) {
     bucket = MAX_BUCKET_SIZE;
   }
 
-  ret = l2_init(&l2_table_, size, bucket);
+  ret = l2_init(&l2_table_.at(0), size, bucket);
+  if (ret == 0) {
+    ret = l2_init(&l2_table_.at(1), size, bucket);
+    if (ret != 0) {
+      l2_deinit(&l2_table_.at(0));
+    }
+  }
 
   if (ret != 0) {
     return CommandFailure(-ret,
@@ -584,12 +592,22 @@ CommandResponse L2Forward::Init(const bess::pb::L2ForwardArg &arg) {
 }
 
 void L2Forward::DeInit() {
-  l2_deinit(&l2_table_);
+  l2_deinit(&l2_table_.at(0));
+  l2_deinit(&l2_table_.at(1));
+}
+
+void L2Forward::MoveToSocket(int socket) {
+  for (int i = 0; i < 2; i++) {
+    if (l2_table_.at(i).table) {
+      mem_move(l2_table_.at(i).table, socket);
+    }
+  }
 }
 
 void L2Forward::ProcessBatch(bess::PacketBatch *batch) {
   gate_idx_t default_gate = ACCESS_ONCE(default_gate_);
   gate_idx_t out_gates[bess::PacketBatch::kMaxBurst];
+  const struct l2_table *l2tbl = &l2_table_.Get();
 
   for (int i = 0; i < batch->cnt(); i++) {
     bess::Packet *snb = batch->pkts()[i];
@@ -598,7 +616,7 @@ void L2Forward::ProcessBatch(bess::PacketBatch *batch) {
 
     // read destination MAC address (first 6 bytes)
     // NOTE: assumes little endian
-    l2_find(&l2_table_, *(snb->head_data<uint64_t *>()) & 0x0000ffffffffffff,
+    l2_find(l2tbl, *(snb->head_data<uint64_t *>()) & 0x0000ffffffffffff,
             &out_gates[i]);
   }
 
@@ -607,63 +625,70 @@ void L2Forward::ProcessBatch(bess::PacketBatch *batch) {
 
 CommandResponse L2Forward::CommandAdd(
     const bess::pb::L2ForwardCommandAddArg &arg) {
-  for (int i = 0; i < arg.entries_size(); i++) {
-    const auto &entry = arg.entries(i);
+  return l2_table_.Update([&](struct l2_table &l2tbl) -> CommandResponse {
+    for (int i = 0; i < arg.entries_size(); i++) {
+      const auto &entry = arg.entries(i);
 
-    if (!entry.addr().length()) {
-      return CommandFailure(EINVAL,
-                            "add list item map must contain addr as a string");
-    }
+      if (!entry.addr().length()) {
+        return CommandFailure(
+            EINVAL, "add list item map must contain addr as a string");
+      }
 
-    const char *str_addr = entry.addr().c_str();
-    int gate = entry.gate();
-    char addr[6];
+      const char *str_addr = entry.addr().c_str();
+      int gate = entry.gate();
+      char addr[6];
 
-    if (parse_mac_addr(str_addr, addr) != 0) {
-      return CommandFailure(EINVAL, "%s is not a proper mac address", str_addr);
-    }
+      if (parse_mac_addr(str_addr, addr) != 0) {
+        return CommandFailure(EINVAL, "%s is not a proper mac address",
+                              str_addr);
+      }
 
-    int r = l2_add_entry(&l2_table_, l2_addr_to_u64(addr), gate);
+      int r = l2_add_entry(&l2tbl, l2_addr_to_u64(addr), gate);
 
-    if (r == -EEXIST) {
-      return CommandFailure(EEXIST, "MAC address '%s' already exist", str_addr);
-    } else if (r == -ENOMEM) {
-      return CommandFailure(ENOMEM, "Not enough space");
-    } else if (r != 0) {
-      return CommandFailure(-r);
+      if (r == -EEXIST) {
+        return CommandFailure(EEXIST, "MAC address '%s' already exist",
+                              str_addr);
+      } else if (r == -ENOMEM) {
+        return CommandFailure(ENOMEM, "Not enough space");
+      } else if (r != 0) {
+        return CommandFailure(-r);
+      }
     }
-  }
 
-  return CommandSuccess();
+    return CommandSuccess();
+  });
 }
 
 CommandResponse L2Forward::CommandDelete(
     const bess::pb::L2ForwardCommandDeleteArg &arg) {
-  for (int i = 0; i < arg.addrs_size(); i++) {
-    const auto &_addr = arg.addrs(i);
+  return l2_table_.Update([&](struct l2_table &l2tbl) -> CommandResponse {
+    for (int i = 0; i < arg.addrs_size(); i++) {
+      const auto &_addr = arg.addrs(i);
 
-    if (!_addr.length()) {
-      return CommandFailure(EINVAL, "lookup must be list of string");
-    }
+      if (!_addr.length()) {
+        return CommandFailure(EINVAL, "lookup must be list of string");
+      }
 
-    const char *str_addr = _addr.c_str();
-    char addr[6];
+      const char *str_addr = _addr.c_str();
+      char addr[6];
 
-    if (parse_mac_addr(str_addr, addr) != 0) {
-      return CommandFailure(EINVAL, "%s is not a proper mac address", str_addr);
-    }
+      if (parse_mac_addr(str_addr, addr) != 0) {
+        return CommandFailure(EINVAL, "%s is not a proper mac address",
+                              str_addr);
+      }
 
-    int r = l2_del_entry(&l2_table_, l2_addr_to_u64(addr));
+      int r = l2_del_entry(&l2tbl, l2_addr_to_u64(addr));
 
-    if (r == -ENOENT) {
-      return CommandFailure(ENOENT, "MAC address '%s' does not exist",
-                            str_addr);
-    } else if (r != 0) {
-      return CommandFailure(EINVAL, "Unknown Error: %d\n", r);
+      if (r == -ENOENT) {
+        return CommandFailure(ENOENT, "MAC address '%s' does not exist",
+                              str_addr);
+      } else if (r != 0) {
+        return CommandFailure(EINVAL, "Unknown Error: %d\n", r);
+      }
     }
-  }
 
-  return CommandSuccess();
+    return CommandSuccess();
+  });
 }
 
 CommandResponse L2Forward::CommandSetDefaultGate(
@@ -690,7 +715,7 @@ CommandResponse L2Forward::CommandLookup(
     }
 
     gate_idx_t gate;
-    int r = l2_find(&l2_table_, l2_addr_to_u64(addr), &gate);
+    int r = l2_find(&l2_table_.Get(), l2_addr_to_u64(addr), &gate);
 
     if (r == -ENOENT) {
       return CommandFailure(ENOENT, "MAC address '%s' does not exist",
@@ -728,12 +753,16 @@ CommandResponse L2Forward::CommandPopulate(
   base_u64 = bess::utils::be64_t::swap(base_u64) >> 16;
   base_u64 = base_u64 >> 16;
 
-  for (int i = 0; i < cnt; i++) {
-    l2_add_entry(&l2_table_, bess::utils::be64_t::swap(base_u64 << 16),
-                 i % gate_cnt);
+  l2_table_.Update([&](struct l2_table &l2tbl) {
+    uint64_t addr = base_u64;
+    for (int i = 0; i < cnt; i++) {
+      l2_add_entry(&l2tbl, bess::utils::be64_t::swap(addr << 16),
+                   i % gate_cnt);
 
-    base_u64++;
-  }
+      addr++;
+    }
+    return 0;
+  });
 
   return CommandSuccess();
 }
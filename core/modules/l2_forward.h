@@ -33,6 +33,7 @@
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../rcu.h"
 
 #if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
 #error this code assumes little endian architecture (x86)
@@ -71,6 +72,8 @@ class L2Forward final : public Module {
 
   void DeInit() override;
 
+  void MoveToSocket(int socket) override;
+
   void ProcessBatch(bess::PacketBatch *batch) override;
 
   CommandResponse CommandAdd(const bess::pb::L2ForwardCommandAddArg &arg);
@@ -82,7 +85,8 @@ class L2Forward final : public Module {
       const bess::pb::L2ForwardCommandPopulateArg &arg);
 
  private:
-  struct l2_table l2_table_;
+  // Updated without pausing workers, see bess::RcuDoubleBuffer
+  bess::RcuDoubleBuffer<struct l2_table> l2_table_;
   gate_idx_t default_gate_;
 };
 
@@ -36,7 +36,10 @@
 // Compute L4 checksum on packet
 class L4Checksum final : public Module {
  public:
-  L4Checksum() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  L4Checksum() : Module() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
+  }
   void ProcessBatch(bess::PacketBatch *batch) override;
 };
 
@@ -1,8 +1,16 @@
 #include "lro.h"
 #include "../mem_alloc.h"
 #include "../utils/time.h"
+#include "parse_headers.h"
 
 CommandResponse LRO::Init(const bess::pb::EmptyArg &){
+  headers_attr_id_ =
+      ParseHeaders::AddAttr(this, bess::metadata::Attribute::AccessMode::kRead);
+  if (headers_attr_id_ < 0) {
+    return CommandFailure(-headers_attr_id_,
+                          "Failed to register metadata attribute");
+  }
+
   worker_flows = (lro_flow *)mem_alloc(sizeof(struct lro_flow) * MAX_LRO_FLOWS);
   assert(worker_flows);
 
@@ -13,6 +21,17 @@ CommandResponse LRO::Init(const bess::pb::EmptyArg &){
   return CommandSuccess();
 }
 
+// Each flow being merged holds one (possibly chained) packet.
+size_t LRO::NumBufferedPackets() const {
+  size_t cnt = 0;
+  for (int i = 0; i < MAX_LRO_FLOWS; i++) {
+    if (worker_flows[i].pkt) {
+      cnt++;
+    }
+  }
+  return cnt;
+}
+
 void LRO::ProcessBatch(bess::PacketBatch *batch) {
   bess::PacketBatch new_batch_object = bess::PacketBatch();
   bess::PacketBatch *new_batch = &new_batch_object;
@@ -183,26 +202,19 @@ void LRO::DoLro(bess::PacketBatch *batch, bess::Packet *pkt) {
   int i;
 
   /* skip checking whether packets are from physical intefaces and has correct csum */
-  Ethernet *eth = pkt->head_data<Ethernet *>();
-  void *data = eth + 1;
+  bess::utils::ParsedHeaders h =
+      ParseHeaders::Get(attr_offset(headers_attr_id_), pkt);
 
-  if (eth->ether_type != be16_t(Ethernet::Type::kIpv4)) {
-    BatchPush(batch, pkt);
-    return;
-  }
-
-  Ipv4 *iph = reinterpret_cast<Ipv4 *>(data);
-  size_t ip_bytes = (iph->header_length) << 2;
-  
-  if (iph->protocol != Ipv4::Proto::kTcp) {
+  if (h.ip_proto != Ipv4::Proto::kTcp || !h.l4_offset) {
     BatchPush(batch, pkt);
     return;
   }
 
-  Tcp *tcph = reinterpret_cast<Tcp *>(reinterpret_cast<uint8_t *>(iph) + ip_bytes);
+  Ipv4 *iph = pkt->head_data<Ipv4 *>(h.l3_offset);
+  Tcp *tcph = pkt->head_data<Tcp *>(h.l4_offset);
 
-  ip_offset = reinterpret_cast<uint8_t *>(iph) - reinterpret_cast<uint8_t *>(eth);
-  tcp_offset = reinterpret_cast<uint8_t *>(tcph) - reinterpret_cast<uint8_t *>(eth);
+  ip_offset = h.l3_offset;
+  tcp_offset = h.l4_offset;
   payload_offset = tcp_offset + ((tcph->offset) << 2) + XPASS_BYTES;
 
   for (i = 0; i < MAX_LRO_FLOWS; i++) {
@@ -35,6 +35,8 @@ struct lro_flow {
 
 class LRO final : public Module {
 public:
+  LRO() : Module() { writes_payload_ = true; }
+
   static const gate_idx_t kNumIGates = 1;
   static const gate_idx_t kNumOGates = 1;
   struct lro_flow *worker_flows;
@@ -51,5 +53,10 @@ public:
   void LroAppendPkt(bess::PacketBatch *batch, struct lro_flow *flow, 
                     bess::Packet *pkt, uint16_t ip_offset, uint16_t tcp_offset);
   void DoLro(bess::PacketBatch *batch, bess::Packet *pkt);
+
+  size_t NumBufferedPackets() const override;
+
+ private:
+  int headers_attr_id_;  // ParseHeaders::kAttrName
 };
 #endif // BESS_MODULES_LRO_H_
@@ -35,7 +35,10 @@
 
 class MACSwap final : public Module {
  public:
-  MACSwap() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  MACSwap() : Module() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
+  }
 
   void ProcessBatch(bess::PacketBatch *batch) override;
 };
@@ -46,6 +46,7 @@ MPLSPop::MPLSPop()
     : next_ether_type_(be16_t(Ethernet::Type::kIpv4)),
       remove_eth_header_(false) {
   max_allowed_workers_ = Worker::kMaxWorkers;
+  writes_payload_ = true;
 }
 
 void MPLSPop::ProcessBatch(bess::PacketBatch *batch) {
@@ -41,6 +41,7 @@
 #include "../utils/ip.h"
 #include "../utils/tcp.h"
 #include "../utils/udp.h"
+#include "parse_headers.h"
 
 using bess::utils::Ethernet;
 using bess::utils::Ipv4;
@@ -48,12 +49,21 @@ using IpProto = bess::utils::Ipv4::Proto;
 using bess::utils::Udp;
 using bess::utils::Tcp;
 using bess::utils::Icmp;
+using bess::utils::ParsedHeaders;
 using bess::utils::ChecksumIncrement16;
 using bess::utils::ChecksumIncrement32;
 using bess::utils::UpdateChecksumWithIncrement;
 using bess::utils::UpdateChecksum16;
 
 CommandResponse NAT::Init(const bess::pb::NATArg &arg) {
+  // Translation changes the 5-tuple, so the flow hash must be updated
+  headers_attr_id_ = ParseHeaders::AddAttr(
+      this, bess::metadata::Attribute::AccessMode::kUpdate);
+  if (headers_attr_id_ < 0) {
+    return CommandFailure(-headers_attr_id_,
+                          "Failed to register metadata attribute");
+  }
+
   for (const std::string &ext_addr : arg.ext_addrs()) {
     be32_t addr;
     bool ret = bess::utils::ParseIpv4Address(ext_addr, &addr);
@@ -254,14 +264,26 @@ inline void NAT::DoProcessBatch(bess::PacketBatch *batch) {
 
   int cnt = batch->cnt();
   uint64_t now = ctx.current_ns();
+  bess::metadata::mt_offset_t headers_offset = attr_offset(headers_attr_id_);
+  bool parsed = bess::metadata::IsValidOffset(headers_offset);
 
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
-    Ethernet *eth = pkt->head_data<Ethernet *>();
-    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
-    size_t ip_bytes = (ip->header_length) << 2;
-    void *l4 = reinterpret_cast<uint8_t *>(ip) + ip_bytes;
+    Ipv4 *ip;
+    void *l4;
+    ParsedHeaders *h =
+        parsed ? _ptr_attr_with_offset<ParsedHeaders>(headers_offset, pkt)
+               : nullptr;
+    if (h && h->l4_offset) {
+      ip = pkt->head_data<Ipv4 *>(h->l3_offset);
+      l4 = pkt->head_data<void *>(h->l4_offset);
+    } else {
+      Ethernet *eth = pkt->head_data<Ethernet *>();
+      ip = reinterpret_cast<Ipv4 *>(eth + 1);
+      size_t ip_bytes = (ip->header_length) << 2;
+      l4 = reinterpret_cast<uint8_t *>(ip) + ip_bytes;
+    }
 
     bool valid_protocol;
     Endpoint before;
@@ -288,6 +310,11 @@ inline void NAT::DoProcessBatch(bess::PacketBatch *batch) {
 
     Stamp<dir>(ip, l4, before, hash_item->second.endpoint);
 
+    if (h && h->l4_offset) {
+      h->hash = ParsedHeaders::FlowHash(
+          ip->src, ip->dst, *static_cast<uint32_t *>(l4), ip->protocol);
+    }
+
     out_batch.add(pkt);
   }
 
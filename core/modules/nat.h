@@ -131,6 +131,8 @@ class NAT final : public Module {
   static const gate_idx_t kNumIGates = 2;
   static const gate_idx_t kNumOGates = 2;
 
+  NAT() : Module() { writes_payload_ = true; }
+
   CommandResponse Init(const bess::pb::NATArg &arg);
 
   void ProcessBatch(bess::PacketBatch *batch) override;
@@ -157,6 +159,8 @@ class NAT final : public Module {
 
   HashTable map_;
   Random rng_;
+
+  int headers_attr_id_;  // ParseHeaders::kAttrName
 };
 
 #endif  // BESS_MODULES_NAT_H_
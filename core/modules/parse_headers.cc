@@ -0,0 +1,67 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "parse_headers.h"
+
+using bess::metadata::Attribute;
+using bess::utils::ParsedHeaders;
+
+const std::string ParseHeaders::kAttrName = "parsed_headers";
+
+CommandResponse ParseHeaders::Init(const bess::pb::EmptyArg &) {
+  int ret = AddMetadataAttr(kAttrName, sizeof(ParsedHeaders),
+                            Attribute::AccessMode::kWrite);
+  if (ret < 0) {
+    return CommandFailure(-ret, "Failed to register metadata attribute");
+  }
+
+  return CommandSuccess();
+}
+
+void ParseHeaders::ProcessBatch(bess::PacketBatch *batch) {
+  bess::metadata::mt_offset_t offset = attr_offset(0);
+
+  // Nobody downstream reads it
+  if (!bess::metadata::IsValidOffset(offset)) {
+    RunNextModule(batch);
+    return;
+  }
+
+  int cnt = batch->cnt();
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    ParsedHeaders *h = _ptr_attr_with_offset<ParsedHeaders>(offset, pkt);
+    h->Parse(pkt->head_data(), pkt->head_len());
+  }
+
+  RunNextModule(batch);
+}
+
+ADD_MODULE(ParseHeaders, "parse_headers",
+           "parses packet headers once for downstream modules")
@@ -0,0 +1,78 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_PARSE_HEADERS_H_
+#define BESS_MODULES_PARSE_HEADERS_H_
+
+#include <string>
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/parsed_headers.h"
+
+// Parses the L2/L3/L4 headers of each packet once and keeps the result
+// (bess::utils::ParsedHeaders) in the "parsed_headers" metadata attribute.
+// Downstream modules that register the attribute with AddAttr() use it
+// instead of walking the headers themselves; without a ParseHeaders module
+// upstream they parse packets on their own, as before.
+//
+// The offsets are not updated by modules that add or strip headers, so
+// ParseHeaders should come after any such module in the pipeline.
+class ParseHeaders final : public Module {
+ public:
+  static const std::string kAttrName;
+
+  ParseHeaders() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+
+  CommandResponse Init(const bess::pb::EmptyArg &arg);
+
+  void ProcessBatch(bess::PacketBatch *batch) override;
+
+  // Registers the attribute on a module that wants to use it, as optional.
+  // Returns the attribute id, or a negative number for error.
+  static int AddAttr(Module *m, bess::metadata::Attribute::AccessMode mode) {
+    return m->AddMetadataAttr(kAttrName, sizeof(bess::utils::ParsedHeaders),
+                              mode, true);
+  }
+
+  // Returns the headers of pkt kept at offset by an upstream ParseHeaders
+  // module, or parses them now if there is none (offset is not valid).
+  static bess::utils::ParsedHeaders Get(bess::metadata::mt_offset_t offset,
+                                        const bess::Packet *pkt) {
+    if (bess::metadata::IsValidOffset(offset)) {
+      return _get_attr_with_offset<bess::utils::ParsedHeaders>(offset, pkt);
+    }
+
+    bess::utils::ParsedHeaders h;
+    h.Parse(pkt->head_data(), pkt->head_len());
+    return h;
+  }
+};
+
+#endif  // BESS_MODULES_PARSE_HEADERS_H_
@@ -67,7 +67,7 @@ CommandResponse PortInc::Init(const bess::pb::PortIncArg &arg) {
   node_constraints_ = placement;
 
   for (queue_t qid = 0; qid < num_inc_q; qid++) {
-    task_id_t tid = RegisterTask((void *)(uintptr_t)qid);
+    task_id_t tid = RegisterTask((void *)(uintptr_t)qid, true);
 
     if (tid == INVALID_TASK_ID) {
       return CommandFailure(ENOMEM, "Task creation failed");
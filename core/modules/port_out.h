@@ -50,6 +50,9 @@ class PortOut final : public Module {
   void ProcessBatch(bess::PacketBatch *batch) override;
 
   int OnEvent(bess::Event e) override;
+  bool HandlesEvent(bess::Event e) const override {
+    return e == bess::Event::PreResume;
+  }
 
   std::string GetDesc() const override;
 
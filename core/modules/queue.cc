@@ -51,7 +51,7 @@ int Queue::Resize(int slots) {
 
   int ret;
 
-  new_queue = static_cast<llring *>(mem_alloc_ex(bytes, alignof(llring), 0));
+  new_queue = static_cast<llring *>(mem_alloc_pages(bytes, socket()));
   if (!new_queue) {
     return -ENOMEM;
   }
@@ -89,7 +89,7 @@ CommandResponse Queue::Init(const bess::pb::QueueArg &arg) {
   task_id_t tid;
   CommandResponse err;
 
-  tid = RegisterTask(nullptr);
+  tid = RegisterTask(nullptr, true);
   if (tid == INVALID_TASK_ID) {
     return CommandFailure(ENOMEM, "Task creation failed");
   }
@@ -138,6 +138,14 @@ std::string Queue::GetDesc() const {
   return bess::utils::Format("%u/%u", llring_count(ring), ring->common.slots);
 }
 
+size_t Queue::NumBufferedPackets() const {
+  return llring_count(queue_);
+}
+
+void Queue::MoveToSocket(int socket) {
+  mem_move(queue_, socket);
+}
+
 /* from upstream */
 void Queue::ProcessBatch(bess::PacketBatch *batch) {
   int queued =
@@ -62,6 +62,10 @@ class Queue : public Module {
 
   std::string GetDesc() const override;
 
+  size_t NumBufferedPackets() const override;
+
+  void MoveToSocket(int socket) override;
+
   CommandResponse CommandSetBurst(const bess::pb::QueueCommandSetBurstArg &arg);
   CommandResponse CommandSetSize(const bess::pb::QueueCommandSetSizeArg &arg);
   CommandResponse CommandGetStatus(
@@ -59,7 +59,7 @@ CommandResponse QueueInc::Init(const bess::pb::QueueIncArg &arg) {
     prefetch_ = 1;
   }
   node_constraints_ = port_->GetNodePlacementConstraint();
-  tid = RegisterTask((void *)(uintptr_t)qid_);
+  tid = RegisterTask((void *)(uintptr_t)qid_, true);
   if (tid == INVALID_TASK_ID)
     return CommandFailure(ENOMEM, "Task creation failed");
 
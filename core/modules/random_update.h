@@ -45,6 +45,7 @@ class RandomUpdate final : public Module {
 
   RandomUpdate() : Module(), num_vars_(), vars_(), rng_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
   }
 
   CommandResponse Init(const bess::pb::RandomUpdateArg &arg);
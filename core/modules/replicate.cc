@@ -70,11 +70,13 @@ void Replicate::ProcessBatch(bess::PacketBatch *batch) {
     out_gates[i].clear();
   }
 
+  // Extra gates get clones that share the data buffer, rather than copies.
+  // Downstream modules that modify packet data copy them on demand.
   for (int i = 0; i < batch->cnt(); i++) {
     bess::Packet *tocopy = batch->pkts()[i];
     out_gates[0].add(tocopy);
     for (int j = 1; j < ngates_; j++) {
-      bess::Packet *newpkt = bess::Packet::copy(tocopy);
+      bess::Packet *newpkt = bess::Packet::clone(tocopy);
       if (newpkt) {
         out_gates[j].add(newpkt);
       }
@@ -48,6 +48,7 @@ class Rewrite final : public Module {
         template_size_(),
         templates_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
   }
 
   CommandResponse Init(const bess::pb::RewriteArg &arg);
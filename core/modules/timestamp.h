@@ -39,7 +39,10 @@ class Timestamp final : public Module {
   using MarkerType = uint32_t;
   static const MarkerType kMarker = 0x54C5BE55;
 
-  Timestamp() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  Timestamp() : Module() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
+  }
 
   CommandResponse Init(const bess::pb::TimestampArg &arg);
 
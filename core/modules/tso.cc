@@ -1,5 +1,19 @@
 #include "tso.h"
 
+#include "parse_headers.h"
+
+CommandResponse TSO::Init(const bess::pb::EmptyArg &) {
+  // New segments need the headers of the original packet
+  headers_attr_id_ = ParseHeaders::AddAttr(
+      this, bess::metadata::Attribute::AccessMode::kUpdate);
+  if (headers_attr_id_ < 0) {
+    return CommandFailure(-headers_attr_id_,
+                          "Failed to register metadata attribute");
+  }
+
+  return CommandSuccess();
+}
+
 void TSO::ProcessBatch(bess::PacketBatch *batch) {
   bess::PacketBatch new_batch_object = bess::PacketBatch();
   bess::PacketBatch *new_batch = &new_batch_object;
@@ -45,33 +59,21 @@ void TSO::DoTso(bess::PacketBatch *new_batch, bess::Packet *pkt) {
   int seg_size;
 
   // offset setting
+  bess::metadata::mt_offset_t headers_offset = attr_offset(headers_attr_id_);
+  bess::utils::ParsedHeaders h = ParseHeaders::Get(headers_offset, pkt);
 
-  //get the headers of the packet
-  Ethernet *eth = pkt->head_data<Ethernet *>();
-  void *data = eth + 1;
-	
-  //[SKIP] check 802.1Q tag
-  if (unlikely(eth->ether_type != be16_t(Ethernet::Type::kIpv4))) {
-    BatchPush(new_batch, pkt);
-    return;
-  }
-
-  Ipv4 *iph = reinterpret_cast<Ipv4 *>(data);
-  size_t ip_bytes = (iph->header_length) << 2;
-
-  if (unlikely(iph->protocol != Ipv4::Proto::kTcp)) {
+  if (unlikely(h.ip_proto != Ipv4::Proto::kTcp || !h.l4_offset)) {
     BatchPush(new_batch, pkt);
     return;
   }
 
-  Tcp *tcph = reinterpret_cast<Tcp *>(reinterpret_cast<uint8_t *>(iph) + ip_bytes);
+  Ipv4 *iph = pkt->head_data<Ipv4 *>(h.l3_offset);
+  Tcp *tcph = pkt->head_data<Tcp *>(h.l4_offset);
   size_t tcp_bytes = (tcph->offset) << 2;
 
-  data = reinterpret_cast<uint8_t *>(tcph) + tcp_bytes;
-
-  ip_offset = reinterpret_cast<uint8_t *>(iph) - reinterpret_cast<uint8_t *>(eth);
-  tcp_offset = reinterpret_cast<uint8_t *>(tcph) - reinterpret_cast<uint8_t *>(eth);
-  payload_offset = reinterpret_cast<uint8_t *>(data) - reinterpret_cast<uint8_t *>(eth);
+  ip_offset = h.l3_offset;
+  tcp_offset = h.l4_offset;
+  payload_offset = tcp_offset + tcp_bytes;
 
   if (org_frame_len <= FRAME_SIZE) {
     PushXpass(pkt, iph, payload_offset);
@@ -98,7 +100,9 @@ void TSO::DoTso(bess::PacketBatch *new_batch, bess::Packet *pkt) {
     bess::utils::Copy(new_pkt->append(payload_offset + XPASS_BYTES),
                       pkt->head_data(), payload_offset);
 
-    eth = new_pkt->head_data<Ethernet *>();
+    // The segment has the same headers at the same offsets
+    set_attr_with_offset(headers_offset, new_pkt, h);
+
     iph = new_pkt->head_data<Ipv4 *>(ip_offset);
     tcph = new_pkt->head_data<Tcp *>(tcp_offset);
 
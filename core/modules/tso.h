@@ -17,16 +17,21 @@ using bess::utils::be32_t;
 
 class TSO final : public Module {
 public:
-  TSO() {}
+  TSO() : headers_attr_id_() { writes_payload_ = true; }
 
   static const gate_idx_t kNumIGates = 1;
   static const gate_idx_t kNumOGates = 1;
 
+  CommandResponse Init(const bess::pb::EmptyArg &arg);
+
   void ProcessBatch(bess::PacketBatch *batch) override;
   void BatchPush(bess::PacketBatch *batch, bess::Packet *pkt); 
   void PushXpass(bess::Packet *pkt, Ipv4 *iph, uint16_t payload_offset);
 
   void DoTso(bess::PacketBatch *batch, bess::Packet *pkt);
+
+ private:
+  int headers_attr_id_;  // ParseHeaders::kAttrName
 };
 
 #endif // BESS_MODULES_TSO_H_
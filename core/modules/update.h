@@ -44,6 +44,7 @@ class Update final : public Module {
 
   Update() : Module(), num_fields_(), fields_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
   }
 
   CommandResponse Init(const bess::pb::UpdateArg &arg);
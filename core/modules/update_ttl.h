@@ -37,7 +37,10 @@
 // <= 1
 class UpdateTTL final : public Module {
  public:
-  UpdateTTL() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  UpdateTTL() : Module() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
+  }
   void ProcessBatch(bess::PacketBatch *batch) override;
 };
 
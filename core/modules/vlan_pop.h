@@ -35,7 +35,10 @@
 
 class VLANPop final : public Module {
  public:
-  VLANPop() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  VLANPop() : Module() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
+  }
 
   void ProcessBatch(bess::PacketBatch *batch) override;
 };
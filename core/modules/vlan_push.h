@@ -42,6 +42,7 @@ class VLANPush final : public Module {
 
   VLANPush() : Module(), vlan_tag_(), qinq_tag_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
   }
 
   CommandResponse Init(const bess::pb::VLANPushArg &arg);
@@ -37,6 +37,7 @@ class VLANSplit final : public Module {
  public:
   VLANSplit() : Module() {
     max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
   }
 
   static const gate_idx_t kNumOGates = 4096;
@@ -42,6 +42,7 @@ class VXLANEncap final : public Module {
 
   VXLANEncap() : Module(), dstport_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
+    writes_payload_ = true;
   }
 
   CommandResponse Init(const bess::pb::VXLANEncapArg &arg);
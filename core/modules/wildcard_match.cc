@@ -35,6 +35,7 @@
 
 #include "../utils/endian.h"
 #include "../utils/format.h"
+#include "../utils/time.h"
 
 using bess::metadata::Attribute;
 
@@ -57,13 +58,15 @@ static inline int is_valid_gate(gate_idx_t gate) {
 
 const Commands WildcardMatch::cmds = {
     {"add", "WildcardMatchCommandAddArg",
-     MODULE_CMD_FUNC(&WildcardMatch::CommandAdd), Command::THREAD_UNSAFE},
+     MODULE_CMD_FUNC(&WildcardMatch::CommandAdd), Command::THREAD_SAFE},
+    {"add_bulk", "WildcardMatchCommandAddBulkArg",
+     MODULE_CMD_FUNC(&WildcardMatch::CommandAddBulk), Command::THREAD_SAFE},
     {"delete", "WildcardMatchCommandDeleteArg",
-     MODULE_CMD_FUNC(&WildcardMatch::CommandDelete), Command::THREAD_UNSAFE},
+     MODULE_CMD_FUNC(&WildcardMatch::CommandDelete), Command::THREAD_SAFE},
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&WildcardMatch::CommandClear),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
     {"get_rules", "EmptyArg", MODULE_CMD_FUNC(&WildcardMatch::CommandGetRules),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
     {"set_default_gate", "WildcardMatchCommandSetDefaultGateArg",
      MODULE_CMD_FUNC(&WildcardMatch::CommandSetDefaultGate),
      Command::THREAD_SAFE}};
@@ -129,13 +132,14 @@ CommandResponse WildcardMatch::Init(const bess::pb::WildcardMatchArg &arg) {
   return CommandSuccess();
 }
 
-inline gate_idx_t WildcardMatch::LookupEntry(const wm_hkey_t &key,
-                                             gate_idx_t def_gate) {
+inline gate_idx_t WildcardMatch::LookupEntry(
+    const std::vector<struct WmTuple> &tuples, const wm_hkey_t &key,
+    gate_idx_t def_gate) {
   struct WmData result = {
       .priority = INT_MIN, .ogate = def_gate,
   };
 
-  for (auto &tuple : tuples_) {
+  for (auto &tuple : tuples) {
     const auto &ht = tuple.ht;
     wm_hkey_t key_masked;
 
@@ -166,6 +170,7 @@ void WildcardMatch::ProcessBatch(bess::PacketBatch *batch) {
   }
 
   default_gate = ACCESS_ONCE(default_gate_);
+  const auto &tuples = tuples_.Get();
 
   for (const auto &field : fields_) {
     int offset;
@@ -194,7 +199,7 @@ void WildcardMatch::ProcessBatch(bess::PacketBatch *batch) {
   }
 
   for (int i = 0; i < cnt; i++) {
-    out_gates[i] = LookupEntry(keys[i], default_gate);
+    out_gates[i] = LookupEntry(tuples, keys[i], default_gate);
   }
 
   RunSplit(out_gates, batch);
@@ -203,13 +208,21 @@ void WildcardMatch::ProcessBatch(bess::PacketBatch *batch) {
 std::string WildcardMatch::GetDesc() const {
   int num_rules = 0;
 
-  for (const auto &tuple : tuples_) {
+  for (const auto &tuple : tuples_.Get()) {
     num_rules += tuple.ht.Count();
   }
 
   return bess::utils::Format("%zu fields, %d rules", fields_.size(), num_rules);
 }
 
+void WildcardMatch::MoveToSocket(int socket) {
+  for (int i = 0; i < 2; i++) {
+    for (auto &tuple : tuples_.at(i)) {
+      tuple.ht.MoveToSocket(socket);
+    }
+  }
+}
+
 template <typename T>
 CommandResponse WildcardMatch::ExtractKeyMask(const T &arg, wm_hkey_t *key,
                                               wm_hkey_t *mask) {
@@ -273,10 +286,11 @@ CommandResponse WildcardMatch::ExtractKeyMask(const T &arg, wm_hkey_t *key,
   return CommandSuccess();
 }
 
-int WildcardMatch::FindTuple(wm_hkey_t *mask) {
+int WildcardMatch::FindTuple(const std::vector<struct WmTuple> &tuples,
+                             wm_hkey_t *mask) {
   int i = 0;
 
-  for (const auto &tuple : tuples_) {
+  for (const auto &tuple : tuples) {
     if (memcmp(&tuple.mask, mask, total_key_size_) == 0) {
       return i;
     }
@@ -285,20 +299,45 @@ int WildcardMatch::FindTuple(wm_hkey_t *mask) {
   return -ENOENT;
 }
 
-int WildcardMatch::AddTuple(wm_hkey_t *mask) {
-  if (tuples_.size() >= MAX_TUPLES) {
+int WildcardMatch::AddTuple(std::vector<struct WmTuple> *tuples,
+                            wm_hkey_t *mask) {
+  if (tuples->size() >= MAX_TUPLES) {
     return -ENOSPC;
   }
 
-  tuples_.emplace_back();
-  struct WmTuple &tuple = tuples_.back();
+  tuples->emplace_back();
+  struct WmTuple &tuple = tuples->back();
   bess::utils::Copy(&tuple.mask, mask, sizeof(*mask));
+  if (socket() >= 0) {
+    tuple.ht.MoveToSocket(socket());
+  }
 
-  return int(tuples_.size() - 1);
+  return int(tuples->size() - 1);
 }
 
-int WildcardMatch::DelEntry(int idx, wm_hkey_t *key) {
-  struct WmTuple &tuple = tuples_[idx];
+int WildcardMatch::AddEntry(std::vector<struct WmTuple> *tuples,
+                            const wm_hkey_t &key, wm_hkey_t *mask,
+                            const struct WmData &data) {
+  int idx = FindTuple(*tuples, mask);
+  if (idx < 0) {
+    idx = AddTuple(tuples, mask);
+    if (idx < 0) {
+      return idx;
+    }
+  }
+
+  auto *ret = (*tuples)[idx].ht.Insert(key, data, wm_hash(total_key_size_),
+                                       wm_eq(total_key_size_));
+  if (ret == nullptr) {
+    return -EINVAL;
+  }
+
+  return 0;
+}
+
+int WildcardMatch::DelEntry(std::vector<struct WmTuple> *tuples, int idx,
+                            wm_hkey_t *key) {
+  struct WmTuple &tuple = (*tuples)[idx];
   int ret =
       tuple.ht.Remove(*key, wm_hash(total_key_size_), wm_eq(total_key_size_));
   if (ret) {
@@ -306,12 +345,93 @@ int WildcardMatch::DelEntry(int idx, wm_hkey_t *key) {
   }
 
   if (tuple.ht.Count() == 0) {
-    tuples_.erase(tuples_.begin() + idx);
+    tuples->erase(tuples->begin() + idx);
   }
 
   return 0;
 }
 
+int WildcardMatch::AddRules(std::vector<struct WmTuple> *tuples,
+                            const std::vector<struct WmRule> &rules,
+                            bool replace, struct WmUndoLog *log,
+                            int *failed_rule) {
+  log->replaced = replace;
+
+  if (replace) {
+    // Build the new table aside, and swap it in only if it is complete
+    std::vector<struct WmTuple> new_tuples;
+    for (size_t i = 0; i < rules.size(); i++) {
+      wm_hkey_t mask = rules[i].mask;
+      int ret = AddEntry(&new_tuples, rules[i].key, &mask, rules[i].data);
+      if (ret < 0) {
+        *failed_rule = i;
+        return ret;
+      }
+    }
+    log->old_tuples = std::move(*tuples);
+    *tuples = std::move(new_tuples);
+    return 0;
+  }
+
+  log->num_tuples = tuples->size();
+  log->old_data.clear();
+
+  for (size_t i = 0; i < rules.size(); i++) {
+    const struct WmRule &rule = rules[i];
+    wm_hkey_t mask = rule.mask;
+    std::pair<bool, struct WmData> old(false, WmData());
+
+    int idx = FindTuple(*tuples, &mask);
+    if (idx >= 0) {
+      const auto *entry = (*tuples)[idx].ht.Find(
+          rule.key, wm_hash(total_key_size_), wm_eq(total_key_size_));
+      if (entry) {
+        old = std::make_pair(true, entry->second);
+      }
+    }
+
+    int ret = AddEntry(tuples, rule.key, &mask, rule.data);
+    if (ret < 0) {
+      *failed_rule = i;
+      UndoRules(tuples, rules, log);
+      return ret;
+    }
+    log->old_data.push_back(old);
+  }
+
+  return 0;
+}
+
+void WildcardMatch::UndoRules(std::vector<struct WmTuple> *tuples,
+                              const std::vector<struct WmRule> &rules,
+                              struct WmUndoLog *log) {
+  if (log->replaced) {
+    *tuples = std::move(log->old_tuples);
+    return;
+  }
+
+  // In reverse order, for rules that appear more than once
+  for (size_t i = log->old_data.size(); i-- > 0;) {
+    const struct WmRule &rule = rules[i];
+    wm_hkey_t mask = rule.mask;
+
+    int idx = FindTuple(*tuples, &mask);
+    DCHECK_GE(idx, 0);
+    auto &ht = (*tuples)[idx].ht;
+    if (log->old_data[i].first) {
+      // Updates the entry in place, so it cannot fail
+      ht.Insert(rule.key, log->old_data[i].second, wm_hash(total_key_size_),
+                wm_eq(total_key_size_));
+    } else {
+      ht.Remove(rule.key, wm_hash(total_key_size_), wm_eq(total_key_size_));
+    }
+  }
+
+  // Tuples added for the rules are empty by now
+  tuples->erase(tuples->begin() + log->num_tuples, tuples->end());
+  log->old_data.clear();
+}
+
 CommandResponse WildcardMatch::CommandAdd(
     const bess::pb::WildcardMatchCommandAddArg &arg) {
   gate_idx_t gate = arg.gate();
@@ -334,21 +454,73 @@ CommandResponse WildcardMatch::CommandAdd(
   data.priority = priority;
   data.ogate = gate;
 
-  int idx = FindTuple(&mask);
-  if (idx < 0) {
-    idx = AddTuple(&mask);
-    if (idx < 0) {
-      return CommandFailure(-idx, "failed to add a new wildcard pattern");
+  int ret = tuples_.Update([&](std::vector<struct WmTuple> &tuples) {
+    return AddEntry(&tuples, key, &mask, data);
+  });
+  if (ret == -ENOSPC) {
+    return CommandFailure(ENOSPC, "failed to add a new wildcard pattern");
+  } else if (ret < 0) {
+    return CommandFailure(-ret, "failed to add a rule");
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse WildcardMatch::CommandAddBulk(
+    const bess::pb::WildcardMatchCommandAddBulkArg &arg) {
+  double start = get_epoch_time();
+
+  // All rules are checked first, so that the table is updated only once, and
+  // in one go.
+  std::vector<struct WmRule> rules(arg.rules_size());
+
+  for (int i = 0; i < arg.rules_size(); i++) {
+    const auto &rule_arg = arg.rules(i);
+    struct WmRule &rule = rules[i];
+
+    CommandResponse err = ExtractKeyMask(rule_arg, &rule.key, &rule.mask);
+    if (err.error().code() != 0) {
+      return err;
+    }
+
+    gate_idx_t gate = rule_arg.gate();
+    if (!is_valid_gate(gate)) {
+      return CommandFailure(EINVAL, "rule %d: invalid gate: %hu", i, gate);
     }
+
+    rule.data.priority = rule_arg.priority();
+    rule.data.ogate = gate;
   }
 
-  auto *ret = tuples_[idx].ht.Insert(key, data, wm_hash(total_key_size_),
-                                     wm_eq(total_key_size_));
-  if (ret == nullptr) {
-    return CommandFailure(EINVAL, "failed to add a rule");
+  // A batch that fails leaves the table as it was.
+  int failed_rule = -1;
+  struct WmUndoLog logs[2];
+  auto log = [&](std::vector<struct WmTuple> &tuples) {
+    return &logs[&tuples == &tuples_.at(0) ? 0 : 1];
+  };
+  int ret = tuples_.TryUpdate(
+      [&](std::vector<struct WmTuple> &tuples) {
+        return AddRules(&tuples, rules, arg.replace(), log(tuples),
+                        &failed_rule);
+      },
+      [&](std::vector<struct WmTuple> &tuples) {
+        UndoRules(&tuples, rules, log(tuples));
+      });
+
+  if (ret == -ENOSPC) {
+    return CommandFailure(ENOSPC, "rule %d: failed to add a new wildcard "
+                          "pattern", failed_rule);
+  } else if (ret < 0) {
+    return CommandFailure(-ret, "rule %d: failed to add a rule", failed_rule);
   }
 
-  return CommandSuccess();
+  double elapsed = get_epoch_time() - start;
+
+  bess::pb::WildcardMatchCommandAddBulkResponse r;
+  r.set_rules(rules.size());
+  r.set_elapsed_sec(elapsed);
+  r.set_rules_per_sec(elapsed > 0 ? rules.size() / elapsed : 0);
+  return CommandSuccess(r);
 }
 
 CommandResponse WildcardMatch::CommandDelete(
@@ -361,12 +533,13 @@ CommandResponse WildcardMatch::CommandDelete(
     return err;
   }
 
-  int idx = FindTuple(&mask);
-  if (idx < 0) {
-    return CommandFailure(-idx, "failed to delete a rule");
-  }
-
-  int ret = DelEntry(idx, &key);
+  int ret = tuples_.Update([&](std::vector<struct WmTuple> &tuples) {
+    int idx = FindTuple(tuples, &mask);
+    if (idx < 0) {
+      return idx;
+    }
+    return DelEntry(&tuples, idx, &key);
+  });
   if (ret < 0) {
     return CommandFailure(-ret, "failed to delete a rule");
   }
@@ -375,9 +548,12 @@ CommandResponse WildcardMatch::CommandDelete(
 }
 
 CommandResponse WildcardMatch::CommandClear(const bess::pb::EmptyArg &) {
-  for (auto &tuple : tuples_) {
-    tuple.ht.Clear();
-  }
+  tuples_.Update([](std::vector<struct WmTuple> &tuples) {
+    for (auto &tuple : tuples) {
+      tuple.ht.Clear();
+    }
+    return 0;
+  });
 
   CommandResponse response;
 
@@ -398,7 +574,7 @@ CommandResponse WildcardMatch::CommandGetRules(const bess::pb::EmptyArg &) {
     f->set_num_bytes(field.size);
   }
 
-  for (auto &tuple : tuples_) {
+  for (auto &tuple : tuples_.standby()) {
     wm_hkey_t mask = tuple.mask;
     for (auto &entry : tuple.ht) {
       bess::pb::WildcardMatchRule *rule = resp.add_rules();
@@ -37,6 +37,7 @@
 #include <rte_hash_crc.h>
 
 #include "../pb/module_msg.pb.h"
+#include "../rcu.h"
 #include "../utils/cuckoo_map.h"
 
 using bess::utils::HashResult;
@@ -145,7 +146,11 @@ class WildcardMatch final : public Module {
 
   std::string GetDesc() const override;
 
+  void MoveToSocket(int socket) override;
+
   CommandResponse CommandAdd(const bess::pb::WildcardMatchCommandAddArg &arg);
+  CommandResponse CommandAddBulk(
+      const bess::pb::WildcardMatchCommandAddBulkArg &arg);
   CommandResponse CommandDelete(
       const bess::pb::WildcardMatchCommandDeleteArg &arg);
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
@@ -159,16 +164,47 @@ class WildcardMatch final : public Module {
     wm_hkey_t mask;
   };
 
-  gate_idx_t LookupEntry(const wm_hkey_t &key, gate_idx_t def_gate);
+  struct WmRule {
+    wm_hkey_t key;
+    wm_hkey_t mask;
+    struct WmData data;
+  };
+
+  // What AddRules() did to a table, for UndoRules()
+  struct WmUndoLog {
+    bool replaced;
+
+    // The table as it was, if the rules replaced it
+    std::vector<struct WmTuple> old_tuples;
+
+    // Otherwise, the number of tuples before, and the previous data of each
+    // rule added (if the rule was already there)
+    size_t num_tuples;
+    std::vector<std::pair<bool, struct WmData>> old_data;
+  };
+
+  gate_idx_t LookupEntry(const std::vector<struct WmTuple> &tuples,
+                         const wm_hkey_t &key, gate_idx_t def_gate);
 
   CommandResponse AddFieldOne(const bess::pb::Field &field, struct WmField *f);
 
   template <typename T>
   CommandResponse ExtractKeyMask(const T &arg, wm_hkey_t *key, wm_hkey_t *mask);
 
-  int FindTuple(wm_hkey_t *mask);
-  int AddTuple(wm_hkey_t *mask);
-  int DelEntry(int idx, wm_hkey_t *key);
+  int FindTuple(const std::vector<struct WmTuple> &tuples, wm_hkey_t *mask);
+  int AddTuple(std::vector<struct WmTuple> *tuples, wm_hkey_t *mask);
+  int AddEntry(std::vector<struct WmTuple> *tuples, const wm_hkey_t &key,
+               wm_hkey_t *mask, const struct WmData &data);
+  int DelEntry(std::vector<struct WmTuple> *tuples, int idx, wm_hkey_t *key);
+
+  // Adds all rules, or none: upon failure, returns -errno with the index of
+  // the rule in *failed_rule, after undoing what it did.
+  int AddRules(std::vector<struct WmTuple> *tuples,
+               const std::vector<struct WmRule> &rules, bool replace,
+               struct WmUndoLog *log, int *failed_rule);
+  void UndoRules(std::vector<struct WmTuple> *tuples,
+                 const std::vector<struct WmRule> &rules,
+                 struct WmUndoLog *log);
 
   gate_idx_t default_gate_;
 
@@ -176,7 +212,9 @@ class WildcardMatch final : public Module {
 
   // TODO(melvinw): this can be refactored to use ExactMatchTable
   std::vector<struct WmField> fields_;
-  std::vector<struct WmTuple> tuples_;
+
+  // Updated without pausing workers, see bess::RcuDoubleBuffer
+  bess::RcuDoubleBuffer<std::vector<struct WmTuple>> tuples_;
 };
 
 #endif  // BESS_MODULES_WILDCARDMATCH_H_
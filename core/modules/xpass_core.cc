@@ -1,6 +1,45 @@
 #include "xpass_core.h"
 
+#include "parse_headers.h"
+
+using bess::utils::HeaderClassifier;
+
+CommandResponse XPassCore::Init(const bess::pb::EmptyArg &) {
+  headers_attr_id_ =
+      ParseHeaders::AddAttr(this, bess::metadata::Attribute::AccessMode::kRead);
+  if (headers_attr_id_ < 0) {
+    return CommandFailure(-headers_attr_id_,
+                          "Failed to register metadata attribute");
+  }
+
+  return CommandSuccess();
+}
+
 // Helper function implementations
+void XPassCore::Classify(const bess::PacketBatch *batch,
+                         HeaderClassifier::Result *res) {
+  bess::metadata::mt_offset_t headers_offset = attr_offset(headers_attr_id_);
+  int cnt = batch->cnt();
+  const void *data[bess::PacketBatch::kMaxBurst];
+  uint16_t len[bess::PacketBatch::kMaxBurst];
+
+  for (int i = 0; i < cnt; i++) {
+    const bess::Packet *pkt = batch->pkts()[i];
+    data[i] = pkt->head_data();
+    len[i] = pkt->head_len();
+  }
+
+  if (bess::metadata::IsValidOffset(headers_offset)) {
+    bess::utils::ParsedHeaders h[bess::PacketBatch::kMaxBurst];
+    for (int i = 0; i < cnt; i++) {
+      h[i] = ParseHeaders::Get(headers_offset, batch->pkts()[i]);
+    }
+    HeaderClassifier::ClassifyParsed(h, data, len, cnt, res);
+  } else {
+    HeaderClassifier::Classify(data, len, cnt, res);
+  }
+}
+
 void XPassCore::SetDSCP(Ipv4 *iph, int dscp) {
   if (dscp < 0 || dscp > 127) {
     LOG(INFO) << "[XPass Core] Tried to set invalid DSCP value";
@@ -62,53 +101,24 @@ void XPassCore::ProcessBatch(bess::PacketBatch *batch) {
 // TX Path implementations
 void XPassCore::ReceiveTx(bess::PacketBatch *batch) {
   bess::PacketBatch new_batch;
+  HeaderClassifier::Result res;
   int cnt = batch->cnt();
 
   new_batch.clear();
+  Classify(batch, &res);
 
   for (int i=0; i<cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
-    
-    Ethernet *eth = pkt->head_data<Ethernet *>();
-    void *data = eth + 1;
-    be16_t ether_type = eth->ether_type;
-
-    if (ether_type == be16_t(Ethernet::Type::kQinQ)) {
-      Vlan *qinq = reinterpret_cast<Vlan *>(data);
-      data = qinq + 1;
-      ether_type = qinq->ether_type;
-      if (ether_type != be16_t(Ethernet::Type::kVlan)) {
-        LOG(WARNING) << "[Fatal Error] ExpressPass Core detected wrong packet. (Vlan)";
-      }
-    }
-
-    if (ether_type == be16_t(Ethernet::Type::kVlan)) {
-      Vlan *vlan = reinterpret_cast<Vlan *>(data);
-      data = vlan + 1;
-      ether_type = vlan->ether_type;
-    }
-
-    if (ether_type != be16_t(Ethernet::Type::kIpv4)) {
-      // not IP packet.
-      new_batch.add(pkt);
-      continue;
-    }
 
-    Ipv4 *iph = reinterpret_cast<Ipv4 *>(data);
-
-    if (iph->protocol != Ipv4::Proto::kTcp) {
+    if (res.cls[i] != HeaderClassifier::kTcp &&
+        res.cls[i] != HeaderClassifier::kTcpSyn) {
       // not TCP packet.
       new_batch.add(pkt);
       continue;
     }
 
-    size_t ip_bytes = (iph->header_length) << 2;
-    Tcp *tcph =
-        reinterpret_cast<Tcp *>(reinterpret_cast<uint8_t *>(iph) + ip_bytes);
-
-    size_t tcp_bytes = (tcph->offset) << 2;
-    // now data points to the payload.
-    data = reinterpret_cast<uint8_t *>(tcph) + tcp_bytes;
+    Ipv4 *iph = pkt->head_data<Ipv4 *>(res.l3_offset[i]);
+    Tcp *tcph = pkt->head_data<Tcp *>(res.l4_offset[i]);
 
     NetworkFlow *flow = FindForwardFlow(iph, tcph);
     if (!flow) {
@@ -130,10 +140,12 @@ void XPassCore::ReceiveTx(bess::PacketBatch *batch) {
 //    xph->time = 3;
 
     // Handle SYN/SYNACK
-    if ((tcph->flags & Tcp::Flag::kSyn) && !(tcph->flags & Tcp::Flag::kAck)) {
-      ReceiveSynTx(flow);
-    } else if ((tcph->flags & Tcp::Flag::kSyn) && (tcph->flags & Tcp::Flag::kAck)) {
-      ReceiveSynAckTx(flow);
+    if (res.cls[i] == HeaderClassifier::kTcpSyn) {
+      if (res.tcp_flags[i] & Tcp::Flag::kAck) {
+        ReceiveSynAckTx(flow);
+      } else {
+        ReceiveSynTx(flow);
+      }
     }
 
     SetDSCP(iph, 1);
@@ -187,49 +199,27 @@ void XPassCore::ProcessAckTx(NetworkFlow *flow) {
 // RX Path implementations
 void XPassCore::ReceiveRx(bess::PacketBatch *batch) {
   bess::PacketBatch new_batch;
+  HeaderClassifier::Result res;
   int cnt = batch->cnt();
 
   new_batch.clear();
+  Classify(batch, &res);
 
   for (int i=0; i<cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
-    
-    Ethernet *eth = pkt->head_data<Ethernet *>();
-    void *data = eth + 1;
-    be16_t ether_type = eth->ether_type;
-
-    if (ether_type == be16_t(Ethernet::Type::kQinQ)) {
-      Vlan *qinq = reinterpret_cast<Vlan *>(data);
-      data = qinq + 1;
-      ether_type = qinq->ether_type;
-      if (ether_type != be16_t(Ethernet::Type::kVlan)) {
-        LOG(WARNING) << "[Fatal Error] ExpressPass Core detected wrong packet. (Vlan)";
-      }
-    }
 
-    if (ether_type == be16_t(Ethernet::Type::kVlan)) {
-      Vlan *vlan = reinterpret_cast<Vlan *>(data);
-      data = vlan + 1;
-      ether_type = vlan->ether_type;
-    }
-
-    if (ether_type != be16_t(Ethernet::Type::kIpv4)) {
+    if (res.cls[i] != HeaderClassifier::kTcp &&
+        res.cls[i] != HeaderClassifier::kTcpSyn) {
       new_batch.add(pkt);
       continue;
     }
 
-    Ipv4 *iph = reinterpret_cast<Ipv4 *>(data);
-
-    if (iph->protocol != Ipv4::Proto::kTcp) {
-      new_batch.add(pkt);
-      continue;
-    }
-    uint8_t dscp = (iph->type_of_service >> 2);
-    size_t ip_bytes = (iph->header_length) << 2;
+    Ethernet *eth = pkt->head_data<Ethernet *>();
+    Ipv4 *iph = pkt->head_data<Ipv4 *>(res.l3_offset[i]);
+    uint8_t dscp = res.dscp[i];
 
-    Tcp *tcph =
-        reinterpret_cast<Tcp *>(reinterpret_cast<uint8_t *>(iph) + ip_bytes);
-    data = tcph + 1;
+    Tcp *tcph = pkt->head_data<Tcp *>(res.l4_offset[i]);
+    void *data = tcph + 1;
 
     Xpass *xph = reinterpret_cast<Xpass *>(data);
     data = xph + 1;
@@ -8,6 +8,7 @@
 #include "../utils/xpass.h"
 #include "../utils/time.h"
 #include "../utils/checksum.h"
+#include "../utils/header_classifier.h"
 #include <map>
 
 #define IGATE_FROM_TX 0
@@ -269,7 +270,7 @@ public:
     uint64_t now = ConvertToLocalTS(clock);
     while (now >= front_local_ts_) {
       if (slots_[currentIdx()].next) { // while slot is not empty
-        assert(slots_[currentIndx()].prev);
+        assert(slots_[currentIdx()].prev);
         list_elem *head_elem = &slots_[currentIdx()];
 	list_elem *elem_to_remove = head_elem->next;
 	if (head_elem->next == head_elem->prev) { // last element in the list.
@@ -348,15 +349,22 @@ private:
 
 class XPassCore final : public Module {
 public:
-  XPassCore(): Module(){
+  XPassCore(): Module(), headers_attr_id_() {
+    writes_payload_ = true;
     tx_timing_wheel.Init(now());
   }
   static const gate_idx_t kNumIGates = IGATE_MAX;
   static const gate_idx_t kNumOGates = OGATE_MAX;
 
+  CommandResponse Init(const bess::pb::EmptyArg &arg);
+
   void ProcessBatch(bess::PacketBatch *batch);
 private:
   // Helper functions
+  // Classifies the packets of batch, with the headers parsed by an upstream
+  // ParseHeaders module if there is one.
+  void Classify(const bess::PacketBatch *batch,
+                bess::utils::HeaderClassifier::Result *res);
   void SetDSCP(Ipv4 *iph, int dscp);
   NetworkFlow* FindForwardFlow(Ipv4 *iph, Tcp *tcph);
   NetworkFlow* FindReverseFlow(Ipv4 *iph, Tcp *tcph);
@@ -380,6 +388,8 @@ private:
 
   std::map<NetworkFlowKey, NetworkFlow> flow_table; 
   TimingWheel tx_timing_wheel;
+
+  int headers_attr_id_;  // ParseHeaders::kAttrName
 };
 
 #endif  // BESS_MODULE_XPASS_H_
@@ -0,0 +1,225 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/* Client side of the BESS "memif_port" driver (drivers/memif.cc).
+ * Header-only and DPDK-free, so that any local process can use it. */
+
+#ifndef __MEMIF_H__
+#define __MEMIF_H__
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../drivers/memif_common.h"
+
+struct memif_client {
+	int sock;
+
+	void *region;
+	size_t region_size;
+	struct memif_region_hdr *hdr;
+
+	int num_inc_q;	/* client -> BESS */
+	int num_out_q;	/* BESS -> client */
+
+	int irq_fds[MEMIF_MAX_QUEUES];
+};
+
+/* Connects to the port and maps its region. Returns 0 or -errno. */
+static int memif_connect(struct memif_client *c, const char *path)
+{
+	struct sockaddr_un addr;
+	struct memif_hello hello;
+	char cbuf[CMSG_SPACE(sizeof(int) * (1 + MEMIF_MAX_QUEUES))];
+	struct iovec iov = {.iov_base = &hello, .iov_len = sizeof(hello)};
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	int fds[1 + MEMIF_MAX_QUEUES];
+	int num_fds;
+	ssize_t ret;
+	int i;
+
+	memset(c, 0, sizeof(*c));
+
+	c->sock = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (c->sock < 0)
+		return -errno;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+	if (addr.sun_path[0] == '@')
+		addr.sun_path[0] = '\0';
+
+	if (connect(c->sock, (struct sockaddr *)&addr,
+		    sizeof(addr.sun_family) + strlen(path)) < 0)
+		goto err;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+
+	do {
+		ret = recvmsg(c->sock, &msg, MSG_CMSG_CLOEXEC);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0)
+		goto err;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (ret != sizeof(hello) || hello.magic != MEMIF_MAGIC || !cmsg ||
+	    cmsg->cmsg_type != SCM_RIGHTS) {
+		errno = EPROTO;
+		goto err;
+	}
+
+	num_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * num_fds);
+	if (num_fds != 1 + (int)hello.num_out_q) {
+		errno = EPROTO;
+		goto err;
+	}
+
+	c->region = mmap(NULL, hello.region_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, fds[0], 0);
+	close(fds[0]);
+	if (c->region == MAP_FAILED) {
+		c->region = NULL;
+		goto err;
+	}
+
+	c->region_size = hello.region_size;
+	c->hdr = (struct memif_region_hdr *)c->region;
+	c->num_inc_q = hello.num_inc_q;
+	c->num_out_q = hello.num_out_q;
+
+	for (i = 0; i < c->num_out_q; i++)
+		c->irq_fds[i] = fds[1 + i];
+
+	return 0;
+
+err:
+	ret = -errno;
+	close(c->sock);
+	return ret;
+}
+
+static void memif_disconnect(struct memif_client *c)
+{
+	int i;
+
+	for (i = 0; i < c->num_out_q; i++)
+		close(c->irq_fds[i]);
+
+	if (c->region)
+		munmap(c->region, c->region_size);
+
+	close(c->sock);
+}
+
+static inline struct memif_queue_pair *memif_qp(struct memif_client *c, int q)
+{
+	return &c->hdr->qps[q];
+}
+
+static inline char *memif_data(struct memif_client *c, int q, void *desc)
+{
+	return memif_buf(c->region, memif_qp(c, q), c->hdr->buf_size,
+			 memif_desc_idx(desc));
+}
+
+/* Takes up to cnt empty buffers of queue pair q, to be filled and sent with
+ * memif_send(). Set the length with memif_desc(memif_desc_idx(desc), len). */
+static inline int memif_alloc(struct memif_client *c, int q, void **descs,
+			      int cnt)
+{
+	return llring_mc_dequeue_burst(
+	    memif_ring(c->region, memif_qp(c, q)->free_ring_off), descs, cnt);
+}
+
+static inline void memif_free(struct memif_client *c, int q, void **descs,
+			      int cnt)
+{
+	llring_mp_enqueue_burst(
+	    memif_ring(c->region, memif_qp(c, q)->free_ring_off), descs, cnt);
+}
+
+/* Receives up to cnt packets from the outgoing queue q. The buffers must be
+ * given back with memif_free(), or forwarded with memif_send(). */
+static inline int memif_recv(struct memif_client *c, int q, void **descs,
+			     int cnt)
+{
+	return llring_sc_dequeue_burst(
+	    memif_ring(c->region, memif_qp(c, q)->out_ring_off), descs, cnt);
+}
+
+/* Sends buffers to the incoming queue q. Never fails, since the ring is larger
+ * than the buffer pool of the queue pair. */
+static inline void memif_send(struct memif_client *c, int q, void **descs,
+			      int cnt)
+{
+	llring_sp_enqueue_burst(
+	    memif_ring(c->region, memif_qp(c, q)->inc_ring_off), descs, cnt);
+}
+
+/* Sleeps until BESS puts a packet on the outgoing queue q, or the timeout
+ * (in milliseconds, -1 for infinite) expires. */
+static inline void memif_wait(struct memif_client *c, int q, int timeout_ms)
+{
+	struct memif_queue_regs *regs = (struct memif_queue_regs *)(
+	    (char *)c->region + memif_qp(c, q)->regs_off);
+	struct llring *ring =
+	    memif_ring(c->region, memif_qp(c, q)->out_ring_off);
+	struct pollfd pfd = {.fd = c->irq_fds[q], .events = POLLIN};
+	uint64_t t;
+
+	regs->irq_enabled = 1;
+	__sync_synchronize();
+
+	/* Avoid the race with a packet enqueued just before */
+	if (llring_empty(ring))
+		poll(&pfd, 1, timeout_ms);
+
+	regs->irq_enabled = 0;
+
+	if (read(c->irq_fds[q], &t, sizeof(t)) < 0) {
+		/* nothing to consume (EAGAIN) */
+	}
+}
+
+#endif
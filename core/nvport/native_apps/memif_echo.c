@@ -0,0 +1,190 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/* Reflects every packet received on a memif_port back to BESS, without
+ * copying: outgoing queue i -> incoming queue i. */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memif.h"
+
+#define MAX_BATCH 32
+
+int batch_size = MAX_BATCH;
+int polling = 1;
+
+struct {
+	uint64_t pkts;
+	uint64_t batches;
+	uint64_t bytes;
+	uint64_t dropped;
+} stats, last_stats;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int run_echo(struct memif_client *c)
+{
+	void *descs[MAX_BATCH];
+	int total = 0;
+	int q;
+	int i;
+
+	for (q = 0; q < c->num_out_q; q++) {
+		int received = memif_recv(c, q, descs, batch_size);
+
+		if (received == 0)
+			continue;
+
+		stats.pkts += received;
+		stats.batches++;
+		for (i = 0; i < received; i++)
+			stats.bytes += memif_desc_len(descs[i]);
+
+		if (q < c->num_inc_q) {
+			memif_send(c, q, descs, received);
+		} else {
+			memif_free(c, q, descs, received);
+			stats.dropped += received;
+		}
+
+		total += received;
+	}
+
+	return total;
+}
+
+static void show_usage(char *prog_name)
+{
+	fprintf(stderr, "Usage: %s -s <socket path> [-c <core id>] "
+		"[-b <batch size>] [-w (sleep when idle)]\n",
+		prog_name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct memif_client client;
+	char path[108] = "";
+	int core = -1;
+	uint64_t last_ns;
+	uint64_t loop_count = 0;
+	uint64_t idle_count = 0;
+	int opt;
+	int ret;
+
+	while ((opt = getopt(argc, argv, "s:c:b:w")) != -1) {
+		switch (opt) {
+		case 's':
+			snprintf(path, sizeof(path), "%s", optarg);
+			break;
+		case 'c':
+			core = atoi(optarg);
+			break;
+		case 'b':
+			batch_size = atoi(optarg);
+			if (batch_size < 1 || batch_size > MAX_BATCH)
+				show_usage(argv[0]);
+			break;
+		case 'w':
+			polling = 0;
+			break;
+		default:
+			show_usage(argv[0]);
+		}
+	}
+
+	if (!path[0])
+		show_usage(argv[0]);
+
+	if (core >= 0) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(core, &set);
+		ret = sched_setaffinity(0, sizeof(set), &set);
+		assert(ret == 0);
+	}
+
+	ret = memif_connect(&client, path);
+	if (ret < 0) {
+		fprintf(stderr, "Cannot connect to %s: %s\n", path,
+			strerror(-ret));
+		return 1;
+	}
+
+	printf("Connected to %s (%d incoming, %d outgoing queues)\n", path,
+	       client.num_inc_q, client.num_out_q);
+
+	last_ns = now_ns();
+
+	for (;; loop_count++) {
+		if (run_echo(&client) == 0) {
+			idle_count++;
+			/* Only the first queue can wake us up, so use a
+			 * timeout for the others. */
+			if (!polling && client.num_out_q > 0)
+				memif_wait(&client, 0, 1);
+		}
+
+		if ((loop_count % 100) || now_ns() - last_ns < 1000000000ull)
+			continue;
+
+		printf("Idle: %4.1f%%\t\t%8lu pkts/s (%4.1f pkts/batch) "
+		       "%7.1f Mbps\t\tdropped: %lu\n",
+		       (double)idle_count * 100 / loop_count,
+		       stats.pkts - last_stats.pkts,
+		       (double)(stats.pkts - last_stats.pkts) /
+			   ((stats.batches - last_stats.batches) ?: 1),
+		       (double)(stats.bytes - last_stats.bytes) * 8 / 1000000,
+		       stats.dropped - last_stats.dropped);
+
+		memcpy(&last_stats, &stats, sizeof(stats));
+		loop_count = 0;
+		idle_count = 0;
+		last_ns = now_ns();
+	}
+
+	memif_disconnect(&client);
+
+	return 0;
+}
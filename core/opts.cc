@@ -93,3 +93,10 @@ static bool ValidateMegabytesPerSocket(const char *, int32_t value) {
 DEFINE_int32(m, 1024, "Specifies how many megabytes to use per socket");
 static const bool _m_dummy[[maybe_unused]] =
     google::RegisterFlagValidator(&FLAGS_m, &ValidateMegabytesPerSocket);
+
+DEFINE_bool(lazy_mempool, false,
+            "Create the packet pool of a NUMA node only when a worker or a "
+            "port first needs it");
+DEFINE_bool(lazy_probe, false,
+            "Do not probe DPDK PCI devices at startup, but when the first PMD "
+            "port is created");
@@ -45,5 +45,7 @@ DECLARE_int32(p);
 DECLARE_int32(m);
 DECLARE_bool(no_huge);
 DECLARE_string(modules);
+DECLARE_bool(lazy_mempool);
+DECLARE_bool(lazy_probe);
 
 #endif  // BESS_OPTS_H_
@@ -33,21 +33,37 @@
 #include <glog/logging.h>
 #include <rte_errno.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdio>
 #include <iomanip>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "dpdk.h"
 #include "opts.h"
 #include "utils/common.h"
+#include "utils/time.h"
 
 namespace bess {
 
 const size_t PacketBatch::kMaxBurst;
 
-static struct rte_mempool *pframe_pool[RTE_MAX_NUMA_NODES];
+// Set once per socket, by init_mempool() or (with --lazy_mempool) by the first
+// ensure_pframe_pool_socket() for that socket.
+static std::atomic<struct rte_mempool *> pframe_pool[RTE_MAX_NUMA_NODES];
+static std::mutex pframe_pool_mutex;
+
+// Sockets that have cores on them. Only these get packet pools.
+static bool socket_in_use[RTE_MAX_NUMA_NODES];
+
+// Initializing buffers is bound by memory bandwidth, which a handful of cores
+// per socket saturates.
+static const size_t kMaxInitThreadsPerSocket = 8;
 
 static void packet_init(struct rte_mempool *mp, void *opaque_arg, void *_m,
                         unsigned i) {
@@ -65,29 +81,121 @@ static void packet_init(struct rte_mempool *mp, void *opaque_arg, void *_m,
   pkt->set_index(i);
 }
 
-static void init_mempool_socket(int sid) {
+static void collect_obj(struct rte_mempool *, void *opaque_arg, void *obj,
+                        unsigned) {
+  reinterpret_cast<std::vector<void *> *>(opaque_arg)->push_back(obj);
+}
+
+static void pin_to_core(int core) {
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  // Not fatal: it only makes initialization slower.
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    VLOG(1) << "Cannot pin mempool initialization thread to core " << core;
+  }
+}
+
+// Returns the cores (that workers could run on) of socket sid.
+static std::vector<int> cores_on_socket(int sid) {
+  std::vector<int> cores;
+
+  for (int i = 0; i < RTE_MAX_LCORE; i++) {
+    if (is_cpu_present(i) &&
+        static_cast<int>(rte_lcore_to_socket_id(i)) == sid) {
+      cores.push_back(i);
+    }
+  }
+
+  return cores;
+}
+
+// Does what rte_mempool_create() does, short of initializing the buffers.
+static struct rte_mempool *create_mempool(const char *name, unsigned n,
+                                          int sid) {
+  const int num_mempool_cache = 512;
   struct rte_pktmbuf_pool_private pool_priv;
+  struct rte_mempool *mp;
+  int ret;
+
+  pool_priv.mbuf_data_room_size = SNBUF_HEADROOM + SNBUF_DATA;
+  pool_priv.mbuf_priv_size = SNBUF_RESERVE;
+
+  mp = rte_mempool_create_empty(name, n, sizeof(Packet), num_mempool_cache,
+                                sizeof(struct rte_pktmbuf_pool_private), sid,
+                                0);
+  if (!mp) {
+    return nullptr;
+  }
+
+  ret = rte_mempool_set_ops_byname(mp, "ring_mp_mc", nullptr);
+  if (ret == 0) {
+    rte_pktmbuf_pool_init(mp, &pool_priv);
+    ret = rte_mempool_populate_default(mp);
+  }
+
+  if (ret < 0) {
+    rte_mempool_free(mp);
+    rte_errno = -ret;
+    return nullptr;
+  }
+
+  return mp;
+}
+
+// Runs packet_init() on all buffers of the pool, split across the cores of
+// its socket. Buffer indices are the same as rte_mempool_create() would give.
+static void init_packets(struct rte_mempool *mp, int sid) {
+  std::vector<int> cores = cores_on_socket(sid);
+  std::vector<void *> objs;
+  std::vector<std::thread> threads;
+
+  objs.reserve(mp->size);
+  rte_mempool_obj_iter(mp, collect_obj, &objs);
+
+  size_t num_threads = std::min(cores.size(), kMaxInitThreadsPerSocket);
+  num_threads = std::max(num_threads, static_cast<size_t>(1));
+  size_t per_thread = (objs.size() + num_threads - 1) / num_threads;
+
+  for (size_t t = 0; t < num_threads; t++) {
+    size_t begin = std::min(t * per_thread, objs.size());
+    size_t end = std::min(begin + per_thread, objs.size());
+    int core = cores.empty() ? -1 : cores[t];
+
+    threads.emplace_back([mp, sid, core, begin, end, &objs]() {
+      if (core >= 0) {
+        pin_to_core(core);
+      }
+      for (size_t i = begin; i < end; i++) {
+        packet_init(mp, reinterpret_cast<void *>(static_cast<uintptr_t>(sid)),
+                    objs[i], i);
+      }
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+static struct rte_mempool *init_mempool_socket(int sid) {
+  struct rte_mempool *mp;
   char name[256];
 
-  const int num_mempool_cache = 512;
   const int initial_try = 24576; //262144;
   const int minimum_try = 8384;
   int current_try = initial_try;
 
-  pool_priv.mbuf_data_room_size = SNBUF_HEADROOM + SNBUF_DATA;
-  pool_priv.mbuf_priv_size = SNBUF_RESERVE;
+  double start = get_epoch_time();
 
 again:
   snprintf(name, sizeof(name), "pframe%d_%dk", sid, (current_try + 1) / 1024);
 
   /* 2^n - 1 is optimal according to the DPDK manual */
-  pframe_pool[sid] = rte_mempool_create(
-      name, current_try - 1, sizeof(Packet), num_mempool_cache,
-      sizeof(struct rte_pktmbuf_pool_private), rte_pktmbuf_pool_init,
-      &pool_priv, packet_init, reinterpret_cast<void *>((uintptr_t)sid), sid,
-      0);
+  mp = create_mempool(name, current_try - 1, sid);
 
-  if (!pframe_pool[sid]) {
+  if (!mp) {
     LOG(WARNING) << "Allocating " << current_try - 1 << " buffers on socket "
                  << sid << ": Failed (" << rte_strerror(rte_errno) << ")";
     if (current_try > minimum_try) {
@@ -98,30 +206,50 @@ again:
     LOG(FATAL) << "Packet buffer allocation failed on socket " << sid;
   }
 
+  double created = get_epoch_time();
+  init_packets(mp, sid);
+  double initialized = get_epoch_time();
+
   LOG(INFO) << "Allocating " << current_try - 1 << " buffers on socket " << sid
-            << ": OK";
+            << ": OK (allocation " << (created - start) * 1000
+            << " ms, initialization " << (initialized - created) * 1000
+            << " ms)";
+
+  return mp;
 }
 
 void init_mempool(void) {
-  int initialized[RTE_MAX_NUMA_NODES];
-
-  int i;
+  std::vector<std::thread> threads;
 
   if (FLAGS_d) {
     rte_dump_physmem_layout(stdout);
   }
 
-  for (i = 0; i < RTE_MAX_NUMA_NODES; i++) {
-    initialized[i] = 0;
+  for (int i = 0; i < RTE_MAX_LCORE; i++) {
+    socket_in_use[rte_lcore_to_socket_id(i)] = true;
   }
 
-  for (i = 0; i < RTE_MAX_LCORE; i++) {
-    int sid = rte_lcore_to_socket_id(i);
+  // With --lazy_mempool, only the socket of the default worker gets its pool
+  // now. The others are created as workers or ports need them.
+  int default_sid = rte_lcore_to_socket_id(FLAGS_c);
 
-    if (!initialized[sid]) {
-      init_mempool_socket(sid);
-      initialized[sid] = 1;
+  // Sockets are independent, so they are initialized in parallel.
+  for (int sid = 0; sid < RTE_MAX_NUMA_NODES; sid++) {
+    if (!socket_in_use[sid] || (FLAGS_lazy_mempool && sid != default_sid)) {
+      continue;
     }
+
+    threads.emplace_back([sid]() {
+      std::vector<int> cores = cores_on_socket(sid);
+      if (!cores.empty()) {
+        pin_to_core(cores[0]);
+      }
+      pframe_pool[sid] = init_mempool_socket(sid);
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
   }
 }
 
@@ -137,6 +265,22 @@ struct rte_mempool *get_pframe_pool_socket(int socket) {
   return pframe_pool[socket];
 }
 
+struct rte_mempool *ensure_pframe_pool_socket(int socket) {
+  struct rte_mempool *pool = pframe_pool[socket];
+  if (pool || !socket_in_use[socket]) {
+    return pool;
+  }
+
+  std::lock_guard<std::mutex> lock(pframe_pool_mutex);
+  pool = pframe_pool[socket];
+  if (!pool) {
+    pool = init_mempool_socket(socket);
+    pframe_pool[socket] = pool;
+  }
+
+  return pool;
+}
+
 #if DPDK_VER >= DPDK_VER_NUM(16, 7, 0)
 static Packet *paddr_to_snb_memchunk(struct rte_mempool_memhdr *chunk,
                                      phys_addr_t paddr) {
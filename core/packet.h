@@ -77,6 +77,10 @@ static inline Packet *__packet_alloc() {
 struct rte_mempool *get_pframe_pool();
 struct rte_mempool *get_pframe_pool_socket(int socket);
 
+// Same as get_pframe_pool_socket(), but creates the pool first if it has been
+// deferred (--lazy_mempool). Slow in that case; not for worker threads.
+struct rte_mempool *ensure_pframe_pool_socket(int socket);
+
 void init_mempool(void);
 void close_mempool(void);
 
@@ -189,6 +193,11 @@ class alignas(64) Packet {
     return is_linear() && RTE_MBUF_DIRECT(&as_rte_mbuf());
   }
 
+  // does the data buffer have other references? (see clone())
+  int is_shared() const {
+    return refcnt() > 1 || RTE_MBUF_INDIRECT(&as_rte_mbuf());
+  }
+
   void reset() { rte_pktmbuf_reset(&as_rte_mbuf()); }
 
   void *prepend(uint16_t len) {
@@ -225,19 +234,57 @@ class alignas(64) Packet {
     DCHECK_EQ(ret, 0);
   }
 
+  // Returns a private copy of src, including its metadata. A scattered src is
+  // gathered into a single buffer.
   // returns nullptr if memory allocation failed
   static Packet *copy(const Packet *src) {
     Packet *dst;
 
-    DCHECK(src->is_linear());
+    dst = __packet_alloc_pool(src->pool_);
+    if (!dst) {
+      return nullptr;  // FAIL.
+    }
+
+    char *p = static_cast<char *>(dst->append(src->total_len()));
+    if (!p) {
+      Free(dst);
+      return nullptr;  // src does not fit in a single buffer
+    }
+
+    if (src->is_linear()) {
+      bess::utils::CopyInlined(p, src->head_data(), src->total_len(), true);
+    } else {
+      for (const Packet *seg = src; seg; seg = seg->next()) {
+        bess::utils::CopyInlined(p, seg->head_data(), seg->head_len());
+        p += seg->head_len();
+      }
+    }
+    bess::utils::CopyInlined(dst->metadata_, src->metadata_, SNBUF_METADATA);
+
+    return dst;
+  }
+
+  // Returns a packet with its own header and metadata that refers to the data
+  // buffer of src. The buffer is freed when the last of src and its clones is
+  // freed. Both src and the clone are shared afterwards, so their data must
+  // not be modified in place; see Module::writes_payload_.
+  // A scattered packet is copied instead, as only its first segment would be
+  // shared.
+  // returns nullptr if memory allocation failed
+  static Packet *clone(Packet *src) {
+    Packet *dst;
+
+    if (!src->is_linear()) {
+      return copy(src);
+    }
 
     dst = __packet_alloc_pool(src->pool_);
     if (!dst) {
       return nullptr;  // FAIL.
     }
 
-    bess::utils::CopyInlined(dst->append(src->total_len()), src->head_data(),
-                             src->total_len(), true);
+    rte_pktmbuf_attach(&dst->as_rte_mbuf(), &src->as_rte_mbuf());
+    bess::utils::CopyInlined(dst->metadata_, src->metadata_, SNBUF_METADATA);
 
     return dst;
   }
@@ -0,0 +1,166 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "packet.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "packet_test_util.h"
+
+namespace {
+
+const char kData[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+uint32_t &meta(bess::Packet *pkt) {
+  return *reinterpret_cast<uint32_t *>(
+      const_cast<char *>(pkt->metadata<const char *>()));
+}
+
+class PacketTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    pool_ = bess::TestPacketPool();
+    avail_ = rte_mempool_avail_count(pool_);
+    src_ = bess::AllocTestPacket(kData, sizeof(kData));
+    ASSERT_NE(nullptr, src_);
+    meta(src_) = 0xdeadbeef;
+  }
+
+  // Every test must give all of its buffers back
+  virtual void TearDown() {
+    EXPECT_EQ(avail_, rte_mempool_avail_count(pool_));
+  }
+
+  struct rte_mempool *pool_;
+  unsigned avail_;
+  bess::Packet *src_;
+};
+
+TEST_F(PacketTest, Copy) {
+  bess::Packet *copy = bess::Packet::copy(src_);
+  ASSERT_NE(nullptr, copy);
+
+  EXPECT_NE(src_->head_data(), copy->head_data());
+  ASSERT_EQ(sizeof(kData), copy->total_len());
+  EXPECT_EQ(0, memcmp(kData, copy->head_data(), sizeof(kData)));
+  EXPECT_EQ(0xdeadbeef, meta(copy));
+  EXPECT_FALSE(src_->is_shared());
+  EXPECT_FALSE(copy->is_shared());
+
+  bess::Packet::Free(copy);
+  bess::Packet::Free(src_);
+}
+
+TEST_F(PacketTest, CloneSharesData) {
+  bess::Packet *clone = bess::Packet::clone(src_);
+  ASSERT_NE(nullptr, clone);
+
+  EXPECT_NE(src_, clone);
+  EXPECT_EQ(src_->head_data(), clone->head_data());
+  EXPECT_EQ(src_->total_len(), clone->total_len());
+  EXPECT_EQ(0xdeadbeef, meta(clone));
+  EXPECT_EQ(2, src_->refcnt());
+  EXPECT_TRUE(src_->is_shared());
+  EXPECT_TRUE(clone->is_shared());
+
+  // Metadata is per packet
+  meta(clone) = 1;
+  EXPECT_EQ(0xdeadbeef, meta(src_));
+
+  // Headers are per packet as well
+  clone->adj(10);
+  EXPECT_EQ(sizeof(kData), src_->total_len());
+
+  bess::Packet::Free(clone);
+  EXPECT_EQ(1, src_->refcnt());
+  EXPECT_FALSE(src_->is_shared());
+
+  bess::Packet::Free(src_);
+}
+
+TEST_F(PacketTest, CloneOutlivesSource) {
+  bess::Packet *clones[3];
+  for (bess::Packet *&clone : clones) {
+    clone = bess::Packet::clone(src_);
+    ASSERT_NE(nullptr, clone);
+  }
+  EXPECT_EQ(4, src_->refcnt());
+
+  // The data buffer stays until the last reference is gone
+  bess::Packet::Free(src_);
+  for (bess::Packet *clone : clones) {
+    EXPECT_EQ(0, memcmp(kData, clone->head_data(), sizeof(kData)));
+    bess::Packet::Free(clone);
+  }
+}
+
+TEST_F(PacketTest, CopyOfClone) {
+  bess::Packet *clone = bess::Packet::clone(src_);
+  ASSERT_NE(nullptr, clone);
+
+  bess::Packet *copy = bess::Packet::copy(clone);
+  ASSERT_NE(nullptr, copy);
+  EXPECT_FALSE(copy->is_shared());
+  EXPECT_EQ(0, memcmp(kData, copy->head_data(), sizeof(kData)));
+
+  // Writing to the copy leaves the others alone
+  copy->head_data<char *>()[0] = 'X';
+  EXPECT_EQ('0', src_->head_data<char *>()[0]);
+
+  bess::Packet::Free(copy);
+  bess::Packet::Free(clone);
+  bess::Packet::Free(src_);
+}
+
+// A scattered packet is gathered into a private copy rather than cloned
+TEST_F(PacketTest, CloneScattered) {
+  bess::Packet *tail = bess::AllocTestPacket(kData, sizeof(kData));
+  ASSERT_NE(nullptr, tail);
+  src_->set_next(tail);
+  src_->set_nb_segs(2);
+  src_->set_total_len(2 * sizeof(kData));
+  ASSERT_FALSE(src_->is_linear());
+
+  bess::Packet *clone = bess::Packet::clone(src_);
+  ASSERT_NE(nullptr, clone);
+  EXPECT_TRUE(clone->is_linear());
+  EXPECT_FALSE(clone->is_shared());
+  EXPECT_FALSE(src_->is_shared());
+  ASSERT_EQ(2 * sizeof(kData), clone->total_len());
+  EXPECT_EQ(0, memcmp(kData, clone->head_data(), sizeof(kData)));
+  EXPECT_EQ(0, memcmp(kData, clone->head_data(sizeof(kData)), sizeof(kData)));
+  EXPECT_EQ(0xdeadbeef, meta(clone));
+
+  bess::Packet::Free(clone);
+  bess::Packet::Free(src_);
+}
+
+}  // namespace
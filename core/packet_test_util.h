@@ -0,0 +1,74 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_PACKET_TEST_UTIL_H_
+#define BESS_PACKET_TEST_UTIL_H_
+
+#include <rte_mbuf.h>
+#include <rte_memory.h>
+#include <rte_mempool.h>
+
+#include <glog/logging.h>
+
+#include <cstring>
+
+#include "dpdk.h"
+#include "packet.h"
+
+namespace bess {
+
+// Returns a small packet pool for tests that need real packets. DPDK is
+// initialized (without hugepages) the first time, once per process, since
+// all tests are linked into a single binary as well.
+inline struct rte_mempool *TestPacketPool() {
+  static struct rte_mempool *pool = []() {
+    init_dpdk("bess_test", 256, 0, true);
+    struct rte_mempool *mp = rte_pktmbuf_pool_create(
+        "test_pframe", 255, 0, SNBUF_RESERVE, SNBUF_HEADROOM + SNBUF_DATA,
+        SOCKET_ID_ANY);
+    CHECK(mp) << "Cannot create the packet pool for tests";
+    return mp;
+  }();
+
+  return pool;
+}
+
+// Allocates a single-segment packet from TestPacketPool() with the given
+// contents. Returns nullptr if the pool is empty.
+inline Packet *AllocTestPacket(const void *data, uint16_t len) {
+  Packet *pkt = reinterpret_cast<Packet *>(rte_pktmbuf_alloc(TestPacketPool()));
+  if (pkt) {
+    memcpy(pkt->append(len), data, len);
+  }
+  return pkt;
+}
+
+}  // namespace bess
+
+#endif  // BESS_PACKET_TEST_UTIL_H_
@@ -33,6 +33,11 @@
 
 #include "utils/copy.h"
 
+// Maximum number of packets in a batch. 32 unless overridden by the build.
+#ifndef BESS_MAX_BURST
+#define BESS_MAX_BURST 32
+#endif
+
 namespace bess {
 
 class Packet;
@@ -62,7 +67,7 @@ class PacketBatch {
     bess::utils::CopyInlined(pkts_, src->pkts_, cnt_ * sizeof(Packet *));
   }
 
-  static const size_t kMaxBurst = 32;
+  static const size_t kMaxBurst = BESS_MAX_BURST;
 
  private:
   int cnt_;
@@ -70,6 +75,10 @@ class PacketBatch {
 };
 
 static_assert(std::is_pod<PacketBatch>::value, "PacketBatch is not a POD Type");
+static_assert(PacketBatch::kMaxBurst >= 1 && PacketBatch::kMaxBurst <= 256,
+              "BESS_MAX_BURST must be in [1, 256]");
+static_assert((PacketBatch::kMaxBurst & (PacketBatch::kMaxBurst - 1)) == 0,
+              "BESS_MAX_BURST must be a power of two");
 
 }  // namespace bess
 
@@ -184,6 +184,8 @@ Port::PortStats Port::GetPortStats() {
     ret.out.bytes += out.bytes;
   }
 
+  GetDriverStats(&ret.driver);
+
   return ret;
 }
 
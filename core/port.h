@@ -179,6 +179,13 @@ struct QueueStats {
   uint64_t bytes;    // It doesn't include Ethernet overhead
 };
 
+// Each queue is polled by a single worker, which updates its counters. The
+// padding keeps the counters of different queues in different cache lines.
+// (alignas() would not do, since Port objects are not cache-aligned.)
+struct PaddedQueueStats : public QueueStats {
+  char pad[64];
+};
+
 class Port {
  public:
   struct LinkStatus {
@@ -191,6 +198,7 @@ class Port {
   struct PortStats {
     QueueStats inc;
     QueueStats out;
+    std::map<std::string, uint64_t> driver;  // See GetDriverStats()
   };
 
   // overide this section to create a new driver -----------------------------
@@ -229,6 +237,10 @@ class Port {
     return UNCONSTRAINED_SOCKET;
   }
 
+  // Adds counters specific to the driver (e.g., of notifications sent to the
+  // peer) to `stats`, by name (optional).
+  virtual void GetDriverStats(std::map<std::string, uint64_t> *) {}
+
   virtual LinkStatus GetLinkStatus() {
     return LinkStatus{
         .speed = 0, .full_duplex = true, .autoneg = true, .link_up = true,
@@ -287,7 +299,7 @@ class Port {
    * TODO: more robust gate keeping */
   const struct module *users[PACKET_DIRS][MAX_QUEUES_PER_DIR];
 
-  struct QueueStats queue_stats[PACKET_DIRS][MAX_QUEUES_PER_DIR];
+  PaddedQueueStats queue_stats[PACKET_DIRS][MAX_QUEUES_PER_DIR];
 };
 
 #define ADD_DRIVER(_DRIVER, _NAME_TEMPLATE, _HELP)                       \
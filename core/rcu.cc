@@ -0,0 +1,71 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "rcu.h"
+
+#include <x86intrin.h>
+
+namespace bess {
+
+std::atomic<uint64_t> rcu_epoch(0);
+
+std::mutex rcu_mutex;
+
+void SynchronizeRcu() {
+  std::lock_guard<std::mutex> lock(rcu_mutex);
+
+  // Any worker that reports this epoch or later has finished whatever task
+  // was running when the caller published its update.
+  uint64_t epoch = rcu_epoch.fetch_add(1) + 1;
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    bool woken_up = false;
+
+    while (is_worker_active(wid)) {
+      worker_status_t status = workers[wid]->status();
+      if (status == WORKER_PAUSED || status == WORKER_FINISHED) {
+        break;
+      }
+
+      if (workers[wid]->quiescent_epoch() >= epoch) {
+        break;
+      }
+
+      // It may be in Worker::IdleSleep()
+      if (!woken_up) {
+        wakeup_worker(wid);
+        woken_up = true;
+      }
+
+      _mm_pause();
+    }
+  }
+}
+
+}  // namespace bess
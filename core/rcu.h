@@ -0,0 +1,151 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_RCU_H_
+#define BESS_RCU_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+#include "utils/common.h"
+#include "worker.h"
+
+namespace bess {
+
+// Read-copy-update (RCU) for data that the master thread updates while
+// workers keep reading it, without pausing the workers or taking any lock on
+// the data path. Tasks never hold on to such data across runs, so the
+// scheduler reports a quiescent state between tasks (see
+// RcuQuiescentState()). After publishing a new version, the master calls
+// SynchronizeRcu(), which returns once no worker can still be looking at the
+// old version; only then may the old version be reclaimed or modified.
+
+// Incremented by every SynchronizeRcu()
+extern std::atomic<uint64_t> rcu_epoch;
+
+// Called by workers between tasks.
+static inline void RcuQuiescentState() {
+  ctx.ReportQuiescentState(rcu_epoch.load(std::memory_order_acquire));
+}
+
+// Waits for a grace period, i.e., until every running worker has gone
+// through a quiescent state. Paused workers are quiescent, and workers
+// sleeping for lack of work are woken up. Must not be called from a worker.
+// Besides the master, threads that serve a port or module on their own (e.g.,
+// the accept thread of MemifPort, which must not reset a region that a worker
+// may still be reading) can call it without stopping the datapath.
+void SynchronizeRcu();
+
+// Held by SynchronizeRcu() while it looks at the workers. destroy_worker()
+// takes it too, so that a worker never goes away under a SynchronizeRcu()
+// called from a thread other than the master.
+extern std::mutex rcu_mutex;
+
+// Keeps two copies of a T: the active one, which workers read, and a standby
+// one that only the master touches. Update() applies a change to the standby
+// copy, makes it the active one, waits for a grace period and then applies
+// the same change to the other copy. Each update thus takes time in
+// proportion to the change rather than to the size of T (as a copy would),
+// at the cost of twice the memory.
+template <typename T>
+class RcuDoubleBuffer {
+ public:
+  RcuDoubleBuffer() : copies_(), active_(0) {}
+
+  // Returns the active copy. Workers must not keep it across task runs.
+  const T &Get() const {
+    return copies_[active_.load(std::memory_order_acquire)];
+  }
+
+  // Returns the standby copy, which is identical to the active one between
+  // updates. Master thread only, e.g., to read through non-const iterators.
+  T &standby() { return copies_[1 - active_.load(std::memory_order_relaxed)]; }
+
+  // Returns the i-th (0 or 1) copy, to set up or tear down both of them while
+  // no worker can see them, e.g., in Module::Init() or Module::DeInit().
+  T &at(int i) { return copies_[i]; }
+
+  // Applies f(T &) to both copies as described above, and returns what it
+  // returned for the first one. The change must be deterministic, so that
+  // the copies stay identical. It is applied to the second copy even if it
+  // failed on the first, since it may have been partially applied already.
+  // Master thread only.
+  template <typename F>
+  auto Update(F f) -> decltype(f(std::declval<T &>())) {
+    int standby = 1 - active_.load(std::memory_order_relaxed);
+
+    auto ret = f(copies_[standby]);
+    active_.store(standby, std::memory_order_release);
+
+    SynchronizeRcu();
+    f(copies_[1 - standby]);
+
+    return ret;
+  }
+
+  // Like Update(), for changes that may fail halfway. f(T &) returns 0 on
+  // success, or an error after undoing whatever it changed, and undo(T &)
+  // reverts a successful f(). If f() fails on the standby copy, nothing is
+  // published. It may still fail on the other copy, which is equal but may
+  // differ in layout (e.g., of a hash table), in which case the first copy is
+  // taken back and reverted too. Either way, the change is applied to both
+  // copies or to none. Returns what f() returned. Master thread only.
+  template <typename F, typename U>
+  int TryUpdate(F f, U undo) {
+    int standby = 1 - active_.load(std::memory_order_relaxed);
+
+    int ret = f(copies_[standby]);
+    if (ret) {
+      return ret;
+    }
+    active_.store(standby, std::memory_order_release);
+
+    SynchronizeRcu();
+    ret = f(copies_[1 - standby]);
+    if (ret) {
+      active_.store(1 - standby, std::memory_order_release);
+      SynchronizeRcu();
+      undo(copies_[standby]);
+    }
+
+    return ret;
+  }
+
+ private:
+  T copies_[2];
+  std::atomic<int> active_;
+
+  DISALLOW_COPY_AND_ASSIGN(RcuDoubleBuffer);
+};
+
+}  // namespace bess
+
+#endif  // BESS_RCU_H_
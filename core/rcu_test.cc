@@ -0,0 +1,103 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "rcu.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace bess {
+namespace {
+
+TEST(RcuDoubleBufferTest, UpdateBothCopies) {
+  RcuDoubleBuffer<std::vector<int>> buf;
+  const std::vector<int> *before = &buf.Get();
+
+  int calls = 0;
+  int ret = buf.Update([&calls](std::vector<int> &v) {
+    v.push_back(42);
+    return ++calls;
+  });
+
+  EXPECT_EQ(1, ret);  // returned for the first copy
+  EXPECT_EQ(2, calls);
+  EXPECT_NE(before, &buf.Get());
+  EXPECT_EQ(std::vector<int>({42}), buf.Get());
+  EXPECT_EQ(buf.Get(), buf.standby());
+  EXPECT_EQ(buf.at(0), buf.at(1));
+
+  buf.Update([](std::vector<int> &v) {
+    v.clear();
+    return 0;
+  });
+  EXPECT_EQ(before, &buf.Get());
+  EXPECT_TRUE(buf.Get().empty());
+  EXPECT_TRUE(buf.standby().empty());
+}
+
+// A change that fails halfway is applied to both copies all the same.
+TEST(RcuDoubleBufferTest, FailedUpdate) {
+  RcuDoubleBuffer<std::vector<int>> buf;
+
+  bool ok = buf.Update([](std::vector<int> &v) {
+    v.push_back(1);
+    return false;
+  });
+
+  EXPECT_FALSE(ok);
+  EXPECT_EQ(std::vector<int>({1}), buf.at(0));
+  EXPECT_EQ(std::vector<int>({1}), buf.at(1));
+}
+
+// Paused workers, and those that have gone through a quiescent state since,
+// do not hold up a grace period.
+TEST(RcuTest, SynchronizeQuiescentWorkers) {
+  Worker *paused = new Worker();
+  Worker *running = new Worker();
+
+  paused->set_status(WORKER_PAUSED);
+  running->set_status(WORKER_RUNNING);
+  running->ReportQuiescentState(rcu_epoch + 1);
+
+  workers[0] = paused;
+  workers[1] = running;
+
+  uint64_t epoch = rcu_epoch;
+  SynchronizeRcu();
+  EXPECT_EQ(epoch + 1, rcu_epoch);
+
+  workers[0] = nullptr;
+  workers[1] = nullptr;
+  delete paused;
+  delete running;
+}
+
+}  // namespace
+}  // namespace bess
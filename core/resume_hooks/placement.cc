@@ -0,0 +1,64 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "placement.h"
+
+#include "../module.h"
+#include "../module_graph.h"
+
+const std::string PlaceModules::kName = "place_modules";
+
+PlaceModules::PlaceModules() : bess::ResumeHook(kName, kPriority, true) {}
+
+CommandResponse PlaceModules::Init(const bess::pb::EmptyArg &) {
+  return CommandSuccess();
+}
+
+void PlaceModules::Run() {
+  propagate_active_worker();
+
+  for (const auto &it : ModuleGraph::GetAllModules()) {
+    Module *m = it.second;
+    int socket = m->WorkerSocket();
+
+    if (socket >= 0) {
+      m->PlaceOnSocket(socket);
+    }
+  }
+}
+
+ADD_RESUME_HOOK(PlaceModules)
+
+bool __enable_PlaceModules = []() {
+  bool ret = bess::global_resume_hooks.emplace(new PlaceModules()).second;
+  if (!ret) {
+    LOG(ERROR) << "Failed to enable PlaceModules hook by default";
+  }
+  return ret;
+}();
@@ -31,51 +31,105 @@
 #ifndef BESS_SCHEDULER_H_
 #define BESS_SCHEDULER_H_
 
+#include <x86intrin.h>
+
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "rcu.h"
 #include "traffic_class.h"
-#include "utils/extended_priority_queue.h"
 #include "worker.h"
 
 namespace bess {
 
+// Stages of the opt-in idle backoff, in the order they are used as a worker
+// stays idle. See Scheduler::Idle().
+enum IdleStage {
+  IDLE_SPIN = 0,  // busy polling, without backoff
+  IDLE_PAUSE,     // spinning with the pause instruction
+  IDLE_WAIT,      // tpause, on CPUs that support it (WAITPKG)
+  IDLE_SLEEP,     // sleeping in Worker::IdleSleep()
+  NUM_IDLE_STAGES,
+};
+
 struct sched_stats {
   resource_arr_t usage;
   uint64_t cnt_idle;
   uint64_t cycles_idle;
+  uint64_t cycles_busy;
+  uint64_t cycles_idle_stage[NUM_IDLE_STAGES];  // breakdown of cycles_idle
 };
 
 class Scheduler;
 
-// Queue of blocked traffic classes ordered by time expiration.
+// Queue of blocked traffic classes, to be woken up at their wakeup_time().
+// It is a hashed timing wheel: each slot holds an intrusive list (see
+// TrafficClass::wakeup_next_) of the classes whose wakeup time falls in that
+// tick, modulo the size of the wheel, so Add() and Remove() are O(1).
 class SchedWakeupQueue {
  public:
-  struct WakeupComp {
-    bool operator()(const TrafficClass *left, const TrafficClass *right) const {
-      // Reversed so that priority_queue is a min priority queue.
-      return right->wakeup_time() < left->wakeup_time();
+  // A tick is 1024 cycles and the wheel turns every 4M cycles (about 1.7ms at
+  // 2.5GHz). Classes due further out than that stay in their slot, and are
+  // skipped, until the turn they are due in.
+  static const int kTickShift = 10;
+  static const uint64_t kNumSlots = 4096;
+
+  SchedWakeupQueue() : slots_(), cursor_() {}
+
+  // Adds the given traffic class to those that are considered blocked, to be
+  // woken up at wakeup_time, or updates its position if it is already there.
+  void Add(TrafficClass *c, uint64_t wakeup_time) {
+    c->UnlinkWakeup();
+    c->wakeup_time_ = wakeup_time;
+
+    // Classes already overdue go to the slot that is checked next.
+    uint64_t tick = std::max(c->wakeup_time_ >> kTickShift, cursor_);
+    TrafficClass **head = &slots_[tick % kNumSlots];
+
+    c->wakeup_next_ = *head;
+    c->wakeup_pprev_ = head;
+    if (*head) {
+      (*head)->wakeup_pprev_ = &c->wakeup_next_;
     }
-  };
-
-  SchedWakeupQueue() : q_() {}
-
-  // Adds the given traffic class to those that are considered blocked.
-  void Add(TrafficClass *c) { q_.push(c); }
+    *head = c;
+  }
 
   // Removes the given traffic class from the blocked list.
-  void Remove(const TrafficClass *c) {
-    const auto del_pred = [&](const TrafficClass *t) { return t == c; };
-    q_.delete_single_element(del_pred);
+  void Remove(TrafficClass *c) { c->UnlinkWakeup(); }
+
+  // Calls f(c) for each class c with wakeup_time() < tsc, after removing it.
+  template <typename F>
+  void Expire(uint64_t tsc, F f) {
+    uint64_t now_tick = std::max(tsc >> kTickShift, cursor_);
+
+    // After a long pause, a single turn of the wheel covers everything
+    uint64_t last_tick = std::min(now_tick, cursor_ + kNumSlots - 1);
+
+    for (uint64_t tick = cursor_; tick <= last_tick; tick++) {
+      TrafficClass *c = slots_[tick % kNumSlots];
+      while (c) {
+        TrafficClass *next = c->wakeup_next_;
+        if (c->wakeup_time_ < tsc) {
+          c->UnlinkWakeup();
+          f(c);
+        }
+        c = next;
+      }
+    }
+
+    // The slot of now_tick is checked again next time, as classes in it may
+    // not have been due yet.
+    cursor_ = now_tick;
   }
 
  private:
-  friend class Scheduler;
+  TrafficClass *slots_[kNumSlots];
 
-  // A priority queue of TrafficClasses to wake up ordered by time.
-  bess::utils::extended_priority_queue<TrafficClass *, WakeupComp> q_;
+  // The earliest tick whose slot may have classes due
+  uint64_t cursor_;
 };
 
 // The non-instantiable base class for schedulers.  Implements common routines
@@ -88,7 +142,10 @@ class Scheduler {
         wakeup_queue_(),
         stats_(),
         checkpoint_(),
-        ns_per_cycle_(1e9 / tsc_hz) {}
+        ns_per_cycle_(1e9 / tsc_hz),
+        idle_sleep_us_(),
+        idle_since_(),
+        ignore_wakeup_fds_() {}
 
   // TODO(barath): Do real cleanup, akin to sched_free() from the old impl.
   virtual ~Scheduler() {
@@ -103,19 +160,13 @@ class Scheduler {
 
   // Wakes up any TrafficClasses whose wakeup time has passed.
   void WakeTCs(uint64_t tsc) {
-    while (!wakeup_queue_.q_.empty()) {
-      TrafficClass *c = wakeup_queue_.q_.top();
+    wakeup_queue_.Expire(tsc, [](TrafficClass *c) {
       uint64_t wakeup_time = c->wakeup_time();
-      if (wakeup_time < tsc) {
-        wakeup_queue_.q_.pop();
-        c->wakeup_time_ = 0;
+      c->wakeup_time_ = 0;
 
-        // Traverse upward toward root to unblock any blocked parents.
-        c->UnblockTowardsRoot(wakeup_time);
-      } else {
-        break;
-      }
-    }
+      // Traverse upward toward root to unblock any blocked parents.
+      c->UnblockTowardsRoot(wakeup_time);
+    });
   }
 
   TrafficClass *root() { return root_; }
@@ -170,12 +221,23 @@ class Scheduler {
     return false;
   }
 
+  // The round-robin root that AttachOrphan() puts tasks under, if any
+  RoundRobinTrafficClass *default_rr_class() const { return default_rr_class_; }
+
   // Return the number of traffic classes, managed by this scheduler.
   size_t NumTcs() const { return root_ ? root_->Size() : 0; }
 
   // For testing
   SchedWakeupQueue &wakeup_queue() { return wakeup_queue_; }
 
+  const struct sched_stats &stats() const { return stats_; }
+
+  // If nonzero, the worker backs off when there is nothing to run, instead of
+  // spinning: it spins with pause, then waits in tpause (if available), then
+  // sleeps for up to `us` microseconds at a time. Must be set before the
+  // worker starts.
+  void set_idle_sleep_us(uint64_t us) { idle_sleep_us_ = us; }
+
   // Selects the next TrafficClass to run.
   LeafTrafficClass *Next(uint64_t tsc) {
     WakeTCs(tsc);
@@ -210,29 +272,29 @@ class Scheduler {
 
   double ns_per_cycle_;
 
- private:
-  DISALLOW_COPY_AND_ASSIGN(Scheduler);
-};
+  // Poll backoff policy, for RunOnce(). Schedulers that set kBackoff hide
+  // these with their own.
+  static const bool kBackoff = false;
 
-// The default scheduler, which picks the first leaf that the TC tree gives it
-// and runs the corresponding task.
-class DefaultScheduler : public Scheduler {
- public:
-  explicit DefaultScheduler(TrafficClass *root = nullptr) : Scheduler(root) {}
+  // The number of cycles not to poll leaf for, after an empty poll
+  uint64_t EmptyPollWait(const LeafTrafficClass *) const { return 0; }
 
-  virtual ~DefaultScheduler() {}
+  // The new poll interval of leaf, after a productive poll
+  uint64_t ProductivePollWait(const LeafTrafficClass *leaf) const {
+    return leaf->wait_cycles();
+  }
 
-  // Runs the scheduler loop forever.
-  void ScheduleLoop() override {
-    uint64_t now;
+  // The main scheduling, running, accounting loop, on S::ScheduleOnce(). A
+  // template so that ScheduleLoop() is the only virtual call that is made.
+  template <typename S>
+  void RunLoop(S *s) {
     // How many rounds to go before we do accounting.
     const uint64_t accounting_mask = 0xff;
     static_assert(((accounting_mask + 1) & accounting_mask) == 0,
                   "Accounting mask must be (2^n)-1");
 
-    this->checkpoint_ = now = rdtsc();
+    checkpoint_ = rdtsc();
 
-    // The main scheduling, running, accounting loop.
     for (uint64_t round = 0;; ++round) {
       // Periodic check, to mitigate expensive operations.
       if ((round & accounting_mask) == 0) {
@@ -240,57 +302,185 @@ class DefaultScheduler : public Scheduler {
           if (ctx.BlockWorker()) {
             break;
           }
+          // Do not account the time spent paused
+          checkpoint_ = rdtsc();
         }
       }
 
-      ScheduleOnce();
+      // Between tasks, this worker holds no RCU-protected data (see rcu.h).
+      RcuQuiescentState();
+
+      s->ScheduleOnce();
     }
   }
 
-  // Runs the scheduler once.
-  void ScheduleOnce() {
+  // Runs the next leaf once, or idles if everything is blocked. If
+  // S::kBackoff and the task yielded no packets but asked to block, the leaf
+  // is not polled again for s->EmptyPollWait() cycles, and the empty poll is
+  // not charged to it, so that it is not penalized by its parent's policy for
+  // being polled.
+  template <typename S>
+  void RunOnce(S *s) {
     resource_arr_t usage;
 
     // Schedule.
-    LeafTrafficClass *leaf = Scheduler::Next(this->checkpoint_);
+    LeafTrafficClass *leaf = Next(checkpoint_);
 
     uint64_t now;
     if (leaf) {
-      ctx.set_current_tsc(this->checkpoint_);  // Tasks see updated tsc.
-      ctx.set_current_ns(this->checkpoint_ * this->ns_per_cycle_);
+      ctx.set_current_tsc(checkpoint_);  // Tasks see updated tsc.
+      ctx.set_current_ns(checkpoint_ * ns_per_cycle_);
 
       // Run.
       auto ret = (*leaf->task())();
-
+      ctx.RunDeferredCalls();
+      leaf->AccountPoll(ret.packets);
       now = rdtsc();
 
-      // Account.
-      usage[RESOURCE_COUNT] = 1;
-      usage[RESOURCE_CYCLE] = now - this->checkpoint_;
-      usage[RESOURCE_PACKET] = ret.packets;
-      usage[RESOURCE_BIT] = ret.bits;
+      if (S::kBackoff && ret.packets == 0 && ret.block) {
+        uint64_t wait = s->EmptyPollWait(leaf);
+        leaf->set_wait_cycles(wait);
+
+        leaf->blocked_ = true;
+        wakeup_queue_.Add(leaf, now + wait);
+
+        usage[RESOURCE_COUNT] = 0;
+        usage[RESOURCE_CYCLE] = 0;
+        usage[RESOURCE_PACKET] = 0;
+        usage[RESOURCE_BIT] = 0;
+      } else {
+        if (S::kBackoff) {
+          leaf->set_wait_cycles(s->ProductivePollWait(leaf));
+        }
+
+        usage[RESOURCE_COUNT] = 1;
+        usage[RESOURCE_CYCLE] = now - checkpoint_;
+        usage[RESOURCE_PACKET] = ret.packets;
+        usage[RESOURCE_BIT] = ret.bits;
+      }
 
       // TODO(barath): Re-enable scheduler-wide stats accumulation.
       // accumulate(stats_.usage, usage);
 
-      leaf->FinishAndAccountTowardsRoot(&this->wakeup_queue_, nullptr, usage,
-                                        now);
+      // Account.
+      leaf->FinishAndAccountTowardsRoot(&wakeup_queue_, nullptr, usage, now);
+      RunBusy(now, ret);
     } else {
-      // TODO(barath): Ideally, we wouldn't spin in this case but rather take
-      // the fact that Next() returned nullptr as an indication that everything
-      // is blocked, so we could wait until something is added that unblocks us.
-      // We currently have no functionality to support such whole-scheduler
-      // blocking/unblocking.
-      ++this->stats_.cnt_idle;
+      // Everything is blocked. Spin, or back off if so configured (see
+      // set_idle_sleep_us()).
+      now = RunIdle();
+    }
 
-      now = rdtsc();
-      this->stats_.cycles_idle += (now - this->checkpoint_);
+    checkpoint_ = now;
+  }
+
+  // Called by RunOnce() when there was nothing to run, with the worker
+  // idle since checkpoint_. Returns the time it returned.
+  uint64_t RunIdle() {
+    ++stats_.cnt_idle;
+
+    IdleStage stage = Idle();
+
+    uint64_t now = rdtsc();
+    stats_.cycles_idle += now - checkpoint_;
+    stats_.cycles_idle_stage[stage] += now - checkpoint_;
+    return now;
+  }
+
+  // Called by RunOnce() when it ran a task. A run that yielded no
+  // packets counts as idle (spinning) rather than busy, and if the task asked
+  // to block, the idle backoff keeps going as well.
+  void RunBusy(uint64_t now, const struct task_result &ret) {
+    if (ret.packets) {
+      stats_.cycles_busy += now - checkpoint_;
+      idle_since_ = 0;
+    } else {
+      stats_.cycles_idle += now - checkpoint_;
+      stats_.cycles_idle_stage[IDLE_SPIN] += now - checkpoint_;
+      if (!ret.block) {
+        idle_since_ = 0;
+      }
     }
+  }
 
-    this->checkpoint_ = now;
+ private:
+  // The idle backoff thresholds, in cycles since the worker became idle.
+  // ~12us and ~400us at 2.5GHz.
+  static const uint64_t kIdlePauseCycles = 1ull << 15;
+  static const uint64_t kIdleWaitCycles = 1ull << 20;
+
+  // How long a single tpause may last
+  static const uint64_t kIdleWaitStepCycles = 1ull << 13;
+
+  // Backs off for a while, depending on how long the worker has been idle.
+  // Returns the stage used.
+  IdleStage Idle() {
+    if (!idle_sleep_us_) {
+      return IDLE_SPIN;
+    }
+
+    // ScheduleLoop() checks for pause requests only every so many rounds, and
+    // the wakeup from pause_worker() is consumed by a single sleep. Do not
+    // wait or sleep again until the request has been served.
+    if (ctx.is_pause_requested()) {
+      _mm_pause();
+      return IDLE_PAUSE;
+    }
+
+    if (!idle_since_) {
+      idle_since_ = checkpoint_;
+    }
+
+    uint64_t idle_cycles = checkpoint_ - idle_since_;
+
+    if (idle_cycles < kIdlePauseCycles) {
+      _mm_pause();
+      return IDLE_PAUSE;
+    }
+
+    if (idle_cycles < kIdleWaitCycles) {
+      if (ctx.IdleWait(checkpoint_ + kIdleWaitStepCycles)) {
+        return IDLE_WAIT;
+      }
+      _mm_pause();
+      return IDLE_PAUSE;
+    }
+
+    // A wakeup fd that woke us up last time without making anything runnable
+    // probably belongs to another worker's task. Sleep on the timeout only.
+    bool woken_by_fd = ctx.IdleSleep(idle_sleep_us_, !ignore_wakeup_fds_);
+    ignore_wakeup_fds_ = woken_by_fd;
+    return IDLE_SLEEP;
   }
+
+  uint64_t idle_sleep_us_;
+
+  // When the worker became idle, or 0 if it is busy
+  uint64_t idle_since_;
+
+  bool ignore_wakeup_fds_;
+
+  DISALLOW_COPY_AND_ASSIGN(Scheduler);
 };
 
+// The default scheduler, which picks the first leaf that the TC tree gives it
+// and runs the corresponding task.
+class DefaultScheduler : public Scheduler {
+ public:
+  explicit DefaultScheduler(TrafficClass *root = nullptr) : Scheduler(root) {}
+
+  virtual ~DefaultScheduler() {}
+
+  // Runs the scheduler loop forever.
+  void ScheduleLoop() override { RunLoop(this); }
+
+  // Runs the scheduler once.
+  void ScheduleOnce() { RunOnce(this); }
+};
+
+// Stops polling a leaf for a while when its task returns no packets and asks
+// to block. The poll interval of the leaf doubles with every empty poll, up
+// to about 1M cycles, and halves with every productive one.
 class ExperimentalScheduler : public Scheduler {
  public:
   explicit ExperimentalScheduler(TrafficClass *root = nullptr)
@@ -299,82 +489,80 @@ class ExperimentalScheduler : public Scheduler {
   virtual ~ExperimentalScheduler() {}
 
   // Runs the scheduler loop forever.
-  // Currently a copy-paste from DefaultScheduler so that this is the only
-  // virtual call that is made (i.e., ScheduleOnce() is non-virtual).
-  void ScheduleLoop() override {
-    uint64_t now;
-    // How many rounds to go before we do accounting.
-    const uint64_t accounting_mask = 0xff;
-    static_assert(((accounting_mask + 1) & accounting_mask) == 0,
-                  "Accounting mask must be (2^n)-1");
+  void ScheduleLoop() override { RunLoop(this); }
 
-    this->checkpoint_ = now = rdtsc();
+  // Runs the scheduler once.
+  void ScheduleOnce() { RunOnce(this); }
 
-    // The main scheduling, running, accounting loop.
-    for (uint64_t round = 0;; ++round) {
-      // Periodic check, to mitigate expensive operations.
-      if ((round & accounting_mask) == 0) {
-        if (ctx.is_pause_requested()) {
-          if (ctx.BlockWorker()) {
-            break;
-          }
-        }
-      }
+  // Poll backoff policy, see Scheduler::RunOnce()
+  static const bool kBackoff = true;
 
-      ScheduleOnce();
-    }
+  uint64_t EmptyPollWait(const LeafTrafficClass *leaf) const {
+    constexpr uint64_t kMaxWait = 1ull << 20;
+    return std::min(kMaxWait, leaf->wait_cycles() << 1);
   }
 
-  // Runs the scheduler once.
-  void ScheduleOnce() {
-    resource_arr_t usage;
-
-    // Schedule.
-    LeafTrafficClass *leaf = Scheduler::Next(this->checkpoint_);
-
-    uint64_t now;
-    if (leaf) {
-      ctx.set_current_tsc(this->checkpoint_);  // Tasks see updated tsc.
-      ctx.set_current_ns(this->checkpoint_ * this->ns_per_cycle_);
+  uint64_t ProductivePollWait(const LeafTrafficClass *leaf) const {
+    return (leaf->wait_cycles() + 1) >> 1;
+  }
+};
 
-      // Run.
-      auto ret = (*leaf->task())();
-      now = rdtsc();
+// Like ExperimentalScheduler, stops polling a leaf for a while when its task
+// returns no packets and asks to block (e.g., PortInc on an empty queue), so
+// that a worker with many mostly idle ports spends its cycles on the busy
+// ones. The poll interval of each leaf doubles with every empty poll and
+// halves with every productive one, and is capped so that a packet arriving
+// at an idle port waits for at most about max_poll_latency_us (plus the time
+// to run the task that happens to be running then).
+class AdaptiveScheduler : public Scheduler {
+ public:
+  static const uint64_t kDefaultMaxPollLatencyUs = 50;
+
+  // The poll interval after the first empty poll. Finer than this is below
+  // the resolution of the wakeup queue anyway.
+  static const uint64_t kMinPollIntervalCycles =
+      1ull << SchedWakeupQueue::kTickShift;
+
+  explicit AdaptiveScheduler(
+      TrafficClass *root = nullptr,
+      uint64_t max_poll_latency_us = kDefaultMaxPollLatencyUs)
+      : Scheduler(root),
+        max_poll_interval_cycles_(
+            static_cast<uint64_t>(max_poll_latency_us * (tsc_hz / 1e6))) {
+    if (max_poll_interval_cycles_ < kMinPollIntervalCycles) {
+      max_poll_interval_cycles_ = kMinPollIntervalCycles;
+    }
+  }
 
-      if (ret.packets == 0 && ret.block) {
-        constexpr uint64_t kMaxWait = 1ull << 20;
-        uint64_t wait = std::min(kMaxWait, leaf->wait_cycles() << 1);
-        leaf->set_wait_cycles(wait);
+  virtual ~AdaptiveScheduler() {}
 
-        leaf->blocked_ = true;
-        leaf->wakeup_time_ = now + leaf->wait_cycles();
-        this->wakeup_queue_.Add(leaf);
+  uint64_t max_poll_interval_cycles() const {
+    return max_poll_interval_cycles_;
+  }
 
-        usage[RESOURCE_COUNT] = 0;
-        usage[RESOURCE_CYCLE] = 0;
-        usage[RESOURCE_PACKET] = 0;
-        usage[RESOURCE_BIT] = 0;
-      } else {
-        leaf->set_wait_cycles((leaf->wait_cycles() + 1) >> 1);
+  // Runs the scheduler loop forever.
+  void ScheduleLoop() override { RunLoop(this); }
 
-        usage[RESOURCE_COUNT] = 1;
-        usage[RESOURCE_CYCLE] = now - this->checkpoint_;
-        usage[RESOURCE_PACKET] = ret.packets;
-        usage[RESOURCE_BIT] = ret.bits;
-      }
+  // Runs the scheduler once.
+  void ScheduleOnce() { RunOnce(this); }
 
-      // Account.
-      leaf->FinishAndAccountTowardsRoot(&this->wakeup_queue_, nullptr, usage,
-                                        now);
-    } else {
-      ++this->stats_.cnt_idle;
+  // Poll backoff policy, see Scheduler::RunOnce()
+  static const bool kBackoff = true;
 
-      now = rdtsc();
-      this->stats_.cycles_idle += (now - this->checkpoint_);
+  uint64_t EmptyPollWait(const LeafTrafficClass *leaf) const {
+    uint64_t wait = leaf->wait_cycles() << 1;
+    if (wait < kMinPollIntervalCycles) {
+      return kMinPollIntervalCycles;
     }
+    return std::min(wait, max_poll_interval_cycles_);
+  }
 
-    this->checkpoint_ = now;
+  uint64_t ProductivePollWait(const LeafTrafficClass *leaf) const {
+    return leaf->wait_cycles() >> 1;
   }
+
+ private:
+  uint64_t max_poll_interval_cycles_;
 };
 
 }  // namespace bess
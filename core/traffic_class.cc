@@ -433,9 +433,7 @@ void RoundRobinTrafficClass::FinishAndAccountTowardsRoot(
 }
 
 RateLimitTrafficClass::~RateLimitTrafficClass() {
-  // TODO(barath): Ensure that when this destructor is called this instance is
-  // also cleared out of the wakeup_queue_ in Scheduler if it is present
-  // there.
+  // ~TrafficClass() takes this class out of the wakeup queue if necessary.
   delete child_;
   TrafficClassBuilder::Clear(this);
 }
@@ -507,8 +505,7 @@ void RateLimitTrafficClass::FinishAndAccountTowardsRoot(
 
     if (limit_) {
       uint64_t wait_tsc = (consumed - tokens) / limit_;
-      wakeup_time_ = tsc + wait_tsc;
-      wakeup_queue->Add(this);
+      wakeup_queue->Add(this, tsc + wait_tsc);
     }
   } else {
     // Still has some tokens, unthrottled.
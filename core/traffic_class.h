@@ -81,6 +81,11 @@ typedef int32_t resource_share_t;
 struct tc_stats {
   resource_arr_t usage;
   uint64_t cnt_throttled;
+
+  // Leaves only: how many times the task ran, and how many of those runs
+  // yielded packets.
+  uint64_t cnt_polls;
+  uint64_t cnt_poll_hits;
 };
 
 class Scheduler;
@@ -168,7 +173,7 @@ class TCChildArgs {
 // schedulable task units.
 class TrafficClass {
  public:
-  virtual ~TrafficClass() {}
+  virtual ~TrafficClass() { UnlinkWakeup(); }
 
   // Returns the number of TCs in the TC subtree rooted at this, including
   // this TC.
@@ -223,6 +228,8 @@ class TrafficClass {
         name_(name),
         stats_(),
         wakeup_time_(),
+        wakeup_next_(),
+        wakeup_pprev_(),
         blocked_(blocked),
         policy_(policy) {}
 
@@ -278,6 +285,28 @@ class TrafficClass {
   friend class Scheduler;
   friend class DefaultScheduler;
   friend class ExperimentalScheduler;
+  friend class AdaptiveScheduler;
+  friend class SchedWakeupQueue;
+
+  // Removes this class from the SchedWakeupQueue slot it is linked in, if any.
+  void UnlinkWakeup() {
+    if (!wakeup_pprev_) {
+      return;
+    }
+
+    *wakeup_pprev_ = wakeup_next_;
+    if (wakeup_next_) {
+      wakeup_next_->wakeup_pprev_ = wakeup_pprev_;
+    }
+    wakeup_next_ = nullptr;
+    wakeup_pprev_ = nullptr;
+  }
+
+  // Intrusive links for SchedWakeupQueue. wakeup_pprev_ points to whatever
+  // points to this class (a slot head or the previous class' wakeup_next_),
+  // or is nullptr if this class is not in the queue.
+  TrafficClass *wakeup_next_;
+  TrafficClass **wakeup_pprev_;
 
   bool blocked_;
 
@@ -560,7 +589,8 @@ class LeafTrafficClass final : public TrafficClass {
   explicit LeafTrafficClass(const std::string &name, const Task &task)
       : TrafficClass(name, POLICY_LEAF, false),
         task_(task),
-        wait_cycles_(kInitialWaitCycles) {
+        wait_cycles_(kInitialWaitCycles),
+        migratable_() {
     task_.Attach(this);
   }
 
@@ -577,6 +607,16 @@ class LeafTrafficClass final : public TrafficClass {
 
   void set_wait_cycles(uint64_t wait_cycles) { wait_cycles_ = wait_cycles; }
 
+  // Whether the task may be moved to another worker by rebalance_workers()
+  bool migratable() const { return migratable_; }
+  void set_migratable(bool migratable) { migratable_ = migratable; }
+
+  // Records a run of the task that yielded `packets` packets.
+  void AccountPoll(uint32_t packets) {
+    stats_.cnt_polls++;
+    stats_.cnt_poll_hits += (packets != 0);
+  }
+
   void BlockTowardsRoot() override {
     TrafficClass::BlockTowardsRootSetBlocked(false);
   }
@@ -602,6 +642,8 @@ class LeafTrafficClass final : public TrafficClass {
   Task task_;
 
   uint64_t wait_cycles_;
+
+  bool migratable_;
 };
 
 class PriorityChildArgs : public TCChildArgs {
@@ -227,6 +227,146 @@ BENCHMARK_REGISTER_F(TCRoundRobin, TCScheduleOnce)
     ->Args({4 << 14})
     ->Complexity();
 
+// Round robin over rate-limited leaves, e.g., for per-tenant shaping. The
+// aggregate limit exceeds what the scheduler can run, so most of the rate
+// limiters are throttled and waiting in the wakeup queue at any time.
+class TCRateLimited : public benchmark::Fixture {
+ public:
+  TCRateLimited() : s_(), dummy_() {}
+
+  void SetUp(benchmark::State &state) override {
+    int num_classes = state.range(0);
+
+    dummy_ = new DummyModule;
+
+    TrafficClass *root = CT("rr", {ROUND_ROBIN}, {});
+    s_ = new DefaultScheduler(root);
+    RoundRobinTrafficClass *rr =
+        static_cast<RoundRobinTrafficClass *>(TrafficClassBuilder::Find("rr"));
+
+    for (int i = 0; i < num_classes; i++) {
+      std::string name("class_" + std::to_string(i));
+      TrafficClass *c =
+          CT("limit_" + std::to_string(i),
+             {RATE_LIMIT, RESOURCE_COUNT, 10000, 0},
+             {CT(name, {LEAF, Task(dummy_, nullptr)})});
+
+      CHECK(rr->AddChild(c));
+    }
+    CHECK(!rr->blocked());
+  }
+
+  void TearDown(benchmark::State &) override {
+    delete s_;
+    s_ = nullptr;
+
+    delete dummy_;
+    dummy_ = nullptr;
+
+    TrafficClassBuilder::ClearAll();
+  }
+
+ protected:
+  DefaultScheduler *s_;
+  Module *dummy_;
+};
+
+BENCHMARK_DEFINE_F(TCRateLimited, TCScheduleOnce)(benchmark::State &state) {
+  while (state.KeepRunning()) {
+    s_->ScheduleOnce();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK_REGISTER_F(TCRateLimited, TCScheduleOnce)
+    ->Args({10})
+    ->Args({100})
+    ->Args({1000})
+    ->Args({10000})
+    ->Complexity();
+
+// A port-polling task: returns a full burst if arg is non-null (a busy port),
+// or asks to block otherwise (an idle port).
+class PollModule : public Module {
+ public:
+  struct task_result RunTask(void *arg) override;
+};
+
+[[gnu::noinline]] struct task_result PollModule::RunTask(void *arg) {
+  if (arg) {
+    return {.block = false, .packets = 32, .bits = 32 * 64 * 8};
+  }
+  return {.block = true, .packets = 0, .bits = 0};
+}
+
+// Round robin over many idle ports and one busy port, on the default
+// (state.range(1) == 0) or the adaptive scheduler. Items processed are the
+// packets of the busy port.
+class TCIdlePorts : public benchmark::Fixture {
+ public:
+  TCIdlePorts() : s_(), poll_(), busy_() {}
+
+  void SetUp(benchmark::State &state) override {
+    int num_idle = state.range(0);
+
+    poll_ = new PollModule;
+
+    TrafficClass *root = CT("rr", {ROUND_ROBIN}, {});
+    if (state.range(1)) {
+      s_ = new AdaptiveScheduler(root);
+    } else {
+      s_ = new DefaultScheduler(root);
+    }
+    RoundRobinTrafficClass *rr =
+        static_cast<RoundRobinTrafficClass *>(TrafficClassBuilder::Find("rr"));
+
+    for (int i = 0; i < num_idle; i++) {
+      std::string name("idle_" + std::to_string(i));
+      CHECK(rr->AddChild(CT(name, {LEAF, Task(poll_, nullptr)})));
+    }
+
+    busy_ = static_cast<LeafTrafficClass *>(
+        CT("busy", {LEAF, Task(poll_, poll_)}));
+    CHECK(rr->AddChild(busy_));
+  }
+
+  void TearDown(benchmark::State &) override {
+    delete s_;
+    s_ = nullptr;
+
+    delete poll_;
+    poll_ = nullptr;
+
+    TrafficClassBuilder::ClearAll();
+  }
+
+ protected:
+  Scheduler *s_;
+  Module *poll_;
+  LeafTrafficClass *busy_;
+};
+
+BENCHMARK_DEFINE_F(TCIdlePorts, TCScheduleOnce)(benchmark::State &state) {
+  // ScheduleOnce() is not virtual
+  if (state.range(1)) {
+    AdaptiveScheduler *s = static_cast<AdaptiveScheduler *>(s_);
+    while (state.KeepRunning()) {
+      s->ScheduleOnce();
+    }
+  } else {
+    DefaultScheduler *s = static_cast<DefaultScheduler *>(s_);
+    while (state.KeepRunning()) {
+      s->ScheduleOnce();
+    }
+  }
+  state.SetItemsProcessed(busy_->stats().usage[RESOURCE_PACKET]);
+}
+
+BENCHMARK_REGISTER_F(TCIdlePorts, TCScheduleOnce)
+    ->Args({64, 0})
+    ->Args({64, 1});
+
 }  // namespace
 
 BENCHMARK_MAIN();
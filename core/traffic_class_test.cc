@@ -33,6 +33,7 @@
 
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 
 #include "module.h"
@@ -616,4 +617,200 @@ TEST(RateLimit, BasicBlockUnblock) {
   TrafficClassBuilder::ClearAll();
 }
 
+class SchedWakeupQueueTest : public ::testing::Test {
+ protected:
+  static const uint64_t kTick = 1ull << SchedWakeupQueue::kTickShift;
+  static const uint64_t kTurn = SchedWakeupQueue::kNumSlots * kTick;
+
+  virtual void SetUp() {
+    Task t(nullptr, nullptr);
+    for (int i = 0; i < 4; i++) {
+      tcs_[i].reset(CT("leaf_" + std::to_string(i), {LEAF, t}));
+      ASSERT_NE(nullptr, tcs_[i].get());
+    }
+  }
+
+  virtual void TearDown() { TrafficClassBuilder::ClearAll(); }
+
+  TrafficClass *tc(int i) { return tcs_[i].get(); }
+
+  void Add(int i, uint64_t wakeup_time) { q_.Add(tc(i), wakeup_time); }
+
+  void Remove(int i) { q_.Remove(tc(i)); }
+
+  // Returns the classes that expired
+  std::set<TrafficClass *> Expire(uint64_t tsc) {
+    std::set<TrafficClass *> ret;
+    q_.Expire(tsc, [&ret](TrafficClass *c) { ret.insert(c); });
+    return ret;
+  }
+
+  SchedWakeupQueue q_;
+  std::unique_ptr<TrafficClass> tcs_[4];
+};
+
+const uint64_t SchedWakeupQueueTest::kTick;
+const uint64_t SchedWakeupQueueTest::kTurn;
+
+typedef std::set<TrafficClass *> TcSet;
+
+// Tests expiration of classes due within one turn of the wheel.
+TEST_F(SchedWakeupQueueTest, WithinOneTurn) {
+  Add(0, 5 * kTick);
+  Add(1, 10 * kTick);
+  Add(2, 100 * kTick + 10);
+
+  EXPECT_EQ(TcSet({tc(0)}), Expire(6 * kTick));
+  EXPECT_EQ(TcSet(), Expire(9 * kTick));
+  EXPECT_EQ(TcSet({tc(1)}), Expire(11 * kTick));
+
+  // Not due yet, although in the tick of tsc
+  EXPECT_EQ(TcSet(), Expire(100 * kTick + 5));
+  EXPECT_EQ(TcSet({tc(2)}), Expire(100 * kTick + 20));
+  EXPECT_EQ(TcSet(), Expire(200 * kTick));
+
+  // Overdue classes expire with the next call
+  Add(3, 50 * kTick);
+  EXPECT_EQ(TcSet({tc(3)}), Expire(201 * kTick));
+}
+
+// Tests that Add() moves a class that is already in the queue, and that
+// Remove() works on any class in a slot, not only the head.
+TEST_F(SchedWakeupQueueTest, AddAgainAndRemove) {
+  Add(0, 5 * kTick);
+  Add(0, 50 * kTick);
+  EXPECT_EQ(TcSet(), Expire(10 * kTick));
+  EXPECT_EQ(TcSet({tc(0)}), Expire(51 * kTick));
+
+  // All in the same slot. The last one added is the head.
+  Add(0, 60 * kTick + 1);
+  Add(1, 60 * kTick + 2);
+  Add(2, 60 * kTick + 3);
+  Add(3, 60 * kTick + 4);
+  Remove(1);  // middle
+  Remove(0);  // tail
+  EXPECT_EQ(TcSet({tc(2), tc(3)}), Expire(61 * kTick));
+
+  Add(0, 70 * kTick);
+  Add(1, 70 * kTick);
+  Remove(1);  // head
+  Remove(1);  // no-op
+  EXPECT_EQ(TcSet({tc(0)}), Expire(71 * kTick));
+  EXPECT_EQ(TcSet(), Expire(100 * kTick));
+}
+
+// Tests classes that are due several turns of the wheel later, which share
+// their slot with classes due earlier.
+TEST_F(SchedWakeupQueueTest, AcrossTurns) {
+  Add(0, 3 * kTurn + 100);
+  Add(1, 1000);
+  Add(2, kTurn + 2000);
+
+  EXPECT_EQ(TcSet({tc(1)}), Expire(kTurn / 2));
+  EXPECT_EQ(TcSet(), Expire(kTurn));
+  EXPECT_EQ(TcSet({tc(2)}), Expire(kTurn + 4 * kTick));
+
+  // tc(0) is skipped at every turn until the one it is due in
+  for (uint64_t tsc = 2 * kTurn; tsc <= 3 * kTurn; tsc += kTurn / 4) {
+    EXPECT_EQ(TcSet(), Expire(tsc)) << tsc;
+  }
+
+  EXPECT_EQ(TcSet(), Expire(3 * kTurn + 50));
+  EXPECT_EQ(TcSet({tc(0)}), Expire(3 * kTurn + 200));
+}
+
+// Tests that no class is missed when Expire() is not called for more than a
+// turn of the wheel, and that the wheel keeps working after that.
+TEST_F(SchedWakeupQueueTest, LongPause) {
+  Add(0, 10 * kTurn + 5000);
+  Add(1, 5 * kTurn);
+  Add(2, 30 * kTurn);
+  EXPECT_EQ(TcSet(), Expire(kTick));
+
+  EXPECT_EQ(TcSet({tc(0), tc(1)}), Expire(20 * kTurn));
+
+  // More than a full turn away from now
+  Add(3, 21 * kTurn + kTurn / 2);
+  EXPECT_EQ(TcSet(), Expire(21 * kTurn));
+  EXPECT_EQ(TcSet({tc(3)}), Expire(22 * kTurn));
+  EXPECT_EQ(TcSet(), Expire(29 * kTurn));
+  EXPECT_EQ(TcSet({tc(2)}), Expire(31 * kTurn));
+}
+
+class PollModule : public Module {
+ public:
+  struct task_result RunTask(void *arg) override;
+};
+
+// Polls a busy "port" if arg is non-null, an idle one otherwise.
+[[gnu::noinline]] struct task_result PollModule::RunTask(void *arg) {
+  if (arg) {
+    return {.block = false, .packets = 32, .bits = 32 * 64 * 8};
+  }
+  return {.block = true, .packets = 0, .bits = 0};
+}
+
+// Tests that the adaptive scheduler stops polling an idle leaf for a while,
+// and keeps polling a busy one.
+TEST(AdaptiveScheduleOnce, IdleAndBusyLeaves) {
+  PollModule pm;
+  AdaptiveScheduler s(
+      CT("root", {ROUND_ROBIN},
+         {{CT("leaf_idle", {LEAF, Task(&pm, nullptr)})},
+          {CT("leaf_busy", {LEAF, Task(&pm, &pm)})}}),
+      100);
+
+  LeafTrafficClass *leaf_idle =
+      static_cast<LeafTrafficClass *>(TrafficClassBuilder::Find("leaf_idle"));
+  LeafTrafficClass *leaf_busy =
+      static_cast<LeafTrafficClass *>(TrafficClassBuilder::Find("leaf_busy"));
+
+  ASSERT_EQ(leaf_idle, s.Next(rdtsc()));
+  s.ScheduleOnce();
+  ASSERT_TRUE(leaf_idle->blocked());
+  EXPECT_EQ(LeafTrafficClass::kInitialWaitCycles << 1,
+            leaf_idle->wait_cycles());
+  EXPECT_EQ(1, leaf_idle->stats().cnt_polls);
+  EXPECT_EQ(0, leaf_idle->stats().cnt_poll_hits);
+
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(leaf_busy, s.Next(rdtsc()));
+    s.ScheduleOnce();
+  }
+  EXPECT_FALSE(leaf_busy->blocked());
+  EXPECT_EQ(3, leaf_busy->stats().cnt_polls);
+  EXPECT_EQ(3, leaf_busy->stats().cnt_poll_hits);
+  EXPECT_EQ(3 * 32, leaf_busy->stats().usage[RESOURCE_PACKET]);
+
+  // The idle leaf is polled again once its interval is over.
+  s.Next(rdtsc() + s.max_poll_interval_cycles() * 2);
+  EXPECT_FALSE(leaf_idle->blocked());
+
+  TrafficClassBuilder::ClearAll();
+}
+
+// Tests that the poll interval of an idle leaf is capped.
+TEST(AdaptiveScheduleOnce, MaxPollInterval) {
+  PollModule pm;
+  AdaptiveScheduler s(CT("leaf_idle", {LEAF, Task(&pm, nullptr)}), 10);
+
+  LeafTrafficClass *leaf_idle =
+      static_cast<LeafTrafficClass *>(TrafficClassBuilder::Find("leaf_idle"));
+  uint64_t min_interval = AdaptiveScheduler::kMinPollIntervalCycles;
+  ASSERT_LT(min_interval, s.max_poll_interval_cycles());
+
+  for (int i = 0; i < 20; i++) {
+    // Wake it up, if it is blocked, and poll it
+    ASSERT_EQ(leaf_idle, s.Next(rdtsc() + s.max_poll_interval_cycles() * 2));
+    s.ScheduleOnce();
+    ASSERT_TRUE(leaf_idle->blocked());
+    ASSERT_LE(leaf_idle->wait_cycles(), s.max_poll_interval_cycles());
+  }
+  EXPECT_EQ(s.max_poll_interval_cycles(), leaf_idle->wait_cycles());
+  EXPECT_EQ(20, leaf_idle->stats().cnt_polls);
+  EXPECT_EQ(0, leaf_idle->stats().cnt_poll_hits);
+
+  TrafficClassBuilder::ClearAll();
+}
+
 }  // namespace bess
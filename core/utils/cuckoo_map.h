@@ -49,6 +49,7 @@
 #include <glog/logging.h>
 
 #include "../debug.h"
+#include "../mem_alloc.h"
 #include "common.h"
 
 namespace bess {
@@ -147,12 +148,13 @@ class CuckooMap {
     size_t slot_idx_;
   };
 
+  // The table is allocated on NUMA node `socket` (anywhere if negative)
   CuckooMap(size_t reserve_buckets = kInitNumBucket,
-            size_t reserve_entries = kInitNumEntries)
+            size_t reserve_entries = kInitNumEntries, int socket = -1)
       : bucket_mask_(reserve_buckets - 1),
         num_entries_(0),
-        buckets_(reserve_buckets),
-        entries_(reserve_entries),
+        buckets_(reserve_buckets, Bucket(), BucketAllocator(socket)),
+        entries_(reserve_entries, Entry(), EntryAllocator(socket)),
         free_entry_indices_() {
     // the number of buckets must be a power of 2
     CHECK_EQ(align_ceil_pow2(reserve_buckets), reserve_buckets);
@@ -265,6 +267,32 @@ class CuckooMap {
   // Return the number of stored entries
   size_t Count() const { return num_entries_; }
 
+  // NUMA node the table is allocated on, or -1 if none in particular
+  int socket() const { return buckets_.get_allocator().socket(); }
+
+  // Moves the table to NUMA node `socket`, where it will also grow from now
+  // on. Like updates, this is not thread-safe with lookups.
+  void MoveToSocket(int socket) {
+    buckets_ = BucketVector(buckets_.begin(), buckets_.end(),
+                            BucketAllocator(socket));
+    entries_ = EntryVector(entries_.begin(), entries_.end(),
+                           EntryAllocator(socket));
+  }
+
+  // Make room for n entries in total, so that inserting many entries at once
+  // does not grow (and rehash) the table over and over again
+  void Reserve(size_t n, const H& hasher = H(), const E& eq = E()) {
+    if (n > entries_.size()) {
+      ExpandEntries(n);
+    }
+
+    // Cuckoo insertion gets slower, and fails more often, as buckets fill up
+    size_t num_buckets = align_ceil_pow2(n * 2 / kEntriesPerBucket);
+    if (num_buckets > buckets_.size()) {
+      ExpandBuckets(hasher, eq, num_buckets);
+    }
+  }
+
  protected:
   // Tunable macros
   static const int kInitNumBucket = 4;
@@ -489,9 +517,9 @@ class CuckooMap {
   }
 
   // Resize the space of entries. Grow less aggressively than buckets.
-  void ExpandEntries() {
+  void ExpandEntries(size_t min_size = 0) {
     size_t old_size = entries_.size();
-    size_t new_size = old_size + old_size / 2;
+    size_t new_size = std::max(old_size + old_size / 2, min_size);
 
     entries_.resize(new_size);
 
@@ -501,8 +529,11 @@ class CuckooMap {
   }
 
   // Resize the space of buckets, and rehash existing entries
-  void ExpandBuckets(const H& hasher, const E& eq) {
-    CuckooMap<K, V, H, E> bigger(buckets_.size() * 2, entries_.size());
+  void ExpandBuckets(const H& hasher, const E& eq, size_t num_buckets = 0) {
+    if (num_buckets == 0) {
+      num_buckets = buckets_.size() * 2;
+    }
+    CuckooMap<K, V, H, E> bigger(num_buckets, entries_.size(), socket());
 
     for (const auto& e : *this) {
       // While very unlikely, this insert() may cause recursive expansion
@@ -525,9 +556,14 @@ class CuckooMap {
   // # of entries
   size_t num_entries_;
 
+  typedef bess::SocketAllocator<Bucket> BucketAllocator;
+  typedef bess::SocketAllocator<Entry> EntryAllocator;
+  typedef std::vector<Bucket, BucketAllocator> BucketVector;
+  typedef std::vector<Entry, EntryAllocator> EntryVector;
+
   // bucket and entry arrays grow independently
-  std::vector<Bucket> buckets_;
-  std::vector<Entry> entries_;
+  BucketVector buckets_;
+  EntryVector entries_;
 
   // Stack of free entries
   std::stack<EntryIndex> free_entry_indices_;
@@ -114,6 +114,55 @@ TEST(CuckooMapTest, Clear) {
   EXPECT_FALSE(cuckoo.Remove(2));
 }
 
+// Reserve() keeps existing entries, and makes room for new ones
+TEST(CuckooMapTest, Reserve) {
+  CuckooMap<uint32_t, uint16_t> cuckoo;
+
+  for (uint32_t i = 0; i < 100; i++) {
+    cuckoo.Insert(i, i);
+  }
+
+  cuckoo.Reserve(10000);
+  EXPECT_EQ(cuckoo.Count(), 100);
+
+  for (uint32_t i = 100; i < 10000; i++) {
+    ASSERT_NE(cuckoo.Insert(i, i), nullptr);
+  }
+  EXPECT_EQ(cuckoo.Count(), 10000);
+
+  for (uint32_t i = 0; i < 10000; i++) {
+    auto *entry = cuckoo.Find(i);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->second, i);
+  }
+}
+
+// Moving the table to another socket keeps its contents, and it keeps growing
+// on the new socket
+TEST(CuckooMapTest, MoveToSocket) {
+  CuckooMap<uint32_t, uint16_t> cuckoo;
+  EXPECT_EQ(cuckoo.socket(), -1);
+
+  for (uint32_t i = 0; i < 100; i++) {
+    cuckoo.Insert(i, i);
+  }
+
+  cuckoo.MoveToSocket(0);
+  EXPECT_EQ(cuckoo.socket(), 0);
+  EXPECT_EQ(cuckoo.Count(), 100);
+
+  for (uint32_t i = 100; i < 1000; i++) {
+    ASSERT_NE(cuckoo.Insert(i, i), nullptr);
+  }
+  EXPECT_EQ(cuckoo.socket(), 0);
+
+  for (uint32_t i = 0; i < 1000; i++) {
+    auto *entry = cuckoo.Find(i);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->second, i);
+  }
+}
+
 // Test iterators
 TEST(CuckooMapTest, Iterator) {
   CuckooMap<uint32_t, uint16_t> cuckoo;
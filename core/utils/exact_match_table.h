@@ -184,10 +184,23 @@ class ExactMatchTable {
       return err;
     }
 
-    table_.Insert(key, val, ExactMatchKeyHash(total_key_size_),
-                  ExactMatchKeyEq(total_key_size_));
+    return InsertKey(key, val);
+  }
 
-    return MakeError(0);
+  // Add a new rule, with the values of all fields given back to back in
+  // `values` (raw_key_size() bytes in total), as they appear in packets.
+  // Faster than AddRule() for adding many rules at once.
+  // Returns 0 on success, non-zero errno on failure.
+  Error AddRawRule(const T &val, const void *values) {
+    ExactMatchKey key = {};
+    memcpy(&key, values, raw_key_size_);
+    return InsertKey(key, val);
+  }
+
+  // Make room for `n` rules in total.
+  void Reserve(size_t n) {
+    table_.Reserve(n, ExactMatchKeyHash(total_key_size_),
+                   ExactMatchKeyEq(total_key_size_));
   }
 
   // Delete an existing rule.
@@ -219,6 +232,9 @@ class ExactMatchTable {
   // Remove all rules from the table.
   void ClearRules() { table_.Clear(); }
 
+  // Move the rules to NUMA node `socket`. Not thread-safe with lookups.
+  void MoveToSocket(int socket) { table_.MoveToSocket(socket); }
+
   size_t Size() const { return table_.Count(); }
 
   // Extract an ExactMatchKey from `buf` based on the fields that have been
@@ -293,6 +309,9 @@ class ExactMatchTable {
 
   uint32_t total_key_size() const { return total_key_size_; }
 
+  // The size of all fields, without padding
+  size_t raw_key_size() const { return raw_key_size_; }
+
   // Set the `idx`th field of this table to one at offset `offset` bytes into a
   // buffer with length `size` and mask `mask`.
   // Returns 0 on success, non-zero errno on failure.
@@ -313,6 +332,17 @@ class ExactMatchTable {
     return DoAddField(f, mt_attr_name, idx, m);
   }
 
+  // Makes this table match on the same fields as `other` does, e.g., to set
+  // up a copy of it. Call it before adding any rules.
+  void CopyFields(const ExactMatchTable &other) {
+    raw_key_size_ = other.raw_key_size_;
+    total_key_size_ = other.total_key_size_;
+    num_fields_ = other.num_fields_;
+    for (size_t i = 0; i < MAX_FIELDS; i++) {
+      fields_[i] = other.fields_[i];
+    }
+  }
+
   size_t num_fields() const { return num_fields_; }
 
   // Returns the ith field.
@@ -327,6 +357,14 @@ class ExactMatchTable {
     return std::make_pair(code, msg);
   }
 
+  Error InsertKey(const ExactMatchKey &key, const T &val) {
+    if (!table_.Insert(key, val, ExactMatchKeyHash(total_key_size_),
+                       ExactMatchKeyEq(total_key_size_))) {
+      return MakeError(ENOMEM, "not enough space in the table");
+    }
+    return MakeError(0);
+  }
+
   // Turn a rule into a key.
   // Returns 0 on success, non-zero errno on failure.
   Error gather_key(const ExactMatchRuleFields &fields, ExactMatchKey *key) {
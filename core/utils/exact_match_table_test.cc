@@ -111,6 +111,33 @@ TEST(EmTableTest, LookupTwoFieldsTwoRules) {
   EXPECT_EQ(0xDEAD, em.Find(keys[2], 0xDEAD));
 }
 
+TEST(EmTableTest, LookupRawRule) {
+  ExactMatchTable<uint16_t> em;
+  ASSERT_EQ(0, em.AddField(0, 4, 0, 0).first);
+  ASSERT_EQ(0, em.AddField(6, 2, 0, 1).first);
+  const uint8_t values[] = {0x04, 0x03, 0x02, 0x01, 0x06, 0x05};
+  ASSERT_EQ(sizeof(values), em.raw_key_size());
+  uint64_t buf = 0x0506000001020304;
+  ASSERT_EQ(0, em.AddRawRule(0xBEEF, values).first);
+  EXPECT_EQ(0xBEEF, em.Find(em.MakeKey(&buf), 0xDEAD));
+  EXPECT_EQ(1, em.Size());
+}
+
+TEST(EmTableTest, CopyFields) {
+  ExactMatchTable<uint16_t> em;
+  ASSERT_EQ(0, em.AddField(0, 4, 0, 0).first);
+  ASSERT_EQ(0, em.AddField(6, 2, 0, 1).first);
+  ExactMatchTable<uint16_t> copy;
+  copy.CopyFields(em);
+  ASSERT_EQ(2, copy.num_fields());
+  EXPECT_EQ(em.total_key_size(), copy.total_key_size());
+  ExactMatchRuleFields rule = {{0x04, 0x03, 0x02, 0x01}, {0x06, 0x05}};
+  uint64_t buf = 0x0506000001020304;
+  ASSERT_EQ(0, copy.AddRule(0xBEEF, rule).first);
+  EXPECT_EQ(0xBEEF, copy.Find(copy.MakeKey(&buf), 0xDEAD));
+  EXPECT_EQ(0xDEAD, em.Find(em.MakeKey(&buf), 0xDEAD));
+}
+
 // This test is for a specific bug introduced at one point
 // where the MakeKeys function didn't clear out any random
 // crud that might be on the stack.
@@ -0,0 +1,189 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "header_classifier.h"
+
+#include <cstring>
+
+#include "simd.h"
+
+namespace bess {
+namespace utils {
+
+#if __AVX2__
+
+// The fast path: untagged IPv4 without options. The TCP flags byte at
+// offset 47 is the last one we look at.
+static const int kFastMinLen = 48;
+static const uint8_t kFastL3Offset = 14;
+static const uint8_t kFastL4Offset = 34;
+
+// Loads the 4 bytes at data + offset of 8 packets, skipping packets whose
+// lane in mask is zero (their result lanes are zero).
+static inline __m256i gather_u32(__m256i addr_lo, __m256i addr_hi,
+                                 __m128i mask_lo, __m128i mask_hi,
+                                 int offset) {
+  const __m256i off = _mm256_set1_epi64x(offset);
+  const __m128i zero = _mm_setzero_si128();
+  const int *base = nullptr;
+
+  __m128i lo = _mm256_mask_i64gather_epi32(
+      zero, base, _mm256_add_epi64(addr_lo, off), mask_lo, 1);
+  __m128i hi = _mm256_mask_i64gather_epi32(
+      zero, base, _mm256_add_epi64(addr_hi, off), mask_hi, 1);
+  return concat_two_m128i(lo, hi);
+}
+
+void HeaderClassifier::ClassifyAvx2(const void *const *data,
+                                    const uint16_t *len, int cnt,
+                                    Result *res) {
+  const __m256i min_len = _mm256_set1_epi32(kFastMinLen - 1);
+  const __m256i ipv4_mask = _mm256_set1_epi32(0x00ffffff);
+  const __m256i ipv4_val = _mm256_set1_epi32(0x00450008);  // 0x0800, 0x45
+  const __m256i frag_mask = _mm256_set1_epi32(0x0000ff1f);
+  const __m256i dscp_mask = _mm256_set1_epi32(0x3f);
+  const __m256i proto_tcp = _mm256_set1_epi32(Ipv4::Proto::kTcp);
+  const __m256i proto_udp = _mm256_set1_epi32(Ipv4::Proto::kUdp);
+  const __m256i proto_icmp = _mm256_set1_epi32(Ipv4::Proto::kIcmp);
+  const __m256i syn = _mm256_set1_epi32(kTcpSynFlag);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i two = _mm256_set1_epi32(2);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i l4_offset = _mm256_set1_epi32(kFastL4Offset);
+  const __m256i unpack_idx = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  const uint64_t l3_bytes = 0x0101010101010101ull * kFastL3Offset;
+
+  memset(res->cnt, 0, sizeof(res->cnt));
+
+  int i;
+  for (i = 0; i + 8 <= cnt; i += 8) {
+    __m256i addr_lo =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    __m256i addr_hi =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 4));
+    __m256i lens = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(len + i)));
+
+    // Do not touch bytes beyond the headers of short packets
+    __m256i ok = _mm256_cmpgt_epi32(lens, min_len);
+    __m128i ok_lo = _mm256_castsi256_si128(ok);
+    __m128i ok_hi = _mm256_extracti128_si256(ok, 1);
+
+    // ether type, version/IHL, TOS
+    __m256i w0 = gather_u32(addr_lo, addr_hi, ok_lo, ok_hi, 12);
+    // fragment offset, TTL, protocol
+    __m256i w1 = gather_u32(addr_lo, addr_hi, ok_lo, ok_hi, 20);
+
+    __m256i fast = _mm256_and_si256(
+        ok, _mm256_cmpeq_epi32(_mm256_and_si256(w0, ipv4_mask), ipv4_val));
+    fast = _mm256_and_si256(
+        fast, _mm256_cmpeq_epi32(_mm256_and_si256(w1, frag_mask), zero));
+
+    int fast_bits = _mm256_movemask_ps(_mm256_castsi256_ps(fast));
+    if (fast_bits == 0) {
+      for (int j = 0; j < 8; j++) {
+        ClassifyOne(data[i + j], len[i + j], i + j, res);
+      }
+      continue;
+    }
+
+    __m128i fast_lo = _mm256_castsi256_si128(fast);
+    __m128i fast_hi = _mm256_extracti128_si256(fast, 1);
+    __m256i src = gather_u32(addr_lo, addr_hi, fast_lo, fast_hi, 26);
+    __m256i dst = gather_u32(addr_lo, addr_hi, fast_lo, fast_hi, 30);
+    __m256i ports = gather_u32(addr_lo, addr_hi, fast_lo, fast_hi, 34);
+    __m256i w5 = gather_u32(addr_lo, addr_hi, fast_lo, fast_hi, 44);
+
+    __m256i proto = _mm256_srli_epi32(w1, 24);
+    __m256i is_tcp = _mm256_cmpeq_epi32(proto, proto_tcp);
+    __m256i is_udp = _mm256_cmpeq_epi32(proto, proto_udp);
+    __m256i has_l4 = _mm256_or_si256(
+        _mm256_or_si256(is_tcp, is_udp),
+        _mm256_cmpeq_epi32(proto, proto_icmp));
+
+    __m256i flags = _mm256_and_si256(_mm256_srli_epi32(w5, 24), is_tcp);
+    __m256i is_syn = _mm256_cmpeq_epi32(_mm256_and_si256(flags, syn), syn);
+
+    // kIpv4 + 1 (kUdp), + 2 (kTcp), + 3 (kTcpSyn)
+    __m256i cls = one;
+    cls = _mm256_add_epi32(cls, _mm256_and_si256(is_udp, one));
+    cls = _mm256_add_epi32(cls, _mm256_and_si256(is_tcp, two));
+    cls = _mm256_add_epi32(cls, _mm256_and_si256(is_syn, one));
+
+    ports = _mm256_and_si256(ports, has_l4);
+    __m256i l4 = _mm256_and_si256(has_l4, l4_offset);
+    __m256i dscp = _mm256_and_si256(_mm256_srli_epi32(w0, 26), dscp_mask);
+
+    // Narrow cls, l4, dscp and flags to bytes, 8 of each in a row, and store
+    // them for all 8 packets. ClassifyOne() overwrites the slow ones below.
+    __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(cls, l4),
+                                         _mm256_packus_epi32(dscp, flags));
+    packed = _mm256_permutevar8x32_epi32(packed, unpack_idx);
+
+    alignas(32) uint64_t bytes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(bytes), packed);
+    memcpy(&res->cls[i], &bytes[0], 8);
+    memcpy(&res->l3_offset[i], &l3_bytes, 8);
+    memcpy(&res->l4_offset[i], &bytes[1], 8);
+    memcpy(&res->dscp[i], &bytes[2], 8);
+    memcpy(&res->tcp_flags[i], &bytes[3], 8);
+
+    alignas(32) uint32_t v_src[8];
+    alignas(32) uint32_t v_dst[8];
+    alignas(32) uint32_t v_ports[8];
+    alignas(32) uint32_t v_proto[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(v_src), src);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(v_dst), dst);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(v_ports), ports);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(v_proto), proto);
+
+    for (int j = 0; j < 8; j++) {
+      int k = i + j;
+
+      if (!(fast_bits & (1 << j))) {
+        ClassifyOne(data[k], len[k], k, res);
+        continue;
+      }
+
+      uint8_t c = res->cls[k];
+      res->hash[k] =
+          ParsedHeaders::FlowHash(v_src[j], v_dst[j], v_ports[j], v_proto[j]);
+      res->idx[c][res->cnt[c]++] = k;
+    }
+  }
+
+  for (; i < cnt; i++) {
+    ClassifyOne(data[i], len[i], i, res);
+  }
+}
+
+#endif  // __AVX2__
+
+}  // namespace utils
+}  // namespace bess
@@ -0,0 +1,151 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_HEADER_CLASSIFIER_H_
+#define BESS_UTILS_HEADER_CLASSIFIER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "parsed_headers.h"
+
+namespace bess {
+namespace utils {
+
+// Classifies the Ethernet/VLAN/IPv4/TCP headers of a whole batch of packets
+// at once, so that modules can handle each class of packets in a tight loop
+// instead of walking the headers of each packet with branchy code.
+//
+// With AVX2, ClassifyAvx2() classifies untagged IPv4 packets without options
+// (the common case) 8 at a time with (masked) gathers of the ether type,
+// version, DSCP, fragment offset, protocol and TCP flags bytes, and gives the
+// same result. It is not faster than the scalar Classify() on the CPUs tried
+// so far (see header_classifier_bench), so it is not the default.
+class HeaderClassifier {
+ public:
+  enum Class : uint8_t {
+    kNonIpv4 = 0,  // Not IPv4, or truncated
+    kIpv4,         // IPv4, but neither TCP nor UDP (or a non-first fragment)
+    kUdp,
+    kTcp,     // TCP without SYN
+    kTcpSyn,  // TCP with SYN (including SYN-ACK)
+    kNumClasses,
+  };
+
+  // Same as the largest possible bess::PacketBatch::kMaxBurst
+  static const size_t kMaxPackets = 256;
+
+  struct Result {
+    // Per class, the indices of packets in that class in ascending order
+    uint16_t cnt[kNumClasses];
+    uint16_t idx[kNumClasses][kMaxPackets];
+
+    // Per packet. All zero for kNonIpv4 packets.
+    uint8_t cls[kMaxPackets];
+    uint8_t l3_offset[kMaxPackets];
+    uint8_t l4_offset[kMaxPackets];  // 0 if there is no L4 header
+    uint8_t dscp[kMaxPackets];
+    uint8_t tcp_flags[kMaxPackets];  // 0 unless kTcp or kTcpSyn
+    uint32_t hash[kMaxPackets];      // ParsedHeaders::FlowHash()
+  };
+
+  // Classifies cnt (<= kMaxPackets) packets. Headers of packet i are the
+  // first len[i] bytes at data[i].
+  static void Classify(const void *const *data, const uint16_t *len, int cnt,
+                       Result *res) {
+    memset(res->cnt, 0, sizeof(res->cnt));
+    for (int i = 0; i < cnt; i++) {
+      ClassifyOne(data[i], len[i], i, res);
+    }
+  }
+
+  // Same as Classify(), for packets already parsed into h[i] (e.g., by the
+  // ParseHeaders module)
+  static void ClassifyParsed(const ParsedHeaders *h, const void *const *data,
+                             const uint16_t *len, int cnt, Result *res) {
+    memset(res->cnt, 0, sizeof(res->cnt));
+    for (int i = 0; i < cnt; i++) {
+      ClassifyOneParsed(h[i], data[i], len[i], i, res);
+    }
+  }
+
+#if __AVX2__
+  // SIMD version of Classify()
+  static void ClassifyAvx2(const void *const *data, const uint16_t *len,
+                           int cnt, Result *res);
+#endif
+
+  // Classifies the i-th packet and appends it to its class
+  static void ClassifyOne(const void *data, uint16_t len, int i, Result *res) {
+    ParsedHeaders h;
+    h.Parse(data, len);
+    ClassifyOneParsed(h, data, len, i, res);
+  }
+
+  // Same as ClassifyOne(), with the headers of the packet already parsed
+  static void ClassifyOneParsed(const ParsedHeaders &h, const void *data,
+                                uint16_t len, int i, Result *res) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    uint8_t cls = kNonIpv4;
+    uint8_t dscp = 0;
+    uint8_t flags = 0;
+
+    if (h.l3_offset) {
+      cls = kIpv4;
+      dscp = p[h.l3_offset + 1] >> 2;
+      if (h.l4_offset) {
+        if (h.ip_proto == Ipv4::Proto::kUdp) {
+          cls = kUdp;
+        } else if (h.ip_proto == Ipv4::Proto::kTcp &&
+                   h.l4_offset + kTcpFlagsOffset < len) {
+          flags = p[h.l4_offset + kTcpFlagsOffset];
+          cls = (flags & kTcpSynFlag) ? kTcpSyn : kTcp;
+        }
+      }
+    }
+
+    res->cls[i] = cls;
+    res->l3_offset[i] = h.l3_offset;
+    res->l4_offset[i] = h.l4_offset;
+    res->dscp[i] = dscp;
+    res->tcp_flags[i] = flags;
+    res->hash[i] = h.hash;
+    res->idx[cls][res->cnt[cls]++] = i;
+  }
+
+ private:
+  static const size_t kTcpFlagsOffset = 13;
+  static const uint8_t kTcpSynFlag = 0x02;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_HEADER_CLASSIFIER_H_
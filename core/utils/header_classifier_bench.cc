@@ -0,0 +1,137 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "header_classifier.h"
+
+#include <cstring>
+
+#include <benchmark/benchmark.h>
+
+#include "ether.h"
+#include "ip.h"
+#include "random.h"
+#include "tcp.h"
+
+using bess::utils::be16_t;
+using bess::utils::be32_t;
+using bess::utils::Ethernet;
+using bess::utils::HeaderClassifier;
+using bess::utils::Ipv4;
+using bess::utils::Tcp;
+using bess::utils::Vlan;
+
+class HeaderClassifierFixture : public benchmark::Fixture {
+ public:
+  static const int kMaxPkts = HeaderClassifier::kMaxPackets;
+
+  // state.range(0): batch size, state.range(1): 1 in N packets is
+  // VLAN-tagged (0 for none), so that it takes the scalar path of
+  // ClassifyAvx2()
+  virtual void SetUp(benchmark::State &state) {
+    int vlan_every = state.range(1);
+
+    for (int i = 0; i < kMaxPkts; i++) {
+      uint8_t *p = bufs_[i];
+      memset(p, 0, sizeof(bufs_[i]));
+
+      Ethernet *eth = reinterpret_cast<Ethernet *>(p);
+      size_t off = sizeof(*eth);
+      if (vlan_every && i % vlan_every == 0) {
+        eth->ether_type = be16_t(Ethernet::Type::kVlan);
+        reinterpret_cast<Vlan *>(p + off)->ether_type =
+            be16_t(Ethernet::Type::kIpv4);
+        off += sizeof(Vlan);
+      } else {
+        eth->ether_type = be16_t(Ethernet::Type::kIpv4);
+      }
+
+      Ipv4 *ip = reinterpret_cast<Ipv4 *>(p + off);
+      ip->version = 4;
+      ip->header_length = 5;
+      ip->protocol = (i % 4) ? Ipv4::Proto::kTcp : Ipv4::Proto::kUdp;
+      ip->src = be32_t(rng_.Get());
+      ip->dst = be32_t(rng_.Get());
+      off += sizeof(*ip);
+
+      Tcp *tcp = reinterpret_cast<Tcp *>(p + off);
+      tcp->src_port = be16_t(rng_.Get());
+      tcp->dst_port = be16_t(rng_.Get());
+      tcp->flags = (i % 8) ? Tcp::Flag::kAck : Tcp::Flag::kSyn;
+
+      data_[i] = p;
+      len_[i] = 64;
+    }
+  }
+
+ protected:
+  Random rng_;
+  uint8_t bufs_[kMaxPkts][128];
+  const void *data_[kMaxPkts];
+  uint16_t len_[kMaxPkts];
+  HeaderClassifier::Result res_;
+};
+
+BENCHMARK_DEFINE_F(HeaderClassifierFixture, BmClassify)
+(benchmark::State &state) {
+  int cnt = state.range(0);
+
+  while (state.KeepRunning()) {
+    HeaderClassifier::Classify(data_, len_, cnt, &res_);
+    benchmark::DoNotOptimize(res_.cnt[HeaderClassifier::kTcp]);
+  }
+
+  state.SetItemsProcessed(state.iterations() * cnt);
+}
+
+#if __AVX2__
+BENCHMARK_DEFINE_F(HeaderClassifierFixture, BmClassifyAvx2)
+(benchmark::State &state) {
+  int cnt = state.range(0);
+
+  while (state.KeepRunning()) {
+    HeaderClassifier::ClassifyAvx2(data_, len_, cnt, &res_);
+    benchmark::DoNotOptimize(res_.cnt[HeaderClassifier::kTcp]);
+  }
+
+  state.SetItemsProcessed(state.iterations() * cnt);
+}
+#endif  // __AVX2__
+
+BENCHMARK_REGISTER_F(HeaderClassifierFixture, BmClassify)
+    ->Args({32, 0})
+    ->Args({32, 8})
+    ->Args({256, 0});
+#if __AVX2__
+BENCHMARK_REGISTER_F(HeaderClassifierFixture, BmClassifyAvx2)
+    ->Args({32, 0})
+    ->Args({32, 8})
+    ->Args({256, 0});
+#endif  // __AVX2__
+
+BENCHMARK_MAIN();
@@ -0,0 +1,204 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "header_classifier.h"
+
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include "ether.h"
+#include "ip.h"
+#include "random.h"
+#include "tcp.h"
+
+namespace {
+
+using bess::utils::be16_t;
+using bess::utils::be32_t;
+using bess::utils::Ethernet;
+using bess::utils::HeaderClassifier;
+using bess::utils::Ipv4;
+using bess::utils::Tcp;
+using bess::utils::Vlan;
+
+class HeaderClassifierTest : public ::testing::Test {
+ protected:
+  static const int kMaxPkts = HeaderClassifier::kMaxPackets;
+
+  // Builds packet i: Ethernet [+ VLAN] + IPv4 [+ options] + L4 header
+  void Build(int i, int num_vlans, uint8_t proto, uint8_t tcp_flags,
+             size_t ip_opts_bytes = 0, uint16_t frag = 0) {
+    uint8_t *p = bufs_[i];
+    memset(p, 0, sizeof(bufs_[i]));
+
+    Ethernet *eth = reinterpret_cast<Ethernet *>(p);
+    size_t off = sizeof(*eth);
+    be16_t *type = &eth->ether_type;
+    for (int v = 0; v < num_vlans; v++) {
+      *type = be16_t(Ethernet::Type::kVlan);
+      type = &reinterpret_cast<Vlan *>(p + off)->ether_type;
+      off += sizeof(Vlan);
+    }
+    *type = be16_t(Ethernet::Type::kIpv4);
+
+    Ipv4 *ip = reinterpret_cast<Ipv4 *>(p + off);
+    ip->version = 4;
+    ip->header_length = (sizeof(*ip) + ip_opts_bytes) >> 2;
+    ip->type_of_service = (i % 64) << 2;
+    ip->fragment_offset = be16_t(frag);
+    ip->protocol = proto;
+    ip->src = be32_t(rng_.Get());
+    ip->dst = be32_t(rng_.Get());
+    off += sizeof(*ip) + ip_opts_bytes;
+
+    Tcp *tcp = reinterpret_cast<Tcp *>(p + off);
+    tcp->src_port = be16_t(rng_.Get());
+    tcp->dst_port = be16_t(rng_.Get());
+    tcp->flags = tcp_flags;
+
+    data_[i] = p;
+    len_[i] = 60 + 4 * num_vlans + ip_opts_bytes;
+  }
+
+  void ExpectSame(int cnt, const HeaderClassifier::Result &a,
+                  const HeaderClassifier::Result &b) {
+    for (int c = 0; c < HeaderClassifier::kNumClasses; c++) {
+      ASSERT_EQ(a.cnt[c], b.cnt[c]) << "class " << c;
+      for (int j = 0; j < a.cnt[c]; j++) {
+        EXPECT_EQ(a.idx[c][j], b.idx[c][j]);
+      }
+    }
+    for (int i = 0; i < cnt; i++) {
+      EXPECT_EQ(a.cls[i], b.cls[i]) << "packet " << i;
+      EXPECT_EQ(a.l3_offset[i], b.l3_offset[i]) << "packet " << i;
+      EXPECT_EQ(a.l4_offset[i], b.l4_offset[i]) << "packet " << i;
+      EXPECT_EQ(a.dscp[i], b.dscp[i]) << "packet " << i;
+      EXPECT_EQ(a.tcp_flags[i], b.tcp_flags[i]) << "packet " << i;
+      EXPECT_EQ(a.hash[i], b.hash[i]) << "packet " << i;
+    }
+  }
+
+  Random rng_;
+  uint8_t bufs_[kMaxPkts][128];
+  const void *data_[kMaxPkts];
+  uint16_t len_[kMaxPkts];
+  HeaderClassifier::Result res_;
+  HeaderClassifier::Result ref_;
+};
+
+TEST_F(HeaderClassifierTest, Classes) {
+  Build(0, 0, Ipv4::Proto::kTcp, Tcp::Flag::kAck);
+  Build(1, 0, Ipv4::Proto::kTcp, Tcp::Flag::kSyn);
+  Build(2, 0, Ipv4::Proto::kUdp, 0);
+  Build(3, 0, Ipv4::Proto::kIcmp, 0);
+  Build(4, 1, Ipv4::Proto::kTcp, Tcp::Flag::kSyn | Tcp::Flag::kAck);
+  Build(5, 0, Ipv4::Proto::kTcp, Tcp::Flag::kAck, 12);
+  Build(6, 0, Ipv4::Proto::kTcp, Tcp::Flag::kAck, 0, 100);  // fragment
+  Build(7, 0, Ipv4::Proto::kUdp, 0);
+  len_[7] = 20;  // truncated
+  Build(8, 0, Ipv4::Proto::kGre, 0);
+
+  HeaderClassifier::Classify(data_, len_, 9, &res_);
+
+  EXPECT_EQ(HeaderClassifier::kTcp, res_.cls[0]);
+  EXPECT_EQ(HeaderClassifier::kTcpSyn, res_.cls[1]);
+  EXPECT_EQ(HeaderClassifier::kUdp, res_.cls[2]);
+  EXPECT_EQ(HeaderClassifier::kIpv4, res_.cls[3]);
+  EXPECT_EQ(HeaderClassifier::kTcpSyn, res_.cls[4]);
+  EXPECT_EQ(18, res_.l3_offset[4]);
+  EXPECT_EQ(HeaderClassifier::kTcp, res_.cls[5]);
+  EXPECT_EQ(46, res_.l4_offset[5]);
+  EXPECT_EQ(HeaderClassifier::kIpv4, res_.cls[6]);
+  EXPECT_EQ(0, res_.l4_offset[6]);
+  EXPECT_EQ(HeaderClassifier::kNonIpv4, res_.cls[7]);
+  EXPECT_EQ(HeaderClassifier::kIpv4, res_.cls[8]);
+
+  EXPECT_EQ(34, res_.l4_offset[0]);
+  EXPECT_EQ(1, res_.dscp[1]);
+  EXPECT_EQ(Tcp::Flag::kAck, res_.tcp_flags[0]);
+
+  ASSERT_EQ(3, res_.cnt[HeaderClassifier::kIpv4]);
+  EXPECT_EQ(3, res_.idx[HeaderClassifier::kIpv4][0]);
+  EXPECT_EQ(6, res_.idx[HeaderClassifier::kIpv4][1]);
+  EXPECT_EQ(8, res_.idx[HeaderClassifier::kIpv4][2]);
+}
+
+// Packets parsed beforehand (by ParseHeaders) are classified the same way
+TEST_F(HeaderClassifierTest, Parsed) {
+  bess::utils::ParsedHeaders h[4];
+
+  Build(0, 0, Ipv4::Proto::kTcp, Tcp::Flag::kSyn);
+  Build(1, 2, Ipv4::Proto::kUdp, 0);
+  Build(2, 1, Ipv4::Proto::kTcp, Tcp::Flag::kAck, 8);
+  Build(3, 0, Ipv4::Proto::kTcp, Tcp::Flag::kAck);
+  bufs_[3][12] = 0x86;  // not IPv4
+  for (int i = 0; i < 4; i++) {
+    h[i].Parse(data_[i], len_[i]);
+  }
+
+  HeaderClassifier::ClassifyParsed(h, data_, len_, 4, &res_);
+  HeaderClassifier::Classify(data_, len_, 4, &ref_);
+  ExpectSame(4, res_, ref_);
+  EXPECT_EQ(HeaderClassifier::kTcpSyn, res_.cls[0]);
+  EXPECT_EQ(HeaderClassifier::kUdp, res_.cls[1]);
+  EXPECT_EQ(22, res_.l3_offset[1]);
+  EXPECT_EQ(HeaderClassifier::kTcp, res_.cls[2]);
+  EXPECT_EQ(HeaderClassifier::kNonIpv4, res_.cls[3]);
+}
+
+#if __AVX2__
+// The SIMD path must give exactly the same results as the scalar one
+TEST_F(HeaderClassifierTest, Avx2SameAsScalar) {
+  const uint8_t protos[] = {Ipv4::Proto::kTcp, Ipv4::Proto::kUdp,
+                            Ipv4::Proto::kIcmp, Ipv4::Proto::kGre};
+
+  for (int round = 0; round < 100; round++) {
+    int cnt = rng_.GetRange(kMaxPkts + 1);
+    for (int i = 0; i < cnt; i++) {
+      uint32_t r = rng_.Get();
+      Build(i, (r & 0x7) == 0, protos[(r >> 3) & 3], r >> 8,
+            ((r >> 16) & 0x7) == 0 ? 4 : 0,
+            ((r >> 19) & 0xf) == 0 ? Ipv4::Flag::kMF : 0);
+      if (((r >> 23) & 0xf) == 0) {
+        len_[i] = rng_.GetRange(len_[i] + 1);
+      }
+      if (((r >> 27) & 0xf) == 0) {
+        bufs_[i][12] = 0x86;  // not IPv4
+      }
+    }
+
+    HeaderClassifier::ClassifyAvx2(data_, len_, cnt, &res_);
+    HeaderClassifier::Classify(data_, len_, cnt, &ref_);
+    ExpectSame(cnt, res_, ref_);
+  }
+}
+#endif  // __AVX2__
+
+}  // namespace
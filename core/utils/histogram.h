@@ -131,6 +131,17 @@ class Histogram {
     return ret;
   }
 
+  // Adds all samples of `other`, which must have the same bucket layout.
+  // Useful for merging per-thread histograms.
+  void Combine(const Histogram &other) {
+    DCHECK_EQ(bucket_width_, other.bucket_width_);
+    DCHECK_EQ(buckets_.size(), other.buckets_.size());
+    for (size_t i = 0; i < buckets_.size(); i++) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+  }
+
   void Reset() {
     count_ = 0;
     buckets_ = std::vector<size_t>(buckets_.size());
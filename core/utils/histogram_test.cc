@@ -78,4 +78,26 @@ TEST(HistogramTest, DoubleQuartiles) {
   EXPECT_DOUBLE_EQ(6.0, ret.percentile_values[3]);  // 100th percentile
 }
 
+TEST(HistogramTest, Combine) {
+  Histogram<uint64_t> a(100, 10);
+  Histogram<uint64_t> b(100, 10);
+
+  a.Insert(5);
+  a.Insert(15);
+  b.Insert(25);
+  b.Insert(5000);
+
+  a.Combine(b);
+
+  auto ret = a.Summarize({60.0});
+  EXPECT_EQ(4, ret.count);
+  EXPECT_EQ(1, ret.above_range);
+  EXPECT_EQ(0, ret.min);
+  EXPECT_EQ(1000, ret.max);
+  EXPECT_EQ(20, ret.percentile_values[0]);
+
+  // `b` is unchanged
+  EXPECT_EQ(2, b.Summarize().count);
+}
+
 }  // namespace (unnamed)
@@ -0,0 +1,132 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_PARSED_HEADERS_H_
+#define BESS_UTILS_PARSED_HEADERS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <rte_config.h>
+#include <rte_hash_crc.h>
+
+#include "endian.h"
+#include "ether.h"
+#include "ip.h"
+
+namespace bess {
+namespace utils {
+
+// Where the headers of a packet are, and the fields most modules classify
+// on. The ParseHeaders module keeps this in per-packet metadata so that
+// downstream modules need not walk Ethernet/VLAN/IPv4 headers again.
+struct[[gnu::packed]] ParsedHeaders {
+  // Walks the Ethernet, up to two VLAN tags and IPv4 headers in data[0, len).
+  void Parse(const void *data, size_t len) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    size_t off = sizeof(Ethernet);
+
+    l3_offset = 0;
+    l4_offset = 0;
+    ip_proto = 0;
+    num_vlans = 0;
+    ether_type = be16_t(0);
+    reserved = 0;
+    hash = 0;
+
+    if (len < off) {
+      return;
+    }
+
+    ether_type = reinterpret_cast<const Ethernet *>(p)->ether_type;
+    while ((ether_type == be16_t(Ethernet::Type::kVlan) ||
+            ether_type == be16_t(Ethernet::Type::kQinQ)) &&
+           num_vlans < 2 && off + sizeof(Vlan) <= len) {
+      ether_type = reinterpret_cast<const Vlan *>(p + off)->ether_type;
+      off += sizeof(Vlan);
+      num_vlans++;
+    }
+
+    if (ether_type != be16_t(Ethernet::Type::kIpv4) ||
+        off + sizeof(Ipv4) > len) {
+      return;
+    }
+
+    const Ipv4 *ip = reinterpret_cast<const Ipv4 *>(p + off);
+    size_t ip_bytes = ip->header_length << 2;
+    if (ip_bytes < sizeof(Ipv4) || off + ip_bytes > len) {
+      return;
+    }
+
+    l3_offset = off;
+    ip_proto = ip->protocol;
+
+    // Only the first fragment has the L4 header
+    uint32_t ports = 0;
+    bool first_frag = (ip->fragment_offset & be16_t(0x1fff)) == be16_t(0);
+    if (first_frag && off + ip_bytes + sizeof(uint32_t) <= len &&
+        (ip_proto == Ipv4::Proto::kTcp || ip_proto == Ipv4::Proto::kUdp ||
+         ip_proto == Ipv4::Proto::kIcmp)) {
+      l4_offset = off + ip_bytes;
+      ports = *reinterpret_cast<const uint32_t *>(p + l4_offset);
+    }
+
+    hash = FlowHash(ip->src, ip->dst, ports, ip_proto);
+  }
+
+  // 5-tuple hash. ports is the first 4 bytes of the L4 header as is.
+  static uint32_t FlowHash(be32_t src, be32_t dst, uint32_t ports,
+                           uint8_t proto) {
+    return FlowHash(src.raw_value(), dst.raw_value(), ports, proto);
+  }
+
+  // Same as above, with the addresses as they are in the packet
+  static uint32_t FlowHash(uint32_t src_raw, uint32_t dst_raw, uint32_t ports,
+                           uint8_t proto) {
+    uint64_t addrs = (static_cast<uint64_t>(dst_raw) << 32) | src_raw;
+    return rte_hash_crc_8byte(addrs, ports ^ proto);
+  }
+
+  uint8_t l3_offset;   // Offset of the IPv4 header, 0 if not IPv4
+  uint8_t l4_offset;   // Offset of the TCP/UDP/ICMP header, 0 if none
+  uint8_t ip_proto;    // 0 if not IPv4
+  uint8_t num_vlans;   // Number of VLAN tags after the Ethernet header
+  be16_t ether_type;   // Innermost ether type
+  uint16_t reserved;
+  uint32_t hash;       // FlowHash() of the packet, 0 if not IPv4
+};
+
+static_assert(std::is_pod<ParsedHeaders>::value, "not a POD type");
+static_assert(sizeof(ParsedHeaders) == 12, "struct ParsedHeaders is incorrect");
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_PARSED_HEADERS_H_
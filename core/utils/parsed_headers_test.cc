@@ -0,0 +1,147 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "parsed_headers.h"
+
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include "tcp.h"
+
+namespace {
+
+using bess::utils::be16_t;
+using bess::utils::be32_t;
+using bess::utils::Ethernet;
+using bess::utils::Ipv4;
+using bess::utils::ParsedHeaders;
+using bess::utils::Tcp;
+using bess::utils::Vlan;
+
+class ParsedHeadersTest : public ::testing::Test {
+ protected:
+  // Builds Ethernet [+ VLAN tags] + IPv4 (+ options) + TCP into buf_.
+  size_t Build(int num_vlans, size_t ip_opts_bytes) {
+    memset(buf_, 0, sizeof(buf_));
+    uint8_t *p = buf_;
+
+    Ethernet *eth = reinterpret_cast<Ethernet *>(p);
+    p += sizeof(*eth);
+    be16_t *type = &eth->ether_type;
+    for (int i = 0; i < num_vlans; i++) {
+      *type = be16_t(i == 0 && num_vlans == 2 ? Ethernet::Type::kQinQ
+                                             : Ethernet::Type::kVlan);
+      Vlan *vlan = reinterpret_cast<Vlan *>(p);
+      p += sizeof(*vlan);
+      type = &vlan->ether_type;
+    }
+    *type = be16_t(Ethernet::Type::kIpv4);
+
+    Ipv4 *ip = reinterpret_cast<Ipv4 *>(p);
+    ip->version = 4;
+    ip->header_length = (sizeof(*ip) + ip_opts_bytes) >> 2;
+    ip->protocol = Ipv4::Proto::kTcp;
+    ip->src = be32_t(0x0a000001);
+    ip->dst = be32_t(0x0a000002);
+    p += sizeof(*ip) + ip_opts_bytes;
+
+    Tcp *tcp = reinterpret_cast<Tcp *>(p);
+    tcp->src_port = be16_t(1234);
+    tcp->dst_port = be16_t(80);
+    p += sizeof(*tcp);
+
+    return p - buf_;
+  }
+
+  Ipv4 *ip(const ParsedHeaders &h) {
+    return reinterpret_cast<Ipv4 *>(buf_ + h.l3_offset);
+  }
+
+  uint8_t buf_[256];
+};
+
+TEST_F(ParsedHeadersTest, Untagged) {
+  ParsedHeaders h;
+  h.Parse(buf_, Build(0, 0));
+
+  EXPECT_EQ(14, h.l3_offset);
+  EXPECT_EQ(34, h.l4_offset);
+  EXPECT_EQ(Ipv4::Proto::kTcp, h.ip_proto);
+  EXPECT_EQ(0, h.num_vlans);
+  EXPECT_EQ(be16_t(Ethernet::Type::kIpv4), h.ether_type);
+
+  const Tcp *tcp = reinterpret_cast<const Tcp *>(buf_ + h.l4_offset);
+  EXPECT_EQ(be16_t(1234), tcp->src_port);
+  EXPECT_EQ(h.hash,
+            ParsedHeaders::FlowHash(
+                ip(h)->src, ip(h)->dst,
+                *reinterpret_cast<const uint32_t *>(tcp), h.ip_proto));
+}
+
+TEST_F(ParsedHeadersTest, TaggedWithOptions) {
+  ParsedHeaders h;
+
+  h.Parse(buf_, Build(1, 0));
+  EXPECT_EQ(18, h.l3_offset);
+  EXPECT_EQ(38, h.l4_offset);
+  EXPECT_EQ(1, h.num_vlans);
+
+  h.Parse(buf_, Build(2, 8));
+  EXPECT_EQ(22, h.l3_offset);
+  EXPECT_EQ(50, h.l4_offset);
+  EXPECT_EQ(2, h.num_vlans);
+  EXPECT_EQ(be32_t(0x0a000002), ip(h)->dst);
+}
+
+TEST_F(ParsedHeadersTest, NotParsable) {
+  ParsedHeaders h;
+  size_t len = Build(0, 0);
+
+  // Truncated IPv4 header
+  h.Parse(buf_, 14 + 10);
+  EXPECT_EQ(0, h.l3_offset);
+  EXPECT_EQ(0, h.hash);
+
+  // Non-first fragment: no L4 header
+  reinterpret_cast<Ipv4 *>(buf_ + 14)->fragment_offset = be16_t(100);
+  h.Parse(buf_, len);
+  EXPECT_EQ(14, h.l3_offset);
+  EXPECT_EQ(0, h.l4_offset);
+
+  // Not IPv4
+  reinterpret_cast<Ethernet *>(buf_)->ether_type =
+      be16_t(Ethernet::Type::kArp);
+  h.Parse(buf_, len);
+  EXPECT_EQ(0, h.l3_offset);
+  EXPECT_EQ(0, h.ip_proto);
+  EXPECT_EQ(be16_t(Ethernet::Type::kArp), h.ether_type);
+}
+
+}  // namespace
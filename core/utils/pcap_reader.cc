@@ -0,0 +1,303 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "pcap_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include "pcap.h"
+#include "pcapng.h"
+
+namespace bess {
+namespace utils {
+
+// Nanosecond-resolution variant of the pcap format
+static const uint32_t kPcapMagicNsec = 0xa1b23c4d;
+
+// pcapng block types without a definition in pcapng.h
+static const uint32_t kSimplePacketBlockType = 0x00000003;
+
+int PcapReader::Open(const std::string &path) {
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -errno;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    int err = errno;
+    close(fd);
+    return -err;
+  }
+
+  if (static_cast<size_t>(st.st_size) < sizeof(struct pcap_hdr)) {
+    close(fd);
+    return -EINVAL;
+  }
+
+  void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+                    fd, 0);
+  int err = errno;
+  close(fd);
+
+  if (addr == MAP_FAILED) {
+    return -err;
+  }
+
+  madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+  base_ = static_cast<const uint8_t *>(addr);
+  len_ = st.st_size;
+
+  uint32_t magic;
+  memcpy(&magic, base_, sizeof(magic));
+
+  if (magic == PCAP_MAGIC_NUMBER || magic == kPcapMagicNsec ||
+      magic == __builtin_bswap32(PCAP_MAGIC_NUMBER) ||
+      magic == __builtin_bswap32(kPcapMagicNsec)) {
+    format_ = kPcap;
+    swapped_ = (magic != PCAP_MAGIC_NUMBER && magic != kPcapMagicNsec);
+    bool nsec = (Get32(base_) == kPcapMagicNsec);
+    ts_mult_ = nsec ? 1 : 1000;
+    ts_div_ = 1;
+    first_off_ = sizeof(struct pcap_hdr);
+  } else if (magic == pcapng::SectionHeaderBlock::kType) {
+    format_ = kPcapNg;
+    first_off_ = 0;
+    off_ = 0;
+    if (!ParseSectionHeader()) {
+      Close();
+      return -EINVAL;
+    }
+  } else {
+    Close();
+    return -EINVAL;
+  }
+
+  Rewind();
+  return 0;
+}
+
+void PcapReader::Close() {
+  if (base_) {
+    munmap(const_cast<uint8_t *>(base_), len_);
+    base_ = nullptr;
+  }
+  len_ = 0;
+  off_ = 0;
+  ifaces_.clear();
+}
+
+bool PcapReader::Next(Record *rec) {
+  if (format_ == kPcap) {
+    return NextPcap(rec);
+  } else {
+    return NextPcapNg(rec);
+  }
+}
+
+bool PcapReader::NextPcap(Record *rec) {
+  if (off_ + sizeof(struct pcap_rec_hdr) > len_) {
+    return false;
+  }
+
+  const uint8_t *p = base_ + off_;
+  uint32_t ts_sec = Get32(p + offsetof(pcap_rec_hdr, ts_sec));
+  uint32_t ts_frac = Get32(p + offsetof(pcap_rec_hdr, ts_usec));
+  uint32_t caplen = Get32(p + offsetof(pcap_rec_hdr, incl_len));
+
+  if (off_ + sizeof(struct pcap_rec_hdr) + caplen > len_) {
+    return false;  // truncated
+  }
+
+  rec->data = p + sizeof(struct pcap_rec_hdr);
+  rec->caplen = caplen;
+  rec->ts_ns = ts_sec * 1000000000ull + ts_frac * ts_mult_ / ts_div_;
+
+  off_ += sizeof(struct pcap_rec_hdr) + caplen;
+  return true;
+}
+
+bool PcapReader::ParseSectionHeader() {
+  if (off_ + sizeof(pcapng::SectionHeaderBlock) > len_) {
+    return false;
+  }
+
+  const uint8_t *p = base_ + off_;
+  uint32_t bom;
+  memcpy(&bom, p + offsetof(pcapng::SectionHeaderBlock, bom), sizeof(bom));
+
+  if (bom == pcapng::SectionHeaderBlock::kBom) {
+    swapped_ = false;
+  } else if (bom == __builtin_bswap32(pcapng::SectionHeaderBlock::kBom)) {
+    swapped_ = true;
+  } else {
+    return false;
+  }
+
+  uint32_t tot_len = Get32(p + offsetof(pcapng::SectionHeaderBlock, tot_len));
+  if (tot_len < sizeof(pcapng::SectionHeaderBlock) || tot_len % 4 ||
+      off_ + tot_len > len_) {
+    return false;
+  }
+
+  // Interface IDs are scoped by section
+  ifaces_.clear();
+  off_ += tot_len;
+  return true;
+}
+
+void PcapReader::ParseInterface(const uint8_t *body, size_t len) {
+  // Default: microseconds
+  TsResolution res = {1000, 1};
+
+  // Options follow link_type(2), reserved(2), snap_len(4)
+  size_t off = 8;
+  while (off + sizeof(pcapng::Option) <= len) {
+    uint16_t code = Get16(body + off);
+    uint16_t opt_len = Get16(body + off + 2);
+    const uint8_t *val = body + off + sizeof(pcapng::Option);
+
+    if (code == pcapng::Option::kEndOfOpts ||
+        off + sizeof(pcapng::Option) + opt_len > len) {
+      break;
+    }
+
+    if (code == pcapng::InterfaceDescriptionBlock::kIfTsresol && opt_len >= 1) {
+      uint8_t v = val[0];
+      uint64_t units = 1;  // per second
+      if (v & 0x80) {
+        units = 1ull << std::min(v & 0x7f, 63);
+      } else {
+        for (int i = 0; i < (v & 0x7f) && units < 1000000000000000000ull;
+             i++) {
+          units *= 10;
+        }
+      }
+
+      if (units <= 1000000000ull && 1000000000ull % units == 0) {
+        res = {1000000000ull / units, 1};
+      } else {
+        res = {1000000000ull, units};
+      }
+    }
+
+    off += sizeof(pcapng::Option) + ((opt_len + 3) & ~3);
+  }
+
+  ifaces_.push_back(res);
+}
+
+bool PcapReader::NextPcapNg(Record *rec) {
+  while (off_ + 12 <= len_) {
+    const uint8_t *p = base_ + off_;
+    uint32_t type;
+    memcpy(&type, p, sizeof(type));
+
+    if (type == pcapng::SectionHeaderBlock::kType) {
+      if (!ParseSectionHeader()) {
+        return false;
+      }
+      continue;
+    }
+
+    type = Get32(p);
+    uint32_t tot_len = Get32(p + 4);
+    if (tot_len < 12 || tot_len % 4 || off_ + tot_len > len_) {
+      return false;
+    }
+
+    // Block body, without the type, tot_len and the trailing tot_len
+    const uint8_t *body = p + 8;
+    size_t body_len = tot_len - 12;
+
+    off_ += tot_len;
+
+    if (type == pcapng::InterfaceDescriptionBlock::kType) {
+      ParseInterface(body, body_len);
+
+    } else if (type == pcapng::EnhancedPacketBlock::kType) {
+      const size_t kHdrLen = sizeof(pcapng::EnhancedPacketBlock) - 8;
+      if (body_len < kHdrLen) {
+        return false;
+      }
+
+      uint32_t iface = Get32(body);
+      uint64_t ts = (static_cast<uint64_t>(Get32(body + 4)) << 32) |
+                    Get32(body + 8);
+      uint32_t caplen = Get32(body + 12);
+      if (kHdrLen + caplen > body_len) {
+        return false;
+      }
+
+      TsResolution res = {1000, 1};
+      if (iface < ifaces_.size()) {
+        res = ifaces_[iface];
+      }
+
+      rec->data = body + kHdrLen;
+      rec->caplen = caplen;
+      if (res.div == 1) {
+        rec->ts_ns = ts * res.mult;
+      } else {
+        rec->ts_ns = static_cast<uint64_t>(static_cast<double>(ts) *
+                                           res.mult / res.div);
+      }
+      last_ts_ns_ = rec->ts_ns;
+      return true;
+
+    } else if (type == kSimplePacketBlockType) {
+      if (body_len < 4) {
+        return false;
+      }
+
+      // The captured length is implied by the block length
+      uint32_t orig_len = Get32(body);
+      rec->data = body + 4;
+      rec->caplen = std::min<uint32_t>(orig_len, body_len - 4);
+      rec->ts_ns = last_ts_ns_;
+      return true;
+    }
+
+    // Skip other blocks (statistics, name resolution, ...)
+  }
+
+  return false;
+}
+
+}  // namespace utils
+}  // namespace bess
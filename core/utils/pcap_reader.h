@@ -0,0 +1,141 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_PCAP_READER_H_
+#define BESS_UTILS_PCAP_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+namespace bess {
+namespace utils {
+
+// Reads packets out of a pcap or pcapng file, without libpcap. The file is
+// mmap'd and parsed in place, so that no copy or system call is needed per
+// packet. Both byte orders, nanosecond pcap and pcapng with multiple sections
+// and interfaces (if_tsresol) are supported.
+class PcapReader {
+ public:
+  struct Record {
+    const uint8_t *data;  // Points into the mapping. Valid until Close().
+    uint32_t caplen;
+    uint64_t ts_ns;  // Capture timestamp, in nanoseconds
+  };
+
+  PcapReader() : base_(), len_(), off_(), first_off_(), format_(), swapped_(),
+                 ts_mult_(), ts_div_(), last_ts_ns_() {}
+
+  ~PcapReader() { Close(); }
+
+  // Maps the file and checks its header. Returns 0 or -errno.
+  int Open(const std::string &path);
+
+  void Close();
+
+  bool is_open() const { return base_ != nullptr; }
+
+  // Reads the next packet. Returns false at the end of the file, or on a
+  // malformed (e.g., truncated) block.
+  bool Next(Record *rec);
+
+  // Goes back to the first packet.
+  void Rewind() {
+    off_ = first_off_;
+    last_ts_ns_ = 0;
+  }
+
+  // Size of the file, in bytes
+  size_t size() const { return len_; }
+
+ private:
+  enum Format {
+    kPcap = 0,
+    kPcapNg,
+  };
+
+  // Timestamp unit of a pcapng interface, as a fraction of a second:
+  // ts_ns = ts * mult / div.
+  struct TsResolution {
+    uint64_t mult;
+    uint64_t div;
+  };
+
+  // Fields may be unaligned (pcap records have no padding)
+  uint32_t Get32(const uint8_t *p) const {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return swapped_ ? __builtin_bswap32(v) : v;
+  }
+
+  uint16_t Get16(const uint8_t *p) const {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return swapped_ ? __builtin_bswap16(v) : v;
+  }
+
+  bool NextPcap(Record *rec);
+  bool NextPcapNg(Record *rec);
+
+  // Parses a pcapng Section Header Block at off_ (and moves past it).
+  // Returns false if invalid.
+  bool ParseSectionHeader();
+
+  // Parses a pcapng Interface Description Block body.
+  void ParseInterface(const uint8_t *body, size_t len);
+
+  const uint8_t *base_;
+  size_t len_;
+  size_t off_;
+  size_t first_off_;  // Beginning of the first record (pcap) or block (pcapng)
+
+  Format format_;
+  bool swapped_;
+
+  // For kPcap
+  uint64_t ts_mult_;  // 1000 for microsecond files, 1 for nanosecond files
+  uint64_t ts_div_;
+
+  // For kPcapNg. Indexed by interface ID, reset for each section.
+  std::vector<TsResolution> ifaces_;
+
+  // Used for blocks without a timestamp (Simple Packet Blocks)
+  uint64_t last_ts_ns_;
+
+  DISALLOW_COPY_AND_ASSIGN(PcapReader);
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_PCAP_READER_H_
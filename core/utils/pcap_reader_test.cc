@@ -0,0 +1,252 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "pcap_reader.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <string>
+
+#include "pcap.h"
+#include "pcapng.h"
+
+namespace {
+
+using bess::utils::PcapReader;
+
+class PcapReaderTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    char tmpl[] = "/tmp/pcap_reader_test_XXXXXX";
+    int fd = mkstemp(tmpl);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    path_ = tmpl;
+  }
+
+  virtual void TearDown() { unlink(path_.c_str()); }
+
+  void WriteFile(const std::string &content) {
+    FILE *fp = fopen(path_.c_str(), "wb");
+    ASSERT_NE(nullptr, fp);
+    ASSERT_EQ(content.size(), fwrite(content.data(), 1, content.size(), fp));
+    fclose(fp);
+  }
+
+  // Appends a 32/16-bit integer, optionally byte-swapped
+  static void Put32(std::string *s, uint32_t v, bool swap = false) {
+    if (swap) {
+      v = __builtin_bswap32(v);
+    }
+    s->append(reinterpret_cast<const char *>(&v), sizeof(v));
+  }
+
+  static void Put16(std::string *s, uint16_t v) {
+    s->append(reinterpret_cast<const char *>(&v), sizeof(v));
+  }
+
+  static std::string PcapHeader(uint32_t magic, bool swap) {
+    std::string s;
+    Put32(&s, magic, swap);
+    Put32(&s, (PCAP_VERSION_MINOR << 16) | PCAP_VERSION_MAJOR, swap);
+    Put32(&s, 0, swap);
+    Put32(&s, 0, swap);
+    Put32(&s, PCAP_SNAPLEN, swap);
+    Put32(&s, PCAP_NETWORK, swap);
+    return s;
+  }
+
+  static std::string PcapRecord(uint32_t sec, uint32_t frac,
+                                const std::string &data, bool swap) {
+    std::string s;
+    Put32(&s, sec, swap);
+    Put32(&s, frac, swap);
+    Put32(&s, data.size(), swap);
+    Put32(&s, data.size(), swap);
+    return s + data;
+  }
+
+  static std::string Block(uint32_t type, const std::string &body) {
+    std::string s;
+    std::string padded = body + std::string((4 - body.size() % 4) % 4, '\0');
+    Put32(&s, type);
+    Put32(&s, padded.size() + 12);
+    s += padded;
+    Put32(&s, padded.size() + 12);
+    return s;
+  }
+
+  static std::string SectionHeader() {
+    using bess::utils::pcapng::SectionHeaderBlock;
+    std::string body;
+    Put32(&body, SectionHeaderBlock::kBom);
+    Put16(&body, SectionHeaderBlock::kMajVer);
+    Put16(&body, SectionHeaderBlock::kMinVer);
+    Put32(&body, 0xffffffff);  // section length: -1
+    Put32(&body, 0xffffffff);
+    return Block(SectionHeaderBlock::kType, body);
+  }
+
+  static std::string InterfaceDescription(int tsresol) {
+    std::string body;
+    Put16(&body, bess::utils::pcapng::InterfaceDescriptionBlock::kEthernet);
+    Put16(&body, 0);
+    Put32(&body, PCAP_SNAPLEN);
+    if (tsresol >= 0) {
+      Put16(&body, 9);  // if_tsresol
+      Put16(&body, 1);
+      body += std::string(1, static_cast<char>(tsresol)) + std::string(3, 0);
+      Put16(&body, bess::utils::pcapng::Option::kEndOfOpts);
+      Put16(&body, 0);
+    }
+    return Block(bess::utils::pcapng::InterfaceDescriptionBlock::kType, body);
+  }
+
+  static std::string EnhancedPacket(uint32_t iface, uint64_t ts,
+                                    const std::string &data) {
+    std::string body;
+    Put32(&body, iface);
+    Put32(&body, ts >> 32);
+    Put32(&body, ts & 0xffffffff);
+    Put32(&body, data.size());
+    Put32(&body, data.size());
+    return Block(bess::utils::pcapng::EnhancedPacketBlock::kType, body + data);
+  }
+
+  static std::string Data(const PcapReader::Record &rec) {
+    return std::string(reinterpret_cast<const char *>(rec.data), rec.caplen);
+  }
+
+  std::string path_;
+};
+
+TEST_F(PcapReaderTest, OpenErrors) {
+  PcapReader r;
+  EXPECT_EQ(-ENOENT, r.Open("/nonexistent/file.pcap"));
+  EXPECT_FALSE(r.is_open());
+
+  WriteFile(std::string(64, 'x'));
+  EXPECT_EQ(-EINVAL, r.Open(path_));
+  EXPECT_FALSE(r.is_open());
+}
+
+TEST_F(PcapReaderTest, Pcap) {
+  WriteFile(PcapHeader(PCAP_MAGIC_NUMBER, false) +
+            PcapRecord(1, 2, "hello", false) +
+            PcapRecord(3, 999999, "odd-sized!", false));
+
+  PcapReader r;
+  ASSERT_EQ(0, r.Open(path_));
+
+  for (int pass = 0; pass < 2; pass++) {
+    PcapReader::Record rec;
+    ASSERT_TRUE(r.Next(&rec));
+    EXPECT_EQ("hello", Data(rec));
+    EXPECT_EQ(1000002000ull, rec.ts_ns);
+
+    ASSERT_TRUE(r.Next(&rec));
+    EXPECT_EQ("odd-sized!", Data(rec));
+    EXPECT_EQ(3999999000ull, rec.ts_ns);
+
+    EXPECT_FALSE(r.Next(&rec));
+    r.Rewind();
+  }
+}
+
+TEST_F(PcapReaderTest, PcapSwappedNsec) {
+  WriteFile(PcapHeader(0xa1b23c4d, true) + PcapRecord(1, 2, "abc", true));
+
+  PcapReader r;
+  ASSERT_EQ(0, r.Open(path_));
+
+  PcapReader::Record rec;
+  ASSERT_TRUE(r.Next(&rec));
+  EXPECT_EQ("abc", Data(rec));
+  EXPECT_EQ(1000000002ull, rec.ts_ns);
+  EXPECT_FALSE(r.Next(&rec));
+}
+
+TEST_F(PcapReaderTest, PcapTruncated) {
+  std::string rec = PcapRecord(1, 2, "truncated", false);
+  WriteFile(PcapHeader(PCAP_MAGIC_NUMBER, false) +
+            PcapRecord(1, 2, "ok", false) + rec.substr(0, rec.size() - 1));
+
+  PcapReader r;
+  ASSERT_EQ(0, r.Open(path_));
+
+  PcapReader::Record record;
+  ASSERT_TRUE(r.Next(&record));
+  EXPECT_EQ("ok", Data(record));
+  EXPECT_FALSE(r.Next(&record));
+}
+
+TEST_F(PcapReaderTest, PcapNg) {
+  std::string spb_body;
+  Put32(&spb_body, 3);
+  spb_body += "spb";
+
+  WriteFile(SectionHeader() + InterfaceDescription(-1) +
+            InterfaceDescription(9) +
+            Block(0x00000005, std::string(8, 0)) +  // stats block: skipped
+            EnhancedPacket(0, 5, "usec") + EnhancedPacket(1, 7, "nsec") +
+            Block(0x00000003, spb_body) +
+            // A new section resets the interfaces
+            SectionHeader() + InterfaceDescription(-1) +
+            EnhancedPacket(0, 1, "second section"));
+
+  PcapReader r;
+  ASSERT_EQ(0, r.Open(path_));
+
+  for (int pass = 0; pass < 2; pass++) {
+    PcapReader::Record rec;
+    ASSERT_TRUE(r.Next(&rec));
+    EXPECT_EQ("usec", Data(rec));
+    EXPECT_EQ(5000ull, rec.ts_ns);
+
+    ASSERT_TRUE(r.Next(&rec));
+    EXPECT_EQ("nsec", Data(rec));
+    EXPECT_EQ(7ull, rec.ts_ns);
+
+    ASSERT_TRUE(r.Next(&rec));
+    EXPECT_EQ("spb", Data(rec));
+    EXPECT_EQ(7ull, rec.ts_ns);
+
+    ASSERT_TRUE(r.Next(&rec));
+    EXPECT_EQ("second section", Data(rec));
+    EXPECT_EQ(1000ull, rec.ts_ns);
+
+    EXPECT_FALSE(r.Next(&rec));
+    r.Rewind();
+  }
+}
+
+}  // namespace
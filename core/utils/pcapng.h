@@ -77,6 +77,12 @@ struct InterfaceDescriptionBlock {
     kEthernet = 1,
   };
 
+  // Options specific to this block
+  enum OptionCode {
+    kIfName = 2,     // UTF-8 string.  Not zero terminated.
+    kIfTsresol = 9,  // 1 byte: 10^-N seconds (or 2^-N if the MSB is set)
+  };
+
   static constexpr uint32_t kType = 0x00000001;
 };
 
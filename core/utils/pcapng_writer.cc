@@ -0,0 +1,511 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "pcapng_writer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include "format.h"
+#include "pcapng.h"
+
+namespace bess {
+namespace utils {
+
+using namespace pcapng;
+
+// How often the writer thread writes out a partially filled segment, so that
+// the files are reasonably up to date even at low packet rates.
+static const int kFlushIntervalMs = 1000;
+
+// IDB names longer than this are truncated
+static const size_t kMaxIfNameLen = 256;
+
+static inline size_t RoundUp(size_t a, size_t b) {
+  return ((a + (b - 1)) / b) * b;
+}
+
+int PcapngWriter::Open(const Config &config) {
+  if (config.prefix.empty() || config.file_size == 0 ||
+      config.file_count == 1 || config.segment_size == 0 ||
+      config.segment_size % kAlign || config.num_segments < 2) {
+    return -EINVAL;
+  }
+
+  Close();
+
+  config_ = config;
+
+  segments_.resize(config_.num_segments);
+  for (Segment &seg : segments_) {
+    void *buf;
+    if (posix_memalign(&buf, kAlign, config_.segment_size)) {
+      Close();
+      return -ENOMEM;
+    }
+    seg = Segment{static_cast<char *>(buf), 0, 0, 0, false};
+  }
+
+  for (size_t i = 1; i < segments_.size(); i++) {
+    free_.push_back(&segments_[i]);
+  }
+
+  cur_ = &segments_[0];
+  spare_ = nullptr;
+  file_seq_ = 0;
+  file_len_ = 0;
+  file_pkts_ = 0;
+  file_start_ns_ = 0;
+  idbs_.clear();
+  num_ifaces_ = 0;
+  packets_ = 0;
+  dropped_ = 0;
+
+  SectionHeaderBlock shb = {
+      .type = SectionHeaderBlock::kType,
+      .tot_len = sizeof(shb) + sizeof(uint32_t),
+      .bom = SectionHeaderBlock::kBom,
+      .maj_ver = SectionHeaderBlock::kMajVer,
+      .min_ver = SectionHeaderBlock::kMinVer,
+      .sec_len = -1,
+  };
+  Put(&shb, sizeof(shb));
+  Put(&shb.tot_len, sizeof(shb.tot_len));
+
+  stop_ = false;
+  fd_ = -1;
+  fd_seq_ = 0;
+  direct_ = true;
+  flushed_seg_ = nullptr;
+  flushed_len_ = 0;
+
+  writer_ = std::thread([this]() { this->WriterThread(); });
+
+  return 0;
+}
+
+void PcapngWriter::Close() {
+  if (writer_.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(mtx_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    writer_.join();
+
+    // The writer thread has written out all full segments.
+    Write(cur_->file_seq, cur_->file_off, cur_->buf, cur_->len);
+    FinishFile(cur_->file_off + cur_->len);
+  }
+
+  for (Segment &seg : segments_) {
+    free(seg.buf);
+  }
+  segments_.clear();
+  free_.clear();
+  full_.clear();
+  cur_ = nullptr;
+  spare_ = nullptr;
+}
+
+std::string PcapngWriter::FileName(uint64_t seq) const {
+  if (config_.file_count) {
+    seq %= config_.file_count;
+  }
+  return Format("%s_%03" PRIu64 ".pcapng", config_.prefix.c_str(), seq);
+}
+
+int PcapngWriter::AddInterface(const std::string &name, uint32_t snaplen) {
+  size_t name_len = std::min(name.size(), kMaxIfNameLen);
+  uint32_t tot_len = sizeof(InterfaceDescriptionBlock) +
+                     sizeof(Option) + RoundUp(name_len, 4) +
+                     sizeof(Option) + 4 + sizeof(Option) + sizeof(uint32_t);
+
+  InterfaceDescriptionBlock idb = {
+      .type = InterfaceDescriptionBlock::kType,
+      .tot_len = tot_len,
+      .link_type = InterfaceDescriptionBlock::kEthernet,
+      .reserved = 0,
+      .snap_len = snaplen,
+  };
+  Option opt_name = {
+      .code = InterfaceDescriptionBlock::kIfName,
+      .len = static_cast<uint16_t>(name_len),
+  };
+  Option opt_tsresol = {
+      .code = InterfaceDescriptionBlock::kIfTsresol, .len = 1,
+  };
+  const char tsresol[4] = {9, 0, 0, 0};  // nanoseconds
+  Option opt_end = {
+      .code = Option::kEndOfOpts, .len = 0,
+  };
+
+  std::vector<char> blk(tot_len, 0);
+  char *p = blk.data();
+  memcpy(p, &idb, sizeof(idb));
+  p += sizeof(idb);
+  memcpy(p, &opt_name, sizeof(opt_name));
+  p += sizeof(opt_name);
+  memcpy(p, name.data(), name_len);
+  p += RoundUp(name_len, 4);
+  memcpy(p, &opt_tsresol, sizeof(opt_tsresol));
+  p += sizeof(opt_tsresol);
+  memcpy(p, tsresol, sizeof(tsresol));
+  p += sizeof(tsresol);
+  memcpy(p, &opt_end, sizeof(opt_end));
+  p += sizeof(opt_end);
+  memcpy(p, &tot_len, sizeof(tot_len));
+
+  mcslock_node_t node;
+  int ret;
+
+  Lock(&node);
+  if (!cur_) {
+    ret = -EBADF;
+  } else if (!Reserve(blk.size())) {
+    ret = -ENOBUFS;
+  } else {
+    Put(blk.data(), blk.size());
+    idbs_.insert(idbs_.end(), blk.begin(), blk.end());
+    ret = num_ifaces_++;
+  }
+  Unlock(&node);
+
+  return ret;
+}
+
+bool PcapngWriter::Append(uint32_t if_id, uint64_t ts_ns, const void *data,
+                          uint32_t caplen, uint32_t orig_len) {
+  static const uint32_t padding = 0;
+
+  size_t pad = RoundUp(caplen, 4) - caplen;
+  uint32_t tot_len =
+      sizeof(EnhancedPacketBlock) + caplen + pad + sizeof(uint32_t);
+
+  if (file_pkts_ > 0 &&
+      (file_len_ + tot_len > config_.file_size ||
+       (config_.rotate_ns && ts_ns >= file_start_ns_ + config_.rotate_ns))) {
+    if (!StartFile()) {
+      dropped_++;
+      return false;
+    }
+  }
+
+  if (!Reserve(tot_len)) {
+    dropped_++;
+    return false;
+  }
+
+  if (file_pkts_ == 0) {
+    file_start_ns_ = ts_ns;
+  }
+
+  EnhancedPacketBlock epb = {
+      .type = EnhancedPacketBlock::kType,
+      .tot_len = tot_len,
+      .interface_id = if_id,
+      .timestamp_high = static_cast<uint32_t>(ts_ns >> 32),
+      .timestamp_low = static_cast<uint32_t>(ts_ns),
+      .captured_len = caplen,
+      .orig_len = orig_len,
+  };
+
+  Put(&epb, sizeof(epb));
+  Put(data, caplen);
+  Put(&padding, pad);
+  Put(&tot_len, sizeof(tot_len));
+
+  file_pkts_++;
+  packets_++;
+  return true;
+}
+
+PcapngWriter::Segment *PcapngWriter::GetFree() {
+  std::lock_guard<std::mutex> guard(mtx_);
+  if (free_.empty()) {
+    return nullptr;
+  }
+  Segment *seg = free_.front();
+  free_.pop_front();
+  return seg;
+}
+
+bool PcapngWriter::Reserve(size_t len) {
+  // Put() moves on to the spare segment at most once
+  if (len >= config_.segment_size) {
+    return false;
+  }
+
+  // Strictly less: a segment that becomes full is sealed right away, and
+  // needs a successor.
+  if (cur_->len + len < config_.segment_size || spare_) {
+    return true;
+  }
+  spare_ = GetFree();
+  return spare_ != nullptr;
+}
+
+void PcapngWriter::Put(const void *data, size_t len) {
+  const char *p = static_cast<const char *>(data);
+
+  while (len > 0) {
+    size_t n = std::min(len, config_.segment_size - cur_->len);
+    memcpy(cur_->buf + cur_->len, p, n);
+    cur_->len += n;
+    file_len_ += n;
+    p += n;
+    len -= n;
+
+    if (cur_->len == config_.segment_size) {
+      Segment *next = spare_;
+      spare_ = nullptr;
+      DCHECK(next);
+      Seal(next, false);
+    }
+  }
+}
+
+void PcapngWriter::Seal(Segment *next, bool last) {
+  next->len = 0;
+  next->last = false;
+  if (last) {
+    next->file_seq = cur_->file_seq + 1;
+    next->file_off = 0;
+  } else {
+    next->file_seq = cur_->file_seq;
+    next->file_off = cur_->file_off + config_.segment_size;
+  }
+
+  cur_->last = last;
+  {
+    std::lock_guard<std::mutex> guard(mtx_);
+    full_.push_back(cur_);
+  }
+  cv_.notify_one();
+
+  cur_ = next;
+}
+
+bool PcapngWriter::StartFile() {
+  // The header goes at the beginning of an empty segment. It always fits,
+  // unless there are thousands of interfaces.
+  if (sizeof(SectionHeaderBlock) + sizeof(uint32_t) + idbs_.size() >=
+      config_.segment_size) {
+    return false;
+  }
+
+  // The previous file ends in the middle of the current segment, so the new
+  // file needs a segment of its own.
+  Segment *next = GetFree();
+  if (!next) {
+    return false;
+  }
+
+  Seal(next, true);
+
+  file_seq_++;
+  file_len_ = 0;
+  file_pkts_ = 0;
+  file_start_ns_ = 0;
+
+  SectionHeaderBlock shb = {
+      .type = SectionHeaderBlock::kType,
+      .tot_len = sizeof(shb) + sizeof(uint32_t),
+      .bom = SectionHeaderBlock::kBom,
+      .maj_ver = SectionHeaderBlock::kMajVer,
+      .min_ver = SectionHeaderBlock::kMinVer,
+      .sec_len = -1,
+  };
+
+  Put(&shb, sizeof(shb));
+  Put(&shb.tot_len, sizeof(shb.tot_len));
+  Put(idbs_.data(), idbs_.size());
+
+  return true;
+}
+
+int PcapngWriter::OpenFile(uint64_t seq) {
+  std::string path = FileName(seq);
+  int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  int fd = -1;
+
+  if (direct_) {
+    fd = open(path.c_str(), flags | O_DIRECT, 0644);
+    if (fd < 0 && errno == EINVAL) {
+      LOG(INFO) << "pcapng: O_DIRECT not supported for " << path
+                << ", using buffered I/O";
+      direct_ = false;
+    }
+  }
+
+  if (!direct_) {
+    fd = open(path.c_str(), flags, 0644);
+  }
+
+  if (fd < 0) {
+    return -errno;
+  }
+
+  // Have the file system allocate all blocks upfront, rather than on each
+  // write. Not all file systems support this, and that's fine.
+  fallocate(fd, 0, 0, config_.file_size);
+
+  fd_ = fd;
+  fd_seq_ = seq;
+  return 0;
+}
+
+void PcapngWriter::FinishFile(uint64_t len) {
+  if (fd_ < 0) {
+    return;
+  }
+
+  // Trim the preallocated space and the O_DIRECT padding
+  if (ftruncate(fd_, len) < 0) {
+    PLOG(WARNING) << "pcapng: ftruncate()";
+  }
+  close(fd_);
+  fd_ = -1;
+}
+
+void PcapngWriter::Write(uint64_t file_seq, uint64_t file_off,
+                         const char *buf, size_t len) {
+  if (fd_ >= 0 && fd_seq_ != file_seq) {
+    // Should not happen: files are finished by their last segment.
+    close(fd_);
+    fd_ = -1;
+  }
+
+  if (fd_ < 0) {
+    int ret = OpenFile(file_seq);
+    if (ret < 0) {
+      LOG_FIRST_N(ERROR, 1) << "pcapng: cannot open " << FileName(file_seq)
+                            << ": " << strerror(-ret);
+      return;
+    }
+  }
+
+  // With O_DIRECT, the tail of the last page is garbage until the segment is
+  // written again or the file is finished (and truncated).
+  size_t left = direct_ ? RoundUp(len, kAlign) : len;
+  off_t off = file_off;
+
+  while (left > 0) {
+    ssize_t ret = pwrite(fd_, buf, left, off);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_FIRST_N(ERROR, 1) << "pcapng: write to " << FileName(file_seq)
+                            << " failed: " << strerror(errno);
+      return;
+    }
+    buf += ret;
+    off += ret;
+    left -= ret;
+  }
+}
+
+void PcapngWriter::FlushPartial() {
+  mcslock_node_t node;
+
+  Lock(&node);
+  const Segment *seg = cur_;
+  size_t len = seg->len;
+  uint64_t file_seq = seg->file_seq;
+  uint64_t file_off = seg->file_off;
+  Unlock(&node);
+
+  if (len == 0 || (seg == flushed_seg_ && len == flushed_len_)) {
+    return;
+  }
+
+  {
+    // Segments sealed before the snapshot must be written first.
+    std::lock_guard<std::mutex> guard(mtx_);
+    if (!full_.empty()) {
+      return;
+    }
+  }
+
+  // Producers may keep appending past `len` meanwhile. Those bytes will be
+  // written again, along with the rest of the segment.
+  Write(file_seq, file_off, seg->buf, len);
+  flushed_seg_ = seg;
+  flushed_len_ = len;
+}
+
+void PcapngWriter::WriterThread() {
+  std::unique_lock<std::mutex> guard(mtx_);
+
+  while (true) {
+    if (full_.empty()) {
+      if (stop_) {
+        return;
+      }
+
+      bool woken =
+          cv_.wait_for(guard, std::chrono::milliseconds(kFlushIntervalMs),
+                       [this]() { return !full_.empty() || stop_; });
+      if (!woken) {
+        guard.unlock();
+        FlushPartial();
+        guard.lock();
+      }
+      continue;
+    }
+
+    Segment *seg = full_.front();
+    full_.pop_front();
+    guard.unlock();
+
+    Write(seg->file_seq, seg->file_off, seg->buf, seg->len);
+    if (seg->last) {
+      FinishFile(seg->file_off + seg->len);
+    }
+    if (seg == flushed_seg_) {
+      flushed_seg_ = nullptr;
+    }
+
+    guard.lock();
+    free_.push_back(seg);
+  }
+}
+
+}  // namespace utils
+}  // namespace bess
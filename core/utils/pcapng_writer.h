@@ -0,0 +1,209 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_PCAPNG_WRITER_H_
+#define BESS_UTILS_PCAPNG_WRITER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "mcslock.h"
+
+namespace bess {
+namespace utils {
+
+// Writes a pcapng stream into a rotating set of files, for long-running
+// captures. Producers (workers) append blocks into large, page-aligned
+// segments under a short lock; a background thread writes out full segments
+// (with O_DIRECT if the filesystem supports it) so that no system call is
+// made on the datapath.
+//
+// Files are named <prefix>_<N>.pcapng. A new file is started when the current
+// one would grow past `file_size`, or after `rotate_ns`. With a non-zero
+// `file_count`, N wraps around and the oldest file is overwritten. Each file
+// is a self-contained section, with all the interfaces registered so far.
+// Timestamps are in nanoseconds (if_tsresol = 9).
+class PcapngWriter {
+ public:
+  struct Config {
+    std::string prefix;
+    uint64_t file_size;    // Max bytes per file. Also preallocated.
+    uint32_t file_count;   // Number of files in the ring. 0: unlimited
+    uint64_t rotate_ns;    // Max time span of a file. 0: no limit
+    size_t segment_size;   // Multiple of kAlign
+    size_t num_segments;   // At least 2
+  };
+
+  // O_DIRECT requires the buffer, the offset and the size to be aligned
+  static constexpr size_t kAlign = 4096;
+
+  static constexpr size_t kDefaultSegmentSize = 4 * 1024 * 1024;
+  static constexpr size_t kDefaultNumSegments = 16;
+
+  PcapngWriter()
+      : config_(),
+        lock_(),
+        cur_(),
+        spare_(),
+        file_seq_(),
+        file_len_(),
+        file_pkts_(),
+        file_start_ns_(),
+        idbs_(),
+        num_ifaces_(),
+        packets_(),
+        dropped_(),
+        segments_(),
+        mtx_(),
+        cv_(),
+        free_(),
+        full_(),
+        stop_(),
+        writer_(),
+        fd_(-1),
+        fd_seq_(),
+        direct_(),
+        flushed_seg_(),
+        flushed_len_() {
+    mcs_lock_init(&lock_);
+  }
+
+  ~PcapngWriter() { Close(); }
+
+  // Allocates the segments and starts the writer thread. Returns 0 or -errno.
+  int Open(const Config &config);
+
+  // Writes out everything appended so far and stops the writer thread.
+  // No producer may be running.
+  void Close();
+
+  // Adds an Interface Description Block to the current and all later files.
+  // Returns the interface ID, or -errno.
+  int AddInterface(const std::string &name, uint32_t snaplen);
+
+  // Append() must be called between Lock() and Unlock(). Producers should
+  // take the lock once per batch, not per packet.
+  void Lock(mcslock_node_t *node) { mcs_lock(&lock_, node); }
+  void Unlock(mcslock_node_t *node) { mcs_unlock(&lock_, node); }
+
+  // Appends an Enhanced Packet Block. Returns false if the packet was dropped
+  // because the writer thread is lagging behind.
+  bool Append(uint32_t if_id, uint64_t ts_ns, const void *data,
+              uint32_t caplen, uint32_t orig_len);
+
+  std::string FileName(uint64_t seq) const;
+
+  const Config &config() const { return config_; }
+
+  uint64_t packets() const { return packets_; }
+  uint64_t dropped() const { return dropped_; }
+
+ private:
+  struct Segment {
+    char *buf;
+    size_t len;
+    uint64_t file_seq;
+    uint64_t file_off;
+    bool last;  // Last segment of the file
+  };
+
+  // Makes sure that `len` more bytes can be appended. Grabs a spare segment
+  // if needed. Returns false if there is none left, or if `len` does not fit
+  // in a segment.
+  bool Reserve(size_t len);
+
+  // Copies into the current segment, moving on to the spare one if full.
+  // Reserve() must have succeeded for the bytes put since.
+  void Put(const void *data, size_t len);
+
+  // Hands the current segment to the writer thread and continues with
+  // `next` (at the next offset, or at the beginning of a new file).
+  void Seal(Segment *next, bool last);
+
+  // Finishes the current file and begins a new one with a section header and
+  // all interfaces. Returns false if there is no free segment, or if the
+  // header does not fit in one.
+  bool StartFile();
+
+  Segment *GetFree();
+
+  // Writer thread side
+  void WriterThread();
+  void Write(uint64_t file_seq, uint64_t file_off, const char *buf,
+             size_t len);
+  void FlushPartial();
+  int OpenFile(uint64_t seq);
+  void FinishFile(uint64_t len);
+
+  Config config_;
+
+  // Producer side, protected by lock_
+  mcslock_t lock_;
+  Segment *cur_;
+  Segment *spare_;
+  uint64_t file_seq_;
+  uint64_t file_len_;
+  uint64_t file_pkts_;
+  uint64_t file_start_ns_;
+  std::vector<char> idbs_;  // All IDBs, to be repeated in each file
+  uint32_t num_ifaces_;
+  uint64_t packets_;
+  uint64_t dropped_;
+
+  std::vector<Segment> segments_;
+
+  // Segment queues, protected by mtx_
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::deque<Segment *> free_;
+  std::deque<Segment *> full_;
+  bool stop_;
+
+  // Writer thread side
+  std::thread writer_;
+  int fd_;
+  uint64_t fd_seq_;
+  bool direct_;
+  const Segment *flushed_seg_;
+  size_t flushed_len_;
+
+  DISALLOW_COPY_AND_ASSIGN(PcapngWriter);
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_PCAPNG_WRITER_H_
@@ -0,0 +1,204 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "pcapng_writer.h"
+
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+
+#include "pcap_reader.h"
+
+namespace {
+
+using bess::utils::PcapReader;
+using bess::utils::PcapngWriter;
+
+class PcapngWriterTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    char tmpl[] = "/tmp/pcapng_writer_test_XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(tmpl));
+    dir_ = tmpl;
+  }
+
+  virtual void TearDown() {
+    for (uint64_t i = 0; i < 100; i++) {
+      unlink(writer_.FileName(i).c_str());
+    }
+    rmdir(dir_.c_str());
+  }
+
+  PcapngWriter::Config DefaultConfig() {
+    PcapngWriter::Config config;
+    config.prefix = dir_ + "/cap";
+    config.file_size = 1024 * 1024;
+    config.file_count = 0;
+    config.rotate_ns = 0;
+    config.segment_size = 4 * PcapngWriter::kAlign;
+    config.num_segments = 64;
+    return config;
+  }
+
+  // Appends `n` 100-byte packets, with the index in the first byte and
+  // timestamps 1000ns apart.
+  void AppendPackets(int n, uint32_t if_id) {
+    mcslock_node_t node;
+    char data[100] = {};
+
+    writer_.Lock(&node);
+    for (int i = 0; i < n; i++) {
+      data[0] = static_cast<char>(i);
+      EXPECT_TRUE(writer_.Append(if_id, 1000 * (i + 1), data, sizeof(data),
+                                 sizeof(data) + 10));
+    }
+    writer_.Unlock(&node);
+  }
+
+  // Returns the number of packets in the file
+  int CountPackets(const std::string &path) {
+    PcapReader reader;
+    PcapReader::Record rec;
+    int cnt = 0;
+
+    if (reader.Open(path) != 0) {
+      return -1;
+    }
+    while (reader.Next(&rec)) {
+      cnt++;
+    }
+    return cnt;
+  }
+
+  static bool Exists(const std::string &path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+  }
+
+  std::string dir_;
+  PcapngWriter writer_;
+};
+
+TEST_F(PcapngWriterTest, InvalidConfig) {
+  PcapngWriter::Config config = DefaultConfig();
+  config.segment_size = 1000;
+  EXPECT_EQ(-EINVAL, writer_.Open(config));
+
+  config = DefaultConfig();
+  config.file_count = 1;
+  EXPECT_EQ(-EINVAL, writer_.Open(config));
+}
+
+TEST_F(PcapngWriterTest, ReadBack) {
+  ASSERT_EQ(0, writer_.Open(DefaultConfig()));
+  EXPECT_EQ(0, writer_.AddInterface("m0:out0", 128));
+  EXPECT_EQ(1, writer_.AddInterface("m1:in0", 128));
+
+  // Spans several segments
+  AppendPackets(1000, 1);
+  writer_.Close();
+
+  PcapReader reader;
+  PcapReader::Record rec;
+  ASSERT_EQ(0, reader.Open(writer_.FileName(0)));
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(reader.Next(&rec));
+    EXPECT_EQ(100, rec.caplen);
+    EXPECT_EQ(static_cast<uint8_t>(i), rec.data[0]);
+    EXPECT_EQ(1000ull * (i + 1), rec.ts_ns);
+  }
+  EXPECT_FALSE(reader.Next(&rec));
+  EXPECT_FALSE(Exists(writer_.FileName(1)));
+}
+
+TEST_F(PcapngWriterTest, RotateBySize) {
+  PcapngWriter::Config config = DefaultConfig();
+  config.file_size = 16 * 1024;
+  config.file_count = 3;
+  ASSERT_EQ(0, writer_.Open(config));
+  ASSERT_EQ(0, writer_.AddInterface("m0:out0", 128));
+
+  // 136 bytes per block: ~120 packets per file, 9 files
+  AppendPackets(1000, 0);
+  writer_.Close();
+
+  int total = 0;
+  for (uint64_t i = 0; i < 3; i++) {
+    struct stat st;
+    ASSERT_EQ(0, stat(writer_.FileName(i).c_str(), &st));
+    EXPECT_LE(st.st_size, 16 * 1024);
+
+    int cnt = CountPackets(writer_.FileName(i));
+    EXPECT_GT(cnt, 0);
+    total += cnt;
+  }
+  EXPECT_LT(total, 1000);
+  EXPECT_FALSE(Exists(dir_ + "/cap_003.pcapng"));
+  EXPECT_EQ(1000, writer_.packets());
+}
+
+TEST_F(PcapngWriterTest, RotateByTime) {
+  PcapngWriter::Config config = DefaultConfig();
+  config.rotate_ns = 5000;
+  ASSERT_EQ(0, writer_.Open(config));
+  ASSERT_EQ(0, writer_.AddInterface("m0:out0", 128));
+
+  AppendPackets(20, 0);
+  writer_.Close();
+
+  for (uint64_t i = 0; i < 4; i++) {
+    EXPECT_EQ(5, CountPackets(writer_.FileName(i)));
+  }
+  EXPECT_FALSE(Exists(writer_.FileName(4)));
+}
+
+// Tests that a packet larger than a segment is dropped, not written in part.
+TEST_F(PcapngWriterTest, DropOversized) {
+  ASSERT_EQ(0, writer_.Open(DefaultConfig()));
+  ASSERT_EQ(0, writer_.AddInterface("m0:out0", 65535));
+
+  std::string big(DefaultConfig().segment_size, 'x');
+  mcslock_node_t node;
+  writer_.Lock(&node);
+  EXPECT_FALSE(writer_.Append(0, 1000, big.data(), big.size(), big.size()));
+  writer_.Unlock(&node);
+  EXPECT_EQ(1, writer_.dropped());
+
+  AppendPackets(10, 0);
+  writer_.Close();
+
+  EXPECT_EQ(10, CountPackets(writer_.FileName(0)));
+  EXPECT_EQ(10, writer_.packets());
+}
+
+}  // namespace
@@ -30,6 +30,8 @@
 
 #include "worker.h"
 
+#include <cpuid.h>
+#include <poll.h>
 #include <sched.h>
 #include <sys/eventfd.h>
 #include <unistd.h>
@@ -38,17 +40,22 @@
 #include <rte_config.h>
 #include <rte_lcore.h>
 
+#include <algorithm>
 #include <cassert>
 #include <climits>
+#include <cmath>
 #include <list>
+#include <map>
 #include <string>
 #include <utility>
 
 #include "metadata.h"
 #include "module.h"
+#include "module_graph.h"
 #include "opts.h"
 #include "packet.h"
 #include "resume_hook.h"
+#include "rcu.h"
 #include "resume_hooks/metadata.h"
 #include "scheduler.h"
 #include "utils/random.h"
@@ -57,6 +64,7 @@
 using bess::Scheduler;
 using bess::DefaultScheduler;
 using bess::ExperimentalScheduler;
+using bess::AdaptiveScheduler;
 
 int num_workers = 0;
 std::thread worker_threads[Worker::kMaxWorkers];
@@ -77,6 +85,12 @@ struct thread_arg {
   Scheduler *scheduler;
 };
 
+// fds registered with add_idle_wakeup_fd(). Only modified by the master
+// thread, with the workers paused.
+static const int kMaxIdleWakeupFds = 64;
+static int idle_wakeup_fds[kMaxIdleWakeupFds];
+static int num_idle_wakeup_fds;
+
 #define SYS_CPU_DIR "/sys/devices/system/cpu/cpu%u"
 #define CORE_ID_FILE "topology/core_id"
 
@@ -111,11 +125,41 @@ void pause_worker(int wid) {
 
     FULL_BARRIER();
 
+    wakeup_worker(wid);
+
     while (workers[wid]->status() == WORKER_PAUSING) {
     } /* spin */
   }
 }
 
+void wakeup_worker(int wid) {
+  if (workers[wid]) {
+    uint64_t one = 1;
+    int ret = write(workers[wid]->fd_idle(), &one, sizeof(one));
+    // EAGAIN if the counter is saturated, which is fine
+    DCHECK(ret == sizeof(one) || errno == EAGAIN);
+  }
+}
+
+bool add_idle_wakeup_fd(int fd) {
+  WorkerPauser wp;
+  if (num_idle_wakeup_fds >= kMaxIdleWakeupFds) {
+    return false;
+  }
+  idle_wakeup_fds[num_idle_wakeup_fds++] = fd;
+  return true;
+}
+
+void remove_idle_wakeup_fd(int fd) {
+  WorkerPauser wp;
+  for (int i = 0; i < num_idle_wakeup_fds; i++) {
+    if (idle_wakeup_fds[i] == fd) {
+      idle_wakeup_fds[i] = idle_wakeup_fds[--num_idle_wakeup_fds];
+      return;
+    }
+  }
+}
+
 void pause_all_workers() {
   for (int wid = 0; wid < Worker::kMaxWorkers; wid++)
     pause_worker(wid);
@@ -183,6 +227,8 @@ void destroy_worker(int wid) {
   pause_worker(wid);
 
   if (workers[wid] && workers[wid]->status() == WORKER_PAUSED) {
+    // The Worker object is gone with the thread. See SynchronizeRcu().
+    std::lock_guard<std::mutex> lock(bess::rcu_mutex);
     int ret;
     worker_signal sig = worker_signal::quit;
 
@@ -239,6 +285,7 @@ void Worker::SetNonWorker() {
   core_ = INT_MIN;
   socket_ = INT_MIN;
   fd_event_ = INT_MIN;
+  fd_idle_ = INT_MIN;
 
   // Packet pools should be available to non-worker threads.
   // (doesn't need to be NUMA-aware, so pick any)
@@ -274,6 +321,82 @@ int Worker::BlockWorker() {
   return 0;
 }
 
+static bool cpu_has_waitpkg() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return ecx & (1 << 5);
+}
+
+bool Worker::IdleWait(uint64_t deadline_tsc) {
+  static const bool has_waitpkg = cpu_has_waitpkg();
+  if (!has_waitpkg) {
+    return false;
+  }
+
+  // tpause ecx, with ecx = 1 (C0.1, the lighter state with faster wakeup).
+  // Encoded by hand, for assemblers that do not know WAITPKG.
+  asm volatile(".byte 0x66, 0x0f, 0xae, 0xf1"
+               :
+               : "c"(1), "a"(static_cast<uint32_t>(deadline_tsc)),
+                 "d"(static_cast<uint32_t>(deadline_tsc >> 32))
+               : "cc", "memory");
+  return true;
+}
+
+bool Worker::IdleSleep(uint64_t timeout_us, bool use_wakeup_fds) {
+  struct pollfd fds[kMaxIdleWakeupFds + 1];
+  int num_fds = 0;
+
+  fds[num_fds].fd = fd_idle_;
+  fds[num_fds].events = POLLIN;
+  num_fds++;
+
+  if (use_wakeup_fds) {
+    for (int i = 0; i < num_idle_wakeup_fds; i++) {
+      fds[num_fds].fd = idle_wakeup_fds[i];
+      fds[num_fds].events = POLLIN;
+      num_fds++;
+    }
+  }
+
+  struct timespec timeout;
+  timeout.tv_sec = timeout_us / 1000000;
+  timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+
+  int ret = ppoll(fds, num_fds, &timeout, nullptr);
+  if (ret <= 0) {
+    return false;
+  }
+
+  if (fds[0].revents & POLLIN) {
+    uint64_t cnt;
+    ret = read(fd_idle_, &cnt, sizeof(cnt));
+    DCHECK_EQ(ret, sizeof(cnt));
+  }
+
+  for (int i = 1; i < num_fds; i++) {
+    if (fds[i].revents) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Worker::Init(int wid, int core, int socket, bess::Scheduler *scheduler) {
+  wid_ = wid;
+  core_ = core;
+  socket_ = socket;
+  DCHECK_GE(socket_, 0); /* shouldn't be SOCKET_ID_ANY (-1) */
+  fd_event_ = eventfd(0, 0);
+  DCHECK_GE(fd_event_, 0);
+  fd_idle_ = eventfd(0, EFD_NONBLOCK);
+  DCHECK_GE(fd_idle_, 0);
+
+  scheduler_ = scheduler;
+}
+
 /* The entry point of worker threads */
 void *Worker::Run(void *_arg) {
   struct thread_arg *arg = (struct thread_arg *)_arg;
@@ -289,14 +412,7 @@ void *Worker::Run(void *_arg) {
   RTE_PER_LCORE(_lcore_id) = arg->wid;
 
   /* for workers, wid == rte_lcore_id() */
-  wid_ = arg->wid;
-  core_ = arg->core;
-  socket_ = rte_socket_id();
-  DCHECK_GE(socket_, 0); /* shouldn't be SOCKET_ID_ANY (-1) */
-  fd_event_ = eventfd(0, 0);
-  DCHECK_GE(fd_event_, 0);
-
-  scheduler_ = arg->scheduler;
+  Init(arg->wid, arg->core, rte_socket_id(), arg->scheduler);
 
   current_tsc_ = rdtsc();
 
@@ -332,15 +448,28 @@ void *run_worker(void *_arg) {
 }
 
 void launch_worker(int wid, int core,
-                   [[maybe_unused]] const std::string &scheduler) {
+                   [[maybe_unused]] const std::string &scheduler,
+                   uint64_t idle_sleep_us, uint64_t max_poll_latency_us) {
   struct thread_arg arg = {.wid = wid, .core = core, .scheduler = nullptr};
   if (scheduler == "") {
     arg.scheduler = new DefaultScheduler();
   } else if (scheduler == "experimental") {
     arg.scheduler = new ExperimentalScheduler();
+  } else if (scheduler == "adaptive") {
+    if (!max_poll_latency_us) {
+      max_poll_latency_us = AdaptiveScheduler::kDefaultMaxPollLatencyUs;
+    }
+    arg.scheduler = new AdaptiveScheduler(nullptr, max_poll_latency_us);
+    // Sleeping when idle must not break the latency bound either
+    idle_sleep_us = std::min(idle_sleep_us, max_poll_latency_us);
   } else {
     CHECK(false) << "Scheduler " << scheduler << " is invalid.";
   }
+  arg.scheduler->set_idle_sleep_us(idle_sleep_us);
+
+  // The worker picks the packet pool of its socket up as it starts, so make
+  // sure there is one (see --lazy_mempool).
+  bess::ensure_pframe_pool_socket(rte_lcore_to_socket_id(core));
 
   worker_threads[wid] = std::thread(run_worker, &arg);
   worker_threads[wid].detach();
@@ -412,6 +541,171 @@ bool detach_tc(bess::TrafficClass *c) {
   return remove_tc_from_orphan(c);
 }
 
+bool migrate_tc(bess::LeafTrafficClass *c, int wid) {
+  CHECK(!is_any_worker_running());
+
+  int from_wid = c->WorkerId();
+  if (!c->migratable() || from_wid < 0 || from_wid == wid ||
+      !is_worker_active(wid)) {
+    return false;
+  }
+
+  // Tasks placed in a tree of their own (by AddTc or UpdateTcParent) stay
+  // where they are. Otherwise 'c' is either under the default round-robin
+  // root or, if there is none, the root itself.
+  Scheduler *from = workers[from_wid]->scheduler();
+  if (c->parent() != from->default_rr_class()) {
+    return false;
+  }
+
+  placement_constraint socket = 1ull << workers[wid]->socket();
+  if ((c->task()->GetSocketConstraints() & socket) == 0) {
+    return false;
+  }
+
+  CHECK(detach_tc(c));
+  from->AdjustDefault();
+
+  // The leaf may be waiting to be polled again (ExperimentalScheduler and
+  // AdaptiveScheduler). The new worker polls it right away instead.
+  from->wakeup_queue().Remove(c);
+  c->UnblockTowardsRoot(rdtsc());
+
+  CHECK(workers[wid]->scheduler()->AttachOrphan(c, wid));
+  return true;
+}
+
+// Number of modules that run on more workers than they allow
+static int count_unsafe_modules() {
+  int cnt = 0;
+  for (const auto &pair : ModuleGraph::GetAllModules()) {
+    const Module *m = pair.second;
+    if (static_cast<int>(m->num_active_workers()) > m->max_allowed_workers()) {
+      cnt++;
+    }
+  }
+  return cnt;
+}
+
+rebalance_result rebalance_workers(double min_load_gap) {
+  // Cycle counters as of the previous call
+  static uint64_t last_busy[Worker::kMaxWorkers];
+  static uint64_t last_total[Worker::kMaxWorkers];
+  static std::map<std::string, uint64_t> last_tc_cycles;
+
+  rebalance_result ret = {};
+  ret.from_wid = ret.to_wid = -1;
+
+  uint64_t window[Worker::kMaxWorkers] = {};
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (!is_worker_active(wid)) {
+      last_busy[wid] = last_total[wid] = 0;
+      continue;
+    }
+
+    const bess::sched_stats &stats = workers[wid]->scheduler()->stats();
+    uint64_t busy = stats.cycles_busy;
+    uint64_t total = stats.cycles_busy + stats.cycles_idle;
+    if (total < last_total[wid]) {
+      // A new worker with the same ID
+      last_busy[wid] = last_total[wid] = 0;
+    }
+
+    double load = -1.0;
+    if (last_total[wid] && total > last_total[wid] &&
+        is_worker_running(wid)) {
+      window[wid] = total - last_total[wid];
+      load = static_cast<double>(busy - last_busy[wid]) / window[wid];
+    }
+    last_busy[wid] = busy;
+    last_total[wid] = total;
+
+    if (load < 0.0) {
+      continue;
+    }
+    if (ret.from_wid < 0 || load > ret.from_load) {
+      ret.from_wid = wid;
+      ret.from_load = load;
+    }
+    if (ret.to_wid < 0 || load < ret.to_load) {
+      ret.to_wid = wid;
+      ret.to_load = load;
+    }
+  }
+
+  // Cycles used by each leaf since the previous call
+  std::map<std::string, uint64_t> tc_cycles;
+  std::vector<std::pair<bess::LeafTrafficClass *, uint64_t>> candidates;
+  for (const auto &pair : bess::TrafficClassBuilder::all_tcs()) {
+    bess::TrafficClass *c = pair.second;
+    if (c->policy() != bess::POLICY_LEAF) {
+      continue;
+    }
+
+    uint64_t cycles = c->stats().usage[bess::RESOURCE_CYCLE];
+    tc_cycles[c->name()] = cycles;
+
+    auto it = last_tc_cycles.find(c->name());
+    auto leaf = static_cast<bess::LeafTrafficClass *>(c);
+    if (it != last_tc_cycles.end() && cycles > it->second &&
+        leaf->migratable() && ret.from_wid >= 0 &&
+        leaf->WorkerId() == ret.from_wid) {
+      candidates.emplace_back(leaf, cycles - it->second);
+    }
+  }
+  last_tc_cycles.swap(tc_cycles);
+
+  if (ret.from_wid < 0 || ret.from_wid == ret.to_wid ||
+      ret.from_load - ret.to_load < min_load_gap) {
+    return ret;
+  }
+
+  // Ideally, move half of the gap. Never move more than all of it, or the
+  // imbalance just flips around.
+  double gap_cycles = (ret.from_load - ret.to_load) * window[ret.from_wid];
+  bess::LeafTrafficClass *best = nullptr;
+  double best_diff = 0.0;
+  for (const auto &candidate : candidates) {
+    double cycles = candidate.second;
+    if (cycles >= gap_cycles) {
+      continue;
+    }
+    double diff = std::abs(cycles - gap_cycles / 2);
+    if (!best || diff < best_diff) {
+      best = candidate.first;
+      best_diff = diff;
+    }
+  }
+  if (!best) {
+    return ret;
+  }
+
+  WorkerPauser wp;
+
+  propagate_active_worker();
+  int unsafe = count_unsafe_modules();
+
+  if (!migrate_tc(best, ret.to_wid)) {
+    return ret;
+  }
+
+  propagate_active_worker();
+  if (count_unsafe_modules() > unsafe) {
+    LOG(INFO) << "Not moving " << best->name() << " to worker " << ret.to_wid
+              << ": its pipeline is not thread safe";
+    CHECK(migrate_tc(best, ret.from_wid));
+    propagate_active_worker();
+    return ret;
+  }
+
+  LOG(INFO) << "Moved " << best->name() << " from worker " << ret.from_wid
+            << " (load " << ret.from_load << ") to worker " << ret.to_wid
+            << " (load " << ret.to_load << ")";
+  ret.moved = true;
+  ret.tc = best->name();
+  return ret;
+}
+
 WorkerPauser::WorkerPauser() {
   if (is_any_worker_running()) {
     for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
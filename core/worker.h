@@ -33,6 +33,7 @@
 
 #include <glog/logging.h>
 
+#include <atomic>
 #include <cstdint>
 #include <string>
 #include <thread>
@@ -79,6 +80,11 @@ class Worker {
   static const int kMaxWorkers = 64;
   static const int kAnyWorker = -1;  // unspecified worker ID
 
+  // Max number of calls that can be deferred within a single task run
+  static const int kMaxDeferredCalls = 32;
+
+  using deferred_func_t = void (*)(void *);
+
   /* ----------------------------------------------------------------------
    * functions below are invoked by non-worker threads (the master)
    * ---------------------------------------------------------------------- */
@@ -92,9 +98,22 @@ class Worker {
   /* Block myself. Return nonzero if the worker needs to die */
   int BlockWorker();
 
+  /* Sets the identity, event fds and scheduler of the worker. Run() calls
+   * this first thing; tests may call it to set up a worker without a thread */
+  void Init(int wid, int core, int socket, bess::Scheduler *scheduler);
+
   /* The entry point of worker threads */
   void *Run(void *_arg);
 
+  // Waits in tpause until `deadline_tsc`, or until an interrupt. Returns false
+  // without waiting if the CPU does not support it.
+  bool IdleWait(uint64_t deadline_tsc);
+
+  // Sleeps for up to `timeout_us` microseconds, until Wakeup() is called or,
+  // if `use_wakeup_fds`, one of the fds registered with add_idle_wakeup_fd()
+  // becomes readable. Returns true if woken up by a registered fd.
+  bool IdleSleep(uint64_t timeout_us, bool use_wakeup_fds);
+
   worker_status_t status() { return status_; }
   void set_status(worker_status_t status) { status_ = status; }
 
@@ -102,6 +121,7 @@ class Worker {
   int core() { return core_; }
   int socket() { return socket_; }
   int fd_event() { return fd_event_; }
+  int fd_idle() { return fd_idle_; }
 
   struct rte_mempool *pframe_pool() {
     return pframe_pool_;
@@ -122,7 +142,41 @@ class Worker {
   gate_idx_t current_igate() const { return current_igate_; }
   void set_current_igate(gate_idx_t idx) { current_igate_ = idx; }
 
-  bess::PacketBatch **splits() { return splits_; }
+  uint16_t *split_slots() { return split_slots_; }
+
+  // Called by the scheduler between tasks, where the worker holds no
+  // references to RCU-protected data. See rcu.h.
+  void ReportQuiescentState(uint64_t epoch) {
+    quiescent_epoch_.store(epoch, std::memory_order_release);
+  }
+  uint64_t quiescent_epoch() const {
+    return quiescent_epoch_.load(std::memory_order_acquire);
+  }
+
+  // Defers fn(arg) until the currently running task returns, so that work
+  // triggered several times in one scheduling round (e.g., notifying a peer
+  // after SendPackets()) is done only once. Returns false if there is no room
+  // left, in which case the caller should do the work right away.
+  bool DeferCall(deferred_func_t fn, void *arg) {
+    if (unlikely(num_deferred_calls_ >= kMaxDeferredCalls)) {
+      return false;
+    }
+    deferred_calls_[num_deferred_calls_].fn = fn;
+    deferred_calls_[num_deferred_calls_].arg = arg;
+    num_deferred_calls_++;
+    return true;
+  }
+
+  // Called by the scheduler after each task.
+  void RunDeferredCalls() {
+    if (likely(num_deferred_calls_ == 0)) {
+      return;
+    }
+    for (int i = 0; i < num_deferred_calls_; i++) {
+      deferred_calls_[i].fn(deferred_calls_[i].arg);
+    }
+    num_deferred_calls_ = 0;
+  }
 
   Random *rand() const { return rand_; }
 
@@ -133,6 +187,7 @@ class Worker {
   int core_;  // TODO: should be cpuset_t
   int socket_;
   int fd_event_;
+  int fd_idle_;  // to interrupt IdleSleep()
 
   struct rte_mempool *pframe_pool_;
 
@@ -149,11 +204,21 @@ class Worker {
 
   Random *rand_;
 
-  // For each possible output gate contains a pointer to a batch, or nullptr,
-  // if no batch has been associated with the output gate yet.
+  // The last bess::rcu_epoch seen between tasks
+  std::atomic<uint64_t> quiescent_epoch_;
+
+  int num_deferred_calls_;
+  struct {
+    deferred_func_t fn;
+    void *arg;
+  } deferred_calls_[kMaxDeferredCalls];
+
+  // Scratch space for Module::RunSplit(). For each possible output gate
+  // contains (1 + the index of the gate among those seen in the current
+  // batch), or 0 if the gate has not been seen yet.
   //
   // This should be the last field, since it's huge.
-  bess::PacketBatch *splits_[MAX_GATES + 1];
+  uint16_t split_slots_[MAX_GATES + 1];
 };
 
 // NOTE: Do not use "thread_local" here. It requires a function call every time
@@ -181,6 +246,10 @@ extern Worker *volatile workers[Worker::kMaxWorkers];
 int is_worker_core(int cpu);
 
 void pause_worker(int wid);
+
+// Interrupts the worker if it is sleeping in Worker::IdleSleep(). A no-op if
+// it is not, other than making its next IdleSleep() return immediately.
+void wakeup_worker(int wid);
 void pause_all_workers();
 
 /*!
@@ -205,8 +274,20 @@ inline bool is_worker_running(int wid) {
 }
 
 // arg (int) is the core id the worker should run on, and optionally the
-// scheduler to use.
-void launch_worker(int wid, int core, const std::string &scheduler = "");
+// scheduler to use. If idle_sleep_us is nonzero, the worker backs off instead
+// of busy polling when it has nothing to run (see
+// Scheduler::set_idle_sleep_us()). max_poll_latency_us applies to the
+// "adaptive" scheduler only (0 for its default).
+void launch_worker(int wid, int core, const std::string &scheduler = "",
+                   uint64_t idle_sleep_us = 0,
+                   uint64_t max_poll_latency_us = 0);
+
+// Registers an fd that becomes readable when there is (likely) work to do, so
+// that workers sleeping in Worker::IdleSleep() wake up for it. Ports that have
+// such an fd (e.g., an epoll fd on a socket) should register it. Returns false
+// if there are too many fds registered already.
+bool add_idle_wakeup_fd(int fd);
+void remove_idle_wakeup_fd(int fd);
 
 Worker *get_next_active_worker();
 
@@ -232,6 +313,32 @@ const std::list<std::pair<int, bess::TrafficClass *>> &list_orphan_tcs();
 // Otherwise, return false
 bool detach_tc(bess::TrafficClass *c);
 
+// Moves the migratable leaf 'c' from the default round-robin root of its
+// worker (see Scheduler::AttachOrphan()), or from the root if there is no
+// other task, to worker 'wid'. All workers must be paused. Returns false,
+// without doing anything, if 'c' cannot be moved.
+bool migrate_tc(bess::LeafTrafficClass *c, int wid);
+
+struct rebalance_result {
+  bool moved;
+  std::string tc;  // the leaf moved
+  int from_wid;
+  int to_wid;
+
+  // Fraction of cycles spent running tasks that yielded packets, since the
+  // previous call, for the most and least loaded running workers
+  double from_load;
+  double to_load;
+};
+
+// Moves at most one migratable task from the most loaded running worker to
+// the least loaded one, if their loads differ by at least min_load_gap,
+// picking the task whose share of the load best evens them out. Call it
+// periodically (e.g., every second) to have idle workers take over work from
+// overloaded ones; the first call only takes a sample. A move that would have
+// a thread-unsafe module run on more workers than it allows is undone.
+rebalance_result rebalance_workers(double min_load_gap);
+
 // This class is used as a resource manager to automatically pause workers if
 // running and then restarts workers if they were previously paused.
 class WorkerPauser {
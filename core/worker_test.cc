@@ -0,0 +1,328 @@
+// Copyright (c) 2017, The Regents of the University of California.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "worker.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "scheduler.h"
+#include "task.h"
+#include "traffic_class.h"
+
+#define CT bess::TrafficClassBuilder::CreateTree
+
+using namespace bess::traffic_class_initializer_types;
+using bess::LeafTrafficClass;
+using bess::TrafficClass;
+
+namespace {
+
+// A scheduler whose cycle counters can be advanced by hand
+class TestScheduler : public bess::DefaultScheduler {
+ public:
+  void AddCycles(uint64_t busy, uint64_t idle) {
+    stats_.cycles_busy += busy;
+    stats_.cycles_idle += idle;
+  }
+};
+
+}  // namespace
+
+// Sets up workers that have no thread of their own. migrate_tc() and
+// rebalance_workers() only look at their schedulers and status, and
+// StartWorkers() runs a thread that pauses and resumes them on request.
+class WorkerTest : public ::testing::Test {
+ protected:
+  static const int kNumWorkers = 2;
+
+  virtual void SetUp() {
+    for (int wid = 0; wid < kNumWorkers; wid++) {
+      Worker *w = new Worker();
+      w->Init(wid, wid, 0, new TestScheduler());
+      w->set_status(WORKER_PAUSED);
+      // RunWorkers() polls for signals
+      fcntl(w->fd_event(), F_SETFL, O_NONBLOCK);
+      workers[wid] = w;
+    }
+  }
+
+  virtual void TearDown() {
+    StopWorkers();
+    for (int wid = 0; wid < kNumWorkers; wid++) {
+      Worker *w = workers[wid];
+      workers[wid] = nullptr;
+      delete w->scheduler();
+      close(w->fd_event());
+      close(w->fd_idle());
+      delete w;
+    }
+
+    // Forgets the samples taken by the test
+    rebalance_workers(1.0);
+    bess::TrafficClassBuilder::ClearAll();
+  }
+
+  TestScheduler *sched(int wid) {
+    return static_cast<TestScheduler *>(workers[wid]->scheduler());
+  }
+
+  // Creates a leaf and attaches it to worker 'wid', as attach_orphans() does
+  LeafTrafficClass *AddLeaf(const std::string &name, int wid,
+                            bool migratable = true) {
+    Task t(nullptr, nullptr);
+    auto c = static_cast<LeafTrafficClass *>(CT(name, {LEAF, t}));
+    c->set_migratable(migratable);
+    EXPECT_TRUE(sched(wid)->AttachOrphan(c, wid));
+    return c;
+  }
+
+  // Accounts 'cycles' to the leaf as if its task had run for that long
+  void Run(LeafTrafficClass *c, uint64_t cycles) {
+    bess::resource_arr_t usage = {};
+    usage[bess::RESOURCE_CYCLE] = cycles;
+    c->FinishAndAccountTowardsRoot(&sched(c->WorkerId())->wakeup_queue(),
+                                   nullptr, usage, 0);
+  }
+
+  std::vector<TrafficClass *> DefaultChildren(int wid) {
+    TrafficClass *rr = sched(wid)->default_rr_class();
+    return rr ? rr->Children() : std::vector<TrafficClass *>();
+  }
+
+  void StartWorkers() {
+    for (int wid = 0; wid < kNumWorkers; wid++) {
+      workers[wid]->set_status(WORKER_RUNNING);
+    }
+    stop_ = false;
+    thread_ = std::thread([this]() { RunWorkers(); });
+  }
+
+  void StopWorkers() {
+    if (!thread_.joinable()) {
+      return;
+    }
+    stop_ = true;
+    thread_.join();
+    for (int wid = 0; wid < kNumWorkers; wid++) {
+      workers[wid]->set_status(WORKER_PAUSED);
+    }
+  }
+
+  std::atomic<bool> stop_;
+  std::thread thread_;
+
+ private:
+  // Does what Worker::BlockWorker() would do for each of the workers
+  void RunWorkers() {
+    while (!stop_) {
+      for (int wid = 0; wid < kNumWorkers; wid++) {
+        Worker *w = workers[wid];
+        uint64_t sig;
+        if (w->status() == WORKER_PAUSING) {
+          w->set_status(WORKER_PAUSED);
+        } else if (w->status() == WORKER_PAUSED &&
+                   read(w->fd_event(), &sig, sizeof(sig)) == sizeof(sig)) {
+          w->set_status(WORKER_RUNNING);
+        }
+      }
+    }
+  }
+};
+
+// Tests moving leaves back and forth, and that the default round-robin roots
+// are created and taken down along the way.
+TEST_F(WorkerTest, MigrateTc) {
+  LeafTrafficClass *a = AddLeaf("leaf_a", 0);
+  LeafTrafficClass *b = AddLeaf("leaf_b", 0);
+  LeafTrafficClass *c = AddLeaf("leaf_c", 0);
+  TrafficClass *rr0 = sched(0)->default_rr_class();
+  ASSERT_NE(nullptr, rr0);
+  ASSERT_EQ(rr0, sched(0)->root());
+  ASSERT_EQ(3, DefaultChildren(0).size());
+
+  // The only task of worker 1 becomes its root
+  ASSERT_TRUE(migrate_tc(a, 1));
+  EXPECT_EQ(1, a->WorkerId());
+  EXPECT_EQ(nullptr, a->parent());
+  EXPECT_EQ(a, sched(1)->root());
+  EXPECT_EQ(nullptr, sched(1)->default_rr_class());
+  EXPECT_EQ(std::vector<TrafficClass *>({b, c}), DefaultChildren(0));
+  EXPECT_EQ(rr0, b->parent());
+
+  // ... and then goes under a new default root, along with the next one
+  ASSERT_TRUE(migrate_tc(b, 1));
+  TrafficClass *rr1 = sched(1)->default_rr_class();
+  ASSERT_NE(nullptr, rr1);
+  EXPECT_EQ(rr1, sched(1)->root());
+  EXPECT_EQ(rr1, a->parent());
+  EXPECT_EQ(rr1, b->parent());
+  EXPECT_EQ(1, b->WorkerId());
+  EXPECT_EQ(std::vector<TrafficClass *>({a, b}), DefaultChildren(1));
+
+  // The default root of worker 0 is gone with a single task left
+  EXPECT_EQ(nullptr, sched(0)->default_rr_class());
+  EXPECT_EQ(c, sched(0)->root());
+  EXPECT_EQ(nullptr, c->parent());
+  EXPECT_EQ(0, c->WorkerId());
+
+  // A task that is the root can be moved too
+  ASSERT_TRUE(migrate_tc(c, 1));
+  EXPECT_EQ(nullptr, sched(0)->root());
+  EXPECT_EQ(rr1, c->parent());
+  EXPECT_EQ(3, DefaultChildren(1).size());
+
+  ASSERT_TRUE(migrate_tc(a, 0));
+  EXPECT_EQ(a, sched(0)->root());
+  EXPECT_EQ(0, a->WorkerId());
+  EXPECT_EQ(std::vector<TrafficClass *>({b, c}), DefaultChildren(1));
+}
+
+// Tests the tasks that migrate_tc() must leave where they are.
+TEST_F(WorkerTest, MigrateTcRefused) {
+  LeafTrafficClass *fixed = AddLeaf("leaf_fixed", 0, false);
+  LeafTrafficClass *a = AddLeaf("leaf_a", 0);
+
+  EXPECT_FALSE(migrate_tc(fixed, 1));
+  EXPECT_FALSE(migrate_tc(a, 0));
+  EXPECT_FALSE(migrate_tc(a, kNumWorkers));  // no such worker
+  EXPECT_EQ(0, a->WorkerId());
+  EXPECT_EQ(std::vector<TrafficClass *>({fixed, a}), DefaultChildren(0));
+
+  // A task in a tree of its own
+  Task t(nullptr, nullptr);
+  TrafficClass *tree =
+      CT("rr", {ROUND_ROBIN}, {CT("leaf_in_tree", {LEAF, t})});
+  auto in_tree = static_cast<LeafTrafficClass *>(tree->Children()[0]);
+  in_tree->set_migratable(true);
+  ASSERT_TRUE(sched(0)->AttachOrphan(tree, 0));
+  EXPECT_FALSE(migrate_tc(in_tree, 1));
+  EXPECT_EQ(tree, in_tree->parent());
+
+  // An orphan
+  std::unique_ptr<LeafTrafficClass> orphan(
+      static_cast<LeafTrafficClass *>(CT("leaf_orphan", {LEAF, t})));
+  orphan->set_migratable(true);
+  EXPECT_FALSE(migrate_tc(orphan.get(), 1));
+
+  EXPECT_EQ(nullptr, sched(1)->root());
+}
+
+// Tests that the leaf whose cycles are closest to half of the gap in load is
+// moved from the busiest worker to the idlest one.
+TEST_F(WorkerTest, RebalanceWorkers) {
+  LeafTrafficClass *a = AddLeaf("leaf_a", 0);
+  LeafTrafficClass *b = AddLeaf("leaf_b", 0);
+  LeafTrafficClass *c = AddLeaf("leaf_c", 0);
+  LeafTrafficClass *d = AddLeaf("leaf_d", 1);
+  StartWorkers();
+
+  // The first call only takes a sample
+  sched(0)->AddCycles(0, 1000);
+  sched(1)->AddCycles(0, 1000);
+  rebalance_result ret = rebalance_workers(0.2);
+  EXPECT_FALSE(ret.moved);
+  EXPECT_EQ(-1, ret.from_wid);
+
+  // The gap is 800 cycles. Moving leaf_b evens the workers out the most.
+  Run(a, 600);
+  Run(b, 250);
+  Run(c, 50);
+  Run(d, 100);
+  sched(0)->AddCycles(900, 100);
+  sched(1)->AddCycles(100, 900);
+  ret = rebalance_workers(0.2);
+  EXPECT_TRUE(ret.moved);
+  EXPECT_EQ("leaf_b", ret.tc);
+  EXPECT_EQ(0, ret.from_wid);
+  EXPECT_EQ(1, ret.to_wid);
+  EXPECT_DOUBLE_EQ(0.9, ret.from_load);
+  EXPECT_DOUBLE_EQ(0.1, ret.to_load);
+
+  EXPECT_EQ(1, b->WorkerId());
+  EXPECT_EQ(std::vector<TrafficClass *>({a, c}), DefaultChildren(0));
+  EXPECT_EQ(std::vector<TrafficClass *>({d, b}), DefaultChildren(1));
+
+  // The workers are only paused for the move
+  EXPECT_TRUE(is_worker_running(0));
+  EXPECT_TRUE(is_worker_running(1));
+}
+
+// Tests the cases where rebalance_workers() leaves all tasks in place.
+TEST_F(WorkerTest, RebalanceWorkersNoMove) {
+  LeafTrafficClass *a = AddLeaf("leaf_a", 0);
+  LeafTrafficClass *fixed = AddLeaf("leaf_fixed", 0, false);
+  AddLeaf("leaf_b", 1);
+  StartWorkers();
+
+  sched(0)->AddCycles(0, 1000);
+  sched(1)->AddCycles(0, 1000);
+  rebalance_workers(0.2);
+
+  // The loads are close enough
+  Run(a, 300);
+  sched(0)->AddCycles(600, 400);
+  sched(1)->AddCycles(500, 500);
+  rebalance_result ret = rebalance_workers(0.2);
+  EXPECT_FALSE(ret.moved);
+  EXPECT_EQ(0, ret.from_wid);
+  EXPECT_EQ(1, ret.to_wid);
+  EXPECT_DOUBLE_EQ(0.6, ret.from_load);
+  EXPECT_DOUBLE_EQ(0.5, ret.to_load);
+
+  // leaf_a would only flip the imbalance around, and leaf_fixed must stay
+  Run(a, 850);
+  Run(fixed, 50);
+  sched(0)->AddCycles(900, 100);
+  sched(1)->AddCycles(100, 900);
+  ret = rebalance_workers(0.2);
+  EXPECT_FALSE(ret.moved);
+  EXPECT_EQ(0, ret.from_wid);
+  EXPECT_EQ(1, ret.to_wid);
+
+  // Paused workers are left out
+  pause_worker(1);
+  Run(a, 400);
+  sched(0)->AddCycles(900, 100);
+  sched(1)->AddCycles(0, 1000);
+  ret = rebalance_workers(0.2);
+  EXPECT_FALSE(ret.moved);
+  EXPECT_EQ(0, ret.from_wid);
+  EXPECT_EQ(0, ret.to_wid);
+  resume_worker(1);
+
+  EXPECT_EQ(0, a->WorkerId());
+  EXPECT_EQ(0, fixed->WorkerId());
+}
@@ -448,6 +448,17 @@ class BESS(object):
         request.ogate = ogate
         return self._request('DisconnectModules', request)
 
+    def swap_gate(self, m1, m2, ogate=0, igate=0, destroy=[],
+                  drain_timeout_sec=0):
+        request = bess_msg.SwapGateRequest()
+        request.m1 = m1
+        request.m2 = m2
+        request.ogate = ogate
+        request.igate = igate
+        request.destroy.extend(destroy)
+        request.drain_timeout_sec = drain_timeout_sec
+        return self._request('SwapGate', request)
+
     def run_module_command(self, name, cmd, arg_type, arg):
         request = bess_msg.CommandRequest()
         request.name = name
@@ -502,6 +513,31 @@ class BESS(object):
         request.arg.Pack(arg)
         return self._request('ConfigureGateHook', request)
 
+    def gate_hook_command(self, hook, module, cmd, arg, direction='out',
+                          gate=0):
+        request = bess_msg.ConfigureGateHookRequest()
+        request.hook_name = hook
+        request.module_name = module
+        request.cmd = cmd
+        if direction == 'in':
+            request.igate = gate
+        elif direction == 'out':
+            request.ogate = gate
+        else:
+            raise self.APIError('direction must be either "out" or "in"')
+        request.arg.Pack(arg)
+        response = self._request('ConfigureGateHook', request)
+
+        if response.HasField('data'):
+            response_type_str = response.data.type_url.split('.')[-1]
+            response_type = getattr(bess_msg, response_type_str,
+                                    bess_msg.EmptyResponse)
+            result = response_type()
+            response.data.Unpack(result)
+            return result
+        else:
+            return response
+
     def configure_resume_hook(self, hook, arg, enable=True):
         if enable is None:
             enable = True
@@ -518,29 +554,82 @@ class BESS(object):
         return self._configure_gate_hook('tcpdump', m, arg, enable, direction,
                                          gate)
 
-    def track_module(self, m, enable, bits=False, direction='out', gate=-1):
+    def track_module(self, m, enable, bits=False, direction='out', gate=-1,
+                     batch_hist=False):
         arg = bess_msg.TrackArg()
         arg.bits = bits
+        arg.batch_hist = batch_hist
         return self._configure_gate_hook('track', m, arg, enable, direction,
                                          gate)
 
-    def pcapng(self, enable, m, direction='out', gate=0, fifo=None):
+    def latency_trace(self, enable, m, direction='out', gate=0, mode=None,
+                      sample_rate=0, attr_name=None, bucket_ns=0,
+                      num_buckets=0):
+        arg = bess_msg.LatencyTraceArg()
+        if mode is not None:
+            arg.mode = mode
+        arg.sample_rate = sample_rate
+        if attr_name is not None:
+            arg.attr_name = attr_name
+        arg.bucket_ns = bucket_ns
+        arg.num_buckets = num_buckets
+        return self._configure_gate_hook('latency', m, arg, enable, direction,
+                                         gate)
+
+    def latency_summary(self, m, direction='out', gate=0, percentiles=None,
+                        clear=False):
+        arg = bess_msg.LatencyTraceCommandGetSummaryArg()
+        arg.clear = clear
+        arg.percentiles.extend(percentiles or [])
+        return self.gate_hook_command('latency', m, 'get_summary', arg,
+                                      direction, gate)
+
+    def pcapng(self, enable, m, direction='out', gate=0, fifo=None,
+               file_prefix=None, file_size=0, file_count=0, rotate_secs=0,
+               snaplen=0):
         arg = bess_msg.PcapngArg()
         if fifo is not None:
             arg.fifo = fifo
+        if file_prefix is not None:
+            arg.file_prefix = file_prefix
+        arg.file_size = file_size
+        arg.file_count = file_count
+        arg.rotate_secs = rotate_secs
+        arg.snaplen = snaplen
         return self._configure_gate_hook('pcapng', m, arg, enable, direction,
                                          gate)
 
+    def capture(self, enable, m, direction='out', gate=0, path=None,
+                snaplen=0, sample_rate=0, filter=None, ring_size=0):
+        arg = bess_msg.CaptureArg()
+        if path is not None:
+            arg.path = path
+        arg.snaplen = snaplen
+        arg.sample_rate = sample_rate
+        if filter is not None:
+            arg.filter = filter
+        arg.ring_size = ring_size
+        return self._configure_gate_hook('capture', m, arg, enable, direction,
+                                         gate)
+
     def list_workers(self):
         return self._request('ListWorkers')
 
-    def add_worker(self, wid, core, scheduler=None):
+    def add_worker(self, wid, core, scheduler=None, idle_sleep_us=0,
+                   max_poll_latency_us=0):
         request = bess_msg.AddWorkerRequest()
         request.wid = wid
         request.core = core
         request.scheduler = scheduler or ''
+        request.idle_sleep_us = idle_sleep_us
+        request.max_poll_latency_us = max_poll_latency_us
         return self._request('AddWorker', request)
 
+    def rebalance_workers(self, min_load_gap=0):
+        request = bess_msg.RebalanceWorkersRequest()
+        request.min_load_gap = min_load_gap
+        return self._request('RebalanceWorkers', request)
+
     def destroy_worker(self, wid):
         request = bess_msg.DestroyWorkerRequest()
         request.wid = wid
@@ -646,6 +735,30 @@ class BESS(object):
         request.name = name
         return self._request('GetTcStats', request)
 
+    # Yields a StatsSnapshot (counter deltas of all ports, tracked gates and
+    # TCs) every interval_sec. Stops when the generator is closed.
+    def stream_stats(self, interval_sec=0, max_snapshots=0):
+        if not self.is_connected():
+            raise self.APIError('BESS daemon not connected')
+
+        request = bess_msg.StreamStatsRequest()
+        request.interval_sec = interval_sec
+        request.max_snapshots = max_snapshots
+
+        responses = self.stub.StreamStats(request)
+        try:
+            for snapshot in responses:
+                if snapshot.error.code != 0:
+                    raise self.Error(snapshot.error.code,
+                                     snapshot.error.errmsg,
+                                     query='StreamStats',
+                                     query_arg={'interval_sec': interval_sec})
+                yield snapshot
+        except grpc._channel._Rendezvous as e:
+            raise self.RPCError(str(e))
+        finally:
+            responses.cancel()
+
     def dump_mempool(self, socket=-1):
         request = bess_msg.DumpMempoolRequest()
         request.socket = socket